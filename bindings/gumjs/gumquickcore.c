@@ -5711,6 +5711,7 @@ gum_quick_core_setup_atoms (GumQuickCore * self)
   GUM_SETUP_ATOM (file);
   GUM_SETUP_ATOM (handle);
   GUM_SETUP_ATOM (id);
+  GUM_SETUP_ATOM (index);
   GUM_SETUP_ATOM (ip);
   GUM_SETUP_ATOM (isGlobal);
   GUM_SETUP_ATOM (length);
@@ -5789,6 +5790,7 @@ gum_quick_core_teardown_atoms (GumQuickCore * self)
   GUM_TEARDOWN_ATOM (file);
   GUM_TEARDOWN_ATOM (handle);
   GUM_TEARDOWN_ATOM (id);
+  GUM_TEARDOWN_ATOM (index);
   GUM_TEARDOWN_ATOM (ip);
   GUM_TEARDOWN_ATOM (isGlobal);
   GUM_TEARDOWN_ATOM (length);
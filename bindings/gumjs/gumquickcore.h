@@ -140,6 +140,7 @@ struct _GumQuickCore
   GUM_DECLARE_ATOM (file);
   GUM_DECLARE_ATOM (handle);
   GUM_DECLARE_ATOM (id);
+  GUM_DECLARE_ATOM (index);
   GUM_DECLARE_ATOM (ip);
   GUM_DECLARE_ATOM (isGlobal);
   GUM_DECLARE_ATOM (length);
@@ -23,6 +23,8 @@ typedef guint GumMemoryValueType;
 typedef struct _GumMemoryPatchContext GumMemoryPatchContext;
 typedef struct _GumMemoryScanContext GumMemoryScanContext;
 typedef struct _GumMemoryScanSyncContext GumMemoryScanSyncContext;
+typedef struct _GumMemoryScanMultiContext GumMemoryScanMultiContext;
+typedef struct _GumMemoryScanMultiSyncContext GumMemoryScanMultiSyncContext;
 
 enum _GumMemoryValueType
 {
@@ -76,6 +78,28 @@ struct _GumMemoryScanSyncContext
   GumQuickCore * core;
 };
 
+struct _GumMemoryScanMultiContext
+{
+  GumMemoryRange range;
+  GPtrArray * patterns;
+  JSValue on_match;
+  JSValue on_error;
+  JSValue on_complete;
+  GumQuickMatchResult result;
+
+  JSContext * ctx;
+  GumQuickCore * core;
+};
+
+struct _GumMemoryScanMultiSyncContext
+{
+  JSValue matches;
+  uint32_t index;
+
+  JSContext * ctx;
+  GumQuickCore * core;
+};
+
 GUMJS_DECLARE_FUNCTION (gumjs_memory_alloc)
 GUMJS_DECLARE_FUNCTION (gumjs_memory_copy)
 GUMJS_DECLARE_FUNCTION (gumjs_memory_protect)
@@ -91,6 +115,7 @@ static JSValue gum_quick_memory_write (JSContext * ctx, GumMemoryValueType type,
     GumQuickArgs * args, GumQuickCore * core);
 GUMJS_DECLARE_FUNCTION (gum_quick_memory_read_volatile)
 GUMJS_DECLARE_FUNCTION (gum_quick_memory_write_volatile)
+GUMJS_DECLARE_FUNCTION (gum_quick_memory_read_many)
 
 static void gum_quick_memory_on_access (GumMemoryAccessMonitor * monitor,
     const GumMemoryAccessDetails * details, GumQuickMemory * self);
@@ -153,6 +178,22 @@ static gboolean gum_memory_scan_context_emit_match (GumAddress address,
 GUMJS_DECLARE_FUNCTION (gumjs_memory_scan_sync)
 static gboolean gum_append_match (GumAddress address, gsize size,
     GumMemoryScanSyncContext * sc);
+GUMJS_DECLARE_FUNCTION (gumjs_memory_scan_multi)
+static void gum_memory_scan_multi_context_free (
+    GumMemoryScanMultiContext * self);
+static void gum_memory_scan_multi_context_run (
+    GumMemoryScanMultiContext * self);
+static gboolean gum_memory_scan_multi_context_emit_match (guint pattern_index,
+    GumAddress address, gsize size, GumMemoryScanMultiContext * self);
+GUMJS_DECLARE_FUNCTION (gumjs_memory_scan_multi_sync)
+static gboolean gum_append_multi_match (guint pattern_index,
+    GumAddress address, gsize size, GumMemoryScanMultiSyncContext * sc);
+
+GUMJS_DECLARE_CONSTRUCTOR (gumjs_memory_snapshot_construct)
+GUMJS_DECLARE_FINALIZER (gumjs_memory_snapshot_finalize)
+GUMJS_DECLARE_GETTER (gumjs_memory_snapshot_get_size)
+GUMJS_DECLARE_GETTER (gumjs_memory_snapshot_get_unique_page_count)
+GUMJS_DECLARE_FUNCTION (gumjs_memory_snapshot_diff)
 
 GUMJS_DECLARE_FUNCTION (gumjs_memory_access_monitor_enable)
 GUMJS_DECLARE_FUNCTION (gumjs_memory_access_monitor_disable)
@@ -201,6 +242,7 @@ static const JSCFunctionListEntry gumjs_memory_entries[] =
   GUMJS_EXPORT_MEMORY_READ_WRITE ("AnsiString", ANSI_STRING),
   JS_CFUNC_DEF ("readVolatile", 0, gum_quick_memory_read_volatile),
   JS_CFUNC_DEF ("writeVolatile", 0, gum_quick_memory_write_volatile),
+  JS_CFUNC_DEF ("readMany", 0, gum_quick_memory_read_many),
 
   JS_CFUNC_DEF ("allocAnsiString", 0, gumjs_memory_alloc_ansi_string),
   JS_CFUNC_DEF ("allocUtf8String", 0, gumjs_memory_alloc_utf8_string),
@@ -208,6 +250,22 @@ static const JSCFunctionListEntry gumjs_memory_entries[] =
 
   JS_CFUNC_DEF ("_scan", 0, gumjs_memory_scan),
   JS_CFUNC_DEF ("scanSync", 0, gumjs_memory_scan_sync),
+  JS_CFUNC_DEF ("_scanMulti", 0, gumjs_memory_scan_multi),
+  JS_CFUNC_DEF ("scanMultiSync", 0, gumjs_memory_scan_multi_sync),
+};
+
+static const JSClassDef gumjs_memory_snapshot_def =
+{
+  .class_name = "MemorySnapshot",
+  .finalizer = gumjs_memory_snapshot_finalize,
+};
+
+static const JSCFunctionListEntry gumjs_memory_snapshot_entries[] =
+{
+  JS_CGETSET_DEF ("size", gumjs_memory_snapshot_get_size, NULL),
+  JS_CGETSET_DEF ("uniquePageCount",
+      gumjs_memory_snapshot_get_unique_page_count, NULL),
+  JS_CFUNC_DEF ("_diff", 0, gumjs_memory_snapshot_diff),
 };
 
 static const JSCFunctionListEntry gumjs_memory_access_monitor_entries[] =
@@ -243,7 +301,7 @@ _gum_quick_memory_init (GumQuickMemory * self,
                         GumQuickCore * core)
 {
   JSContext * ctx = core->ctx;
-  JSValue obj, proto;
+  JSValue obj, proto, ctor;
 
   self->core = core;
   self->monitor = NULL;
@@ -256,6 +314,16 @@ _gum_quick_memory_init (GumQuickMemory * self,
       G_N_ELEMENTS (gumjs_memory_entries));
   JS_DefinePropertyValueStr (ctx, ns, "Memory", obj, JS_PROP_C_W_E);
 
+  _gum_quick_create_class (ctx, &gumjs_memory_snapshot_def, core,
+      &self->memory_snapshot_class, &proto);
+  ctor = JS_NewCFunction2 (ctx, gumjs_memory_snapshot_construct,
+      gumjs_memory_snapshot_def.class_name, 0, JS_CFUNC_constructor, 0);
+  JS_SetConstructor (ctx, ctor, proto);
+  JS_SetPropertyFunctionList (ctx, proto, gumjs_memory_snapshot_entries,
+      G_N_ELEMENTS (gumjs_memory_snapshot_entries));
+  JS_DefinePropertyValueStr (ctx, ns, gumjs_memory_snapshot_def.class_name,
+      ctor, JS_PROP_C_W_E);
+
   obj = JS_NewObject (ctx);
   JS_SetPropertyFunctionList (ctx, obj, gumjs_memory_access_monitor_entries,
       G_N_ELEMENTS (gumjs_memory_access_monitor_entries));
@@ -882,6 +950,52 @@ GUMJS_DEFINE_FUNCTION (gum_quick_memory_read_volatile)
       _gum_quick_array_buffer_free, data, FALSE);
 }
 
+GUMJS_DEFINE_FUNCTION (gum_quick_memory_read_many)
+{
+  JSValue result;
+  GArray * ranges;
+  gsize total_size, offset;
+  guint8 * buffer;
+  gsize * n_bytes_read;
+  guint i;
+
+  if (!_gum_quick_args_parse (args, "R", &ranges))
+    return JS_EXCEPTION;
+
+  total_size = 0;
+  for (i = 0; i != ranges->len; i++)
+    total_size += g_array_index (ranges, GumMemoryRange, i).size;
+
+  buffer = g_malloc (total_size);
+  n_bytes_read = g_new (gsize, ranges->len);
+
+  gum_memory_read_many ((const GumMemoryRange *) ranges->data, ranges->len,
+      buffer, n_bytes_read);
+
+  result = JS_NewArray (ctx);
+
+  offset = 0;
+  for (i = 0; i != ranges->len; i++)
+  {
+    gsize size = g_array_index (ranges, GumMemoryRange, i).size;
+    JSValue data;
+
+    if (n_bytes_read[i] == 0 && size != 0)
+      data = JS_NULL;
+    else
+      data = JS_NewArrayBufferCopy (ctx, buffer + offset, n_bytes_read[i]);
+
+    JS_DefinePropertyValueUint32 (ctx, result, i, data, JS_PROP_C_W_E);
+
+    offset += size;
+  }
+
+  g_free (n_bytes_read);
+  g_free (buffer);
+
+  return result;
+}
+
 GUMJS_DEFINE_FUNCTION (gum_quick_memory_write_volatile)
 {
   JSValue result;
@@ -1079,7 +1193,7 @@ gum_memory_scan_context_run (GumMemoryScanContext * self)
 
   if (gum_exceptor_try (exceptor, &exceptor_scope))
   {
-    gum_memory_scan (&self->range, self->pattern,
+    gum_memory_scan_parallel (&self->range, self->pattern, 0,
         (GumMemoryScanMatchFunc) gum_memory_scan_context_emit_match, self);
   }
 
@@ -1203,6 +1317,340 @@ gum_append_match (GumAddress address,
   return TRUE;
 }
 
+GUMJS_DEFINE_FUNCTION (gumjs_memory_scan_multi)
+{
+  gpointer address;
+  gsize size;
+  JSValue patterns_val;
+  GumMemoryScanMultiContext sc;
+
+  if (!_gum_quick_args_parse (args, "pZAF{onMatch,onError,onComplete}",
+      &address, &size, &patterns_val, &sc.on_match, &sc.on_error,
+      &sc.on_complete))
+    return JS_EXCEPTION;
+
+  if (!_gum_quick_match_patterns_get (ctx, patterns_val, core, &sc.patterns))
+    return JS_EXCEPTION;
+
+  sc.range.base_address = GUM_ADDRESS (address);
+  sc.range.size = size;
+
+  JS_DupValue (ctx, sc.on_match);
+  JS_DupValue (ctx, sc.on_error);
+  JS_DupValue (ctx, sc.on_complete);
+
+  sc.result = GUM_QUICK_MATCH_CONTINUE;
+
+  sc.ctx = ctx;
+  sc.core = core;
+
+  _gum_quick_core_pin (core);
+  _gum_quick_core_push_job (core,
+      (GumScriptJobFunc) gum_memory_scan_multi_context_run,
+      g_slice_dup (GumMemoryScanMultiContext, &sc),
+      (GDestroyNotify) gum_memory_scan_multi_context_free);
+
+  return JS_UNDEFINED;
+}
+
+static void
+gum_memory_scan_multi_context_free (GumMemoryScanMultiContext * self)
+{
+  JSContext * ctx = self->ctx;
+  GumQuickCore * core = self->core;
+  GumQuickScope scope;
+
+  _gum_quick_scope_enter (&scope, core);
+
+  JS_FreeValue (ctx, self->on_match);
+  JS_FreeValue (ctx, self->on_error);
+  JS_FreeValue (ctx, self->on_complete);
+
+  _gum_quick_core_unpin (core);
+  _gum_quick_scope_leave (&scope);
+
+  g_ptr_array_unref (self->patterns);
+
+  g_slice_free (GumMemoryScanMultiContext, self);
+}
+
+static void
+gum_memory_scan_multi_context_run (GumMemoryScanMultiContext * self)
+{
+  JSContext * ctx = self->ctx;
+  GumQuickCore * core = self->core;
+  GumExceptor * exceptor = core->exceptor;
+  GumExceptorScope exceptor_scope;
+  GumQuickScope script_scope;
+
+  if (gum_exceptor_try (exceptor, &exceptor_scope))
+  {
+    gum_memory_scan_multi (&self->range,
+        (GumMatchPattern * const *) self->patterns->pdata,
+        self->patterns->len,
+        (GumMemoryScanMultiMatchFunc) gum_memory_scan_multi_context_emit_match,
+        self);
+  }
+
+  _gum_quick_scope_enter (&script_scope, core);
+
+  if (gum_exceptor_catch (exceptor, &exceptor_scope))
+  {
+    if (!JS_IsNull (self->on_error))
+    {
+      gchar * message;
+      JSValue message_val;
+
+      message = gum_exception_details_to_string (&exceptor_scope.exception);
+      message_val = JS_NewString (ctx, message);
+      g_free (message);
+
+      _gum_quick_scope_call_void (&script_scope, self->on_error, JS_UNDEFINED,
+          1, &message_val);
+    }
+  }
+
+  if (self->result != GUM_QUICK_MATCH_ERROR)
+  {
+    _gum_quick_scope_call_void (&script_scope, self->on_complete, JS_UNDEFINED,
+        0, NULL);
+  }
+
+  _gum_quick_scope_leave (&script_scope);
+}
+
+static gboolean
+gum_memory_scan_multi_context_emit_match (guint pattern_index,
+                                          GumAddress address,
+                                          gsize size,
+                                          GumMemoryScanMultiContext * self)
+{
+  gboolean proceed;
+  JSContext * ctx = self->ctx;
+  GumQuickCore * core = self->core;
+  GumQuickScope scope;
+  JSValue argv[3];
+  JSValue result;
+
+  _gum_quick_scope_enter (&scope, core);
+
+  argv[0] = _gum_quick_native_pointer_new (ctx, GSIZE_TO_POINTER (address),
+      core);
+  argv[1] = JS_NewUint32 (ctx, size);
+  argv[2] = JS_NewUint32 (ctx, pattern_index);
+
+  result = _gum_quick_scope_call (&scope, self->on_match, JS_UNDEFINED,
+      G_N_ELEMENTS (argv), argv);
+
+  JS_FreeValue (ctx, argv[0]);
+
+  proceed = _gum_quick_process_match_result (ctx, &result, &self->result);
+
+  _gum_quick_scope_leave (&scope);
+
+  return proceed;
+}
+
+GUMJS_DEFINE_FUNCTION (gumjs_memory_scan_multi_sync)
+{
+  JSValue result;
+  gpointer address;
+  gsize size;
+  JSValue patterns_val;
+  GPtrArray * patterns;
+  GumMemoryRange range;
+  GumExceptorScope scope;
+
+  if (!_gum_quick_args_parse (args, "pZA", &address, &size, &patterns_val))
+    return JS_EXCEPTION;
+
+  if (!_gum_quick_match_patterns_get (ctx, patterns_val, core, &patterns))
+    return JS_EXCEPTION;
+
+  range.base_address = GUM_ADDRESS (address);
+  range.size = size;
+
+  result = JS_NewArray (ctx);
+
+  if (gum_exceptor_try (core->exceptor, &scope))
+  {
+    GumMemoryScanMultiSyncContext sc;
+
+    sc.matches = result;
+    sc.index = 0;
+
+    sc.ctx = ctx;
+    sc.core = core;
+
+    gum_memory_scan_multi (&range,
+        (GumMatchPattern * const *) patterns->pdata, patterns->len,
+        (GumMemoryScanMultiMatchFunc) gum_append_multi_match, &sc);
+  }
+
+  if (gum_exceptor_catch (core->exceptor, &scope))
+  {
+    JS_FreeValue (ctx, result);
+    result = _gum_quick_throw_native (ctx, &scope.exception, core);
+  }
+
+  g_ptr_array_unref (patterns);
+
+  return result;
+}
+
+static gboolean
+gum_append_multi_match (guint pattern_index,
+                        GumAddress address,
+                        gsize size,
+                        GumMemoryScanMultiSyncContext * sc)
+{
+  JSContext * ctx = sc->ctx;
+  GumQuickCore * core = sc->core;
+  JSValue m;
+
+  m = JS_NewObject (ctx);
+  JS_DefinePropertyValue (ctx, m, GUM_QUICK_CORE_ATOM (core, address),
+      _gum_quick_native_pointer_new (ctx, GSIZE_TO_POINTER (address), core),
+      JS_PROP_C_W_E);
+  JS_DefinePropertyValue (ctx, m, GUM_QUICK_CORE_ATOM (core, size),
+      JS_NewUint32 (ctx, size),
+      JS_PROP_C_W_E);
+  JS_DefinePropertyValue (ctx, m, GUM_QUICK_CORE_ATOM (core, index),
+      JS_NewUint32 (ctx, pattern_index),
+      JS_PROP_C_W_E);
+
+  JS_DefinePropertyValueUint32 (ctx, sc->matches, sc->index, m, JS_PROP_C_W_E);
+  sc->index++;
+
+  return TRUE;
+}
+
+static gboolean
+gum_quick_memory_snapshot_get (JSContext * ctx,
+                               JSValueConst val,
+                               GumQuickCore * core,
+                               GumMemorySnapshot ** snapshot)
+{
+  return _gum_quick_unwrap (ctx, val,
+      gumjs_get_parent_module (core)->memory_snapshot_class, core,
+      (gpointer *) snapshot);
+}
+
+GUMJS_DEFINE_CONSTRUCTOR (gumjs_memory_snapshot_construct)
+{
+  JSValue wrapper;
+  GArray * ranges;
+  JSValue previous_val;
+  gboolean track_dirty;
+  GumMemorySnapshot * previous;
+  JSValue proto;
+
+  previous_val = JS_NULL;
+  track_dirty = FALSE;
+  if (!_gum_quick_args_parse (args, "R|O?t", &ranges, &previous_val,
+      &track_dirty))
+    return JS_EXCEPTION;
+
+  previous = NULL;
+  if (!JS_IsNull (previous_val) &&
+      !gum_quick_memory_snapshot_get (ctx, previous_val, core, &previous))
+    return JS_EXCEPTION;
+
+  proto = JS_GetProperty (ctx, new_target,
+      GUM_QUICK_CORE_ATOM (core, prototype));
+  wrapper = JS_NewObjectProtoClass (ctx, proto,
+      gumjs_get_parent_module (core)->memory_snapshot_class);
+  JS_FreeValue (ctx, proto);
+  if (JS_IsException (wrapper))
+    return JS_EXCEPTION;
+
+  JS_SetOpaque (wrapper, gum_memory_snapshot_take (
+      (const GumMemoryRange *) ranges->data, ranges->len, previous,
+      track_dirty
+          ? GUM_MEMORY_SNAPSHOT_TRACK_DIRTY
+          : GUM_MEMORY_SNAPSHOT_FLAGS_NONE));
+
+  return wrapper;
+}
+
+GUMJS_DEFINE_FINALIZER (gumjs_memory_snapshot_finalize)
+{
+  GumMemorySnapshot * snapshot;
+
+  snapshot = JS_GetOpaque (val,
+      gumjs_get_parent_module (core)->memory_snapshot_class);
+  if (snapshot == NULL)
+    return;
+
+  gum_memory_snapshot_unref (snapshot);
+}
+
+GUMJS_DEFINE_GETTER (gumjs_memory_snapshot_get_size)
+{
+  GumMemorySnapshot * self;
+
+  if (!gum_quick_memory_snapshot_get (ctx, this_val, core, &self))
+    return JS_EXCEPTION;
+
+  return JS_NewInt64 (ctx, gum_memory_snapshot_get_size (self));
+}
+
+GUMJS_DEFINE_GETTER (gumjs_memory_snapshot_get_unique_page_count)
+{
+  GumMemorySnapshot * self;
+
+  if (!gum_quick_memory_snapshot_get (ctx, this_val, core, &self))
+    return JS_EXCEPTION;
+
+  return JS_NewUint32 (ctx, gum_memory_snapshot_get_unique_page_count (self));
+}
+
+/*
+ * Returns the offsets followed by the sizes, as doubles, which the runtime
+ * exposes as a pair of Float64Arrays.
+ */
+GUMJS_DEFINE_FUNCTION (gumjs_memory_snapshot_diff)
+{
+  GumMemorySnapshot * self, * other;
+  JSValue other_val;
+  GArray * changes;
+  GError * error;
+  gdouble * data;
+  guint n, i;
+
+  if (!gum_quick_memory_snapshot_get (ctx, this_val, core, &self))
+    return JS_EXCEPTION;
+
+  other_val = JS_NULL;
+  if (!_gum_quick_args_parse (args, "|O?", &other_val))
+    return JS_EXCEPTION;
+
+  other = NULL;
+  if (!JS_IsNull (other_val) &&
+      !gum_quick_memory_snapshot_get (ctx, other_val, core, &other))
+    return JS_EXCEPTION;
+
+  error = NULL;
+  changes = gum_memory_snapshot_diff (self, other, &error);
+  if (changes == NULL)
+    return _gum_quick_throw_error (ctx, &error);
+
+  n = changes->len;
+  data = g_new (gdouble, 2 * MAX (n, 1));
+  for (i = 0; i != n; i++)
+  {
+    const GumMemoryChange * c = &g_array_index (changes, GumMemoryChange, i);
+
+    data[i] = c->offset;
+    data[n + i] = c->size;
+  }
+
+  g_array_free (changes, TRUE);
+
+  return JS_NewArrayBuffer (ctx, (uint8_t *) data, 2 * n * sizeof (gdouble),
+      _gum_quick_array_buffer_free, data, FALSE);
+}
+
 GUMJS_DEFINE_FUNCTION (gumjs_memory_access_monitor_enable)
 {
   GumQuickMemory * self;
@@ -10,6 +10,7 @@
 #include "gumquickcore.h"
 
 #include <gum/gummemoryaccessmonitor.h>
+#include <gum/gummemorysnapshot.h>
 
 G_BEGIN_DECLS
 
@@ -23,6 +24,7 @@ struct _GumQuickMemory
   JSValue on_access;
 
   JSClassID memory_access_details_class;
+  JSClassID memory_snapshot_class;
 };
 
 G_GNUC_INTERNAL void _gum_quick_memory_init (GumQuickMemory * self, JSValue ns,
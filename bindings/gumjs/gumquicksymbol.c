@@ -20,6 +20,7 @@ struct _GumSymbol
 };
 
 GUMJS_DECLARE_FUNCTION (gumjs_symbol_from_address)
+GUMJS_DECLARE_FUNCTION (gumjs_symbol_from_addresses)
 GUMJS_DECLARE_FUNCTION (gumjs_symbol_from_name)
 GUMJS_DECLARE_FUNCTION (gumjs_symbol_get_function_by_name)
 GUMJS_DECLARE_FUNCTION (gumjs_symbol_find_functions_named)
@@ -51,6 +52,7 @@ static const JSClassDef gumjs_symbol_def =
 static const JSCFunctionListEntry gumjs_symbol_module_entries[] =
 {
   JS_CFUNC_DEF ("fromAddress", 0, gumjs_symbol_from_address),
+  JS_CFUNC_DEF ("fromAddresses", 0, gumjs_symbol_from_addresses),
   JS_CFUNC_DEF ("fromName", 0, gumjs_symbol_from_name),
   JS_CFUNC_DEF ("getFunctionByName", 0, gumjs_symbol_get_function_by_name),
   JS_CFUNC_DEF ("findFunctionsNamed", 0, gumjs_symbol_find_functions_named),
@@ -135,6 +137,77 @@ GUMJS_DEFINE_FUNCTION (gumjs_symbol_from_address)
   return wrapper;
 }
 
+GUMJS_DEFINE_FUNCTION (gumjs_symbol_from_addresses)
+{
+  JSValue result;
+  JSValue addresses_val, element;
+  GumQuickSymbol * parent;
+  guint n, i;
+  gpointer * addresses;
+  GumDebugSymbolDetails * details;
+  gboolean * resolved;
+  GumQuickScope scope = GUM_QUICK_SCOPE_INIT (core);
+
+  if (!_gum_quick_args_parse (args, "A", &addresses_val))
+    return JS_EXCEPTION;
+
+  if (!_gum_quick_array_get_length (ctx, addresses_val, core, &n))
+    return JS_EXCEPTION;
+
+  addresses = g_new (gpointer, n);
+  for (i = 0; i != n; i++)
+  {
+    gboolean valid;
+
+    element = JS_GetPropertyUint32 (ctx, addresses_val, i);
+    if (JS_IsException (element))
+      goto propagate_exception;
+
+    valid = _gum_quick_native_pointer_get (ctx, element, core, &addresses[i]);
+    JS_FreeValue (ctx, element);
+    if (!valid)
+      goto propagate_exception;
+  }
+
+  details = g_new0 (GumDebugSymbolDetails, n);
+  resolved = g_new (gboolean, n);
+
+  _gum_quick_scope_suspend (&scope);
+
+  gum_symbol_details_from_addresses (addresses, n, details, resolved);
+
+  _gum_quick_scope_resume (&scope);
+
+  parent = gumjs_get_parent_module (core);
+
+  result = JS_NewArray (ctx);
+  for (i = 0; i != n; i++)
+  {
+    GumSymbol * sym;
+
+    element = gum_symbol_new (ctx, parent, &sym);
+
+    sym->details = details[i];
+    sym->details.address = GPOINTER_TO_SIZE (addresses[i]);
+    sym->resolved = resolved[i];
+
+    JS_DefinePropertyValueUint32 (ctx, result, i, element, JS_PROP_C_W_E);
+  }
+
+  g_free (resolved);
+  g_free (details);
+  g_free (addresses);
+
+  return result;
+
+propagate_exception:
+  {
+    g_free (addresses);
+
+    return JS_EXCEPTION;
+  }
+}
+
 GUMJS_DEFINE_FUNCTION (gumjs_symbol_from_name)
 {
   JSValue wrapper;
@@ -548,33 +548,8 @@ _gum_quick_args_parse (GumQuickArgs * self,
       {
         GumMatchPattern * pattern;
 
-        if (JS_IsString (arg))
-        {
-          const char * str;
-
-          str = JS_ToCString (ctx, arg);
-          if (str == NULL)
-            goto propagate_exception;
-
-          pattern = gum_match_pattern_new_from_string (str);
-
-          JS_FreeCString (ctx, str);
-
-          if (pattern == NULL)
-            goto invalid_pattern;
-        }
-        else if (JS_IsObject (arg))
-        {
-          pattern = JS_GetOpaque (arg, core->match_pattern_class);
-          if (pattern == NULL)
-            goto expected_pattern;
-
-          gum_match_pattern_ref (pattern);
-        }
-        else
-        {
-          goto expected_pattern;
-        }
+        if (!_gum_quick_match_pattern_get (ctx, arg, core, &pattern))
+          goto propagate_exception;
 
         *va_arg (ap, GumMatchPattern **) = pattern;
 
@@ -628,16 +603,6 @@ expected_function:
     error_message = "expected a function";
     goto propagate_exception;
   }
-invalid_pattern:
-  {
-    error_message = "invalid match pattern";
-    goto propagate_exception;
-  }
-expected_pattern:
-  {
-    error_message = "expected either a pattern string or a MatchPattern object";
-    goto propagate_exception;
-  }
 propagate_exception:
   {
     va_end (ap);
@@ -1734,6 +1699,108 @@ propagate_exception:
   }
 }
 
+gboolean
+_gum_quick_match_pattern_get (JSContext * ctx,
+                              JSValueConst val,
+                              GumQuickCore * core,
+                              GumMatchPattern ** pattern)
+{
+  GumMatchPattern * result;
+
+  if (JS_IsString (val))
+  {
+    const char * str;
+
+    str = JS_ToCString (ctx, val);
+    if (str == NULL)
+      return FALSE;
+
+    result = gum_match_pattern_new_from_string (str);
+
+    JS_FreeCString (ctx, str);
+
+    if (result == NULL)
+      goto invalid_pattern;
+  }
+  else if (JS_IsObject (val))
+  {
+    result = JS_GetOpaque (val, core->match_pattern_class);
+    if (result == NULL)
+      goto expected_pattern;
+
+    gum_match_pattern_ref (result);
+  }
+  else
+  {
+    goto expected_pattern;
+  }
+
+  *pattern = result;
+  return TRUE;
+
+invalid_pattern:
+  {
+    _gum_quick_throw_literal (ctx, "invalid match pattern");
+    return FALSE;
+  }
+expected_pattern:
+  {
+    _gum_quick_throw_literal (ctx,
+        "expected either a pattern string or a MatchPattern object");
+    return FALSE;
+  }
+}
+
+gboolean
+_gum_quick_match_patterns_get (JSContext * ctx,
+                               JSValueConst val,
+                               GumQuickCore * core,
+                               GPtrArray ** patterns)
+{
+  GPtrArray * result;
+  JSValue element = JS_NULL;
+  guint n, i;
+
+  if (!JS_IsArray (ctx, val))
+  {
+    _gum_quick_throw_literal (ctx, "expected an array of patterns");
+    return FALSE;
+  }
+
+  if (!_gum_quick_array_get_length (ctx, val, core, &n))
+    return FALSE;
+
+  result = g_ptr_array_new_full (n, (GDestroyNotify) gum_match_pattern_unref);
+
+  for (i = 0; i != n; i++)
+  {
+    GumMatchPattern * pattern;
+
+    element = JS_GetPropertyUint32 (ctx, val, i);
+    if (JS_IsException (element))
+      goto propagate_exception;
+
+    if (!_gum_quick_match_pattern_get (ctx, element, core, &pattern))
+      goto propagate_exception;
+
+    g_ptr_array_add (result, pattern);
+
+    JS_FreeValue (ctx, element);
+    element = JS_NULL;
+  }
+
+  *patterns = result;
+  return TRUE;
+
+propagate_exception:
+  {
+    JS_FreeValue (ctx, element);
+    g_ptr_array_unref (result);
+
+    return FALSE;
+  }
+}
+
 gboolean
 _gum_quick_memory_range_get (JSContext * ctx,
                              JSValueConst val,
@@ -131,6 +131,11 @@ G_GNUC_INTERNAL gboolean _gum_quick_memory_ranges_get (JSContext * ctx,
 G_GNUC_INTERNAL gboolean _gum_quick_memory_range_get (JSContext * ctx,
     JSValueConst val, GumQuickCore * core, GumMemoryRange * range);
 
+G_GNUC_INTERNAL gboolean _gum_quick_match_pattern_get (JSContext * ctx,
+    JSValueConst val, GumQuickCore * core, GumMatchPattern ** pattern);
+G_GNUC_INTERNAL gboolean _gum_quick_match_patterns_get (JSContext * ctx,
+    JSValueConst val, GumQuickCore * core, GPtrArray ** patterns);
+
 G_GNUC_INTERNAL JSValue _gum_quick_page_protection_new (JSContext * ctx,
     GumPageProtection prot);
 G_GNUC_INTERNAL gboolean _gum_quick_page_protection_get (JSContext * ctx,
@@ -73,6 +73,24 @@ struct GumMemoryScanSyncContext
   GumV8Core * core;
 };
 
+struct GumMemoryScanMultiContext
+{
+  GumMemoryRange range;
+  GPtrArray * patterns;
+  Global<Function> * on_match;
+  Global<Function> * on_error;
+  Global<Function> * on_complete;
+
+  GumV8Core * core;
+};
+
+struct GumV8MemorySnapshot
+{
+  Global<Object> * wrapper;
+  GumMemorySnapshot * handle;
+  GumV8Memory * module;
+};
+
 GUMJS_DECLARE_FUNCTION (gumjs_memory_alloc)
 GUMJS_DECLARE_FUNCTION (gumjs_memory_copy)
 GUMJS_DECLARE_FUNCTION (gumjs_memory_protect)
@@ -88,6 +106,7 @@ static void gum_v8_memory_write (GumMemoryValueType type,
     const GumV8Args * args);
 GUMJS_DECLARE_FUNCTION (gum_v8_memory_read_volatile)
 GUMJS_DECLARE_FUNCTION (gum_v8_memory_write_volatile)
+GUMJS_DECLARE_FUNCTION (gum_v8_memory_read_many)
 
 #ifdef HAVE_WINDOWS
 static gchar * gum_ansi_string_to_utf8 (const gchar * str_ansi, gint length);
@@ -147,6 +166,28 @@ static gboolean gum_memory_scan_context_emit_match (GumAddress address,
 GUMJS_DECLARE_FUNCTION (gumjs_memory_scan_sync)
 static gboolean gum_append_match (GumAddress address, gsize size,
     GumMemoryScanSyncContext * ctx);
+GUMJS_DECLARE_FUNCTION (gumjs_memory_scan_multi)
+static void gum_memory_scan_multi_context_free (
+    GumMemoryScanMultiContext * self);
+static void gum_memory_scan_multi_context_run (
+    GumMemoryScanMultiContext * self);
+static gboolean gum_memory_scan_multi_context_emit_match (guint pattern_index,
+    GumAddress address, gsize size, GumMemoryScanMultiContext * self);
+GUMJS_DECLARE_FUNCTION (gumjs_memory_scan_multi_sync)
+static gboolean gum_append_multi_match (guint pattern_index,
+    GumAddress address, gsize size, GumMemoryScanSyncContext * ctx);
+
+GUMJS_DECLARE_CONSTRUCTOR (gumjs_memory_snapshot_construct)
+GUMJS_DECLARE_GETTER (gumjs_memory_snapshot_get_size)
+GUMJS_DECLARE_GETTER (gumjs_memory_snapshot_get_unique_page_count)
+GUMJS_DECLARE_FUNCTION (gumjs_memory_snapshot_diff)
+static gboolean gum_v8_memory_snapshot_get (Local<Value> value,
+    GumMemorySnapshot ** snapshot, GumV8Memory * module);
+static GumV8MemorySnapshot * gum_v8_memory_snapshot_new (
+    Local<Object> wrapper, GumMemorySnapshot * handle, GumV8Memory * module);
+static void gum_v8_memory_snapshot_free (GumV8MemorySnapshot * self);
+static void gum_v8_memory_snapshot_on_weak_notify (
+    const WeakCallbackInfo<GumV8MemorySnapshot> & info);
 
 GUMJS_DECLARE_FUNCTION (gumjs_memory_access_monitor_enable)
 GUMJS_DECLARE_FUNCTION (gumjs_memory_access_monitor_disable)
@@ -187,6 +228,7 @@ static const GumV8Function gumjs_memory_functions[] =
   GUMJS_EXPORT_MEMORY_READ_WRITE ("AnsiString", ANSI_STRING),
   { "readVolatile", gum_v8_memory_read_volatile },
   { "writeVolatile", gum_v8_memory_write_volatile },
+  { "readMany", gum_v8_memory_read_many },
 
   { "allocAnsiString", gumjs_memory_alloc_ansi_string },
   { "allocUtf8String", gumjs_memory_alloc_utf8_string },
@@ -194,6 +236,23 @@ static const GumV8Function gumjs_memory_functions[] =
 
   { "_scan", gumjs_memory_scan },
   { "scanSync", gumjs_memory_scan_sync },
+  { "_scanMulti", gumjs_memory_scan_multi },
+  { "scanMultiSync", gumjs_memory_scan_multi_sync },
+
+  { NULL, NULL }
+};
+
+static const GumV8Property gumjs_memory_snapshot_values[] =
+{
+  { "size", gumjs_memory_snapshot_get_size, NULL },
+  { "uniquePageCount", gumjs_memory_snapshot_get_unique_page_count, NULL },
+
+  { NULL, NULL, NULL }
+};
+
+static const GumV8Function gumjs_memory_snapshot_functions[] =
+{
+  { "_diff", gumjs_memory_snapshot_diff },
 
   { NULL, NULL }
 };
@@ -220,6 +279,13 @@ _gum_v8_memory_init (GumV8Memory * self,
   auto memory = _gum_v8_create_module ("Memory", scope, isolate);
   _gum_v8_module_add (module, memory, gumjs_memory_functions, isolate);
 
+  auto snapshot = _gum_v8_create_class ("MemorySnapshot",
+      gumjs_memory_snapshot_construct, scope, module, isolate);
+  _gum_v8_class_add (snapshot, gumjs_memory_snapshot_values, module, isolate);
+  _gum_v8_class_add (snapshot, gumjs_memory_snapshot_functions, module,
+      isolate);
+  self->snapshot = new Global<FunctionTemplate> (isolate, snapshot);
+
   auto monitor = _gum_v8_create_module ("MemoryAccessMonitor", scope, isolate);
   _gum_v8_module_add (module, monitor, gumjs_memory_access_monitor_functions,
       isolate);
@@ -228,12 +294,20 @@ _gum_v8_memory_init (GumV8Memory * self,
 void
 _gum_v8_memory_realize (GumV8Memory * self)
 {
+  self->snapshots = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) gum_v8_memory_snapshot_free);
 }
 
 void
 _gum_v8_memory_dispose (GumV8Memory * self)
 {
   gum_v8_memory_clear_monitor (self);
+
+  g_hash_table_unref (self->snapshots);
+  self->snapshots = NULL;
+
+  delete self->snapshot;
+  self->snapshot = nullptr;
 }
 
 void
@@ -694,6 +768,55 @@ GUMJS_DEFINE_FUNCTION (gum_v8_memory_read_volatile)
   g_free (data);
 }
 
+GUMJS_DEFINE_FUNCTION (gum_v8_memory_read_many)
+{
+  GArray * ranges;
+  if (!_gum_v8_args_parse (args, "R", &ranges))
+    return;
+
+  auto context = isolate->GetCurrentContext ();
+
+  gsize total_size = 0;
+  for (guint i = 0; i != ranges->len; i++)
+    total_size += g_array_index (ranges, GumMemoryRange, i).size;
+
+  auto buffer = (guint8 *) g_malloc (total_size);
+  auto n_bytes_read = g_new (gsize, ranges->len);
+
+  gum_memory_read_many ((const GumMemoryRange *) ranges->data, ranges->len,
+      buffer, n_bytes_read);
+
+  auto result = Array::New (isolate, ranges->len);
+
+  gsize offset = 0;
+  for (guint i = 0; i != ranges->len; i++)
+  {
+    gsize size = g_array_index (ranges, GumMemoryRange, i).size;
+    gsize n = n_bytes_read[i];
+
+    Local<Value> data;
+    if (n == 0 && size != 0)
+    {
+      data = Null (isolate);
+    }
+    else
+    {
+      auto array_buffer = ArrayBuffer::New (isolate, n);
+      memcpy (array_buffer->GetBackingStore ()->Data (), buffer + offset, n);
+      data = array_buffer;
+    }
+    result->Set (context, i, data).ToChecked ();
+
+    offset += size;
+  }
+
+  g_free (n_bytes_read);
+  g_free (buffer);
+  g_array_free (ranges, TRUE);
+
+  info.GetReturnValue ().Set (result);
+}
+
 GUMJS_DEFINE_FUNCTION (gum_v8_memory_write_volatile)
 {
   gpointer address;
@@ -1031,7 +1154,7 @@ gum_memory_scan_context_run (GumMemoryScanContext * self)
 
   if (gum_exceptor_try (exceptor, &scope))
   {
-    gum_memory_scan (&self->range, self->pattern,
+    gum_memory_scan_parallel (&self->range, self->pattern, 0,
         (GumMemoryScanMatchFunc) gum_memory_scan_context_emit_match, self);
   }
 
@@ -1150,10 +1273,337 @@ gum_append_match (GumAddress address,
   return TRUE;
 }
 
+GUMJS_DEFINE_FUNCTION (gumjs_memory_scan_multi)
+{
+  gpointer address;
+  gsize size;
+  Local<Array> patterns_value;
+  Local<Function> on_match, on_error, on_complete;
+  if (!_gum_v8_args_parse (args, "pZAF{onMatch,onError,onComplete}", &address,
+      &size, &patterns_value, &on_match, &on_error, &on_complete))
+    return;
+
+  auto patterns = _gum_v8_match_patterns_get (patterns_value, core);
+  if (patterns == NULL)
+    return;
+
+  GumMemoryRange range;
+  range.base_address = GUM_ADDRESS (address);
+  range.size = size;
+
+  auto ctx = g_slice_new0 (GumMemoryScanMultiContext);
+  ctx->range = range;
+  ctx->patterns = patterns;
+  ctx->on_match = new Global<Function> (isolate, on_match);
+  ctx->on_error = new Global<Function> (isolate, on_error);
+  ctx->on_complete = new Global<Function> (isolate, on_complete);
+  ctx->core = core;
+
+  _gum_v8_core_pin (core);
+  _gum_v8_core_push_job (core,
+      (GumScriptJobFunc) gum_memory_scan_multi_context_run, ctx,
+      (GDestroyNotify) gum_memory_scan_multi_context_free);
+}
+
+static void
+gum_memory_scan_multi_context_free (GumMemoryScanMultiContext * self)
+{
+  auto core = self->core;
+
+  {
+    ScriptScope script_scope (core->script);
+
+    delete self->on_match;
+    delete self->on_error;
+    delete self->on_complete;
+
+    _gum_v8_core_unpin (core);
+  }
+
+  g_ptr_array_unref (self->patterns);
+
+  g_slice_free (GumMemoryScanMultiContext, self);
+}
+
+static void
+gum_memory_scan_multi_context_run (GumMemoryScanMultiContext * self)
+{
+  auto core = self->core;
+  auto exceptor = core->exceptor;
+  auto isolate = core->isolate;
+  GumExceptorScope scope;
+
+  if (gum_exceptor_try (exceptor, &scope))
+  {
+    gum_memory_scan_multi (&self->range,
+        (GumMatchPattern * const *) self->patterns->pdata,
+        self->patterns->len,
+        (GumMemoryScanMultiMatchFunc) gum_memory_scan_multi_context_emit_match,
+        self);
+  }
+
+  if (gum_exceptor_catch (exceptor, &scope) && self->on_error != nullptr)
+  {
+    ScriptScope script_scope (core->script);
+    auto context = isolate->GetCurrentContext ();
+
+    auto message = gum_exception_details_to_string (&scope.exception);
+
+    auto on_error = Local<Function>::New (isolate, *self->on_error);
+    auto recv = Undefined (isolate);
+    Local<Value> argv[] = {
+      String::NewFromUtf8 (isolate, message).ToLocalChecked ()
+    };
+    auto result = on_error->Call (context, recv, G_N_ELEMENTS (argv), argv);
+    _gum_v8_ignore_result (result);
+
+    g_free (message);
+  }
+
+  {
+    ScriptScope script_scope (core->script);
+    auto context = isolate->GetCurrentContext ();
+
+    auto on_complete (Local<Function>::New (isolate, *self->on_complete));
+    auto recv = Undefined (isolate);
+    auto result = on_complete->Call (context, recv, 0, nullptr);
+    _gum_v8_ignore_result (result);
+  }
+}
+
+static gboolean
+gum_memory_scan_multi_context_emit_match (guint pattern_index,
+                                          GumAddress address,
+                                          gsize size,
+                                          GumMemoryScanMultiContext * self)
+{
+  ScriptScope scope (self->core->script);
+  auto isolate = self->core->isolate;
+  auto context = isolate->GetCurrentContext ();
+
+  gboolean proceed = TRUE;
+
+  auto on_match = Local<Function>::New (isolate, *self->on_match);
+  auto recv = Undefined (isolate);
+  Local<Value> argv[] = {
+    _gum_v8_native_pointer_new (GSIZE_TO_POINTER (address), self->core),
+    Integer::NewFromUnsigned (isolate, size),
+    Integer::NewFromUnsigned (isolate, pattern_index)
+  };
+  Local<Value> result;
+  if (on_match->Call (context, recv, G_N_ELEMENTS (argv), argv)
+      .ToLocal (&result) && result->IsString ())
+  {
+    String::Utf8Value str (isolate, result);
+    proceed = strcmp (*str, "stop") != 0;
+  }
+
+  return proceed;
+}
+
+GUMJS_DEFINE_FUNCTION (gumjs_memory_scan_multi_sync)
+{
+  gpointer address;
+  gsize size;
+  Local<Array> patterns_value;
+  if (!_gum_v8_args_parse (args, "pZA", &address, &size, &patterns_value))
+    return;
+
+  auto patterns = _gum_v8_match_patterns_get (patterns_value, core);
+  if (patterns == NULL)
+    return;
+
+  GumMemoryRange range;
+  range.base_address = GUM_ADDRESS (address);
+  range.size = size;
+
+  GumMemoryScanSyncContext ctx;
+  ctx.matches = Array::New (isolate);
+  ctx.core = core;
+
+  GumExceptorScope scope;
+
+  if (gum_exceptor_try (core->exceptor, &scope))
+  {
+    gum_memory_scan_multi (&range,
+        (GumMatchPattern * const *) patterns->pdata, patterns->len,
+        (GumMemoryScanMultiMatchFunc) gum_append_multi_match, &ctx);
+  }
+
+  g_ptr_array_unref (patterns);
+
+  if (gum_exceptor_catch (core->exceptor, &scope))
+  {
+    _gum_v8_throw_native (&scope.exception, core);
+  }
+  else
+  {
+    info.GetReturnValue ().Set (ctx.matches);
+  }
+}
+
+static gboolean
+gum_append_multi_match (guint pattern_index,
+                        GumAddress address,
+                        gsize size,
+                        GumMemoryScanSyncContext * ctx)
+{
+  GumV8Core * core = ctx->core;
+
+  auto match = Object::New (core->isolate);
+  _gum_v8_object_set_pointer (match, "address", address, core);
+  _gum_v8_object_set_uint (match, "size", size, core);
+  _gum_v8_object_set_uint (match, "index", pattern_index, core);
+  ctx->matches->Set (core->isolate->GetCurrentContext (),
+      ctx->matches->Length (), match).ToChecked ();
+
+  return TRUE;
+}
+
 #ifdef _MSC_VER
 # pragma warning (pop)
 #endif
 
+GUMJS_DEFINE_CONSTRUCTOR (gumjs_memory_snapshot_construct)
+{
+  if (!info.IsConstructCall ())
+  {
+    _gum_v8_throw_ascii_literal (isolate,
+        "use `new MemorySnapshot()` to create a new instance");
+    return;
+  }
+
+  GArray * ranges;
+  Local<Object> previous_obj;
+  gboolean track_dirty = FALSE;
+  if (!_gum_v8_args_parse (args, "R|O?t", &ranges, &previous_obj,
+      &track_dirty))
+    return;
+
+  GumMemorySnapshot * previous = NULL;
+  if (!previous_obj.IsEmpty () &&
+      !gum_v8_memory_snapshot_get (previous_obj, &previous, module))
+  {
+    g_array_free (ranges, TRUE);
+    return;
+  }
+
+  auto handle = gum_memory_snapshot_take ((const GumMemoryRange *) ranges->data,
+      ranges->len, previous, track_dirty
+          ? GUM_MEMORY_SNAPSHOT_TRACK_DIRTY
+          : GUM_MEMORY_SNAPSHOT_FLAGS_NONE);
+
+  g_array_free (ranges, TRUE);
+
+  auto snapshot = gum_v8_memory_snapshot_new (wrapper, handle, module);
+  wrapper->SetAlignedPointerInInternalField (0, snapshot);
+}
+
+GUMJS_DEFINE_CLASS_GETTER (gumjs_memory_snapshot_get_size, GumV8MemorySnapshot)
+{
+  info.GetReturnValue ().Set (
+      (double) gum_memory_snapshot_get_size (self->handle));
+}
+
+GUMJS_DEFINE_CLASS_GETTER (gumjs_memory_snapshot_get_unique_page_count,
+                           GumV8MemorySnapshot)
+{
+  info.GetReturnValue ().Set (
+      gum_memory_snapshot_get_unique_page_count (self->handle));
+}
+
+/*
+ * Returns the offsets followed by the sizes, as doubles, which the runtime
+ * exposes as a pair of Float64Arrays.
+ */
+GUMJS_DEFINE_CLASS_METHOD (gumjs_memory_snapshot_diff, GumV8MemorySnapshot)
+{
+  Local<Object> other_obj;
+  if (!_gum_v8_args_parse (args, "|O?", &other_obj))
+    return;
+
+  GumMemorySnapshot * other = NULL;
+  if (!other_obj.IsEmpty () &&
+      !gum_v8_memory_snapshot_get (other_obj, &other, module))
+    return;
+
+  GError * error = NULL;
+  auto changes = gum_memory_snapshot_diff (self->handle, other, &error);
+  if (_gum_v8_maybe_throw (isolate, &error))
+    return;
+
+  guint n = changes->len;
+  auto result = ArrayBuffer::New (isolate, 2 * n * sizeof (gdouble));
+  auto data = (gdouble *) result->GetBackingStore ()->Data ();
+  for (guint i = 0; i != n; i++)
+  {
+    auto c = &g_array_index (changes, GumMemoryChange, i);
+
+    data[i] = c->offset;
+    data[n + i] = c->size;
+  }
+
+  g_array_free (changes, TRUE);
+
+  info.GetReturnValue ().Set (result);
+}
+
+static gboolean
+gum_v8_memory_snapshot_get (Local<Value> value,
+                            GumMemorySnapshot ** snapshot,
+                            GumV8Memory * module)
+{
+  auto isolate = module->core->isolate;
+
+  auto klass = Local<FunctionTemplate>::New (isolate, *module->snapshot);
+  if (!klass->HasInstance (value))
+  {
+    _gum_v8_throw_ascii_literal (isolate, "expected a MemorySnapshot object");
+    return FALSE;
+  }
+
+  auto s = (GumV8MemorySnapshot *)
+      value.As<Object> ()->GetAlignedPointerFromInternalField (0);
+  *snapshot = s->handle;
+  return TRUE;
+}
+
+static GumV8MemorySnapshot *
+gum_v8_memory_snapshot_new (Local<Object> wrapper,
+                            GumMemorySnapshot * handle,
+                            GumV8Memory * module)
+{
+  auto snapshot = g_slice_new (GumV8MemorySnapshot);
+  snapshot->wrapper = new Global<Object> (module->core->isolate, wrapper);
+  snapshot->wrapper->SetWeak (snapshot, gum_v8_memory_snapshot_on_weak_notify,
+      WeakCallbackType::kParameter);
+  snapshot->handle = handle;
+  snapshot->module = module;
+
+  g_hash_table_add (module->snapshots, snapshot);
+
+  return snapshot;
+}
+
+static void
+gum_v8_memory_snapshot_free (GumV8MemorySnapshot * self)
+{
+  gum_memory_snapshot_unref (self->handle);
+
+  delete self->wrapper;
+
+  g_slice_free (GumV8MemorySnapshot, self);
+}
+
+static void
+gum_v8_memory_snapshot_on_weak_notify (
+    const WeakCallbackInfo<GumV8MemorySnapshot> & info)
+{
+  HandleScope handle_scope (info.GetIsolate ());
+  auto self = info.GetParameter ();
+  g_hash_table_remove (self->module->snapshots, self);
+}
+
 GUMJS_DEFINE_FUNCTION (gumjs_memory_access_monitor_enable)
 {
   GArray * ranges;
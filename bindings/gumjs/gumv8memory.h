@@ -10,6 +10,7 @@
 #include "gumv8core.h"
 
 #include <gum/gummemoryaccessmonitor.h>
+#include <gum/gummemorysnapshot.h>
 
 struct GumV8Memory
 {
@@ -17,6 +18,9 @@ struct GumV8Memory
 
   GumMemoryAccessMonitor * monitor;
   v8::Global<v8::Function> * on_access;
+
+  v8::Global<v8::FunctionTemplate> * snapshot;
+  GHashTable * snapshots;
 };
 
 G_GNUC_INTERNAL void _gum_v8_memory_init (GumV8Memory * self,
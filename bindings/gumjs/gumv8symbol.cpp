@@ -24,6 +24,7 @@ struct GumSymbol
 };
 
 GUMJS_DECLARE_FUNCTION (gumjs_symbol_from_address)
+GUMJS_DECLARE_FUNCTION (gumjs_symbol_from_addresses)
 GUMJS_DECLARE_FUNCTION (gumjs_symbol_from_name)
 GUMJS_DECLARE_FUNCTION (gumjs_symbol_get_function_by_name)
 GUMJS_DECLARE_FUNCTION (gumjs_symbol_find_functions_named)
@@ -45,6 +46,7 @@ static void gum_symbol_on_weak_notify (
 static const GumV8Function gumjs_symbol_module_functions[] =
 {
   { "fromAddress", gumjs_symbol_from_address },
+  { "fromAddresses", gumjs_symbol_from_addresses },
   { "fromName", gumjs_symbol_from_name },
   { "getFunctionByName", gumjs_symbol_get_function_by_name },
   { "findFunctionsNamed", gumjs_symbol_find_functions_named },
@@ -146,6 +148,56 @@ GUMJS_DEFINE_FUNCTION (gumjs_symbol_from_address)
   info.GetReturnValue ().Set (object);
 }
 
+GUMJS_DEFINE_FUNCTION (gumjs_symbol_from_addresses)
+{
+  auto context = isolate->GetCurrentContext ();
+
+  Local<Array> addresses_val;
+  if (!_gum_v8_args_parse (args, "A", &addresses_val))
+    return;
+
+  guint n = addresses_val->Length ();
+  auto addresses = g_new (gpointer, n);
+  for (guint i = 0; i != n; i++)
+  {
+    Local<Value> element;
+    if (!addresses_val->Get (context, i).ToLocal (&element) ||
+        !_gum_v8_native_pointer_get (element, &addresses[i], core))
+    {
+      g_free (addresses);
+      return;
+    }
+  }
+
+  auto details = g_new0 (GumDebugSymbolDetails, n);
+  auto resolved = g_new (gboolean, n);
+
+  {
+    ScriptUnlocker unlocker (core);
+
+    gum_symbol_details_from_addresses (addresses, n, details, resolved);
+  }
+
+  auto result = Array::New (isolate, n);
+  for (guint i = 0; i != n; i++)
+  {
+    GumSymbol * symbol;
+    auto object = gum_symbol_new (module, &symbol);
+
+    symbol->details = details[i];
+    symbol->details.address = GPOINTER_TO_SIZE (addresses[i]);
+    symbol->resolved = resolved[i];
+
+    result->Set (context, i, object).Check ();
+  }
+
+  info.GetReturnValue ().Set (result);
+
+  g_free (resolved);
+  g_free (details);
+  g_free (addresses);
+}
+
 GUMJS_DEFINE_FUNCTION (gumjs_symbol_from_name)
 {
   gchar * name;
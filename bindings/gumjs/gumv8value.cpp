@@ -597,34 +597,8 @@ _gum_v8_args_parse (const GumV8Args * args,
       case 'M':
       {
         GumMatchPattern * pattern;
-
-        if (arg->IsString ())
-        {
-          String::Utf8Value arg_utf8 (isolate, arg);
-
-          pattern = gum_match_pattern_new_from_string (*arg_utf8);
-          if (pattern == NULL)
-          {
-            _gum_v8_throw_ascii_literal (isolate, "invalid match pattern");
-            return FALSE;
-          }
-        }
-        else
-        {
-          auto match_pattern = Local<FunctionTemplate>::New (core->isolate,
-              *core->match_pattern);
-          if (!match_pattern->HasInstance (arg))
-          {
-            _gum_v8_throw_ascii_literal (isolate,
-                "expected either a pattern string or a MatchPattern object");
-            return FALSE;
-          }
-
-          pattern = (GumMatchPattern *) arg.As<Object> ()
-              ->GetInternalField (0).As<External> ()->Value ();
-
-          gum_match_pattern_ref (pattern);
-        }
+        if (!_gum_v8_match_pattern_get (arg, &pattern, core))
+          return FALSE;
 
         scope.add (pattern);
 
@@ -1779,6 +1753,76 @@ _gum_v8_object_set_page_protection (Local<Object> object,
       core);
 }
 
+gboolean
+_gum_v8_match_pattern_get (Local<Value> value,
+                           GumMatchPattern ** pattern,
+                           GumV8Core * core)
+{
+  auto isolate = core->isolate;
+
+  if (value->IsString ())
+  {
+    String::Utf8Value value_utf8 (isolate, value);
+
+    auto result = gum_match_pattern_new_from_string (*value_utf8);
+    if (result == NULL)
+    {
+      _gum_v8_throw_ascii_literal (isolate, "invalid match pattern");
+      return FALSE;
+    }
+
+    *pattern = result;
+    return TRUE;
+  }
+
+  auto match_pattern = Local<FunctionTemplate>::New (isolate,
+      *core->match_pattern);
+  if (!match_pattern->HasInstance (value))
+  {
+    _gum_v8_throw_ascii_literal (isolate,
+        "expected either a pattern string or a MatchPattern object");
+    return FALSE;
+  }
+
+  auto result = (GumMatchPattern *) value.As<Object> ()
+      ->GetInternalField (0).As<External> ()->Value ();
+  *pattern = gum_match_pattern_ref (result);
+  return TRUE;
+}
+
+GPtrArray *
+_gum_v8_match_patterns_get (Local<Value> value,
+                            GumV8Core * core)
+{
+  auto isolate = core->isolate;
+  auto context = isolate->GetCurrentContext ();
+
+  if (!value->IsArray ())
+  {
+    _gum_v8_throw_ascii_literal (isolate, "expected an array of patterns");
+    return NULL;
+  }
+
+  auto pattern_values = value.As<Array> ();
+
+  uint32_t length = pattern_values->Length ();
+  auto patterns = g_ptr_array_new_full (length,
+      (GDestroyNotify) gum_match_pattern_unref);
+  for (uint32_t i = 0; i != length; i++)
+  {
+    Local<Value> pattern_value;
+    GumMatchPattern * pattern;
+    if (!pattern_values->Get (context, i).ToLocal (&pattern_value) ||
+        !_gum_v8_match_pattern_get (pattern_value, &pattern, core))
+    {
+      g_ptr_array_unref (patterns);
+      return NULL;
+    }
+    g_ptr_array_add (patterns, pattern);
+  }
+  return patterns;
+}
+
 GArray *
 _gum_v8_memory_ranges_get (Local<Value> value,
                            GumV8Core * core)
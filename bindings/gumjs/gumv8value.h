@@ -157,6 +157,11 @@ G_GNUC_INTERNAL gboolean _gum_v8_object_set_page_protection (
     v8::Local<v8::Object> object, const gchar * key, GumPageProtection prot,
     GumV8Core * core);
 
+G_GNUC_INTERNAL gboolean _gum_v8_match_pattern_get (
+    v8::Local<v8::Value> value, GumMatchPattern ** pattern, GumV8Core * core);
+G_GNUC_INTERNAL GPtrArray * _gum_v8_match_patterns_get (
+    v8::Local<v8::Value> value, GumV8Core * core);
+
 G_GNUC_INTERNAL GArray * _gum_v8_memory_ranges_get (v8::Local<v8::Value> value,
     GumV8Core * core);
 G_GNUC_INTERNAL gboolean _gum_v8_memory_range_get (v8::Local<v8::Value> value,
@@ -274,6 +274,30 @@ Object.defineProperties(Memory, {
         }
       });
 
+      return request;
+    }
+  },
+  scanMulti: {
+    enumerable: true,
+    value: function (address, size, patterns, callbacks) {
+      let onSuccess, onFailure;
+      const request = new Promise((resolve, reject) => {
+        onSuccess = resolve;
+        onFailure = reject;
+      });
+
+      Memory._scanMulti(address, size, patterns, {
+        onMatch: callbacks.onMatch,
+        onError(reason) {
+          onFailure(new Error(reason));
+          callbacks.onError?.(reason);
+        },
+        onComplete() {
+          onSuccess();
+          callbacks.onComplete?.();
+        }
+      });
+
       return request;
     }
   }
@@ -838,6 +862,16 @@ Object.defineProperties(Socket, {
   },
 });
 
+MemorySnapshot.prototype.diff = function (other = null) {
+  const buffer = this._diff(other);
+  const n = buffer.byteLength / 16;
+
+  return {
+    offsets: new Float64Array(buffer, 0, n),
+    sizes: new Float64Array(buffer, n * 8, n)
+  };
+};
+
 SourceMap.prototype.resolve = function (generatedPosition) {
   const generatedColumn = generatedPosition.column;
   const position = (generatedColumn !== undefined)
@@ -881,6 +881,39 @@ _gum_interceptor_backend_create_trampoline (GumInterceptorBackend * self,
   return TRUE;
 }
 
+gboolean
+_gum_interceptor_backend_create_import_trampoline (GumInterceptorBackend * self,
+                                                   GumFunctionContext * ctx)
+{
+  GumArm64Writer * aw = &self->writer;
+
+  ctx->trampoline_slice = gum_code_allocator_alloc_slice (self->allocator);
+
+  gum_arm64_writer_reset (aw, ctx->trampoline_slice->data);
+
+  ctx->on_enter_trampoline = gum_sign_code_pointer (gum_arm64_writer_cur (aw));
+
+  gum_arm64_writer_put_ldr_reg_address (aw, ARM64_REG_X17, GUM_ADDRESS (ctx));
+  gum_arm64_writer_put_ldr_reg_address (aw, ARM64_REG_X16,
+      GUM_ADDRESS (gum_sign_code_pointer (self->enter_thunk)));
+  gum_arm64_writer_put_br_reg (aw, ARM64_REG_X16);
+
+  ctx->on_leave_trampoline = gum_arm64_writer_cur (aw);
+
+  gum_arm64_writer_put_ldr_reg_address (aw, ARM64_REG_X17, GUM_ADDRESS (ctx));
+  gum_arm64_writer_put_ldr_reg_address (aw, ARM64_REG_X16,
+      GUM_ADDRESS (gum_sign_code_pointer (self->leave_thunk)));
+  gum_arm64_writer_put_br_reg (aw, ARM64_REG_X16);
+
+  gum_arm64_writer_flush (aw);
+  g_assert (gum_arm64_writer_offset (aw) <= ctx->trampoline_slice->size);
+
+  ctx->on_invoke_trampoline = gum_sign_code_pointer (ctx->function_address);
+  ctx->overwritten_prologue_len = 0;
+
+  return TRUE;
+}
+
 void
 _gum_interceptor_backend_destroy_trampoline (GumInterceptorBackend * self,
                                              GumFunctionContext * ctx)
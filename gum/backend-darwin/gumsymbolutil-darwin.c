@@ -126,6 +126,28 @@ gum_symbol_details_from_address (gpointer address,
   return success;
 }
 
+void
+gum_symbol_details_from_addresses (const gpointer * addresses,
+                                   guint n_addresses,
+                                   GumDebugSymbolDetails * details,
+                                   gboolean * resolved)
+{
+  GumDarwinSymbolicator * symbolicator;
+  guint i;
+
+  symbolicator = gum_try_obtain_symbolicator ();
+
+  for (i = 0; i != n_addresses; i++)
+  {
+    resolved[i] = (symbolicator != NULL)
+        ? gum_darwin_symbolicator_details_from_address (symbolicator,
+            GUM_ADDRESS (addresses[i]), &details[i])
+        : FALSE;
+  }
+
+  g_clear_object (&symbolicator);
+}
+
 gchar *
 gum_symbol_name_from_address (gpointer address)
 {
@@ -202,6 +224,11 @@ gum_load_symbols (const gchar * path)
   return FALSE;
 }
 
+void
+gum_symbol_util_set_cache_dir (const gchar * path)
+{
+}
+
 static GArray *
 gum_pointer_array_new_empty (void)
 {
@@ -83,6 +83,18 @@ gum_symbol_details_from_address (gpointer address,
   return (has_sym_info || has_file_info);
 }
 
+void
+gum_symbol_details_from_addresses (const gpointer * addresses,
+                                   guint n_addresses,
+                                   GumDebugSymbolDetails * details,
+                                   gboolean * resolved)
+{
+  guint i;
+
+  for (i = 0; i != n_addresses; i++)
+    resolved[i] = gum_symbol_details_from_address (addresses[i], &details[i]);
+}
+
 gchar *
 gum_symbol_name_from_address (gpointer address)
 {
@@ -177,6 +189,11 @@ beach:
   return success;
 }
 
+void
+gum_symbol_util_set_cache_dir (const gchar * path)
+{
+}
+
 static BOOL CALLBACK
 enum_functions_callback (SYMBOL_INFO * sym_info,
                          gulong symbol_size,
@@ -477,6 +477,8 @@ gum_native_module_find_export_by_name (GumModule * module,
                                        const gchar * symbol_name)
 {
   GumNativeModule * self;
+  GumElfModule * elf_module;
+  GumAddress address;
   gpointer handle;
 
   self = GUM_NATIVE_MODULE (module);
@@ -491,6 +493,21 @@ gum_native_module_find_export_by_name (GumModule * module,
   }
 #endif
 
+  /*
+   * Try the module's own hash table first, which spares us the loader lock.
+   * The first call creates the GumElfModule shared with the enumerations,
+   * which only parses the headers and dynamic entries of the mapped image.
+   * Anything it cannot answer, such as GNU IFUNCs and symbols provided by
+   * dependencies, is left to the dynamic linker.
+   */
+  elf_module = _gum_native_module_get_elf_module (self);
+  if (elf_module != NULL)
+  {
+    address = gum_elf_module_find_export_by_name (elf_module, symbol_name);
+    if (address != 0)
+      return address;
+  }
+
   handle = _gum_native_module_get_handle (self);
   if (handle == NULL)
     return 0;
@@ -0,0 +1,19 @@
+/*
+ * Copyright (C) 2024 Ole André Vadla Ravnås <oleavr@nowsecure.com>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_SYMBOL_UTIL_LIBDWARF_PRIV_H__
+#define __GUM_SYMBOL_UTIL_LIBDWARF_PRIV_H__
+
+#include <gum/gumelfmodule.h>
+
+G_BEGIN_DECLS
+
+GUM_API gchar * _gum_symbol_util_find_nearest_symbol (GumElfModule * module,
+    GumAddress address, GumAddress * symbol_address);
+
+G_END_DECLS
+
+#endif
@@ -7,23 +7,43 @@
 
 #include "gumsymbolutil.h"
 
+#include "gumsymbolutil-libdwarf-priv.h"
+
 #include "gum-init.h"
 #include "gummodule-elf.h"
+#include "gumworkerpool.h"
 
 #include <dlfcn.h>
 #include <dwarf.h>
+#include <glib/gstdio.h>
 #include <libdwarf.h>
+#include <string.h>
 #include <strings.h>
 
+#define GUM_SYMBOL_CACHE_MAGIC   0x43595347
+#define GUM_SYMBOL_CACHE_VERSION 2
+
+#define GUM_NT_GNU_BUILD_ID 3
 #define GUM_MAX_CACHE_AGE (0.5)
 
 typedef struct _GumModuleEntry GumModuleEntry;
+typedef struct _GumCollectFunctionsJob GumCollectFunctionsJob;
+typedef struct _GumCollectedFunction GumCollectedFunction;
+typedef struct _GumSymbolIndex GumSymbolIndex;
+typedef struct _GumSymbolIndexEntry GumSymbolIndexEntry;
+typedef struct _GumSymbolCacheHeader GumSymbolCacheHeader;
+typedef struct _GumFindBuildIdOperation GumFindBuildIdOperation;
+
+typedef struct _GumDwarfIndex GumDwarfIndex;
+typedef struct _GumDwarfUnit GumDwarfUnit;
+typedef struct _GumDwarfUnitRange GumDwarfUnitRange;
+typedef struct _GumDwarfSymbolEntry GumDwarfSymbolEntry;
+typedef struct _GumDwarfLineEntry GumDwarfLineEntry;
+
+typedef struct _GumSymbolQuery GumSymbolQuery;
 
 typedef struct _GumNearestSymbolDetails GumNearestSymbolDetails;
-typedef struct _GumDwarfSymbolDetails GumDwarfSymbolDetails;
-typedef struct _GumDwarfSourceDetails GumDwarfSourceDetails;
-typedef struct _GumFindCuDieOperation GumFindCuDieOperation;
-typedef struct _GumFindSymbolOperation GumFindSymbolOperation;
+typedef struct _GumLoadUnitOperation GumLoadUnitOperation;
 
 typedef struct _GumCuDieDetails GumCuDieDetails;
 typedef struct _GumDieDetails GumDieDetails;
@@ -38,39 +58,126 @@ struct _GumModuleEntry
   GumElfModule * module;
   Dwarf_Debug dbg;
   gboolean collected;
+
+  GumSymbolIndex * symbols;
+  GumDwarfIndex * dwarf;
 };
 
-struct _GumNearestSymbolDetails
+struct _GumCollectFunctionsJob
 {
-  const gchar * name;
-  gpointer address;
+  GumModuleEntry * entry;
+  GArray * functions;
 };
 
-struct _GumDwarfSymbolDetails
+struct _GumCollectedFunction
 {
   gchar * name;
+  gpointer address;
+};
+
+struct _GumSymbolIndex
+{
+  GumAddress base_address;
+
+  const GumSymbolIndexEntry * entries;
+  guint n_entries;
+  const gchar * names;
+  gsize names_size;
+
+  GArray * entry_storage;
+  GString * name_storage;
+  GMappedFile * cache_file;
+};
+
+struct _GumSymbolIndexEntry
+{
+  guint64 offset;
+  guint64 size;
+  guint32 name_offset;
+  guint32 reserved;
+};
+
+struct _GumSymbolCacheHeader
+{
+  guint32 magic;
+  guint32 version;
+  guint64 file_size;
+  gint64 file_mtime;
+  guint32 n_entries;
+  guint32 names_size;
+};
+
+struct _GumFindBuildIdOperation
+{
+  GumElfModule * module;
+  gchar * build_id;
+};
+
+struct _GumDwarfIndex
+{
+  Dwarf_Debug dbg;
+
+  GArray * units;
+  GArray * ranges;
+
+  GString * strings;
+  GHashTable * paths;
+};
+
+struct _GumDwarfUnit
+{
+  Dwarf_Off die_offset;
+  gboolean loaded;
+
+  GArray * symbols;
+  GArray * lines;
+};
+
+struct _GumDwarfUnitRange
+{
+  Dwarf_Addr start;
+  Dwarf_Addr end;
+  Dwarf_Addr max_end;
+  guint unit;
+};
+
+struct _GumDwarfSymbolEntry
+{
+  Dwarf_Addr address;
+  guint name_offset;
   guint line_number;
+  guint order;
 };
 
-struct _GumDwarfSourceDetails
+struct _GumDwarfLineEntry
 {
-  gchar * path;
+  Dwarf_Addr address;
+  guint path_offset;
   guint line_number;
   guint column;
+  guint order;
+};
+
+struct _GumSymbolQuery
+{
+  gpointer address;
+  guint index;
+
+  GumModuleEntry * entry;
+  Dwarf_Addr file_address;
+  gboolean resolved;
 };
 
-struct _GumFindCuDieOperation
+struct _GumNearestSymbolDetails
 {
-  Dwarf_Addr needle;
-  gboolean found;
-  Dwarf_Off cu_die_offset;
+  const gchar * name;
+  gpointer address;
 };
 
-struct _GumFindSymbolOperation
+struct _GumLoadUnitOperation
 {
-  GumAddress needle;
-  GumDwarfSymbolDetails * symbol;
-  GumAddress closest_address;
+  GumDwarfIndex * index;
+  GumDwarfUnit * unit;
 };
 
 struct _GumCuDieDetails
@@ -88,34 +195,90 @@ struct _GumDieDetails
   Dwarf_Debug dbg;
 };
 
-static gboolean gum_find_nearest_symbol_by_address (gpointer address,
-    GumNearestSymbolDetails * nearest);
+static void gum_resolve_queries_using_dwarf (GumSymbolQuery * queries,
+    guint n_queries, GumDebugSymbolDetails * details);
+static void gum_resolve_queries_in_module (GumModuleEntry * entry,
+    GumSymbolQuery * queries, guint n_queries,
+    GumDebugSymbolDetails * details);
+static void gum_resolve_query_using_symbols (GumSymbolQuery * query,
+    GumDebugSymbolDetails * details);
+static gint gum_symbol_query_compare (const GumSymbolQuery * a,
+    const GumSymbolQuery * b);
+
+static gboolean gum_find_nearest_symbol_by_address (GumModuleEntry * entry,
+    gpointer address, GumNearestSymbolDetails * nearest);
 static GumModuleEntry * gum_module_entry_from_address (gpointer address,
     GumNearestSymbolDetails * nearest);
 static GumModuleEntry * gum_module_entry_from_module (GumModule * module);
 
+static const GumSymbolIndex * gum_module_entry_get_symbol_index (
+    GumModuleEntry * self);
+static GumDwarfIndex * gum_module_entry_get_dwarf_index (
+    GumModuleEntry * self);
+
+static GumSymbolIndex * gum_symbol_index_obtain (GumElfModule * module);
+static GumSymbolIndex * gum_symbol_index_new (GumElfModule * module);
+static GumSymbolIndex * gum_symbol_index_load (const gchar * path,
+    const GStatBuf * source_info, GumElfModule * module);
+static void gum_symbol_index_save (const GumSymbolIndex * self,
+    const gchar * path, const GStatBuf * source_info);
+static void gum_symbol_index_free (GumSymbolIndex * index);
+static gboolean gum_symbol_index_add_symbol (
+    const GumElfSymbolDetails * details, GumSymbolIndex * self);
+static gint gum_symbol_index_entry_compare (const GumSymbolIndexEntry * a,
+    const GumSymbolIndexEntry * b);
+static const GumSymbolIndexEntry * gum_symbol_index_lookup (
+    const GumSymbolIndex * self, GumAddress address);
+
+static gchar * gum_elf_module_read_build_id (GumElfModule * module);
+static gboolean gum_store_build_id_if_present (
+    const GumElfSectionDetails * details, GumFindBuildIdOperation * op);
+
 static GHashTable * gum_get_function_addresses (void);
-static GHashTable * gum_get_address_symbols (void);
 static void gum_maybe_refresh_symbol_caches (void);
-static gboolean gum_collect_module_functions (GumModule * module,
+static gboolean gum_collect_pending_module_entry (GumModule * module,
+    gpointer user_data);
+static void gum_collect_module_functions (GumCollectFunctionsJob * job,
     gpointer user_data);
 static gboolean gum_collect_symbol_if_function (
     const GumElfSymbolDetails * details, gpointer user_data);
+static void gum_add_function_address (gchar * name, gpointer address);
 
 static void gum_symbol_util_ensure_initialized (void);
 static void gum_symbol_util_deinitialize (void);
 
-static Dwarf_Die gum_find_cu_die_by_virtual_address (Dwarf_Debug dbg,
+static GumDwarfIndex * gum_dwarf_index_new (Dwarf_Debug dbg);
+static void gum_dwarf_index_free (GumDwarfIndex * index);
+static gboolean gum_dwarf_index_add_unit (const GumCuDieDetails * details,
+    GumDwarfIndex * self);
+static GumDwarfUnit * gum_dwarf_index_find_unit (GumDwarfIndex * self,
     Dwarf_Addr address);
-static gboolean gum_store_cu_die_offset_if_containing_address (
-    const GumCuDieDetails * details, GumFindCuDieOperation * op);
-static gboolean gum_find_symbol_by_virtual_address (Dwarf_Debug dbg,
-    Dwarf_Die cu_die, Dwarf_Addr address, GumDwarfSymbolDetails * details);
-static gboolean gum_collect_die_if_closest_so_far (
-    const GumDieDetails * details, GumFindSymbolOperation * op);
-static gboolean gum_find_line_by_virtual_address (Dwarf_Debug dbg,
-    Dwarf_Die cu_die, Dwarf_Addr address, guint symbol_line_number,
-    GumDwarfSourceDetails * details);
+static void gum_dwarf_index_load_unit (GumDwarfIndex * self,
+    GumDwarfUnit * unit);
+static gboolean gum_dwarf_index_add_symbol (const GumDieDetails * details,
+    GumLoadUnitOperation * op);
+static void gum_dwarf_index_add_line (GumDwarfIndex * self,
+    GumDwarfUnit * unit, Dwarf_Line line);
+static guint gum_dwarf_index_add_string (GumDwarfIndex * self,
+    const gchar * str);
+static guint gum_dwarf_index_intern_path (GumDwarfIndex * self,
+    const gchar * path);
+static void gum_dwarf_unit_clear (GumDwarfUnit * unit);
+static const GumDwarfSymbolEntry * gum_dwarf_unit_find_symbol (
+    const GumDwarfUnit * self, Dwarf_Addr address);
+static const GumDwarfLineEntry * gum_dwarf_unit_find_line (
+    const GumDwarfUnit * self, Dwarf_Addr address, guint symbol_line_number);
+static gint gum_dwarf_unit_range_compare (const GumDwarfUnitRange * a,
+    const GumDwarfUnitRange * b);
+static gint gum_dwarf_symbol_entry_compare (const GumDwarfSymbolEntry * a,
+    const GumDwarfSymbolEntry * b);
+static gint gum_dwarf_line_entry_compare (const GumDwarfLineEntry * a,
+    const GumDwarfLineEntry * b);
+
+static void gum_collect_cu_die_ranges (Dwarf_Debug dbg, Dwarf_Die die,
+    guint unit, GArray * ranges);
+static void gum_append_unit_range (GArray * ranges, Dwarf_Addr start,
+    Dwarf_Addr end, guint unit);
 
 static void gum_enumerate_cu_dies (Dwarf_Debug dbg, gboolean is_info,
     GumFoundCuDieFunc func, gpointer user_data);
@@ -138,136 +301,268 @@ static gint gum_compare_pointers (gconstpointer a, gconstpointer b);
 G_LOCK_DEFINE_STATIC (gum_symbol_util);
 static GHashTable * gum_module_entries = NULL;
 static GHashTable * gum_function_addresses = NULL;
-static GHashTable * gum_address_symbols = NULL;
 static GTimer * gum_cache_timer = NULL;
+static gchar * gum_symbol_cache_dir = NULL;
 
 gboolean
 gum_symbol_details_from_address (gpointer address,
                                  GumDebugSymbolDetails * details)
 {
-  gboolean success;
-  GumModuleEntry * entry;
-  GumNearestSymbolDetails nearest;
-  Dwarf_Addr file_address;
-  Dwarf_Die cu_die;
-  GumDwarfSymbolDetails symbol;
-  GumDwarfSourceDetails source;
-  gchar * str, * canonicalized;
+  gboolean resolved;
 
-  success = FALSE;
+  gum_symbol_details_from_addresses (&address, 1, details, &resolved);
+
+  return resolved;
+}
+
+void
+gum_symbol_details_from_addresses (const gpointer * addresses,
+                                   guint n_addresses,
+                                   GumDebugSymbolDetails * details,
+                                   gboolean * resolved)
+{
+  GArray * sorted, * queries;
+  guint i, j;
+
+  sorted = g_array_sized_new (FALSE, FALSE, sizeof (GumSymbolQuery),
+      n_addresses);
+  for (i = 0; i != n_addresses; i++)
+  {
+    GumSymbolQuery q = { 0, };
+
+    q.address = addresses[i];
+    q.index = i;
+
+    g_array_append_val (sorted, q);
+  }
+  g_array_sort (sorted, (GCompareFunc) gum_symbol_query_compare);
+
+  queries = g_array_new (FALSE, FALSE, sizeof (GumSymbolQuery));
+  for (i = 0; i != sorted->len; i++)
+  {
+    GumSymbolQuery * q = &g_array_index (sorted, GumSymbolQuery, i);
+
+    if (queries->len != 0 && g_array_index (queries, GumSymbolQuery,
+          queries->len - 1).address == q->address)
+      continue;
+
+    g_array_append_val (queries, *q);
+  }
 
   G_LOCK (gum_symbol_util);
+  gum_resolve_queries_using_dwarf ((GumSymbolQuery *) queries->data,
+      queries->len, details);
+  G_UNLOCK (gum_symbol_util);
 
-  entry = gum_module_entry_from_address (address, &nearest);
-  if (entry == NULL)
-    goto entry_not_found;
-  if (entry->dbg == NULL)
-    goto no_debug_info;
+  for (i = 0; i != queries->len; i++)
+  {
+    GumSymbolQuery * q = &g_array_index (queries, GumSymbolQuery, i);
 
-  file_address = gum_elf_module_translate_to_offline (entry->module,
-      GUM_ADDRESS (address));
+    if (!q->resolved)
+      gum_resolve_query_using_symbols (q, details);
+  }
+
+  for (i = 0, j = 0; i != sorted->len; i++)
+  {
+    GumSymbolQuery * q = &g_array_index (sorted, GumSymbolQuery, i);
+    GumSymbolQuery * leader = &g_array_index (queries, GumSymbolQuery, j);
 
-  cu_die = gum_find_cu_die_by_virtual_address (entry->dbg, file_address);
-  if (cu_die == NULL)
-    goto cu_die_not_found;
+    if (leader->address != q->address)
+      leader = &g_array_index (queries, GumSymbolQuery, ++j);
 
-  if (!gum_find_symbol_by_virtual_address (entry->dbg, cu_die, file_address,
-      &symbol))
-    goto symbol_not_found;
+    if (q->index != leader->index)
+      details[q->index] = details[leader->index];
+    resolved[q->index] = leader->resolved;
+  }
 
-  if (!gum_find_line_by_virtual_address (entry->dbg, cu_die, file_address,
-      symbol.line_number, &source))
-    goto line_not_found;
+  g_array_free (queries, TRUE);
+  g_array_free (sorted, TRUE);
+}
 
-  details->address = GUM_ADDRESS (address);
+static void
+gum_resolve_queries_using_dwarf (GumSymbolQuery * queries,
+                                 guint n_queries,
+                                 GumDebugSymbolDetails * details)
+{
+  guint i, end, j;
 
-  str = g_path_get_basename (gum_elf_module_get_source_path (entry->module));
-  g_strlcpy (details->module_name, str, sizeof (details->module_name));
-  g_free (str);
-  g_strlcpy (details->symbol_name, symbol.name, sizeof (details->symbol_name));
+  for (i = 0; i != n_queries; i = end)
+  {
+    GumModule * module;
+    const GumMemoryRange * range;
+    GumModuleEntry * entry;
 
-  canonicalized = g_canonicalize_filename (source.path, "/");
-  g_strlcpy (details->file_name, canonicalized, sizeof (details->file_name));
-  details->line_number = source.line_number;
-  details->column = source.column;
+    module = gum_process_find_module_by_address (
+        GUM_ADDRESS (queries[i].address));
+    if (module == NULL)
+    {
+      end = i + 1;
+      continue;
+    }
 
-  success = TRUE;
+    range = gum_module_get_range (module);
+    for (end = i + 1;
+        end != n_queries &&
+        GUM_ADDRESS (queries[end].address) <
+        range->base_address + range->size;
+        end++)
+    {
+    }
 
-  g_free (canonicalized);
-  g_free (source.path);
+    entry = gum_module_entry_from_module (module);
 
-line_not_found:
-  g_free (symbol.name);
+    g_object_unref (module);
 
-symbol_not_found:
-  dwarf_dealloc (entry->dbg, cu_die, DW_DLA_DIE);
+    for (j = i; j != end; j++)
+      queries[j].entry = entry;
 
-cu_die_not_found:
-  if (!success)
-    goto no_debug_info;
+    if (entry != NULL && entry->dbg != NULL)
+      gum_resolve_queries_in_module (entry, queries + i, end - i, details);
+  }
+}
 
-entry_not_found:
-  G_UNLOCK (gum_symbol_util);
+static void
+gum_resolve_queries_in_module (GumModuleEntry * entry,
+                               GumSymbolQuery * queries,
+                               guint n_queries,
+                               GumDebugSymbolDetails * details)
+{
+  GumDwarfIndex * index;
+  gchar * module_name;
+  guint i;
 
-  return success;
+  index = gum_module_entry_get_dwarf_index (entry);
 
-no_debug_info:
+  module_name =
+      g_path_get_basename (gum_elf_module_get_source_path (entry->module));
+
+  for (i = 0; i != n_queries; i++)
   {
-    gsize offset;
+    GumSymbolQuery * q = &queries[i];
+    GumDebugSymbolDetails * d = &details[q->index];
+    const GumDwarfUnit * unit;
+    const GumDwarfSymbolEntry * symbol;
+    const GumDwarfLineEntry * line;
 
-    details->address = GUM_ADDRESS (address);
+    q->file_address = gum_elf_module_translate_to_offline (entry->module,
+        GUM_ADDRESS (q->address));
 
-    str = g_path_get_basename (gum_elf_module_get_source_path (entry->module));
-    g_strlcpy (details->module_name, str, sizeof (details->module_name));
-    g_free (str);
+    unit = gum_dwarf_index_find_unit (index, q->file_address);
+    if (unit == NULL)
+      continue;
 
-    if (nearest.name == NULL)
-      gum_find_nearest_symbol_by_address (address, &nearest);
+    symbol = gum_dwarf_unit_find_symbol (unit, q->file_address);
+    if (symbol == NULL)
+      continue;
 
-    if (nearest.name != NULL)
+    line = gum_dwarf_unit_find_line (unit, q->file_address,
+        symbol->line_number);
+    if (line == NULL)
+      continue;
+
+    d->address = GUM_ADDRESS (q->address);
+    g_strlcpy (d->module_name, module_name, sizeof (d->module_name));
+    g_strlcpy (d->symbol_name, index->strings->str + symbol->name_offset,
+        sizeof (d->symbol_name));
+    g_strlcpy (d->file_name, index->strings->str + line->path_offset,
+        sizeof (d->file_name));
+    d->line_number = line->line_number;
+    d->column = line->column;
+
+    q->resolved = TRUE;
+  }
+
+  g_free (module_name);
+}
+
+static void
+gum_resolve_query_using_symbols (GumSymbolQuery * query,
+                                 GumDebugSymbolDetails * details)
+{
+  GumModuleEntry * entry = query->entry;
+  gpointer address = query->address;
+  GumDebugSymbolDetails * d = &details[query->index];
+  GumNearestSymbolDetails nearest;
+  gchar * str;
+  gsize offset;
+
+  if (entry == NULL)
+    return;
+
+  d->address = GUM_ADDRESS (address);
+
+  str = g_path_get_basename (gum_elf_module_get_source_path (entry->module));
+  g_strlcpy (d->module_name, str, sizeof (d->module_name));
+  g_free (str);
+
+  nearest.name = NULL;
+  nearest.address = NULL;
+
+  if (entry->dbg == NULL)
+  {
+    Dl_info dl_info;
+
+    if (dladdr (address, &dl_info) != 0)
     {
-      offset = GPOINTER_TO_SIZE (address) - GPOINTER_TO_SIZE (nearest.address);
+      nearest.name = dl_info.dli_sname;
+      nearest.address = dl_info.dli_saddr;
+    }
+  }
 
-      if (offset == 0)
-      {
-        g_strlcpy (details->symbol_name, nearest.name,
-            sizeof (details->symbol_name));
-      }
-      else
-      {
-        g_snprintf (details->symbol_name, sizeof (details->symbol_name),
-            "%s+0x%" G_GSIZE_MODIFIER "x", nearest.name, offset);
-      }
+  if (nearest.name == NULL)
+    gum_find_nearest_symbol_by_address (entry, address, &nearest);
+
+  if (nearest.name != NULL)
+  {
+    offset = GPOINTER_TO_SIZE (address) - GPOINTER_TO_SIZE (nearest.address);
+
+    if (offset == 0)
+    {
+      g_strlcpy (d->symbol_name, nearest.name, sizeof (d->symbol_name));
     }
     else
     {
-      offset = details->address -
-          gum_elf_module_get_base_address (entry->module);
-
-      g_snprintf (details->symbol_name, sizeof (details->symbol_name),
-          "0x%" G_GSIZE_MODIFIER "x", offset);
+      g_snprintf (d->symbol_name, sizeof (d->symbol_name),
+          "%s+0x%" G_GSIZE_MODIFIER "x", nearest.name, offset);
     }
+  }
+  else
+  {
+    offset = d->address - gum_elf_module_get_base_address (entry->module);
 
-    details->file_name[0] = '\0';
-    details->line_number = 0;
-    details->column = 0;
+    g_snprintf (d->symbol_name, sizeof (d->symbol_name),
+        "0x%" G_GSIZE_MODIFIER "x", offset);
+  }
 
-    G_UNLOCK (gum_symbol_util);
+  d->file_name[0] = '\0';
+  d->line_number = 0;
+  d->column = 0;
 
-    return TRUE;
-  }
+  query->resolved = TRUE;
+}
+
+static gint
+gum_symbol_query_compare (const GumSymbolQuery * a,
+                          const GumSymbolQuery * b)
+{
+  if (a->address != b->address)
+    return (a->address < b->address) ? -1 : 1;
+
+  return (a->index < b->index) ? -1 : (a->index > b->index) ? 1 : 0;
 }
 
 gchar *
 gum_symbol_name_from_address (gpointer address)
 {
-  GumDwarfSymbolDetails symbol;
+  gchar * name;
   GumModuleEntry * entry;
   GumNearestSymbolDetails nearest;
   Dwarf_Addr file_address;
-  Dwarf_Die cu_die;
+  GumDwarfIndex * index;
+  const GumDwarfUnit * unit;
+  const GumDwarfSymbolEntry * symbol;
 
-  symbol.name = NULL;
+  name = NULL;
 
   G_LOCK (gum_symbol_util);
 
@@ -280,30 +575,31 @@ gum_symbol_name_from_address (gpointer address)
   file_address = gum_elf_module_translate_to_offline (entry->module,
       GUM_ADDRESS (address));
 
-  cu_die = gum_find_cu_die_by_virtual_address (entry->dbg, file_address);
-  if (cu_die == NULL)
-    goto cu_die_not_found;
-
-  gum_find_symbol_by_virtual_address (entry->dbg, cu_die, file_address,
-      &symbol);
+  index = gum_module_entry_get_dwarf_index (entry);
 
-  dwarf_dealloc (entry->dbg, cu_die, DW_DLA_DIE);
+  unit = gum_dwarf_index_find_unit (index, file_address);
+  if (unit == NULL)
+    goto no_debug_info;
 
-cu_die_not_found:
-  if (symbol.name == NULL)
+  symbol = gum_dwarf_unit_find_symbol (unit, file_address);
+  if (symbol == NULL)
     goto no_debug_info;
 
+  name = g_strdup (index->strings->str + symbol->name_offset);
+
 entry_not_found:
   G_UNLOCK (gum_symbol_util);
 
-  return symbol.name;
+  return name;
 
 no_debug_info:
   {
     gsize offset;
 
+    G_UNLOCK (gum_symbol_util);
+
     if (nearest.name == NULL)
-      gum_find_nearest_symbol_by_address (address, &nearest);
+      gum_find_nearest_symbol_by_address (entry, address, &nearest);
 
     if (nearest.name != NULL)
     {
@@ -311,11 +607,11 @@ no_debug_info:
 
       if (offset == 0)
       {
-        symbol.name = g_strdup (nearest.name);
+        name = g_strdup (nearest.name);
       }
       else
       {
-        symbol.name = g_strdup_printf ("%s+0x%" G_GSIZE_MODIFIER "x",
+        name = g_strdup_printf ("%s+0x%" G_GSIZE_MODIFIER "x",
             nearest.name, offset);
       }
     }
@@ -324,12 +620,10 @@ no_debug_info:
       offset = GPOINTER_TO_SIZE (address) -
           gum_elf_module_get_base_address (entry->module);
 
-      symbol.name = g_strdup_printf ("0x%" G_GSIZE_MODIFIER "x", offset);
+      name = g_strdup_printf ("0x%" G_GSIZE_MODIFIER "x", offset);
     }
 
-    G_UNLOCK (gum_symbol_util);
-
-    return symbol.name;
+    return name;
   }
 }
 
@@ -356,43 +650,23 @@ gum_find_function (const gchar * name)
 }
 
 static gboolean
-gum_find_nearest_symbol_by_address (gpointer address,
+gum_find_nearest_symbol_by_address (GumModuleEntry * entry,
+                                    gpointer address,
                                     GumNearestSymbolDetails * nearest)
 {
-  GHashTable * table;
-  GumElfSymbolDetails * details;
-  GHashTableIter iter;
-  gpointer value;
-
-  table = gum_get_address_symbols ();
-
-  details = g_hash_table_lookup (table, address);
-  if (details != NULL)
-  {
-    nearest->name = details->name;
-    nearest->address = address;
-    return TRUE;
-  }
-
-  g_hash_table_iter_init (&iter, table);
-  while (g_hash_table_iter_next (&iter, NULL, &value))
-  {
-    GumElfSymbolDetails * current_symbol = value;
+  const GumSymbolIndex * index;
+  const GumSymbolIndexEntry * symbol;
 
-    if (current_symbol->address > GUM_ADDRESS (address))
-      continue;
+  index = gum_module_entry_get_symbol_index (entry);
 
-    if (current_symbol->address + current_symbol->size <= GUM_ADDRESS (address))
-    {
-      continue;
-    }
+  symbol = gum_symbol_index_lookup (index, GUM_ADDRESS (address));
+  if (symbol == NULL)
+    return FALSE;
 
-    nearest->address = GSIZE_TO_POINTER (current_symbol->address);
-    nearest->name = current_symbol->name;
-    return TRUE;
-  }
+  nearest->name = index->names + symbol->name_offset;
+  nearest->address = GSIZE_TO_POINTER (index->base_address + symbol->offset);
 
-  return FALSE;
+  return TRUE;
 }
 
 GArray *
@@ -473,6 +747,50 @@ gum_load_symbols (const gchar * path)
   return FALSE;
 }
 
+void
+gum_symbol_util_set_cache_dir (const gchar * path)
+{
+  G_LOCK (gum_symbol_util);
+
+  gum_symbol_util_ensure_initialized ();
+
+  g_free (gum_symbol_cache_dir);
+  gum_symbol_cache_dir = g_strdup (path);
+
+  G_UNLOCK (gum_symbol_util);
+}
+
+/*
+ * Looks up the symbol nearest to @address through a freshly obtained index,
+ * going through the cache directory if one is configured. Used by the test
+ * suite to exercise the cache without involving the per-module state.
+ */
+gchar *
+_gum_symbol_util_find_nearest_symbol (GumElfModule * module,
+                                      GumAddress address,
+                                      GumAddress * symbol_address)
+{
+  gchar * name;
+  GumSymbolIndex * index;
+  const GumSymbolIndexEntry * symbol;
+
+  name = NULL;
+
+  index = gum_symbol_index_obtain (module);
+
+  symbol = gum_symbol_index_lookup (index, address);
+  if (symbol != NULL)
+  {
+    name = g_strdup (index->names + symbol->name_offset);
+    if (symbol_address != NULL)
+      *symbol_address = index->base_address + symbol->offset;
+  }
+
+  gum_symbol_index_free (index);
+
+  return name;
+}
+
 static GumModuleEntry *
 gum_module_entry_from_address (gpointer address,
                                GumNearestSymbolDetails * nearest)
@@ -540,6 +858,8 @@ gum_module_entry_from_module (GumModule * module)
   entry->module = (elf_module != NULL) ? g_object_ref (elf_module) : NULL;
   entry->dbg = dbg;
   entry->collected = FALSE;
+  entry->symbols = NULL;
+  entry->dwarf = NULL;
 
   g_hash_table_insert (gum_module_entries, g_strdup (path), entry);
 
@@ -550,6 +870,12 @@ have_entry:
 static void
 gum_module_entry_free (GumModuleEntry * entry)
 {
+  if (entry->dwarf != NULL)
+    gum_dwarf_index_free (entry->dwarf);
+
+  if (entry->symbols != NULL)
+    gum_symbol_index_free (entry->symbols);
+
   if (entry->dbg != NULL)
     dwarf_finish (entry->dbg);
 
@@ -559,120 +885,537 @@ gum_module_entry_free (GumModuleEntry * entry)
   g_slice_free (GumModuleEntry, entry);
 }
 
-static GHashTable *
-gum_get_function_addresses (void)
+/*
+ * The symbol index of a module is immutable once built, so it is published
+ * atomically and searched without holding the lock. Should two threads race
+ * to build it, the loser simply throws its copy away.
+ */
+static const GumSymbolIndex *
+gum_module_entry_get_symbol_index (GumModuleEntry * self)
 {
-  gum_maybe_refresh_symbol_caches ();
-  return gum_function_addresses;
+  GumSymbolIndex * index;
+
+  index = g_atomic_pointer_get (&self->symbols);
+  if (index != NULL)
+    return index;
+
+  index = gum_symbol_index_obtain (self->module);
+
+  if (!g_atomic_pointer_compare_and_exchange (&self->symbols, NULL, index))
+  {
+    gum_symbol_index_free (index);
+    index = g_atomic_pointer_get (&self->symbols);
+  }
+
+  return index;
 }
 
-static GHashTable *
-gum_get_address_symbols (void)
+static GumDwarfIndex *
+gum_module_entry_get_dwarf_index (GumModuleEntry * self)
 {
-  gum_maybe_refresh_symbol_caches ();
-  return gum_address_symbols;
+  if (self->dwarf == NULL)
+    self->dwarf = gum_dwarf_index_new (self->dbg);
+
+  return self->dwarf;
 }
 
-static void
-gum_maybe_refresh_symbol_caches (void)
+/*
+ * When a cache directory is configured, symbol indexes are persisted there
+ * keyed by the module's GNU build-id, so that the next run can simply map
+ * them in instead of parsing .symtab, .dynsym and .gnu_debugdata again. The
+ * file stores the source file's size and mtime, and is ignored and rewritten
+ * if those no longer match. Symbols are stored as offsets from the module's
+ * base, so the same file serves the module wherever it ends up being loaded.
+ */
+static GumSymbolIndex *
+gum_symbol_index_obtain (GumElfModule * module)
 {
-  gboolean need_update;
+  GumSymbolIndex * index;
+  gchar * cache_dir, * build_id, * cache_path;
+  GStatBuf source_info;
 
-  gum_symbol_util_ensure_initialized ();
+  G_LOCK (gum_symbol_util);
+  cache_dir = g_strdup (gum_symbol_cache_dir);
+  G_UNLOCK (gum_symbol_util);
 
-  if (gum_cache_timer == NULL)
+  if (cache_dir == NULL)
+    return gum_symbol_index_new (module);
+
+  build_id = gum_elf_module_read_build_id (module);
+  if (build_id == NULL)
+    goto uncacheable;
+
+  if (g_stat (gum_elf_module_get_source_path (module), &source_info) != 0)
+    goto uncacheable;
+
+  cache_path = g_strconcat (cache_dir, G_DIR_SEPARATOR_S, build_id, ".symbols",
+      NULL);
+
+  index = gum_symbol_index_load (cache_path, &source_info, module);
+  if (index == NULL)
   {
-    gum_cache_timer = g_timer_new ();
+    index = gum_symbol_index_new (module);
 
-    need_update = TRUE;
+    if (g_mkdir_with_parents (cache_dir, 0700) == 0)
+      gum_symbol_index_save (index, cache_path, &source_info);
   }
-  else
-  {
-    need_update = g_timer_elapsed (gum_cache_timer, NULL) >= GUM_MAX_CACHE_AGE;
+
+  g_free (cache_path);
+  g_free (build_id);
+  g_free (cache_dir);
+
+  return index;
+
+uncacheable:
+  {
+    g_free (build_id);
+    g_free (cache_dir);
+
+    return gum_symbol_index_new (module);
+  }
+}
+
+static GumSymbolIndex *
+gum_symbol_index_new (GumElfModule * module)
+{
+  GumSymbolIndex * index;
+  GArray * entries;
+  guint i, n;
+
+  index = g_slice_new0 (GumSymbolIndex);
+  index->base_address = gum_elf_module_get_base_address (module);
+  index->entry_storage =
+      g_array_new (FALSE, FALSE, sizeof (GumSymbolIndexEntry));
+  index->name_storage = g_string_new (NULL);
+
+  gum_elf_module_enumerate_dynamic_symbols (module,
+      (GumFoundElfSymbolFunc) gum_symbol_index_add_symbol, index);
+  gum_elf_module_enumerate_symbols (module,
+      (GumFoundElfSymbolFunc) gum_symbol_index_add_symbol, index);
+
+  entries = index->entry_storage;
+  g_array_sort (entries, (GCompareFunc) gum_symbol_index_entry_compare);
+
+  n = 0;
+  for (i = 0; i != entries->len; i++)
+  {
+    GumSymbolIndexEntry * e = &g_array_index (entries, GumSymbolIndexEntry, i);
+
+    if (n != 0 &&
+        g_array_index (entries, GumSymbolIndexEntry, n - 1).offset ==
+        e->offset)
+      continue;
+
+    g_array_index (entries, GumSymbolIndexEntry, n++) = *e;
+  }
+  g_array_set_size (entries, n);
+
+  index->entries = (const GumSymbolIndexEntry *) entries->data;
+  index->n_entries = entries->len;
+  index->names = index->name_storage->str;
+  index->names_size = index->name_storage->len;
+
+  return index;
+}
+
+static GumSymbolIndex *
+gum_symbol_index_load (const gchar * path,
+                       const GStatBuf * source_info,
+                       GumElfModule * module)
+{
+  GumSymbolIndex * index;
+  GMappedFile * file;
+  const guint8 * data;
+  gsize size;
+  const GumSymbolCacheHeader * header;
+  const GumSymbolIndexEntry * entries;
+  const gchar * names;
+  guint i;
+
+  file = g_mapped_file_new (path, FALSE, NULL);
+  if (file == NULL)
+    return NULL;
+
+  data = (const guint8 *) g_mapped_file_get_contents (file);
+  size = g_mapped_file_get_length (file);
+
+  if (size < sizeof (GumSymbolCacheHeader))
+    goto invalid_file;
+
+  header = (const GumSymbolCacheHeader *) data;
+  if (header->magic != GUM_SYMBOL_CACHE_MAGIC ||
+      header->version != GUM_SYMBOL_CACHE_VERSION)
+    goto invalid_file;
+  if (header->file_size != (guint64) source_info->st_size ||
+      header->file_mtime != (gint64) source_info->st_mtime)
+    goto invalid_file;
+  if (size != sizeof (GumSymbolCacheHeader) +
+      ((gsize) header->n_entries * sizeof (GumSymbolIndexEntry)) +
+      header->names_size)
+    goto invalid_file;
+
+  entries = (const GumSymbolIndexEntry *) (header + 1);
+  names = (const gchar *) (entries + header->n_entries);
+
+  if (header->names_size != 0 && names[header->names_size - 1] != '\0')
+    goto invalid_file;
+  for (i = 0; i != header->n_entries; i++)
+  {
+    if (entries[i].name_offset >= header->names_size)
+      goto invalid_file;
+  }
+
+  index = g_slice_new0 (GumSymbolIndex);
+  index->base_address = gum_elf_module_get_base_address (module);
+  index->entries = entries;
+  index->n_entries = header->n_entries;
+  index->names = names;
+  index->names_size = header->names_size;
+  index->cache_file = file;
+
+  return index;
+
+invalid_file:
+  {
+    g_mapped_file_unref (file);
+
+    return NULL;
+  }
+}
+
+static void
+gum_symbol_index_save (const GumSymbolIndex * self,
+                       const gchar * path,
+                       const GStatBuf * source_info)
+{
+  GumSymbolCacheHeader header;
+  GByteArray * buffer;
+
+  header.magic = GUM_SYMBOL_CACHE_MAGIC;
+  header.version = GUM_SYMBOL_CACHE_VERSION;
+  header.file_size = source_info->st_size;
+  header.file_mtime = source_info->st_mtime;
+  header.n_entries = self->n_entries;
+  header.names_size = self->names_size;
+
+  buffer = g_byte_array_sized_new (sizeof (header) +
+      (self->n_entries * sizeof (GumSymbolIndexEntry)) + self->names_size);
+  g_byte_array_append (buffer, (const guint8 *) &header, sizeof (header));
+  g_byte_array_append (buffer, (const guint8 *) self->entries,
+      self->n_entries * sizeof (GumSymbolIndexEntry));
+  g_byte_array_append (buffer, (const guint8 *) self->names,
+      self->names_size);
+
+  g_file_set_contents (path, (const gchar *) buffer->data, buffer->len, NULL);
+
+  g_byte_array_unref (buffer);
+}
+
+static void
+gum_symbol_index_free (GumSymbolIndex * index)
+{
+  g_clear_pointer (&index->cache_file, g_mapped_file_unref);
+
+  if (index->name_storage != NULL)
+    g_string_free (index->name_storage, TRUE);
+  if (index->entry_storage != NULL)
+    g_array_free (index->entry_storage, TRUE);
+
+  g_slice_free (GumSymbolIndex, index);
+}
+
+static gboolean
+gum_symbol_index_add_symbol (const GumElfSymbolDetails * details,
+                             GumSymbolIndex * self)
+{
+  GumSymbolIndexEntry e;
+
+  if (details->section == NULL)
+    return TRUE;
+  if (details->type != GUM_ELF_SYMBOL_FUNC &&
+      details->type != GUM_ELF_SYMBOL_OBJECT)
+    return TRUE;
+  if (details->address < self->base_address)
+    return TRUE;
+
+  e.offset = details->address - self->base_address;
+  e.size = details->size;
+  e.name_offset = self->name_storage->len;
+  e.reserved = 0;
+  g_array_append_val (self->entry_storage, e);
+
+  g_string_append_len (self->name_storage, details->name,
+      strlen (details->name) + 1);
+
+  return TRUE;
+}
+
+static gint
+gum_symbol_index_entry_compare (const GumSymbolIndexEntry * a,
+                                const GumSymbolIndexEntry * b)
+{
+  if (a->offset != b->offset)
+    return (a->offset < b->offset) ? -1 : 1;
+
+  /* Prefer the sized flavor when deduplicating. */
+  if (a->size != b->size)
+    return (a->size > b->size) ? -1 : 1;
+
+  return 0;
+}
+
+static const GumSymbolIndexEntry *
+gum_symbol_index_lookup (const GumSymbolIndex * self,
+                         GumAddress address)
+{
+  const GumSymbolIndexEntry * entries;
+  guint64 offset;
+  guint lo, hi;
+  const GumSymbolIndexEntry * candidate;
+
+  if (address < self->base_address)
+    return NULL;
+  offset = address - self->base_address;
+
+  entries = self->entries;
+
+  lo = 0;
+  hi = self->n_entries;
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+
+    if (entries[mid].offset <= offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return NULL;
+
+  candidate = &entries[lo - 1];
+
+  if (candidate->offset == offset ||
+      offset < candidate->offset + candidate->size)
+    return candidate;
+
+  return NULL;
+}
+
+static gchar *
+gum_elf_module_read_build_id (GumElfModule * module)
+{
+  GumFindBuildIdOperation op;
+
+  op.module = module;
+  op.build_id = NULL;
+
+  gum_elf_module_enumerate_sections (module,
+      (GumFoundElfSectionFunc) gum_store_build_id_if_present, &op);
+
+  return op.build_id;
+}
+
+static gboolean
+gum_store_build_id_if_present (const GumElfSectionDetails * details,
+                               GumFindBuildIdOperation * op)
+{
+  gconstpointer data;
+  gsize size;
+  const guint8 * cursor, * end;
+
+  if (details->type != GUM_ELF_SECTION_NOTE)
+    return TRUE;
+
+  data = gum_elf_module_get_file_data (op->module, &size);
+  if (details->offset + details->size > size)
+    return TRUE;
+
+  cursor = (const guint8 *) data + details->offset;
+  end = cursor + details->size;
+
+  while (cursor + sizeof (GumElfNoteHeader) <= end)
+  {
+    const GumElfNoteHeader * header = (const GumElfNoteHeader *) cursor;
+    const gchar * name;
+    const guint8 * desc, * next;
+
+    name = (const gchar *) (header + 1);
+    desc = (const guint8 *) name + GUM_ALIGN_SIZE (header->name_size, 4);
+    next = desc + GUM_ALIGN_SIZE (header->desc_size, 4);
+    if (next > end)
+      break;
+
+    if (header->type == GUM_NT_GNU_BUILD_ID &&
+        header->name_size == 4 && memcmp (name, "GNU", 4) == 0 &&
+        header->desc_size != 0)
+    {
+      GString * id;
+      guint32 i;
+
+      id = g_string_sized_new (2 * header->desc_size);
+      for (i = 0; i != header->desc_size; i++)
+        g_string_append_printf (id, "%02x", desc[i]);
+
+      op->build_id = g_string_free (id, FALSE);
+
+      return FALSE;
+    }
+
+    cursor = next;
+  }
+
+  return TRUE;
+}
+
+static GHashTable *
+gum_get_function_addresses (void)
+{
+  gum_maybe_refresh_symbol_caches ();
+  return gum_function_addresses;
+}
+
+static void
+gum_maybe_refresh_symbol_caches (void)
+{
+  gboolean need_update;
+
+  gum_symbol_util_ensure_initialized ();
+
+  if (gum_cache_timer == NULL)
+  {
+    gum_cache_timer = g_timer_new ();
+
+    need_update = TRUE;
+  }
+  else
+  {
+    need_update = g_timer_elapsed (gum_cache_timer, NULL) >= GUM_MAX_CACHE_AGE;
   }
 
   if (need_update)
   {
-    gum_process_enumerate_modules (gum_collect_module_functions, NULL);
+    GArray * jobs;
+    GPtrArray * pending;
+    guint i, j;
+
+    jobs = g_array_new (FALSE, FALSE, sizeof (GumCollectFunctionsJob));
+    gum_process_enumerate_modules (gum_collect_pending_module_entry, jobs);
+
+    /*
+     * Parsing the symbol tables is what dominates, and each module only
+     * touches its own GumElfModule, so we do that on Gum's worker pool and
+     * merge the results on this thread, in module order.
+     */
+    pending = g_ptr_array_sized_new (jobs->len);
+    for (i = 0; i != jobs->len; i++)
+    {
+      g_ptr_array_add (pending,
+          &g_array_index (jobs, GumCollectFunctionsJob, i));
+    }
+
+    if (!_gum_worker_pool_try_run_jobs (pending,
+          (GFunc) gum_collect_module_functions, NULL))
+    {
+      g_ptr_array_foreach (pending, (GFunc) gum_collect_module_functions, NULL);
+    }
+
+    g_ptr_array_unref (pending);
+
+    for (i = 0; i != jobs->len; i++)
+    {
+      GumCollectFunctionsJob * job =
+          &g_array_index (jobs, GumCollectFunctionsJob, i);
+
+      for (j = 0; j != job->functions->len; j++)
+      {
+        GumCollectedFunction * function =
+            &g_array_index (job->functions, GumCollectedFunction, j);
+
+        gum_add_function_address (function->name, function->address);
+      }
+
+      g_array_free (job->functions, TRUE);
+
+      job->entry->collected = TRUE;
+    }
+
+    g_array_free (jobs, TRUE);
   }
 }
 
 static gboolean
-gum_collect_module_functions (GumModule * module,
-                              gpointer user_data)
+gum_collect_pending_module_entry (GumModule * module,
+                                  gpointer user_data)
 {
+  GArray * jobs = user_data;
   GumModuleEntry * entry;
+  GumCollectFunctionsJob job;
 
   entry = gum_module_entry_from_module (module);
   if (entry == NULL || entry->collected)
     return TRUE;
 
-  gum_elf_module_enumerate_dynamic_symbols (entry->module,
-      gum_collect_symbol_if_function, NULL);
+  job.entry = entry;
+  job.functions = g_array_new (FALSE, FALSE, sizeof (GumCollectedFunction));
+  g_array_append_val (jobs, job);
 
-  gum_elf_module_enumerate_symbols (entry->module,
-      gum_collect_symbol_if_function, NULL);
+  return TRUE;
+}
 
-  entry->collected = TRUE;
+static void
+gum_collect_module_functions (GumCollectFunctionsJob * job,
+                              gpointer user_data)
+{
+  gum_elf_module_enumerate_dynamic_symbols (job->entry->module,
+      gum_collect_symbol_if_function, job->functions);
 
-  return TRUE;
+  gum_elf_module_enumerate_symbols (job->entry->module,
+      gum_collect_symbol_if_function, job->functions);
 }
 
 static gboolean
 gum_collect_symbol_if_function (const GumElfSymbolDetails * details,
                                 gpointer user_data)
 {
-  const gchar * name;
-  gpointer address;
-  GArray * addresses;
-  gboolean already_collected;
-  GumElfSymbolDetails * address_symbol;
+  GArray * functions = user_data;
+  GumCollectedFunction function;
 
   if (details->section == NULL || details->type != GUM_ELF_SYMBOL_FUNC)
     return TRUE;
 
-  name = details->name;
-  address = GSIZE_TO_POINTER (details->address);
+  function.name = g_strdup (details->name);
+  function.address = GSIZE_TO_POINTER (details->address);
+  g_array_append_val (functions, function);
+
+  return TRUE;
+}
 
-  already_collected = FALSE;
+static void
+gum_add_function_address (gchar * name,
+                          gpointer address)
+{
+  GArray * addresses;
+  guint i;
 
   addresses = g_hash_table_lookup (gum_function_addresses, name);
   if (addresses == NULL)
   {
     addresses = g_array_sized_new (FALSE, FALSE, sizeof (gpointer), 1);
-    g_hash_table_insert (gum_function_addresses, g_strdup (name), addresses);
-  }
-  else
-  {
-    guint i;
-
-    for (i = 0; i != addresses->len; i++)
-    {
-      if (g_array_index (addresses, gpointer, i) == address)
-      {
-        already_collected = TRUE;
-        break;
-      }
-    }
+    g_hash_table_insert (gum_function_addresses, name, addresses);
+    g_array_append_val (addresses, address);
+    return;
   }
 
-  if (!already_collected)
-    g_array_append_val (addresses, address);
+  g_free (name);
 
-  address_symbol = g_hash_table_lookup (gum_address_symbols, address);
-  if (address_symbol == NULL)
+  for (i = 0; i != addresses->len; i++)
   {
-    address_symbol = g_slice_new (GumElfSymbolDetails);
-    address_symbol->name = g_strdup (name);
-    address_symbol->address = details->address;
-    address_symbol->size = details->size;
-    address_symbol->type = details->type;
-    address_symbol->bind = details->bind;
-    address_symbol->section = NULL;
-    g_hash_table_insert (gum_address_symbols, address, address_symbol);
+    if (g_array_index (addresses, gpointer, i) == address)
+      return;
   }
 
-  return TRUE;
+  g_array_append_val (addresses, address);
 }
 
 static void
@@ -681,13 +1424,6 @@ gum_function_addresses_free (GArray * addresses)
   g_array_free (addresses, TRUE);
 }
 
-static void
-gum_address_symbols_value_free (GumElfSymbolDetails * details)
-{
-  g_free ((gpointer) details->name);
-  g_slice_free (GumElfSymbolDetails, details);
-}
-
 static void
 gum_symbol_util_ensure_initialized (void)
 {
@@ -698,8 +1434,6 @@ gum_symbol_util_ensure_initialized (void)
       (GDestroyNotify) gum_module_entry_free);
   gum_function_addresses = g_hash_table_new_full (g_str_hash, g_str_equal,
       g_free, (GDestroyNotify) gum_function_addresses_free);
-  gum_address_symbols = g_hash_table_new_full (g_direct_hash, g_direct_equal,
-      NULL, (GDestroyNotify) gum_address_symbols_value_free);
 
   _gum_register_destructor (gum_symbol_util_deinitialize);
 }
@@ -707,11 +1441,9 @@ gum_symbol_util_ensure_initialized (void)
 static void
 gum_symbol_util_deinitialize (void)
 {
+  g_clear_pointer (&gum_symbol_cache_dir, g_free);
   g_clear_pointer (&gum_cache_timer, g_timer_destroy);
 
-  g_hash_table_unref (gum_address_symbols);
-  gum_address_symbols = NULL;
-
   g_hash_table_unref (gum_function_addresses);
   gum_function_addresses = NULL;
 
@@ -719,35 +1451,405 @@ gum_symbol_util_deinitialize (void)
   gum_module_entries = NULL;
 }
 
-static Dwarf_Die
-gum_find_cu_die_by_virtual_address (Dwarf_Debug dbg,
-                                    Dwarf_Addr address)
+/*
+ * The DWARF index of a module maps file addresses to compilation units through
+ * a sorted table of CU ranges, collected by walking the CU headers once. As
+ * ranges may overlap or nest, each one also records the highest end address
+ * seen up to and including it, which bounds how far back a lookup has to look
+ * for a range that contains the address. Each unit's symbols and line rows are
+ * flattened into sorted arrays the first time an address inside it is looked
+ * up, after which queries are plain binary searches that never go back to
+ * libdwarf.
+ */
+static GumDwarfIndex *
+gum_dwarf_index_new (Dwarf_Debug dbg)
 {
-  Dwarf_Die result;
-  GumFindCuDieOperation op;
+  GumDwarfIndex * index;
+  Dwarf_Addr max_end;
+  guint i;
+
+  index = g_slice_new (GumDwarfIndex);
+  index->dbg = dbg;
 
-  op.needle = address;
-  op.found = FALSE;
-  op.cu_die_offset = 0;
+  index->units = g_array_new (FALSE, FALSE, sizeof (GumDwarfUnit));
+  g_array_set_clear_func (index->units, (GDestroyNotify) gum_dwarf_unit_clear);
+  index->ranges = g_array_new (FALSE, FALSE, sizeof (GumDwarfUnitRange));
+
+  index->strings = g_string_new (NULL);
+  index->paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
   gum_enumerate_cu_dies (dbg, TRUE,
-      (GumFoundCuDieFunc) gum_store_cu_die_offset_if_containing_address, &op);
+      (GumFoundCuDieFunc) gum_dwarf_index_add_unit, index);
+
+  g_array_sort (index->ranges, (GCompareFunc) gum_dwarf_unit_range_compare);
+
+  max_end = 0;
+  for (i = 0; i != index->ranges->len; i++)
+  {
+    GumDwarfUnitRange * range =
+        &g_array_index (index->ranges, GumDwarfUnitRange, i);
+
+    max_end = MAX (max_end, range->end);
+    range->max_end = max_end;
+  }
+
+  return index;
+}
+
+static void
+gum_dwarf_index_free (GumDwarfIndex * index)
+{
+  g_hash_table_unref (index->paths);
+  g_string_free (index->strings, TRUE);
+
+  g_array_free (index->ranges, TRUE);
+  g_array_free (index->units, TRUE);
+
+  g_slice_free (GumDwarfIndex, index);
+}
+
+static gboolean
+gum_dwarf_index_add_unit (const GumCuDieDetails * details,
+                          GumDwarfIndex * self)
+{
+  GumDwarfUnit unit;
 
-  if (!op.found)
+  if (dwarf_dieoffset (details->cu_die, &unit.die_offset, NULL) != DW_DLV_OK)
+    return TRUE;
+  unit.loaded = FALSE;
+  unit.symbols = NULL;
+  unit.lines = NULL;
+
+  gum_collect_cu_die_ranges (details->dbg, details->cu_die, self->units->len,
+      self->ranges);
+
+  g_array_append_val (self->units, unit);
+
+  return TRUE;
+}
+
+static GumDwarfUnit *
+gum_dwarf_index_find_unit (GumDwarfIndex * self,
+                           Dwarf_Addr address)
+{
+  const GumDwarfUnitRange * ranges, * range;
+  guint lo, hi;
+  GumDwarfUnit * unit;
+
+  ranges = (const GumDwarfUnitRange *) self->ranges->data;
+
+  lo = 0;
+  hi = self->ranges->len;
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+
+    if (ranges[mid].start <= address)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  /*
+   * Walk back from the last range starting at or before the address, so that
+   * the innermost of any nested ranges wins.
+   */
+  range = NULL;
+  while (lo != 0 && ranges[lo - 1].max_end > address)
+  {
+    lo--;
+
+    if (address < ranges[lo].end)
+    {
+      range = &ranges[lo];
+      break;
+    }
+  }
+  if (range == NULL)
     return NULL;
 
-  result = NULL;
-  dwarf_offdie_b (dbg, op.cu_die_offset, TRUE, &result, NULL);
+  unit = &g_array_index (self->units, GumDwarfUnit, range->unit);
+  if (!unit->loaded)
+    gum_dwarf_index_load_unit (self, unit);
 
-  return result;
+  return unit;
+}
+
+static void
+gum_dwarf_index_load_unit (GumDwarfIndex * self,
+                           GumDwarfUnit * unit)
+{
+  Dwarf_Debug dbg = self->dbg;
+  Dwarf_Die cu_die;
+  GumLoadUnitOperation op;
+  GArray * symbols;
+  Dwarf_Small table_count;
+  Dwarf_Line_Context line_context = NULL;
+  Dwarf_Line * lines;
+  Dwarf_Signed line_count, i;
+  guint j, n;
+
+  unit->loaded = TRUE;
+  unit->symbols = g_array_new (FALSE, FALSE, sizeof (GumDwarfSymbolEntry));
+  unit->lines = g_array_new (FALSE, FALSE, sizeof (GumDwarfLineEntry));
+
+  if (dwarf_offdie_b (dbg, unit->die_offset, TRUE, &cu_die, NULL) != DW_DLV_OK)
+    return;
+
+  op.index = self;
+  op.unit = unit;
+  gum_enumerate_dies (dbg, cu_die,
+      (GumFoundDieFunc) gum_dwarf_index_add_symbol, &op);
+
+  symbols = unit->symbols;
+  g_array_sort (symbols, (GCompareFunc) gum_dwarf_symbol_entry_compare);
+
+  /* Among DIEs at the same address, the first one encountered wins. */
+  n = 0;
+  for (j = 0; j != symbols->len; j++)
+  {
+    GumDwarfSymbolEntry * e = &g_array_index (symbols, GumDwarfSymbolEntry, j);
+
+    if (n != 0 &&
+        g_array_index (symbols, GumDwarfSymbolEntry, n - 1).address ==
+        e->address)
+      continue;
+
+    g_array_index (symbols, GumDwarfSymbolEntry, n++) = *e;
+  }
+  g_array_set_size (symbols, n);
+
+  if (dwarf_srclines_b (cu_die, NULL, &table_count, &line_context, NULL)
+      != DW_DLV_OK)
+  {
+    goto beach;
+  }
+
+  if (dwarf_srclines_from_linecontext (line_context, &lines, &line_count, NULL)
+      != DW_DLV_OK)
+  {
+    goto beach;
+  }
+
+  for (i = 0; i != line_count; i++)
+    gum_dwarf_index_add_line (self, unit, lines[i]);
+
+  g_array_sort (unit->lines, (GCompareFunc) gum_dwarf_line_entry_compare);
+
+beach:
+  g_clear_pointer (&line_context, dwarf_srclines_dealloc_b);
+
+  dwarf_dealloc (dbg, cu_die, DW_DLA_DIE);
 }
 
 static gboolean
-gum_store_cu_die_offset_if_containing_address (const GumCuDieDetails * details,
-                                               GumFindCuDieOperation * op)
+gum_dwarf_index_add_symbol (const GumDieDetails * details,
+                            GumLoadUnitOperation * op)
 {
   Dwarf_Debug dbg = details->dbg;
-  Dwarf_Die die = details->cu_die;
+  Dwarf_Die die = details->die;
+  GumDwarfSymbolEntry e;
+  gchar * name;
+  Dwarf_Unsigned line_number;
+
+  if (details->tag == DW_TAG_subprogram)
+  {
+    if (!gum_read_attribute_address (dbg, die, DW_AT_low_pc, &e.address))
+      return TRUE;
+  }
+  else if (details->tag == DW_TAG_variable)
+  {
+    if (!gum_read_attribute_location (dbg, die, DW_AT_location, &e.address))
+      return TRUE;
+  }
+  else
+  {
+    return TRUE;
+  }
+
+  if (!gum_read_die_name (dbg, die, &name))
+    return TRUE;
+
+  e.name_offset = gum_dwarf_index_add_string (op->index, name);
+  e.line_number =
+      gum_read_attribute_uint (dbg, die, DW_AT_decl_line, &line_number)
+      ? line_number
+      : 0;
+  e.order = op->unit->symbols->len;
+
+  g_array_append_val (op->unit->symbols, e);
+
+  g_free (name);
+
+  return TRUE;
+}
+
+static void
+gum_dwarf_index_add_line (GumDwarfIndex * self,
+                          GumDwarfUnit * unit,
+                          Dwarf_Line line)
+{
+  GumDwarfLineEntry e;
+  Dwarf_Addr address;
+  Dwarf_Unsigned line_number, column;
+  char * path;
+
+  if (dwarf_lineaddr (line, &address, NULL) != DW_DLV_OK)
+    return;
+
+  if (dwarf_lineno (line, &line_number, NULL) != DW_DLV_OK)
+    return;
+
+  if (dwarf_lineoff_b (line, &column, NULL) != DW_DLV_OK)
+    return;
+
+  if (dwarf_linesrc (line, &path, NULL) != DW_DLV_OK)
+    return;
+
+  e.address = address;
+  e.path_offset = gum_dwarf_index_intern_path (self, path);
+  e.line_number = line_number;
+  e.column = column;
+  e.order = unit->lines->len;
+
+  g_array_append_val (unit->lines, e);
+
+  dwarf_dealloc (self->dbg, path, DW_DLA_STRING);
+}
+
+static guint
+gum_dwarf_index_add_string (GumDwarfIndex * self,
+                            const gchar * str)
+{
+  guint offset;
+
+  offset = self->strings->len;
+  g_string_append_len (self->strings, str, strlen (str) + 1);
+
+  return offset;
+}
+
+static guint
+gum_dwarf_index_intern_path (GumDwarfIndex * self,
+                             const gchar * path)
+{
+  gpointer value;
+  gchar * canonicalized;
+  guint offset;
+
+  if (g_hash_table_lookup_extended (self->paths, path, NULL, &value))
+    return GPOINTER_TO_UINT (value);
+
+  canonicalized = g_canonicalize_filename (path, "/");
+  offset = gum_dwarf_index_add_string (self, canonicalized);
+  g_free (canonicalized);
+
+  g_hash_table_insert (self->paths, g_strdup (path),
+      GUINT_TO_POINTER (offset));
+
+  return offset;
+}
+
+static void
+gum_dwarf_unit_clear (GumDwarfUnit * unit)
+{
+  g_clear_pointer (&unit->lines, g_array_unref);
+  g_clear_pointer (&unit->symbols, g_array_unref);
+}
+
+static const GumDwarfSymbolEntry *
+gum_dwarf_unit_find_symbol (const GumDwarfUnit * self,
+                            Dwarf_Addr address)
+{
+  const GumDwarfSymbolEntry * entries;
+  guint lo, hi;
+
+  entries = (const GumDwarfSymbolEntry *) self->symbols->data;
+
+  lo = 0;
+  hi = self->symbols->len;
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+
+    if (entries[mid].address <= address)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return NULL;
+
+  return &entries[lo - 1];
+}
+
+static const GumDwarfLineEntry *
+gum_dwarf_unit_find_line (const GumDwarfUnit * self,
+                          Dwarf_Addr address,
+                          guint symbol_line_number)
+{
+  const GumDwarfLineEntry * entries;
+  guint lo, hi;
+
+  entries = (const GumDwarfLineEntry *) self->lines->data;
+
+  lo = 0;
+  hi = self->lines->len;
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+
+    if (entries[mid].address < address)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  for (; lo != self->lines->len; lo++)
+  {
+    if (entries[lo].line_number >= symbol_line_number)
+      return &entries[lo];
+  }
+
+  return NULL;
+}
+
+static gint
+gum_dwarf_unit_range_compare (const GumDwarfUnitRange * a,
+                              const GumDwarfUnitRange * b)
+{
+  if (a->start != b->start)
+    return (a->start < b->start) ? -1 : 1;
+
+  return (a->unit < b->unit) ? -1 : (a->unit > b->unit) ? 1 : 0;
+}
+
+static gint
+gum_dwarf_symbol_entry_compare (const GumDwarfSymbolEntry * a,
+                                const GumDwarfSymbolEntry * b)
+{
+  if (a->address != b->address)
+    return (a->address < b->address) ? -1 : 1;
+
+  return (a->order < b->order) ? -1 : (a->order > b->order) ? 1 : 0;
+}
+
+static gint
+gum_dwarf_line_entry_compare (const GumDwarfLineEntry * a,
+                              const GumDwarfLineEntry * b)
+{
+  if (a->address != b->address)
+    return (a->address < b->address) ? -1 : 1;
+
+  return (a->order < b->order) ? -1 : (a->order > b->order) ? 1 : 0;
+}
+
+static void
+gum_collect_cu_die_ranges (Dwarf_Debug dbg,
+                           Dwarf_Die die,
+                           guint unit,
+                           GArray * ranges)
+{
   Dwarf_Addr low_pc, high_pc;
   Dwarf_Attribute high_pc_attr;
   Dwarf_Attribute attribute = NULL;
@@ -776,13 +1878,11 @@ gum_store_cu_die_offset_if_containing_address (const GumCuDieDetails * details,
       high_pc = low_pc + offset;
     }
 
-    if (op->needle >= low_pc && op->needle < high_pc)
-    {
-      op->found = TRUE;
-      dwarf_dieoffset (die, &op->cu_die_offset, NULL);
-    }
+    dwarf_dealloc (dbg, high_pc_attr, DW_DLA_ATTR);
+
+    gum_append_unit_range (ranges, low_pc, high_pc, unit);
 
-    return !op->found;
+    return;
   }
 
   if (dwarf_attr (die, DW_AT_ranges, &attribute, NULL) != DW_DLV_OK)
@@ -823,189 +1923,56 @@ gum_store_cu_die_offset_if_containing_address (const GumCuDieDetails * details,
         break;
       if (code == DW_RLE_base_address || code == DW_RLE_base_addressx)
         continue;
-      if (code == debug_addr_unavailable)
+      if (debug_addr_unavailable)
         continue;
 
-      if (op->needle >= low_pc && op->needle < high_pc)
-      {
-        op->found = TRUE;
-        dwarf_dieoffset (die, &op->cu_die_offset, NULL);
-
-        break;
-      }
+      gum_append_unit_range (ranges, low_pc, high_pc, unit);
     }
   }
   else
   {
-    Dwarf_Ranges * ranges;
+    Dwarf_Ranges * dwarf_ranges;
     Dwarf_Signed n, i;
 
-    if (dwarf_get_ranges_b (dbg, ranges_offset, die, NULL, &ranges, &n, NULL,
-        NULL) != DW_DLV_OK)
+    if (dwarf_get_ranges_b (dbg, ranges_offset, die, NULL, &dwarf_ranges, &n,
+        NULL, NULL) != DW_DLV_OK)
       goto skip;
 
     for (i = 0; i != n; i++)
     {
-      Dwarf_Ranges * range = &ranges[i];
+      Dwarf_Ranges * range = &dwarf_ranges[i];
 
       if (range->dwr_type != DW_RANGES_ENTRY)
         break;
 
-      if (op->needle >= range->dwr_addr1 && op->needle < range->dwr_addr2)
-      {
-        op->found = TRUE;
-        dwarf_dieoffset (die, &op->cu_die_offset, NULL);
-
-        break;
-      }
+      gum_append_unit_range (ranges, range->dwr_addr1, range->dwr_addr2, unit);
     }
 
-    dwarf_dealloc_ranges (dbg, ranges, n);
+    dwarf_dealloc_ranges (dbg, dwarf_ranges, n);
   }
 
 skip:
   g_clear_pointer (&rngl, dwarf_dealloc_rnglists_head);
   dwarf_dealloc (dbg, attribute, DW_DLA_ATTR);
-
-  return !op->found;
-}
-
-static gboolean
-gum_find_symbol_by_virtual_address (Dwarf_Debug dbg,
-                                    Dwarf_Die cu_die,
-                                    Dwarf_Addr address,
-                                    GumDwarfSymbolDetails * details)
-{
-  GumFindSymbolOperation op;
-
-  details->name = NULL;
-  details->line_number = 0;
-
-  op.needle = address;
-  op.symbol = details;
-  op.closest_address = 0;
-
-  gum_enumerate_dies (dbg, cu_die,
-      (GumFoundDieFunc) gum_collect_die_if_closest_so_far, &op);
-
-  return details->name != NULL;
 }
 
-static gboolean
-gum_collect_die_if_closest_so_far (const GumDieDetails * details,
-                                   GumFindSymbolOperation * op)
-{
-  Dwarf_Debug dbg = details->dbg;
-  Dwarf_Die die = details->die;
-  GumDwarfSymbolDetails * symbol = op->symbol;
-  Dwarf_Half tag;
-  Dwarf_Addr address;
-
-  if (dwarf_tag (die, &tag, NULL) != DW_DLV_OK)
-    return TRUE;
-
-  if (tag == DW_TAG_subprogram)
-  {
-    if (!gum_read_attribute_address (dbg, die, DW_AT_low_pc, &address))
-      return TRUE;
-  }
-  else if (tag == DW_TAG_variable)
-  {
-    if (!gum_read_attribute_location (dbg, die, DW_AT_location, &address))
-      return TRUE;
-  }
-  else
-  {
-    return TRUE;
-  }
-
-  if (op->needle < address)
-    return TRUE;
-
-  if (op->closest_address == 0 ||
-      (op->needle - address) < (op->needle - op->closest_address))
-  {
-    Dwarf_Unsigned line_number;
-
-    op->closest_address = address;
-
-    g_clear_pointer (&symbol->name, g_free);
-    gum_read_die_name (dbg, die, &symbol->name);
-
-    if (gum_read_attribute_uint (dbg, die, DW_AT_decl_line, &line_number))
-    {
-      symbol->line_number = line_number;
-    }
-  }
-
-  return TRUE;
-}
-
-static gboolean
-gum_find_line_by_virtual_address (Dwarf_Debug dbg,
-                                  Dwarf_Die cu_die,
-                                  Dwarf_Addr address,
-                                  guint symbol_line_number,
-                                  GumDwarfSourceDetails * details)
+static void
+gum_append_unit_range (GArray * ranges,
+                       Dwarf_Addr start,
+                       Dwarf_Addr end,
+                       guint unit)
 {
-  gboolean success = FALSE;
-  Dwarf_Small table_count;
-  Dwarf_Line_Context line_context;
-  Dwarf_Line * lines;
-  Dwarf_Signed line_count, line_index;
-
-  if (dwarf_srclines_b (cu_die, NULL, &table_count, &line_context, NULL)
-      != DW_DLV_OK)
-  {
-    goto beach;
-  }
+  GumDwarfUnitRange range;
 
-  if (dwarf_srclines_from_linecontext (line_context, &lines, &line_count, NULL)
-      != DW_DLV_OK)
-  {
-    goto beach;
-  }
-
-  for (line_index = 0; line_index != line_count; line_index++)
-  {
-    Dwarf_Line line = lines[line_index];
-    Dwarf_Addr line_address;
-
-    if (dwarf_lineaddr (line, &line_address, NULL) != DW_DLV_OK)
-      continue;
-
-    if (line_address >= address)
-    {
-      Dwarf_Unsigned line_number, column;
-      char * path;
-
-      if (dwarf_lineno (line, &line_number, NULL) != DW_DLV_OK)
-        continue;
-
-      if (line_number < symbol_line_number)
-        continue;
-
-      if (dwarf_lineoff_b (line, &column, NULL) != DW_DLV_OK)
-        continue;
-
-      if (dwarf_linesrc (line, &path, NULL) != DW_DLV_OK)
-        continue;
-
-      details->path = g_strdup (path);
-      details->line_number = line_number;
-      details->column = column;
-
-      success = TRUE;
-
-      dwarf_dealloc (dbg, path, DW_DLA_STRING);
-      break;
-    }
-  }
+  if (end <= start)
+    return;
 
-beach:
-  g_clear_pointer (&line_context, dwarf_srclines_dealloc_b);
+  range.start = start;
+  range.end = end;
+  range.max_end = end;
+  range.unit = unit;
 
-  return success;
+  g_array_append_val (ranges, range);
 }
 
 static void
@@ -7,6 +7,9 @@
 #ifndef __GUM_LINUX_PRIV_H__
 #define __GUM_LINUX_PRIV_H__
 
+#include "gummemory.h"
+#include "gummetalarray.h"
+
 #include <dlfcn.h>
 #include <glib.h>
 #include <pthread.h>
@@ -14,18 +17,38 @@
 
 G_BEGIN_DECLS
 
-typedef struct _GumProcMapsIter GumProcMapsIter;
+typedef struct _GumProcMaps GumProcMaps;
+typedef struct _GumProcMapsEntry GumProcMapsEntry;
+
+typedef enum {
+  GUM_PROC_MAPS_CACHED,
+  GUM_PROC_MAPS_FRESH,
+} GumProcMapsFreshness;
+
+typedef struct _GumLinuxWriteTracker GumLinuxWriteTracker;
 
 typedef struct _GumLinuxPThread GumLinuxPThread;
 typedef struct _GumGlibcList GumGlibcList;
 typedef int GumGlibcLock;
 
-struct _GumProcMapsIter
+struct _GumProcMaps
 {
-  gint fd;
-  gchar buffer[(2 * PATH_MAX) + 1];
-  gchar * read_cursor;
-  gchar * write_cursor;
+  gint ref_count;
+  gint generation;
+
+  GumMetalArray text;
+  GumMetalArray entries;
+};
+
+struct _GumProcMapsEntry
+{
+  GumAddress start;
+  GumAddress end;
+  guint64 offset;
+  guint64 inode;
+  GumPageProtection prot;
+  gboolean shared;
+  const gchar * path;
 };
 
 struct _GumLinuxPThreadSpec
@@ -102,15 +125,26 @@ struct _GumLinuxPThread
 
 G_GNUC_INTERNAL const Dl_info * _gum_process_get_libc_info (void);
 
-G_GNUC_INTERNAL void gum_proc_maps_iter_init_for_self (GumProcMapsIter * iter);
-G_GNUC_INTERNAL void gum_proc_maps_iter_init_for_pid (GumProcMapsIter * iter,
-    pid_t pid);
-G_GNUC_INTERNAL void gum_proc_maps_iter_destroy (GumProcMapsIter * iter);
-
-G_GNUC_INTERNAL gboolean gum_proc_maps_iter_next (GumProcMapsIter * iter,
-    const gchar ** line);
-
-G_GNUC_INTERNAL gboolean _gum_try_translate_vdso_name (gchar * name);
+G_GNUC_INTERNAL GumProcMaps * gum_proc_maps_new (void);
+G_GNUC_INTERNAL void gum_proc_maps_free (GumProcMaps * self);
+G_GNUC_INTERNAL gboolean gum_proc_maps_load (GumProcMaps * self, pid_t pid);
+
+G_GNUC_INTERNAL GumProcMaps * _gum_memory_maps_acquire (
+    GumProcMapsFreshness freshness);
+G_GNUC_INTERNAL void _gum_memory_maps_release (GumProcMaps * maps);
+G_GNUC_INTERNAL void _gum_memory_maps_invalidate (void);
+G_GNUC_INTERNAL void _gum_memory_maps_deinit (void);
+
+G_GNUC_INTERNAL GumLinuxWriteTracker * _gum_linux_write_tracker_new (
+    const GumMemoryRange * ranges, guint n_ranges, guint * generation);
+G_GNUC_INTERNAL GumLinuxWriteTracker * _gum_linux_write_tracker_ref (
+    GumLinuxWriteTracker * self);
+G_GNUC_INTERNAL void _gum_linux_write_tracker_unref (
+    GumLinuxWriteTracker * self);
+G_GNUC_INTERNAL gboolean _gum_linux_write_tracker_collect (
+    GumLinuxWriteTracker * self, guint * generation, guint8 * bitmap);
+
+G_GNUC_INTERNAL gint _gum_linux_userfaultfd_create (void);
 
 G_GNUC_INTERNAL void _gum_acquire_dumpability (void);
 G_GNUC_INTERNAL void _gum_release_dumpability (void);
@@ -9,13 +9,19 @@
 
 #include "gumlinux-priv.h"
 #include "gummemory-priv.h"
+#include "gummetalarray.h"
 #include "gum/gumlinux.h"
 #include "valgrind.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <linux/unistd.h>
+#include <linux/userfaultfd.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/syscall.h>
 #include <sys/uio.h>
@@ -49,8 +55,93 @@
 # error FIXME
 #endif
 
+#ifndef IOV_MAX
+# define IOV_MAX 1024
+#endif
+
+#define GUM_PAGEMAP_SOFT_DIRTY (G_GUINT64_CONSTANT (1) << 55)
+#define GUM_PAGEMAP_BATCH_SIZE 512
+
+#if defined (__NR_userfaultfd) && defined (UFFDIO_WRITEPROTECT_MODE_WP)
+# define GUM_HAVE_WRITE_TRACKER 1
+#endif
+
+#define GUM_UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#define GUM_UFFD_FEATURE_WP_ASYNC       (1 << 15)
+
+#define GUM_PAGEMAP_SCAN          _IOWR ('f', 16, GumPageMapScanArg)
+#define GUM_PM_SCAN_WP_MATCHING   (1 << 0)
+#define GUM_PM_SCAN_CHECK_WPASYNC (1 << 1)
+#define GUM_PAGE_IS_WRITTEN       (1 << 1)
+#define GUM_PAGE_IS_PRESENT       (1 << 3)
+#define GUM_PAGEMAP_SCAN_BATCH_SIZE 64
+
+typedef struct _GumPageMapScanArg GumPageMapScanArg;
+typedef struct _GumPageRegion GumPageRegion;
+
+struct _GumLinuxWriteTracker
+{
+  gint ref_count;
+
+  GumMemoryRange * ranges;
+  guint n_ranges;
+
+  gint uffd;
+  gint pagemap_fd;
+
+  GMutex mutex;
+  guint generation;
+};
+
+struct _GumPageMapScanArg
+{
+  guint64 size;
+  guint64 flags;
+  guint64 start;
+  guint64 end;
+  guint64 walk_end;
+  guint64 vec;
+  guint64 vec_len;
+  guint64 max_pages;
+  guint64 category_inverted;
+  guint64 category_mask;
+  guint64 category_anyof_mask;
+  guint64 return_mask;
+};
+
+struct _GumPageRegion
+{
+  guint64 start;
+  guint64 end;
+  guint64 categories;
+};
+
+static void gum_memory_read_many_unbatched (const GumMemoryRange * ranges,
+    guint n_ranges, guint8 * buffer, gsize * n_bytes_read);
+static gboolean gum_memory_probe_readable (gconstpointer address, gsize len,
+    gboolean * readable);
 static gboolean gum_memory_get_protection (gconstpointer address, gsize n,
     gsize * size, GumPageProtection * prot);
+static GumProcMaps * gum_memory_maps_try_ref_cached (void);
+static GumProcMaps * gum_memory_maps_refresh (void);
+static void gum_memory_maps_unref_unlocked (GumProcMaps * maps);
+static gboolean gum_memory_maps_lookup (GumProcMaps * maps, gsize address,
+    gsize n, gsize * size, GumPageProtection * prot);
+
+static gboolean gum_soft_dirty_is_supported (void);
+static gboolean gum_soft_dirty_clear (void);
+static gboolean gum_soft_dirty_probe (void);
+static void gum_set_soft_dirty_error (const gchar * operation, gint code,
+    GError ** error);
+
+#ifdef GUM_HAVE_WRITE_TRACKER
+static gboolean gum_linux_write_tracker_scan (GumLinuxWriteTracker * self,
+    guint8 * bitmap);
+static gboolean gum_linux_write_tracker_is_mapped (
+    GumLinuxWriteTracker * self);
+static void gum_linux_write_tracker_get_page_span (GumLinuxWriteTracker * self,
+    guint range_index, gsize * start, gsize * end);
+#endif
 
 static gssize gum_libc_process_vm_readv (pid_t pid, const struct iovec * local,
     gulong num_local, const struct iovec * remote, gulong num_remote,
@@ -59,13 +150,36 @@ static gssize gum_libc_process_vm_writev (pid_t pid, const struct iovec * local,
     gulong num_local, const struct iovec * remote, gulong num_remote,
     gulong flags);
 
+/*
+ * Snapshot of /proc/self/maps, sorted by address. It is rebuilt lazily once
+ * the generation has moved on, which happens whenever Gum maps, unmaps or
+ * reprotects memory, and when the dynamic linker reports a change. As Gum
+ * does not hear about mappings changed behind its back, the cached snapshot
+ * is only handed to internal callers that tolerate stale answers, such as the
+ * module registry. Protection queries always look at a fresh one, since their
+ * callers go on to touch the memory based on the answer.
+ *
+ * Snapshots are reference counted so they can be walked without holding the
+ * lock, and the most recently retired one is kept around as a spare so that
+ * refreshing does not have to allocate. The lock is never held while reading
+ * the file, which can take a while in processes with many mappings.
+ */
+G_LOCK_DEFINE_STATIC (gum_memory_maps);
+static GumProcMaps * gum_memory_maps = NULL;
+static GumProcMaps * gum_memory_maps_spare = NULL;
+static volatile gint gum_memory_maps_latest_generation = 0;
+
 gboolean
 gum_memory_is_readable (gconstpointer address,
                         gsize len)
 {
+  gboolean readable;
   gsize size;
   GumPageProtection prot;
 
+  if (gum_memory_probe_readable (address, len, &readable))
+    return readable;
+
   if (!gum_memory_get_protection (address, len, &size, &prot))
     return FALSE;
 
@@ -157,6 +271,125 @@ gum_memory_read (gconstpointer address,
   return result;
 }
 
+/*
+ * The buffer is filled sequentially, so a single local iovec covers a whole
+ * batch of remote ones. The kernel stops at the first remote iovec that it
+ * cannot read in full, so after a short read we record how far that range
+ * got and carry on with the next one.
+ */
+void
+gum_memory_read_many (const GumMemoryRange * ranges,
+                      guint n_ranges,
+                      guint8 * buffer,
+                      gsize * n_bytes_read)
+{
+  static gboolean kernel_feature_likely_enabled = TRUE;
+  struct iovec * remote;
+  guint i;
+  gsize offset;
+
+  if (n_ranges == 0)
+    return;
+
+  if (!kernel_feature_likely_enabled ||
+      !gum_linux_check_kernel_version (3, 2, 0))
+  {
+    gum_memory_read_many_unbatched (ranges, n_ranges, buffer, n_bytes_read);
+    return;
+  }
+
+  remote = g_new (struct iovec, MIN (n_ranges, IOV_MAX));
+
+  i = 0;
+  offset = 0;
+
+  while (i != n_ranges)
+  {
+    struct iovec local;
+    guint n_remote, j;
+    gsize batch_size;
+    gssize n;
+
+    n_remote = 0;
+    batch_size = 0;
+    while (i + n_remote != n_ranges && n_remote != IOV_MAX)
+    {
+      const GumMemoryRange * r = &ranges[i + n_remote];
+
+      remote[n_remote].iov_base = GSIZE_TO_POINTER (r->base_address);
+      remote[n_remote].iov_len = r->size;
+      batch_size += r->size;
+      n_remote++;
+    }
+
+    local.iov_base = buffer + offset;
+    local.iov_len = batch_size;
+
+    n = gum_libc_process_vm_readv (getpid (), &local, 1, remote, n_remote, 0);
+    if (n == -1 && errno == ENOSYS)
+    {
+      kernel_feature_likely_enabled = FALSE;
+      gum_memory_read_many_unbatched (ranges + i, n_ranges - i,
+          buffer + offset, n_bytes_read + i);
+      break;
+    }
+
+    if (n < 0)
+      n = 0;
+
+    for (j = 0; j != n_remote; j++)
+    {
+      gsize size = ranges[i + j].size;
+
+      if ((gsize) n < size)
+        break;
+
+      n_bytes_read[i + j] = size;
+      offset += size;
+      n -= size;
+    }
+
+    if (j != n_remote)
+    {
+      n_bytes_read[i + j] = n;
+      offset += ranges[i + j].size;
+      j++;
+    }
+
+    i += j;
+  }
+
+  g_free (remote);
+}
+
+static void
+gum_memory_read_many_unbatched (const GumMemoryRange * ranges,
+                                guint n_ranges,
+                                guint8 * buffer,
+                                gsize * n_bytes_read)
+{
+  guint i;
+
+  for (i = 0; i != n_ranges; i++)
+  {
+    const GumMemoryRange * r = &ranges[i];
+    gconstpointer address = GSIZE_TO_POINTER (r->base_address);
+    gsize size;
+    GumPageProtection prot;
+
+    n_bytes_read[i] = 0;
+
+    if (gum_memory_get_protection (address, r->size, &size, &prot) &&
+        (prot & GUM_PAGE_READ) != 0)
+    {
+      n_bytes_read[i] = MIN (r->size, size);
+      memcpy (buffer, address, n_bytes_read[i]);
+    }
+
+    buffer += r->size;
+  }
+}
+
 gboolean
 gum_memory_write (gpointer address,
                   const guint8 * bytes,
@@ -222,6 +455,8 @@ gum_try_mprotect (gpointer address,
 
   result = mprotect (aligned_address, aligned_size, posix_prot);
 
+  _gum_memory_maps_invalidate ();
+
   return result == 0;
 }
 
@@ -255,6 +490,129 @@ gum_clear_cache (gpointer address,
   VALGRIND_DISCARD_TRANSLATIONS (address, size);
 }
 
+GumProcMaps *
+_gum_memory_maps_acquire (GumProcMapsFreshness freshness)
+{
+  GumProcMaps * maps;
+
+  if (freshness == GUM_PROC_MAPS_CACHED)
+  {
+    maps = gum_memory_maps_try_ref_cached ();
+    if (maps != NULL)
+      return maps;
+  }
+
+  return gum_memory_maps_refresh ();
+}
+
+void
+_gum_memory_maps_release (GumProcMaps * maps)
+{
+  G_LOCK (gum_memory_maps);
+  gum_memory_maps_unref_unlocked (maps);
+  G_UNLOCK (gum_memory_maps);
+}
+
+void
+_gum_memory_maps_invalidate (void)
+{
+  g_atomic_int_inc (&gum_memory_maps_latest_generation);
+}
+
+void
+_gum_memory_maps_deinit (void)
+{
+  G_LOCK (gum_memory_maps);
+
+  if (gum_memory_maps != NULL)
+  {
+    gum_memory_maps_unref_unlocked (gum_memory_maps);
+    gum_memory_maps = NULL;
+  }
+
+  if (gum_memory_maps_spare != NULL)
+  {
+    gum_proc_maps_free (gum_memory_maps_spare);
+    gum_memory_maps_spare = NULL;
+  }
+
+  G_UNLOCK (gum_memory_maps);
+}
+
+/*
+ * Asking the kernel to copy one byte out of each page tells us whether it is
+ * readable right now, without risking a fault, and without trusting a cached
+ * snapshot that mappings made behind our back may have outdated. It also
+ * takes no locks. Returns FALSE if the range spans too many pages to do this
+ * in one go, or if the kernel won't let us.
+ */
+static gboolean
+gum_memory_probe_readable (gconstpointer address,
+                           gsize len,
+                           gboolean * readable)
+{
+  static gboolean kernel_feature_likely_enabled = TRUE;
+  gsize page_size, start, last, cursor;
+  struct iovec local, remote[64];
+  guint8 scratch[G_N_ELEMENTS (remote)];
+  guint n_remote;
+  gboolean finished;
+  gssize n;
+
+  if (!kernel_feature_likely_enabled ||
+      !gum_linux_check_kernel_version (3, 2, 0))
+    return FALSE;
+
+  page_size = gum_query_page_size ();
+
+  start = GPOINTER_TO_SIZE (address);
+  last = start + MAX (len, 1) - 1;
+  if (last < start)
+  {
+    *readable = FALSE;
+    return TRUE;
+  }
+
+  local.iov_base = scratch;
+
+  cursor = start;
+  finished = FALSE;
+  do
+  {
+    n_remote = 0;
+    do
+    {
+      remote[n_remote].iov_base = GSIZE_TO_POINTER (cursor);
+      remote[n_remote].iov_len = 1;
+      n_remote++;
+
+      cursor = (cursor & ~(page_size - 1)) + page_size;
+      finished = cursor == 0 || cursor > last;
+    }
+    while (!finished && n_remote != G_N_ELEMENTS (remote));
+
+    local.iov_len = n_remote;
+
+    n = gum_libc_process_vm_readv (getpid (), &local, 1, remote, n_remote, 0);
+    if (n == -1 && errno != EFAULT)
+    {
+      if (errno == ENOSYS || errno == EPERM)
+        kernel_feature_likely_enabled = FALSE;
+      return FALSE;
+    }
+
+    if (n != (gssize) n_remote)
+    {
+      *readable = FALSE;
+      return TRUE;
+    }
+  }
+  while (!finished);
+
+  *readable = TRUE;
+  return TRUE;
+}
+
 static gboolean
 gum_memory_get_protection (gconstpointer address,
                            gsize n,
@@ -262,8 +620,7 @@ gum_memory_get_protection (gconstpointer address,
                            GumPageProtection * prot)
 {
   gboolean success;
-  GumProcMapsIter iter;
-  const gchar * line;
+  GumProcMaps * maps;
 
   if (size == NULL || prot == NULL)
   {
@@ -275,76 +632,649 @@ gum_memory_get_protection (gconstpointer address,
         (prot != NULL) ? prot : &ignored_prot);
   }
 
-  if (n > 1)
+  *size = 0;
+  *prot = GUM_PAGE_NO_ACCESS;
+
+  maps = gum_memory_maps_refresh ();
+  success = gum_memory_maps_lookup (maps, GPOINTER_TO_SIZE (address), n, size,
+      prot);
+  _gum_memory_maps_release (maps);
+
+  return success;
+}
+
+static GumProcMaps *
+gum_memory_maps_try_ref_cached (void)
+{
+  GumProcMaps * maps;
+
+  G_LOCK (gum_memory_maps);
+
+  maps = gum_memory_maps;
+  if (maps != NULL && maps->generation ==
+      g_atomic_int_get (&gum_memory_maps_latest_generation))
+  {
+    maps->ref_count++;
+  }
+  else
+  {
+    maps = NULL;
+  }
+
+  G_UNLOCK (gum_memory_maps);
+
+  return maps;
+}
+
+/*
+ * Loads a new snapshot into the spare, or a new one if some other thread is
+ * busy with it, and makes it the cached one unless a newer one beat us to it.
+ * The caller gets a reference either way.
+ */
+static GumProcMaps *
+gum_memory_maps_refresh (void)
+{
+  GumProcMaps * maps;
+  gint generation;
+  guint text_capacity, entries_capacity;
+
+  G_LOCK (gum_memory_maps);
+  maps = gum_memory_maps_spare;
+  gum_memory_maps_spare = NULL;
+  G_UNLOCK (gum_memory_maps);
+
+  if (maps == NULL)
+    maps = gum_proc_maps_new ();
+
+  /*
+   * Growing the snapshot's buffers maps memory, which moves the generation
+   * on. If that happened, go again so we don't end up with a snapshot that
+   * is stale from the start. The buffers are big enough by then.
+   */
+  do
+  {
+    text_capacity = maps->text.capacity;
+    entries_capacity = maps->entries.capacity;
+    generation = g_atomic_int_get (&gum_memory_maps_latest_generation);
+
+    gum_proc_maps_load (maps, 0);
+  }
+  while ((maps->text.capacity != text_capacity ||
+        maps->entries.capacity != entries_capacity) &&
+      g_atomic_int_get (&gum_memory_maps_latest_generation) != generation);
+
+  maps->generation = generation;
+  maps->ref_count = 1;
+
+  G_LOCK (gum_memory_maps);
+
+  if (gum_memory_maps == NULL ||
+      (gint) ((guint) generation - (guint) gum_memory_maps->generation) >= 0)
+  {
+    if (gum_memory_maps != NULL)
+      gum_memory_maps_unref_unlocked (gum_memory_maps);
+
+    gum_memory_maps = maps;
+    maps->ref_count++;
+  }
+
+  G_UNLOCK (gum_memory_maps);
+
+  return maps;
+}
+
+static void
+gum_memory_maps_unref_unlocked (GumProcMaps * maps)
+{
+  if (--maps->ref_count != 0)
+    return;
+
+  if (gum_memory_maps_spare == NULL)
+    gum_memory_maps_spare = maps;
+  else
+    gum_proc_maps_free (maps);
+}
+
+static gboolean
+gum_memory_maps_lookup (GumProcMaps * maps,
+                        gsize address,
+                        gsize n,
+                        gsize * size,
+                        GumPageProtection * prot)
+{
+  const GumProcMapsEntry * entries = maps->entries.data;
+  guint num_entries = maps->entries.length;
+  guint lo, hi, i;
+  gsize end;
+
+  lo = 0;
+  hi = num_entries;
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+
+    if (address < entries[mid].start)
+      hi = mid;
+    else if (address >= entries[mid].end)
+      lo = mid + 1;
+    else
+      break;
+  }
+  if (lo >= hi)
+    return FALSE;
+
+  i = lo + ((hi - lo) / 2);
+
+  *prot = entries[i].prot;
+  end = entries[i].end;
+
+  for (i++; i != num_entries && end - address < n; i++)
+  {
+    const GumProcMapsEntry * next = &entries[i];
+
+    if (next->start != end)
+      break;
+    if (next->prot == GUM_PAGE_NO_ACCESS && *prot != GUM_PAGE_NO_ACCESS)
+      break;
+
+    *prot &= next->prot;
+    end = next->end;
+  }
+
+  *size = MIN (end - address, n);
+
+  return TRUE;
+}
+
+/**
+ * gum_linux_reset_soft_dirty:
+ * @error: return location for a #GError
+ *
+ * Clears the soft-dirty bit of every page in the process, so that
+ * gum_linux_query_soft_dirty_pages() subsequently reports only the pages
+ * written to since. The kernel offers no way to do this for a subset of the
+ * address space, so this affects any other user of soft-dirty tracking in
+ * the process as well.
+ *
+ * Requires a kernel built with CONFIG_MEM_SOFT_DIRTY.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+gum_linux_reset_soft_dirty (GError ** error)
+{
+  if (!gum_soft_dirty_is_supported ())
+    goto not_supported;
+
+  if (!gum_soft_dirty_clear ())
+    goto clear_failed;
+
+  return TRUE;
+
+not_supported:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_NOT_SUPPORTED,
+        "Soft-dirty tracking is not supported by the kernel");
+    return FALSE;
+  }
+clear_failed:
+  {
+    gum_set_soft_dirty_error ("reset", errno, error);
+    return FALSE;
+  }
+}
+
+/**
+ * gum_linux_query_soft_dirty_pages:
+ * @range: the #GumMemoryRange to query
+ * @bitmap: (out caller-allocates): where to store one bit per page spanned by
+ *   @range, least significant bit first, set when the page has been written
+ *   to since the last gum_linux_reset_soft_dirty()
+ * @error: return location for a #GError
+ *
+ * Determines which pages in @range have been written to, without incurring
+ * any faults. The number of pages is computed after expanding @range to page
+ * boundaries, and @bitmap must have room for that many bits.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+gum_linux_query_soft_dirty_pages (const GumMemoryRange * range,
+                                  guint8 * bitmap,
+                                  GError ** error)
+{
+  gsize page_size, first_page, n_pages, i;
+  gint fd;
+  gssize res;
+  guint64 entries[GUM_PAGEMAP_BATCH_SIZE];
+
+  page_size = gum_query_page_size ();
+  first_page = range->base_address / page_size;
+  n_pages = ((range->base_address + range->size + page_size - 1) / page_size) -
+      first_page;
+
+  memset (bitmap, 0, (n_pages + 7) / 8);
+
+  fd = open ("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    goto open_failed;
+
+  for (i = 0; i != n_pages;)
+  {
+    gsize n, j;
+
+    n = MIN (n_pages - i, G_N_ELEMENTS (entries));
+
+    res = pread (fd, entries, n * sizeof (guint64),
+        (first_page + i) * sizeof (guint64));
+    if (res < (gssize) sizeof (guint64))
+      goto read_failed;
+    n = res / sizeof (guint64);
+
+    for (j = 0; j != n; j++)
+    {
+      if ((entries[j] & GUM_PAGEMAP_SOFT_DIRTY) != 0)
+        bitmap[(i + j) / 8] |= 1 << ((i + j) % 8);
+    }
+
+    i += n;
+  }
+
+  close (fd);
+
+  return TRUE;
+
+open_failed:
+  {
+    gum_set_soft_dirty_error ("query", errno, error);
+    return FALSE;
+  }
+read_failed:
+  {
+    gint code = (res == -1) ? errno : EIO;
+
+    close (fd);
+    gum_set_soft_dirty_error ("query", code, error);
+
+    return FALSE;
+  }
+}
+
+static gboolean
+gum_soft_dirty_is_supported (void)
+{
+  static gsize cached_result = 0;
+
+  if (g_once_init_enter (&cached_result))
+    g_once_init_leave (&cached_result, gum_soft_dirty_probe () + 1);
+
+  return cached_result - 1;
+}
+
+static gboolean
+gum_soft_dirty_clear (void)
+{
+  gint fd, code;
+  gboolean success;
+
+  fd = open ("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+  if (fd == -1)
+    return FALSE;
+
+  success = write (fd, "4", 1) == 1;
+  code = errno;
+
+  close (fd);
+
+  errno = code;
+
+  return success;
+}
+
+/*
+ * Kernels built without CONFIG_MEM_SOFT_DIRTY accept the request to clear
+ * the bits but never set them, so the only reliable check is to dirty a
+ * page and see whether it gets reported.
+ */
+static gboolean
+gum_soft_dirty_probe (void)
+{
+  gboolean supported = FALSE;
+  volatile guint8 * page;
+  GumMemoryRange range;
+  guint8 bitmap;
+
+  page = gum_alloc_n_pages (1, GUM_PAGE_RW);
+  page[0] = 1;
+
+  if (!gum_soft_dirty_clear ())
+    goto beach;
+
+  page[0] = 2;
+
+  range.base_address = GUM_ADDRESS (page);
+  range.size = 1;
+  if (!gum_linux_query_soft_dirty_pages (&range, &bitmap, NULL))
+    goto beach;
+
+  supported = (bitmap & 1) != 0;
+
+beach:
+  gum_free_pages ((gpointer) page);
+
+  return supported;
+}
+
+static void
+gum_set_soft_dirty_error (const gchar * operation,
+                          gint code,
+                          GError ** error)
+{
+  g_set_error (error, GUM_ERROR,
+      (code == EINVAL) ? GUM_ERROR_NOT_SUPPORTED : GUM_ERROR_FAILED,
+      "Unable to %s soft-dirty bits: %s", operation, g_strerror (code));
+}
+
+/*
+ * Tracks writes to a set of ranges through userfaultfd's asynchronous
+ * write-protection, where a write simply clears the page's protection
+ * instead of blocking the writer. PAGEMAP_SCAN reports the pages whose
+ * protection is gone and restores it in the same walk, so unlike soft-dirty
+ * bits nothing written in between the query and the reset can slip through.
+ * Needs Linux >= 6.7, and the ranges must not be registered with any other
+ * userfaultfd.
+ */
+GumLinuxWriteTracker *
+_gum_linux_write_tracker_new (const GumMemoryRange * ranges,
+                              guint n_ranges,
+                              guint * generation)
+{
+#ifdef GUM_HAVE_WRITE_TRACKER
+  GumLinuxWriteTracker * tracker;
+  struct uffdio_api api;
+  guint i, n_pages;
+  guint8 * bitmap;
+
+  tracker = g_slice_new0 (GumLinuxWriteTracker);
+  tracker->ref_count = 1;
+  tracker->ranges = g_memdup2 (ranges, n_ranges * sizeof (GumMemoryRange));
+  tracker->n_ranges = n_ranges;
+  tracker->pagemap_fd = -1;
+  g_mutex_init (&tracker->mutex);
+  tracker->generation = 1;
+
+  tracker->uffd = _gum_linux_userfaultfd_create ();
+  if (tracker->uffd == -1)
+    goto failure;
+
+  api.api = UFFD_API;
+  api.features = 0;
+  if (ioctl (tracker->uffd, UFFDIO_API, &api) != 0 ||
+      (api.features & GUM_UFFD_FEATURE_WP_ASYNC) == 0)
+    goto failure;
+  close (tracker->uffd);
+
+  tracker->uffd = _gum_linux_userfaultfd_create ();
+  if (tracker->uffd == -1)
+    goto failure;
+
+  api.api = UFFD_API;
+  api.features = UFFD_FEATURE_PAGEFAULT_FLAG_WP | GUM_UFFD_FEATURE_WP_ASYNC |
+      (api.features & GUM_UFFD_FEATURE_WP_UNPOPULATED);
+  if (ioctl (tracker->uffd, UFFDIO_API, &api) != 0)
+    goto failure;
+
+  tracker->pagemap_fd = open ("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+  if (tracker->pagemap_fd == -1)
+    goto failure;
+
+  n_pages = 0;
+  for (i = 0; i != n_ranges; i++)
+  {
+    struct uffdio_register reg;
+    gsize start, end;
+
+    gum_linux_write_tracker_get_page_span (tracker, i, &start, &end);
+
+    reg.range.start = start;
+    reg.range.len = end - start;
+    reg.mode = UFFDIO_REGISTER_MODE_WP;
+    if (ioctl (tracker->uffd, UFFDIO_REGISTER, &reg) != 0)
+      goto failure;
+
+    n_pages += (end - start) / gum_query_page_size ();
+  }
+
+  /*
+   * Every page counts as written until protected, so the first scan both
+   * checks that the kernel supports it and arms the tracking.
+   */
+  bitmap = g_malloc0 ((n_pages + 7) / 8);
+  if (!gum_linux_write_tracker_scan (tracker, bitmap))
+  {
+    g_free (bitmap);
+    goto failure;
+  }
+  g_free (bitmap);
+
+  *generation = tracker->generation;
+
+  return tracker;
+
+failure:
+  {
+    _gum_linux_write_tracker_unref (tracker);
+
+    return NULL;
+  }
+#else
+  return NULL;
+#endif
+}
+
+GumLinuxWriteTracker *
+_gum_linux_write_tracker_ref (GumLinuxWriteTracker * self)
+{
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+_gum_linux_write_tracker_unref (GumLinuxWriteTracker * self)
+{
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
+  if (self->pagemap_fd != -1)
+    close (self->pagemap_fd);
+  if (self->uffd != -1)
+    close (self->uffd);
+
+  g_mutex_clear (&self->mutex);
+  g_free (self->ranges);
+
+  g_slice_free (GumLinuxWriteTracker, self);
+}
+
+/*
+ * Sets the bit of every page written to since the scan that handed out
+ * @generation, one bit per page of each range expanded to page boundaries,
+ * and re-arms the tracking. Pages that are not present are reported as well,
+ * as are all pages if another caller has scanned since or any of the ranges
+ * is no longer fully mapped. On success @generation is updated for the next
+ * call.
+ */
+gboolean
+_gum_linux_write_tracker_collect (GumLinuxWriteTracker * self,
+                                  guint * generation,
+                                  guint8 * bitmap)
+{
+#ifdef GUM_HAVE_WRITE_TRACKER
+  gboolean success;
+  guint n_pages, i;
+  gboolean stale;
+
+  n_pages = 0;
+  for (i = 0; i != self->n_ranges; i++)
+  {
+    gsize start, end;
+
+    gum_linux_write_tracker_get_page_span (self, i, &start, &end);
+    n_pages += (end - start) / gum_query_page_size ();
+  }
+
+  memset (bitmap, 0, (n_pages + 7) / 8);
+
+  g_mutex_lock (&self->mutex);
+
+  stale = *generation != self->generation;
+
+  success = gum_linux_write_tracker_scan (self, bitmap);
+  self->generation++;
+
+  if (success)
   {
-    gsize page_size, start_page, end_page, cur_page;
+    if (stale || !gum_linux_write_tracker_is_mapped (self))
+      memset (bitmap, 0xff, (n_pages + 7) / 8);
 
-    page_size = gum_query_page_size ();
+    *generation = self->generation;
+  }
 
-    start_page = GPOINTER_TO_SIZE (address) & ~(page_size - 1);
-    end_page = (GPOINTER_TO_SIZE (address) + n - 1) & ~(page_size - 1);
+  g_mutex_unlock (&self->mutex);
 
-    success = gum_memory_get_protection (GSIZE_TO_POINTER (start_page), 1, NULL,
-        prot);
-    if (success)
+  return success;
+#else
+  return FALSE;
+#endif
+}
+
+#ifdef GUM_HAVE_WRITE_TRACKER
+
+static gboolean
+gum_linux_write_tracker_scan (GumLinuxWriteTracker * self,
+                              guint8 * bitmap)
+{
+  gsize page_size;
+  guint range_index, first_bit;
+  GumPageRegion regions[GUM_PAGEMAP_SCAN_BATCH_SIZE];
+
+  page_size = gum_query_page_size ();
+  first_bit = 0;
+
+  for (range_index = 0; range_index != self->n_ranges; range_index++)
+  {
+    GumPageMapScanArg arg;
+    gsize start, end;
+
+    gum_linux_write_tracker_get_page_span (self, range_index, &start, &end);
+
+    arg.size = sizeof (arg);
+    arg.flags = GUM_PM_SCAN_WP_MATCHING | GUM_PM_SCAN_CHECK_WPASYNC;
+    arg.start = start;
+    arg.end = end;
+    arg.walk_end = 0;
+    arg.vec = GPOINTER_TO_SIZE (regions);
+    arg.vec_len = G_N_ELEMENTS (regions);
+    arg.max_pages = 0;
+    /* Written or not present, as the latter may have been zapped. */
+    arg.category_inverted = GUM_PAGE_IS_PRESENT;
+    arg.category_mask = 0;
+    arg.category_anyof_mask = GUM_PAGE_IS_WRITTEN | GUM_PAGE_IS_PRESENT;
+    arg.return_mask = GUM_PAGE_IS_WRITTEN | GUM_PAGE_IS_PRESENT;
+
+    while (arg.start < end)
     {
-      *size = page_size - (GPOINTER_TO_SIZE (address) - start_page);
-      for (cur_page = start_page + page_size;
-          cur_page != end_page + page_size;
-          cur_page += page_size)
+      gint n, i;
+
+      n = ioctl (self->pagemap_fd, GUM_PAGEMAP_SCAN, &arg);
+      if (n == -1)
+      {
+        if (errno == EINTR)
+          continue;
+        return FALSE;
+      }
+
+      for (i = 0; i != n; i++)
       {
-        GumPageProtection cur_prot;
+        guint64 page;
 
-        if (gum_memory_get_protection (GSIZE_TO_POINTER (cur_page), 1, NULL,
-            &cur_prot) && (cur_prot != GUM_PAGE_NO_ACCESS ||
-            *prot == GUM_PAGE_NO_ACCESS))
-        {
-          *size += page_size;
-          *prot &= cur_prot;
-        }
-        else
+        for (page = regions[i].start; page != regions[i].end;
+            page += page_size)
         {
-          break;
+          guint bit = first_bit + ((page - start) / page_size);
+
+          bitmap[bit / 8] |= 1 << (bit % 8);
         }
       }
-      *size = MIN (*size, n);
+
+      if (arg.walk_end <= arg.start)
+        return FALSE;
+      arg.start = arg.walk_end;
     }
 
-    return success;
+    first_bit += (end - start) / page_size;
   }
 
-  success = FALSE;
-  *size = 0;
-  *prot = GUM_PAGE_NO_ACCESS;
+  return TRUE;
+}
 
-  gum_proc_maps_iter_init_for_self (&iter);
+static gboolean
+gum_linux_write_tracker_is_mapped (GumLinuxWriteTracker * self)
+{
+  guint i;
 
-  while (gum_proc_maps_iter_next (&iter, &line))
+  for (i = 0; i != self->n_ranges; i++)
   {
-    gpointer start, end;
-    gchar protection[4 + 1];
+    gsize start, end, size;
 
-    sscanf (line, "%p-%p %s ", &start, &end, protection);
+    gum_linux_write_tracker_get_page_span (self, i, &start, &end);
 
-    if (start > address)
-      break;
-    else if (address >= start && address + n - 1 < end)
+    if (!gum_memory_get_protection (GSIZE_TO_POINTER (start), end - start,
+          &size, NULL) ||
+        size != end - start)
     {
-      success = TRUE;
-      *size = 1;
-      if (protection[0] == 'r')
-        *prot |= GUM_PAGE_READ;
-      if (protection[1] == 'w')
-        *prot |= GUM_PAGE_WRITE;
-      if (protection[2] == 'x')
-        *prot |= GUM_PAGE_EXECUTE;
-      break;
+      return FALSE;
     }
   }
 
-  gum_proc_maps_iter_destroy (&iter);
+  return TRUE;
+}
+
+static void
+gum_linux_write_tracker_get_page_span (GumLinuxWriteTracker * self,
+                                       guint range_index,
+                                       gsize * start,
+                                       gsize * end)
+{
+  const GumMemoryRange * r = &self->ranges[range_index];
+  gsize page_size = gum_query_page_size ();
 
-  return success;
+  *start = r->base_address & ~(page_size - 1);
+  *end = (r->base_address + r->size + page_size - 1) & ~(page_size - 1);
+}
+
+#endif
+
+gint
+_gum_linux_userfaultfd_create (void)
+{
+#ifdef __NR_userfaultfd
+  gint fd;
+
+# ifdef UFFD_USER_MODE_ONLY
+  fd = syscall (__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+  if (fd != -1)
+    return fd;
+# endif
+
+  fd = syscall (__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+
+  return fd;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
 }
 
 static gssize
@@ -190,90 +190,58 @@ static void
 gum_enumerate_modules_using_proc_maps (GumFoundModuleFunc func,
                                        gpointer user_data)
 {
-  GumProcMapsIter iter;
-  gchar * path, * next_path;
-  const gchar * line;
+  GumProcMaps * maps;
+  const GumProcMapsEntry * entries;
   gboolean carry_on = TRUE;
-  gboolean got_line = FALSE;
+  guint n, i;
 
-  gum_proc_maps_iter_init_for_self (&iter);
+  maps = _gum_memory_maps_acquire (GUM_PROC_MAPS_FRESH);
+  entries = maps->entries.data;
+  n = maps->entries.length;
 
-  path = g_malloc (PATH_MAX);
-  next_path = g_malloc (PATH_MAX);
-
-  do
+  i = 0;
+  while (carry_on && i != n)
   {
     const guint8 elf_magic[] = { 0x7f, 'E', 'L', 'F' };
+    const GumProcMapsEntry * first = &entries[i];
+    const gchar * path = first->path;
     GumMemoryRange range;
-    GumAddress end;
-    gchar perms[5] = { 0, };
-    gint n;
-    gboolean is_vdso, readable, shared;
+    gboolean is_vdso;
     GumNativeModule * module;
 
-    if (!got_line)
-    {
-      if (!gum_proc_maps_iter_next (&iter, &line))
-        break;
-    }
-    else
-    {
-      got_line = FALSE;
-    }
+    i++;
 
-    n = sscanf (line,
-        "%" G_GINT64_MODIFIER "x-%" G_GINT64_MODIFIER "x "
-        "%4c "
-        "%*x %*s %*d "
-        "%[^\n]",
-        &range.base_address, &end,
-        perms,
-        path);
-    if (n == 3)
+    if (path == NULL)
       continue;
-    g_assert (n == 4);
 
-    is_vdso = _gum_try_translate_vdso_name (path);
+    is_vdso = strcmp (path, "linux-vdso.so.1") == 0;
 
-    readable = perms[0] == 'r';
-    shared = perms[3] == 's';
-    if (!readable || shared)
+    if ((first->prot & GUM_PAGE_READ) == 0 || first->shared)
       continue;
     else if ((path[0] != '/' && !is_vdso) || g_str_has_prefix (path, "/dev/"))
       continue;
     else if (RUNNING_ON_VALGRIND && strstr (path, "/valgrind/") != NULL)
       continue;
-    else if (memcmp (GSIZE_TO_POINTER (range.base_address), elf_magic,
+    else if (memcmp (GSIZE_TO_POINTER (first->start), elf_magic,
         sizeof (elf_magic)) != 0)
       continue;
 
-    range.size = end - range.base_address;
+    range.base_address = first->start;
+    range.size = first->end - first->start;
 
-    while (gum_proc_maps_iter_next (&iter, &line))
+    for (; i != n; i++)
     {
-      n = sscanf (line,
-          "%*x-%" G_GINT64_MODIFIER "x %*c%*c%*c%*c %*x %*s %*d %[^\n]",
-          &end,
-          next_path);
-      if (n == 1)
-      {
+      const GumProcMapsEntry * e = &entries[i];
+
+      if (e->path == NULL)
+        continue;
+      if (e->path[0] == '[')
         continue;
-      }
-      else if (n == 2 && next_path[0] == '[')
-      {
-        if (!_gum_try_translate_vdso_name (next_path))
-          continue;
-      }
 
-      if (n == 2 && strcmp (next_path, path) == 0)
-      {
-        range.size = end - range.base_address;
-      }
-      else
-      {
-        got_line = TRUE;
+      if (e->path != path && strcmp (e->path, path) != 0)
         break;
-      }
+
+      range.size = e->end - range.base_address;
     }
 
     module = _gum_native_module_make (path, &range, gum_create_module_handle,
@@ -283,12 +251,8 @@ gum_enumerate_modules_using_proc_maps (GumFoundModuleFunc func,
 
     g_object_unref (module);
   }
-  while (carry_on);
-
-  g_free (path);
-  g_free (next_path);
 
-  gum_proc_maps_iter_destroy (&iter);
+  _gum_memory_maps_release (maps);
 }
 
 static gpointer
@@ -382,7 +346,10 @@ _gum_module_registry_handle_rtld_notification (GumSynchronizeModulesFunc sync,
                                                GumInvocationContext * ic)
 {
   if (gum_r_debug->r_state == RT_CONSISTENT)
+  {
+    _gum_memory_maps_invalidate ();
     sync ();
+  }
 }
 
 static const GumProgramModules *
@@ -395,9 +362,9 @@ gum_query_program_modules (void)
     static GumProgramRanges ranges;
     gboolean got_kern, got_user;
     GumProgramRanges kern, user;
-    GumProcMapsIter iter;
-    gchar * path;
-    const gchar * line;
+    GumProcMaps * maps;
+    const GumProcMapsEntry * entries;
+    guint n, i;
 
     got_kern = gum_query_program_ranges (gum_read_auxv_from_proc, &kern);
     got_user = gum_query_program_ranges (gum_read_auxv_from_stack, &user);
@@ -416,23 +383,22 @@ gum_query_program_modules (void)
         ? GUM_PROGRAM_RTLD_NONE
         : GUM_PROGRAM_RTLD_SHARED;
 
-    gum_proc_maps_iter_init_for_self (&iter);
-    path = g_malloc (PATH_MAX);
+    maps = _gum_memory_maps_acquire (GUM_PROC_MAPS_CACHED);
+    entries = maps->entries.data;
+    n = maps->entries.length;
 
-    while (gum_proc_maps_iter_next (&iter, &line))
+    for (i = 0; i != n; i++)
     {
-      GumAddress start;
+      const GumProcMapsEntry * e = &entries[i];
       GumModule ** m;
       const GumMemoryRange * r;
 
-      sscanf (line, "%" G_GINT64_MODIFIER "x-", &start);
-
-      if (start == ranges.program.base_address)
+      if (e->start == ranges.program.base_address)
       {
         m = &gum_program_modules.program;
         r = &ranges.program;
       }
-      else if (start == ranges.interpreter.base_address)
+      else if (e->start == ranges.interpreter.base_address)
       {
         m = &gum_program_modules.interpreter;
         r = &ranges.interpreter;
@@ -440,13 +406,11 @@ gum_query_program_modules (void)
       else
         continue;
 
-      sscanf (line, "%*x-%*x %*c%*c%*c%*c %*x %*s %*d %[^\n]", path);
-
-      *m = GUM_MODULE (_gum_native_module_make_handleless (path, r));
+      *m = GUM_MODULE (_gum_native_module_make_handleless (
+          (e->path != NULL) ? e->path : "", r));
     }
 
-    g_free (path);
-    gum_proc_maps_iter_destroy (&iter);
+    _gum_memory_maps_release (maps);
 
     if (ranges.vdso.base_address != 0)
     {
@@ -617,31 +581,30 @@ gum_read_auxv_from_stack (void)
 static gboolean
 gum_query_main_thread_stack_range (GumMemoryRange * range)
 {
-  GumProcMapsIter iter;
-  GumAddress stack_bottom, stack_top;
-  const gchar * line;
+  GumProcMaps * maps;
+  const GumProcMapsEntry * entries;
+  guint n, i;
 
-  gum_proc_maps_iter_init_for_self (&iter);
+  range->base_address = 0;
+  range->size = 0;
 
-  stack_bottom = 0;
-  stack_top = 0;
+  maps = _gum_memory_maps_acquire (GUM_PROC_MAPS_FRESH);
+  entries = maps->entries.data;
+  n = maps->entries.length;
 
-  while (gum_proc_maps_iter_next (&iter, &line))
+  for (i = 0; i != n; i++)
   {
-    if (g_str_has_suffix (line, " [stack]"))
+    const GumProcMapsEntry * e = &entries[i];
+
+    if (e->path != NULL && strcmp (e->path, "[stack]") == 0)
     {
-      sscanf (line,
-          "%" G_GINT64_MODIFIER "x-%" G_GINT64_MODIFIER "x ",
-          &stack_bottom,
-          &stack_top);
+      range->base_address = e->start;
+      range->size = e->end - e->start;
       break;
     }
   }
 
-  range->base_address = stack_bottom;
-  range->size = stack_top - stack_bottom;
-
-  gum_proc_maps_iter_destroy (&iter);
+  _gum_memory_maps_release (maps);
 
   return range->size != 0;
 }
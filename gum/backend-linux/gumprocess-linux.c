@@ -361,8 +361,10 @@ static void gum_do_set_hardware_watchpoint (GumThreadId thread_id,
 static void gum_do_unset_hardware_watchpoint (GumThreadId thread_id,
     GumRegs * regs, gpointer user_data);
 
-static void gum_proc_maps_iter_init_for_path (GumProcMapsIter * iter,
-    const gchar * path);
+static gboolean gum_proc_maps_read_text (GumProcMaps * self, pid_t pid);
+static gboolean gum_proc_maps_parse_line (gchar ** cursor,
+    GumProcMapsEntry * entry);
+static guint64 gum_proc_maps_parse_number (gchar ** cursor, guint base);
 
 static GumPageProtection gum_page_protection_from_proc_perms_string (
     const gchar * perms);
@@ -1100,93 +1102,57 @@ GHashTable *
 gum_linux_collect_named_ranges (void)
 {
   GHashTable * result;
-  GumProcMapsIter iter;
-  gchar * name, * next_name;
-  const gchar * line;
-  gboolean carry_on = TRUE;
-  gboolean got_line = FALSE;
+  GumProcMaps * maps;
+  const GumProcMapsEntry * entries;
+  guint n, i;
 
   result = g_hash_table_new_full (NULL, NULL, NULL,
       (GDestroyNotify) gum_linux_named_range_free);
 
-  gum_proc_maps_iter_init_for_self (&iter);
-
-  name = g_malloc (PATH_MAX);
-  next_name = g_malloc (PATH_MAX);
+  maps = _gum_memory_maps_acquire (GUM_PROC_MAPS_FRESH);
+  entries = maps->entries.data;
+  n = maps->entries.length;
 
-  do
+  i = 0;
+  while (i != n)
   {
-    GumAddress start, end;
+    const GumProcMapsEntry * first = &entries[i];
+    const gchar * name = first->path;
     gsize size;
-    gint n;
     GumLinuxNamedRange * range;
 
-    if (!got_line)
-    {
-      if (!gum_proc_maps_iter_next (&iter, &line))
-        break;
-    }
-    else
-    {
-      got_line = FALSE;
-    }
+    i++;
 
-    n = sscanf (line,
-        "%" G_GINT64_MODIFIER "x-%" G_GINT64_MODIFIER "x "
-        "%*4c "
-        "%*x %*s %*d "
-        "%[^\n]",
-        &start, &end,
-        name);
-    if (n == 2)
+    if (name == NULL)
       continue;
-    g_assert (n == 3);
 
-    _gum_try_translate_vdso_name (name);
+    size = first->end - first->start;
 
-    size = end - start;
-
-    while (gum_proc_maps_iter_next (&iter, &line))
+    for (; i != n; i++)
     {
-      n = sscanf (line,
-          "%*x-%" G_GINT64_MODIFIER "x %*c%*c%*c%*c %*x %*s %*d %[^\n]",
-          &end,
-          next_name);
-      if (n == 1)
-      {
+      const GumProcMapsEntry * e = &entries[i];
+
+      if (e->path == NULL)
+        continue;
+      if (e->path[0] == '[' && e->path != name)
         continue;
-      }
-      else if (n == 2 && next_name[0] == '[')
-      {
-        if (!_gum_try_translate_vdso_name (next_name))
-          continue;
-      }
 
-      if (n == 2 && strcmp (next_name, name) == 0)
-      {
-        size = end - start;
-      }
-      else
-      {
-        got_line = TRUE;
+      if (e->path != name)
         break;
-      }
+
+      size = e->end - first->start;
     }
 
     range = g_slice_new (GumLinuxNamedRange);
 
     range->name = g_strdup (name);
-    range->base = GSIZE_TO_POINTER (start);
+    range->base = GSIZE_TO_POINTER (first->start);
     range->size = size;
 
     g_hash_table_insert (result, range->base, range);
   }
-  while (carry_on);
-
-  g_free (name);
-  g_free (next_name);
 
-  gum_proc_maps_iter_destroy (&iter);
+  _gum_memory_maps_release (maps);
 
   return result;
 }
@@ -1199,18 +1165,6 @@ gum_linux_named_range_free (GumLinuxNamedRange * range)
   g_slice_free (GumLinuxNamedRange, range);
 }
 
-gboolean
-_gum_try_translate_vdso_name (gchar * name)
-{
-  if (strcmp (name, "[vdso]") == 0)
-  {
-    strcpy (name, "linux-vdso.so.1");
-    return TRUE;
-  }
-
-  return FALSE;
-}
-
 void
 gum_linux_pthread_iter_init (GumLinuxPThreadIter * iter,
                              const GumLinuxPThreadSpec * spec)
@@ -1316,41 +1270,44 @@ gum_linux_enumerate_ranges (pid_t pid,
                             GumFoundRangeFunc func,
                             gpointer user_data)
 {
-  GumProcMapsIter iter;
+  gboolean is_self;
+  GumProcMaps * maps;
+  const GumProcMapsEntry * entries;
   gboolean carry_on = TRUE;
-  const gchar * line;
+  guint n, i;
+
+  is_self = pid == getpid ();
+  if (is_self)
+  {
+    maps = _gum_memory_maps_acquire (GUM_PROC_MAPS_FRESH);
+  }
+  else
+  {
+    maps = gum_proc_maps_new ();
+    gum_proc_maps_load (maps, pid);
+  }
 
-  gum_proc_maps_iter_init_for_pid (&iter, pid);
+  entries = maps->entries.data;
+  n = maps->entries.length;
 
-  while (carry_on && gum_proc_maps_iter_next (&iter, &line))
+  for (i = 0; carry_on && i != n; i++)
   {
+    const GumProcMapsEntry * e = &entries[i];
     GumRangeDetails details;
     GumMemoryRange range;
     GumFileMapping file;
-    GumAddress end;
-    gchar perms[5] = { 0, };
-    guint64 inode;
-    gint length;
-
-    sscanf (line,
-        "%" G_GINT64_MODIFIER "x-%" G_GINT64_MODIFIER "x "
-        "%4c "
-        "%" G_GINT64_MODIFIER "x %*s %" G_GINT64_MODIFIER "d"
-        "%n",
-        &range.base_address, &end,
-        perms,
-        &file.offset, &inode,
-        &length);
-
-    range.size = end - range.base_address;
+
+    range.base_address = e->start;
+    range.size = e->end - e->start;
 
     details.file = NULL;
-    if (inode != 0)
+    if (e->inode != 0 && e->path != NULL)
     {
-      file.path = strchr (line + length, '/');
+      file.path = strchr (e->path, '/');
       if (file.path != NULL)
       {
         details.file = &file;
+        file.offset = e->offset;
         file.size = 0; /* TODO */
 
         if (RUNNING_ON_VALGRIND && strstr (file.path, "/valgrind/") != NULL)
@@ -1359,7 +1316,7 @@ gum_linux_enumerate_ranges (pid_t pid,
     }
 
     details.range = &range;
-    details.protection = gum_page_protection_from_proc_perms_string (perms);
+    details.protection = e->prot;
 
     if ((details.protection & prot) == prot)
     {
@@ -1367,7 +1324,10 @@ gum_linux_enumerate_ranges (pid_t pid,
     }
   }
 
-  gum_proc_maps_iter_destroy (&iter);
+  if (is_self)
+    _gum_memory_maps_release (maps);
+  else
+    gum_proc_maps_free (maps);
 }
 
 void
@@ -2018,103 +1978,205 @@ gum_linux_module_path_matches (const gchar * path,
   return strcmp (name_or_path, path) == 0;
 }
 
-void
-gum_proc_maps_iter_init_for_self (GumProcMapsIter * iter)
-{
-  gum_proc_maps_iter_init_for_path (iter, "/proc/self/maps");
-}
+/*
+ * Parsed snapshot of a process' maps. The file is slurped with as few reads as
+ * the kernel allows into a buffer that is kept around between loads, and the
+ * lines are then parsed in place: path strings are NUL-terminated where they
+ * are, and runs of mappings backed by the same file share one path pointer so
+ * that consumers may coalesce them by pointer comparison. Reloading an
+ * existing snapshot does not allocate unless it has outgrown its buffers.
+ */
 
-void
-gum_proc_maps_iter_init_for_pid (GumProcMapsIter * iter,
-                                 pid_t pid)
+GumProcMaps *
+gum_proc_maps_new (void)
 {
-  gchar path[31 + 1];
+  GumProcMaps * maps;
 
-  sprintf (path, "/proc/%u/maps", (guint) pid);
-
-  gum_proc_maps_iter_init_for_path (iter, path);
-}
+  maps = g_slice_new (GumProcMaps);
+  maps->ref_count = 0;
+  maps->generation = -1;
+  gum_metal_array_init (&maps->text, sizeof (gchar));
+  gum_metal_array_init (&maps->entries, sizeof (GumProcMapsEntry));
 
-static void
-gum_proc_maps_iter_init_for_path (GumProcMapsIter * iter,
-                                  const gchar * path)
-{
-  iter->fd = open (path, O_RDONLY | O_CLOEXEC);
-  iter->read_cursor = iter->buffer;
-  iter->write_cursor = iter->buffer;
+  return maps;
 }
 
 void
-gum_proc_maps_iter_destroy (GumProcMapsIter * iter)
+gum_proc_maps_free (GumProcMaps * self)
 {
-  if (iter->fd != -1)
-    close (iter->fd);
+  gum_metal_array_free (&self->entries);
+  gum_metal_array_free (&self->text);
+
+  g_slice_free (GumProcMaps, self);
 }
 
 gboolean
-gum_proc_maps_iter_next (GumProcMapsIter * iter,
-                         const gchar ** line)
+gum_proc_maps_load (GumProcMaps * self,
+                    pid_t pid)
 {
-  gchar * next_newline;
-  guint available;
-  gboolean need_refill;
+  gchar * cursor, * end;
+  const gchar * previous_path;
+
+  gum_metal_array_remove_all (&self->entries);
 
-  if (iter->fd == -1)
+  if (!gum_proc_maps_read_text (self, pid))
     return FALSE;
 
-  next_newline = NULL;
+  cursor = self->text.data;
+  end = cursor + self->text.length;
+  previous_path = NULL;
 
-  available = iter->write_cursor - iter->read_cursor;
-  if (available == 0)
+  while (cursor != end)
   {
-    need_refill = TRUE;
-  }
-  else
-  {
-    next_newline = strchr (iter->read_cursor, '\n');
-    if (next_newline != NULL)
-    {
-      need_refill = FALSE;
-    }
-    else
+    GumProcMapsEntry entry;
+
+    if (!gum_proc_maps_parse_line (&cursor, &entry))
+      continue;
+
+    /*
+     * Pseudo-paths like [heap] and [anon:foo] may sit between mappings of
+     * the same file, so they must not break up the sharing.
+     */
+    if (entry.path != NULL && entry.path[0] != '[')
     {
-      need_refill = TRUE;
+      if (previous_path != NULL && strcmp (entry.path, previous_path) == 0)
+        entry.path = previous_path;
+      else
+        previous_path = entry.path;
     }
+
+    *((GumProcMapsEntry *) gum_metal_array_append (&self->entries)) = entry;
   }
 
-  if (need_refill)
+  return TRUE;
+}
+
+static gboolean
+gum_proc_maps_read_text (GumProcMaps * self,
+                         pid_t pid)
+{
+  gboolean success = FALSE;
+  gchar path[31 + 1];
+  gint fd;
+  GumMetalArray * text = &self->text;
+
+  if (pid == 0)
+    strcpy (path, "/proc/self/maps");
+  else
+    sprintf (path, "/proc/%u/maps", (guint) pid);
+
+  fd = open (path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return FALSE;
+
+  gum_metal_array_remove_all (text);
+  gum_metal_array_ensure_capacity (text, 64 * 1024);
+
+  while (TRUE)
   {
-    guint offset;
     gssize res;
 
-    offset = iter->read_cursor - iter->buffer;
-    if (offset > 0)
-    {
-      memmove (iter->buffer, iter->read_cursor, available);
-      iter->read_cursor -= offset;
-      iter->write_cursor -= offset;
-    }
+    if (text->capacity - text->length < PATH_MAX + 256)
+      gum_metal_array_ensure_capacity (text, text->capacity * 2);
 
-    res = GUM_TEMP_FAILURE_RETRY (gum_libc_read (iter->fd,
-        iter->write_cursor,
-        iter->buffer + sizeof (iter->buffer) - 1 - iter->write_cursor));
-    if (res <= 0)
-      return FALSE;
-
-    iter->write_cursor += res;
-    iter->write_cursor[0] = '\0';
+    res = GUM_TEMP_FAILURE_RETRY (gum_libc_read (fd,
+        (gchar *) text->data + text->length,
+        text->capacity - text->length - 1));
+    if (res == -1)
+      goto beach;
+    if (res == 0)
+      break;
 
-    next_newline = strchr (iter->read_cursor, '\n');
+    text->length += res;
   }
 
-  *line = iter->read_cursor;
-  *next_newline = '\0';
+  ((gchar *) text->data)[text->length] = '\0';
+
+  success = TRUE;
+
+beach:
+  close (fd);
+
+  return success;
+}
+
+static gboolean
+gum_proc_maps_parse_line (gchar ** cursor,
+                          GumProcMapsEntry * entry)
+{
+  gchar * p = *cursor;
+  gchar * line_end, * path;
+
+  line_end = strchr (p, '\n');
+  if (line_end == NULL)
+    line_end = p + strlen (p);
+  *cursor = (*line_end != '\0') ? line_end + 1 : line_end;
+  *line_end = '\0';
+
+  entry->start = gum_proc_maps_parse_number (&p, 16);
+  if (*p++ != '-')
+    return FALSE;
+  entry->end = gum_proc_maps_parse_number (&p, 16);
+  if (*p++ != ' ')
+    return FALSE;
+
+  if (line_end - p < 5 || p[4] != ' ')
+    return FALSE;
+  entry->prot = gum_page_protection_from_proc_perms_string (p);
+  entry->shared = p[3] == 's';
+  p += 5;
+
+  entry->offset = gum_proc_maps_parse_number (&p, 16);
+  if (*p++ != ' ')
+    return FALSE;
+
+  p = strchr (p, ' ');
+  if (p == NULL)
+    return FALSE;
+  p++;
+
+  entry->inode = gum_proc_maps_parse_number (&p, 10);
 
-  iter->read_cursor = next_newline + 1;
+  path = p;
+  while (*path == ' ')
+    path++;
+  if (*path == '\0')
+    entry->path = NULL;
+  else if (strcmp (path, "[vdso]") == 0)
+    entry->path = "linux-vdso.so.1";
+  else
+    entry->path = path;
 
   return TRUE;
 }
 
+static guint64
+gum_proc_maps_parse_number (gchar ** cursor,
+                            guint base)
+{
+  guint64 value = 0;
+  gchar * p;
+
+  for (p = *cursor; TRUE; p++)
+  {
+    gchar c = *p;
+    guint digit;
+
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (base == 16 && c >= 'a' && c <= 'f')
+      digit = 10 + (c - 'a');
+    else
+      break;
+
+    value = (value * base) + digit;
+  }
+
+  *cursor = p;
+
+  return value;
+}
+
 void
 _gum_acquire_dumpability (void)
 {
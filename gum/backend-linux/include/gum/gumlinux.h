@@ -60,6 +60,10 @@ GUM_API void gum_linux_lock_pthread_list (const GumLinuxPThreadSpec * spec);
 GUM_API void gum_linux_unlock_pthread_list (const GumLinuxPThreadSpec * spec);
 GUM_API const GumLinuxPThreadSpec * gum_linux_query_pthread_spec (void);
 
+GUM_API gboolean gum_linux_reset_soft_dirty (GError ** error);
+GUM_API gboolean gum_linux_query_soft_dirty_pages (
+    const GumMemoryRange * range, guint8 * bitmap, GError ** error);
+
 GUM_API gboolean gum_linux_module_path_matches (const gchar * path,
     const gchar * name_or_path);
 
@@ -8,11 +8,20 @@
 
 #include "gummemory-priv.h"
 #include "gumprocess-priv.h"
+#ifdef HAVE_LINUX
+# include "gumlinux-priv.h"
+#endif
 
 #include <errno.h>
 #include <unistd.h>
 #include <sys/mman.h>
 
+#ifdef HAVE_LINUX
+# define GUM_NOTE_MAPPINGS_CHANGED() _gum_memory_maps_invalidate ()
+#else
+# define GUM_NOTE_MAPPINGS_CHANGED()
+#endif
+
 typedef struct _GumAllocNearContext GumAllocNearContext;
 typedef struct _GumEnumerateFreeRangesContext GumEnumerateFreeRangesContext;
 
@@ -55,6 +64,9 @@ _gum_memory_backend_init (void)
 void
 _gum_memory_backend_deinit (void)
 {
+#ifdef HAVE_LINUX
+  _gum_memory_maps_deinit ();
+#endif
 }
 
 guint
@@ -293,14 +305,25 @@ gum_allocate_page_aligned (gpointer address,
   }
 #endif
 
-  return (result != MAP_FAILED) ? result : NULL;
+  if (result == MAP_FAILED)
+    return NULL;
+
+  GUM_NOTE_MAPPINGS_CHANGED ();
+
+  return result;
 }
 
 gboolean
 gum_memory_free (gpointer address,
                  gsize size)
 {
-  return munmap (address, size) == 0;
+  gboolean success;
+
+  success = munmap (address, size) == 0;
+
+  GUM_NOTE_MAPPINGS_CHANGED ();
+
+  return success;
 }
 
 gboolean
@@ -350,8 +373,14 @@ gboolean
 gum_memory_decommit (gpointer address,
                      gsize size)
 {
-  return mmap (address, size, PROT_NONE,
+  gboolean success;
+
+  success = mmap (address, size, PROT_NONE,
       MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) == address;
+
+  GUM_NOTE_MAPPINGS_CHANGED ();
+
+  return success;
 }
 
 static void
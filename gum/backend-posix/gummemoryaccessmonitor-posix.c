@@ -8,8 +8,26 @@
 #include "gummemoryaccessmonitor.h"
 
 #include "gumexceptor.h"
+#ifdef HAVE_LINUX
+# include "backend-linux/gumlinux-priv.h"
+#endif
 
 #include <sys/mman.h>
+#ifdef HAVE_LINUX
+# include <errno.h>
+# include <fcntl.h>
+# include <poll.h>
+# include <unistd.h>
+# include <linux/userfaultfd.h>
+# include <sys/eventfd.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# if defined (__NR_userfaultfd) && defined (UFFDIO_WRITEPROTECT_MODE_WP)
+#  define GUM_HAVE_USERFAULTFD_WP 1
+# endif
+#endif
+
+#define GUM_USERFAULTFD_BATCH_SIZE 64
 
 typedef struct _GumPageState GumPageState;
 typedef struct _GumRangeStats GumRangeStats;
@@ -40,6 +58,14 @@ struct _GumMemoryAccessMonitor
   GumMemoryAccessNotify notify_func;
   gpointer notify_data;
   GDestroyNotify notify_data_destroy;
+
+  gboolean async_delivery;
+#ifdef GUM_HAVE_USERFAULTFD_WP
+  gint uffd;
+  guint64 uffd_features;
+  gint uffd_wakeup_fd;
+  GThread * uffd_thread;
+#endif
 };
 
 struct _GumPageState
@@ -76,7 +102,7 @@ static void gum_memory_access_monitor_finalize (GObject * object);
 
 static gboolean gum_collect_range_stats (const GumLivePageDetails * details,
     gpointer user_data);
-static gboolean gum_monitor_range (const GumLivePageDetails * details,
+static gboolean gum_collect_page (const GumLivePageDetails * details,
     gpointer user_data);
 static gboolean gum_demonitor_range (const GumLivePageDetails * details,
     gpointer user_data);
@@ -89,6 +115,25 @@ static gboolean gum_emit_live_range_if_monitored (
 
 static gboolean gum_memory_access_monitor_on_exception (
     GumExceptionDetails * details, gpointer user_data);
+static GumPageState * gum_memory_access_monitor_find_page (
+    GumMemoryAccessMonitor * self, gpointer address);
+static gboolean gum_memory_access_monitor_report (
+    GumMemoryAccessMonitor * self, GumPageState * page,
+    GumMemoryAccessDetails * d);
+
+#ifdef GUM_HAVE_USERFAULTFD_WP
+static gboolean gum_memory_access_monitor_try_enable_userfaultfd (
+    GumMemoryAccessMonitor * self);
+static void gum_memory_access_monitor_disable_userfaultfd (
+    GumMemoryAccessMonitor * self);
+static gpointer gum_memory_access_monitor_process_faults (
+    GumMemoryAccessMonitor * self);
+static void gum_memory_access_monitor_on_write_fault (
+    GumMemoryAccessMonitor * self, const struct uffd_msg * msg);
+static gint gum_userfaultfd_open (guint64 * features);
+static gboolean gum_userfaultfd_write_protect (gint uffd, gsize start,
+    gsize size, gboolean protect);
+#endif
 
 G_DEFINE_TYPE (GumMemoryAccessMonitor, gum_memory_access_monitor, G_TYPE_OBJECT)
 
@@ -105,6 +150,11 @@ static void
 gum_memory_access_monitor_init (GumMemoryAccessMonitor * self)
 {
   self->page_size = gum_query_page_size ();
+
+#ifdef GUM_HAVE_USERFAULTFD_WP
+  self->uffd = -1;
+  self->uffd_wakeup_fd = -1;
+#endif
 }
 
 static void
@@ -176,11 +226,39 @@ gum_memory_access_monitor_new (const GumMemoryRange * ranges,
   return monitor;
 }
 
+/**
+ * gum_memory_access_monitor_set_async_delivery:
+ * @self: a #GumMemoryAccessMonitor
+ * @enabled: whether accesses may be reported from a different thread
+ *
+ * Allows accesses to be reported from a dedicated thread while the thread
+ * performing the access is held back, instead of from a signal handler on
+ * the accessing thread. Must be called before enabling the monitor.
+ *
+ * On Linux this lets a monitor that only looks for writes, with auto-reset
+ * enabled, use userfaultfd write-protection when the kernel supports it.
+ * No signals are involved then, so the target's own SIGSEGV handling is left
+ * alone. The details are delivered without #GumMemoryAccessDetails.from and
+ * #GumMemoryAccessDetails.context, as those are not known to the kernel,
+ * and with a #GumMemoryAccessDetails.thread_id of 0 if the kernel is too old
+ * to report it.
+ * In all other cases this setting has no effect.
+ */
+void
+gum_memory_access_monitor_set_async_delivery (GumMemoryAccessMonitor * self,
+                                              gboolean enabled)
+{
+  g_return_if_fail (!self->enabled);
+
+  self->async_delivery = enabled;
+}
+
 gboolean
 gum_memory_access_monitor_enable (GumMemoryAccessMonitor * self,
                                   GError ** error)
 {
   GumRangeStats stats;
+  guint i;
 
   if (self->enabled)
     return TRUE;
@@ -195,13 +273,30 @@ gum_memory_access_monitor_enable (GumMemoryAccessMonitor * self,
   else if (stats.guarded_count != 0)
     goto error_inaccessible_pages;
 
+  self->pages = g_array_new (FALSE, FALSE, sizeof (GumPageState));
+  gum_memory_access_monitor_enumerate_live_pages (self, gum_collect_page,
+      self);
+
+#ifdef GUM_HAVE_USERFAULTFD_WP
+  if (gum_memory_access_monitor_try_enable_userfaultfd (self))
+  {
+    self->enabled = TRUE;
+    return TRUE;
+  }
+#endif
+
   self->exceptor = gum_exceptor_obtain ();
   gum_exceptor_add (self->exceptor, gum_memory_access_monitor_on_exception,
       self);
 
-  self->pages = g_array_new (FALSE, FALSE, sizeof (GumPageState));
-  gum_memory_access_monitor_enumerate_live_pages (self, gum_monitor_range,
-      self);
+  for (i = 0; i != self->pages->len; i++)
+  {
+    const GumPageState * page = &g_array_index (self->pages, GumPageState, i);
+    GumPageProtection old_prot = page->protection;
+
+    gum_try_mprotect (page->base, self->page_size,
+        (old_prot ^ self->access_mask) & old_prot);
+  }
 
   self->enabled = TRUE;
 
@@ -227,13 +322,22 @@ gum_memory_access_monitor_disable (GumMemoryAccessMonitor * self)
   if (!self->enabled)
     return;
 
-  gum_memory_access_monitor_enumerate_live_pages (self, gum_demonitor_range,
-      self);
+#ifdef GUM_HAVE_USERFAULTFD_WP
+  if (self->uffd != -1)
+  {
+    gum_memory_access_monitor_disable_userfaultfd (self);
+  }
+  else
+#endif
+  {
+    gum_memory_access_monitor_enumerate_live_pages (self, gum_demonitor_range,
+        self);
 
-  gum_exceptor_remove (self->exceptor, gum_memory_access_monitor_on_exception,
-      self);
-  g_object_unref (self->exceptor);
-  self->exceptor = NULL;
+    gum_exceptor_remove (self->exceptor,
+        gum_memory_access_monitor_on_exception, self);
+    g_object_unref (self->exceptor);
+    self->exceptor = NULL;
+  }
 
   g_array_free (self->pages, TRUE);
 
@@ -255,25 +359,19 @@ gum_collect_range_stats (const GumLivePageDetails * details,
 }
 
 static gboolean
-gum_monitor_range (const GumLivePageDetails * details,
-                   gpointer user_data)
+gum_collect_page (const GumLivePageDetails * details,
+                  gpointer user_data)
 {
   GumMemoryAccessMonitor * self = user_data;
-  GumPageProtection old_prot, new_prot;
   GumPageState page;
 
-  old_prot = details->protection;
-  new_prot = (old_prot ^ self->access_mask) & old_prot;
-
   page.base = details->base;
-  page.protection = old_prot;
+  page.protection = details->protection;
   page.range_index = details->range_index;
   page.completed = 0;
 
   g_array_append_val (self->pages, page);
 
-  gum_try_mprotect (page.base, self->page_size, new_prot);
-
   return TRUE;
 }
 
@@ -368,9 +466,9 @@ gum_memory_access_monitor_on_exception (GumExceptionDetails * details,
                                         gpointer user_data)
 {
   GumMemoryAccessMonitor * self = user_data;
-  const guint page_size = self->page_size;
   GumMemoryAccessDetails d;
-  guint i;
+  GumPageState * page;
+  GumPageProtection original_prot;
 
   if (details->type != GUM_EXCEPTION_ACCESS_VIOLATION)
     return FALSE;
@@ -381,62 +479,341 @@ gum_memory_access_monitor_on_exception (GumExceptionDetails * details,
   d.address = details->memory.address;
   d.context = &details->context;
 
+  page = gum_memory_access_monitor_find_page (self, d.address);
+  if (page == NULL)
+    return FALSE;
+
+  original_prot = page->protection;
+
+  switch (d.operation)
+  {
+    case GUM_MEMOP_READ:
+      if ((original_prot & GUM_PAGE_READ) == 0)
+        return FALSE;
+      break;
+    case GUM_MEMOP_WRITE:
+      if ((original_prot & GUM_PAGE_WRITE) == 0)
+        return FALSE;
+      break;
+    case GUM_MEMOP_EXECUTE:
+      if ((original_prot & GUM_PAGE_EXECUTE) == 0)
+        return FALSE;
+      break;
+    default:
+      g_assert_not_reached ();
+  }
+
+  if (self->auto_reset)
+    gum_try_mprotect (page->base, self->page_size, page->protection);
+
+  return gum_memory_access_monitor_report (self, page, &d);
+}
+
+static GumPageState *
+gum_memory_access_monitor_find_page (GumMemoryAccessMonitor * self,
+                                     gpointer address)
+{
+  const guint page_size = self->page_size;
+  guint i;
+
   for (i = 0; i != self->pages->len; i++)
   {
-    GumPageState * page;
-    const GumMemoryRange * r;
-    guint operation_mask;
-    guint operations_reported;
-    guint pages_remaining;
+    GumPageState * page = &g_array_index (self->pages, GumPageState, i);
+
+    if (address >= page->base && address < page->base + page_size)
+      return page;
+  }
 
-    page = &g_array_index (self->pages, GumPageState, i);
-    r = &self->ranges[page->range_index];
+  return NULL;
+}
+
+static gboolean
+gum_memory_access_monitor_report (GumMemoryAccessMonitor * self,
+                                  GumPageState * page,
+                                  GumMemoryAccessDetails * d)
+{
+  const GumMemoryRange * r = &self->ranges[page->range_index];
+  guint operation_mask;
+  guint operations_reported;
+  guint pages_remaining;
+
+  operation_mask = 1 << d->operation;
+  operations_reported = g_atomic_int_or (&page->completed, operation_mask);
+  if (operations_reported != 0 && self->auto_reset)
+    return FALSE;
+  if (operations_reported == 0)
+    pages_remaining = g_atomic_int_add (&self->pages_remaining, -1) - 1;
+  else
+    pages_remaining = g_atomic_int_get (&self->pages_remaining);
+  d->pages_completed = self->pages_total - pages_remaining;
+
+  d->range_index = page->range_index;
+  d->page_index =
+      (d->address - GSIZE_TO_POINTER (r->base_address)) / self->page_size;
+  d->pages_total = self->pages_total;
+
+  self->notify_func (self, d, self->notify_data);
+
+  return TRUE;
+}
+
+#ifdef GUM_HAVE_USERFAULTFD_WP
+
+/*
+ * Writes to write-protected pages suspend the writer inside the kernel and
+ * queue a message on the userfaultfd, which we drain in batches from a
+ * dedicated thread. Lifting the protection of the page wakes the writer up,
+ * so there is neither a signal nor an mprotect() involved per access.
+ */
+static gboolean
+gum_memory_access_monitor_try_enable_userfaultfd (GumMemoryAccessMonitor * self)
+{
+  gint uffd, wakeup_fd;
+  guint64 features;
+  guint num_registered, i;
+
+  if (!self->async_delivery || self->access_mask != GUM_PAGE_WRITE ||
+      !self->auto_reset)
+  {
+    return FALSE;
+  }
+
+  uffd = gum_userfaultfd_open (&features);
+  if (uffd == -1)
+    return FALSE;
+  wakeup_fd = -1;
+  num_registered = 0;
 
-    if (d.address >= page->base && d.address < page->base + page_size)
+#ifdef UFFD_FEATURE_WP_UNPOPULATED
+  if ((features & UFFD_FEATURE_WP_UNPOPULATED) == 0)
+#endif
+  {
+    for (i = 0; i != self->pages->len; i++)
     {
-      GumPageProtection original_prot = page->protection;
-
-      switch (d.operation)
-      {
-        case GUM_MEMOP_READ:
-          if ((original_prot & GUM_PAGE_READ) == 0)
-            return FALSE;
-          break;
-        case GUM_MEMOP_WRITE:
-          if ((original_prot & GUM_PAGE_WRITE) == 0)
-            return FALSE;
-          break;
-        case GUM_MEMOP_EXECUTE:
-          if ((original_prot & GUM_PAGE_EXECUTE) == 0)
-            return FALSE;
-          break;
-        default:
-          g_assert_not_reached ();
-      }
-
-      if (self->auto_reset)
-        gum_try_mprotect (page->base, page_size, page->protection);
-
-      operation_mask = 1 << d.operation;
-      operations_reported = g_atomic_int_or (&page->completed, operation_mask);
-      if (operations_reported != 0 && self->auto_reset)
-        return FALSE;
-      if (operations_reported == 0)
-        pages_remaining = g_atomic_int_add (&self->pages_remaining, -1) - 1;
-      else
-        pages_remaining = g_atomic_int_get (&self->pages_remaining);
-      d.pages_completed = self->pages_total - pages_remaining;
+      const GumPageState * page =
+          &g_array_index (self->pages, GumPageState, i);
+
+      if ((page->protection & GUM_PAGE_READ) != 0)
+        (void) *((volatile guint8 *) page->base);
+    }
+  }
 
-      d.range_index = page->range_index;
-      d.page_index =
-          (d.address - GSIZE_TO_POINTER (r->base_address)) / page_size;
-      d.pages_total = self->pages_total;
+  for (i = 0; i != self->num_ranges; i++)
+  {
+    const GumMemoryRange * r = &self->ranges[i];
+    struct uffdio_register reg;
+
+    reg.range.start = r->base_address;
+    reg.range.len = r->size;
+    reg.mode = UFFDIO_REGISTER_MODE_WP;
+    if (ioctl (uffd, UFFDIO_REGISTER, &reg) != 0)
+      goto failure;
+    num_registered++;
+  }
 
-      self->notify_func (self, &d, self->notify_data);
+  wakeup_fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (wakeup_fd == -1)
+    goto failure;
 
-      return TRUE;
+  for (i = 0; i != self->num_ranges; i++)
+  {
+    const GumMemoryRange * r = &self->ranges[i];
+
+    if (!gum_userfaultfd_write_protect (uffd, r->base_address, r->size, TRUE))
+      goto failure;
+  }
+
+  self->uffd = uffd;
+  self->uffd_features = features;
+  self->uffd_wakeup_fd = wakeup_fd;
+  self->uffd_thread = g_thread_new ("gum-access-monitor",
+      (GThreadFunc) gum_memory_access_monitor_process_faults, self);
+
+  return TRUE;
+
+failure:
+  {
+    for (i = 0; i != num_registered; i++)
+    {
+      const GumMemoryRange * r = &self->ranges[i];
+      struct uffdio_range range;
+
+      gum_userfaultfd_write_protect (uffd, r->base_address, r->size, FALSE);
+
+      range.start = r->base_address;
+      range.len = r->size;
+      ioctl (uffd, UFFDIO_UNREGISTER, &range);
+    }
+
+    if (wakeup_fd != -1)
+      close (wakeup_fd);
+    close (uffd);
+
+    return FALSE;
+  }
+}
+
+static void
+gum_memory_access_monitor_disable_userfaultfd (GumMemoryAccessMonitor * self)
+{
+  const guint64 wakeup = 1;
+  guint i;
+
+  while (write (self->uffd_wakeup_fd, &wakeup, sizeof (wakeup)) == -1 &&
+      errno == EINTR)
+    ;
+  g_thread_join (self->uffd_thread);
+  self->uffd_thread = NULL;
+
+  for (i = 0; i != self->num_ranges; i++)
+  {
+    const GumMemoryRange * r = &self->ranges[i];
+    struct uffdio_range range;
+
+    gum_userfaultfd_write_protect (self->uffd, r->base_address, r->size,
+        FALSE);
+
+    range.start = r->base_address;
+    range.len = r->size;
+    ioctl (self->uffd, UFFDIO_UNREGISTER, &range);
+  }
+
+  close (self->uffd_wakeup_fd);
+  self->uffd_wakeup_fd = -1;
+
+  close (self->uffd);
+  self->uffd = -1;
+}
+
+static gpointer
+gum_memory_access_monitor_process_faults (GumMemoryAccessMonitor * self)
+{
+  struct pollfd fds[2];
+  struct uffd_msg msgs[GUM_USERFAULTFD_BATCH_SIZE];
+
+  fds[0].fd = self->uffd;
+  fds[0].events = POLLIN;
+  fds[1].fd = self->uffd_wakeup_fd;
+  fds[1].events = POLLIN;
+
+  while (TRUE)
+  {
+    gssize n;
+    guint i;
+
+    if (poll (fds, G_N_ELEMENTS (fds), -1) == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    if (fds[1].revents != 0)
+      break;
+
+    n = read (self->uffd, msgs, sizeof (msgs));
+    if (n == -1)
+    {
+      if (errno == EAGAIN || errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (i = 0; i != n / sizeof (struct uffd_msg); i++)
+    {
+      if (msgs[i].event == UFFD_EVENT_PAGEFAULT)
+        gum_memory_access_monitor_on_write_fault (self, &msgs[i]);
     }
   }
 
-  return FALSE;
+  return NULL;
 }
+
+static void
+gum_memory_access_monitor_on_write_fault (GumMemoryAccessMonitor * self,
+                                          const struct uffd_msg * msg)
+{
+  GumMemoryAccessDetails d;
+  GumPageState * page;
+  gsize page_base;
+
+  d.thread_id = ((self->uffd_features & UFFD_FEATURE_THREAD_ID) != 0)
+      ? msg->arg.pagefault.feat.ptid
+      : 0;
+  d.operation = GUM_MEMOP_WRITE;
+  d.from = NULL;
+  d.address = GSIZE_TO_POINTER (msg->arg.pagefault.address);
+  d.context = NULL;
+
+  page = gum_memory_access_monitor_find_page (self, d.address);
+  if (page != NULL)
+    gum_memory_access_monitor_report (self, page, &d);
+
+  page_base = GPOINTER_TO_SIZE (d.address) & ~((gsize) self->page_size - 1);
+  gum_userfaultfd_write_protect (self->uffd, page_base, self->page_size,
+      FALSE);
+}
+
+static gint
+gum_userfaultfd_open (guint64 * features)
+{
+  gint fd;
+  struct uffdio_api api;
+  guint64 required, optional;
+
+  required = UFFD_FEATURE_PAGEFAULT_FLAG_WP;
+  optional = UFFD_FEATURE_THREAD_ID;
+#ifdef UFFD_FEATURE_EXACT_ADDRESS
+  optional |= UFFD_FEATURE_EXACT_ADDRESS;
+#endif
+#ifdef UFFD_FEATURE_WP_UNPOPULATED
+  optional |= UFFD_FEATURE_WP_UNPOPULATED;
+#endif
+
+  /*
+   * The handshake can only be done once per fd, so find out which of the
+   * optional features are available using a throwaway one. Requesting an
+   * unsupported feature fails the handshake, which is how we detect kernels
+   * lacking write-protect support.
+   */
+  fd = _gum_linux_userfaultfd_create ();
+  if (fd == -1)
+    return -1;
+  api.api = UFFD_API;
+  api.features = 0;
+  if (ioctl (fd, UFFDIO_API, &api) != 0)
+    api.features = 0;
+  close (fd);
+
+  fd = _gum_linux_userfaultfd_create ();
+  if (fd == -1)
+    return -1;
+  api.features = required | (api.features & optional);
+  api.api = UFFD_API;
+  if (ioctl (fd, UFFDIO_API, &api) != 0)
+  {
+    close (fd);
+    return -1;
+  }
+
+  *features = api.features;
+
+  return fd;
+}
+
+static gboolean
+gum_userfaultfd_write_protect (gint uffd,
+                               gsize start,
+                               gsize size,
+                               gboolean protect)
+{
+  struct uffdio_writeprotect wp;
+
+  wp.range.start = start;
+  wp.range.len = size;
+  wp.mode = protect ? UFFDIO_WRITEPROTECT_MODE_WP : 0;
+
+  return ioctl (uffd, UFFDIO_WRITEPROTECT, &wp) == 0;
+}
+
+#endif
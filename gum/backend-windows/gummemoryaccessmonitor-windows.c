@@ -172,6 +172,15 @@ gum_memory_access_monitor_new (const GumMemoryRange * ranges,
   return monitor;
 }
 
+void
+gum_memory_access_monitor_set_async_delivery (GumMemoryAccessMonitor * self,
+                                              gboolean enabled)
+{
+  g_return_if_fail (!self->enabled);
+
+  /* Accesses are always reported from the faulting thread on Windows. */
+}
+
 gboolean
 gum_memory_access_monitor_enable (GumMemoryAccessMonitor * self,
                                   GError ** error)
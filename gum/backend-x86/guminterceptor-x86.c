@@ -18,6 +18,7 @@
 
 #define GUM_INTERCEPTOR_FULL_REDIRECT_SIZE  16
 #define GUM_INTERCEPTOR_NEAR_REDIRECT_SIZE  5
+#define GUM_INTERCEPTOR_TRAMPOLINE_ALIGNMENT 16
 #define GUM_X86_JMP_MAX_DISTANCE            (G_MAXINT32 - 16384)
 
 #define GUM_FRAME_OFFSET_CPU_CONTEXT 0
@@ -42,6 +43,10 @@ struct _GumInterceptorBackend
 
   GumCodeSlice * enter_thunk;
   GumCodeSlice * leave_thunk;
+
+  GumCodeSlice * pack_slice;
+  guint pack_offset;
+  guint8 * scratch;
 };
 
 struct _GumX86FunctionContextData
@@ -53,6 +58,16 @@ struct _GumX86FunctionContextData
 G_STATIC_ASSERT (sizeof (GumX86FunctionContextData)
     <= sizeof (GumFunctionContextBackendData));
 
+static gboolean gum_interceptor_backend_try_pack_trampoline (
+    GumInterceptorBackend * self, GumFunctionContext * ctx);
+static void gum_interceptor_backend_set_pack_slice (
+    GumInterceptorBackend * self, GumCodeSlice * slice, guint used_size);
+static guint gum_interceptor_backend_emit_trampoline (
+    GumInterceptorBackend * self, GumFunctionContext * ctx, gpointer code,
+    gpointer pc);
+static void gum_interceptor_backend_emit_invocation_trampolines (
+    GumInterceptorBackend * self, GumFunctionContext * ctx);
+
 static void gum_interceptor_backend_create_thunks (
     GumInterceptorBackend * self);
 static void gum_interceptor_backend_destroy_thunks (
@@ -78,12 +93,19 @@ _gum_interceptor_backend_create (GRecMutex * mutex,
 
   gum_interceptor_backend_create_thunks (backend);
 
+  backend->pack_slice = NULL;
+  backend->pack_offset = 0;
+  backend->scratch = g_malloc (allocator->slice_size);
+
   return backend;
 }
 
 void
 _gum_interceptor_backend_destroy (GumInterceptorBackend * backend)
 {
+  g_free (backend->scratch);
+  gum_code_slice_unref (backend->pack_slice);
+
   gum_interceptor_backend_destroy_thunks (backend);
 
   gum_x86_relocator_clear (&backend->relocator);
@@ -168,60 +190,146 @@ gboolean
 _gum_interceptor_backend_create_trampoline (GumInterceptorBackend * self,
                                             GumFunctionContext * ctx)
 {
-  GumX86Writer * cw = &self->writer;
-  GumX86Relocator * rl = &self->relocator;
-  GumX86FunctionContextData * data = GUM_FCDATA (ctx);
-  GumAddress function_ctx_ptr;
-  gpointer after_push_to_shadow_stack;
-  guint reloc_bytes;
+  guint size;
+
+  if (gum_interceptor_backend_try_pack_trampoline (self, ctx))
+    return TRUE;
 
   if (!gum_interceptor_backend_prepare_trampoline (self, ctx))
     return FALSE;
 
-  gum_x86_writer_reset (cw, ctx->trampoline_slice->data);
+  size = gum_interceptor_backend_emit_trampoline (self, ctx,
+      ctx->trampoline_slice->data, ctx->trampoline_slice->data);
+  gum_interceptor_backend_set_pack_slice (self, ctx->trampoline_slice, size);
 
-  if (ctx->type != GUM_INTERCEPTOR_TYPE_FAST)
-  {
-    function_ctx_ptr = GUM_ADDRESS (gum_x86_writer_cur (cw));
-    gum_x86_writer_put_bytes (cw, (guint8 *) &ctx,
-        sizeof (GumFunctionContext *));
+  return TRUE;
+}
 
-    ctx->on_enter_trampoline = gum_x86_writer_cur (cw);
+gboolean
+_gum_interceptor_backend_create_import_trampoline (GumInterceptorBackend * self,
+                                                   GumFunctionContext * ctx)
+{
+  guint size;
 
-    gum_x86_writer_put_push_near_ptr (cw, function_ctx_ptr);
-    gum_x86_writer_put_jmp_address (cw, GUM_ADDRESS (self->enter_thunk->data));
+  if (gum_interceptor_backend_try_pack_trampoline (self, ctx))
+    return TRUE;
 
-    if ((cw->cpu_features & GUM_CPU_CET_SS) != 0)
+  ctx->trampoline_slice = gum_code_allocator_alloc_slice (self->allocator);
+
+  size = gum_interceptor_backend_emit_trampoline (self, ctx,
+      ctx->trampoline_slice->data, ctx->trampoline_slice->data);
+  gum_interceptor_backend_set_pack_slice (self, ctx->trampoline_slice, size);
+
+  return TRUE;
+}
+
+/*
+ * Trampolines are typically far smaller than a slice, so rather than giving
+ * each function a slice of its own we keep appending them to the most recently
+ * allocated one. The code is first generated into a scratch buffer as if it
+ * lived at the next free offset, and only copied over if it fits. Each
+ * function context holds a reference on the shared slice.
+ *
+ * This relies on the slice staying writable after it has been committed, so
+ * it is only done when RWX pages are available.
+ */
+static gboolean
+gum_interceptor_backend_try_pack_trampoline (GumInterceptorBackend * self,
+                                             GumFunctionContext * ctx)
+{
+  GumX86FunctionContextData * data = GUM_FCDATA (ctx);
+  GumCodeSlice * slice = self->pack_slice;
+  guint8 * location;
+  guint size;
+
+  if (slice == NULL)
+    return FALSE;
+
+  location = (guint8 *) slice->data + self->pack_offset;
+
+  if (ctx->type != GUM_INTERCEPTOR_TYPE_IMPORT)
+  {
+#if GLIB_SIZEOF_VOID_P == 4
+    data->redirect_code_size = GUM_INTERCEPTOR_NEAR_REDIRECT_SIZE;
+#else
+    if (ctx->type == GUM_INTERCEPTOR_TYPE_DEFAULT)
     {
+      gssize distance = location - (guint8 *) ctx->function_address;
+
       /*
-       * Jumping to push_to_shadow_stack will push the on_leave_trampoline
-       * address onto the shadow stack, thereby making it a legit address to
-       * return to. Then it will jump back through XAX.
+       * Let the caller try to allocate a slice in range rather than settle
+       * for a full redirect, which would overwrite more of the prologue.
        */
+      if (ABS (distance) > GUM_X86_JMP_MAX_DISTANCE)
+        return FALSE;
+
+      data->redirect_code_size = GUM_INTERCEPTOR_NEAR_REDIRECT_SIZE;
+    }
+    else
+    {
+      data->redirect_code_size = GUM_INTERCEPTOR_FULL_REDIRECT_SIZE;
+    }
+#endif
 
-      after_push_to_shadow_stack = gum_x86_writer_cur (cw);
+    if (!gum_x86_relocator_can_relocate (ctx->function_address,
+          data->redirect_code_size, NULL))
+      return FALSE;
+  }
 
-      gum_x86_writer_put_lea_reg_reg_offset (cw, GUM_X86_XSP,
-          GUM_X86_XSP, (gssize) sizeof (gpointer));
+  size = gum_interceptor_backend_emit_trampoline (self, ctx, self->scratch,
+      location);
+  if (self->pack_offset + size > slice->size)
+    return FALSE;
 
-      gum_x86_writer_put_jmp_reg (cw, GUM_X86_XAX);
+  gum_memcpy (location, self->scratch, size);
 
-      data->push_to_shadow_stack = gum_x86_writer_cur (cw);
+  ctx->trampoline_slice = gum_code_slice_ref (slice);
+  self->pack_offset = GUM_ALIGN_SIZE (self->pack_offset + size,
+      GUM_INTERCEPTOR_TRAMPOLINE_ALIGNMENT);
 
-      gum_x86_writer_put_call_address (cw,
-          GUM_ADDRESS (after_push_to_shadow_stack));
-    }
+  return TRUE;
+}
 
-    ctx->on_leave_trampoline = gum_x86_writer_cur (cw);
+static void
+gum_interceptor_backend_set_pack_slice (GumInterceptorBackend * self,
+                                        GumCodeSlice * slice,
+                                        guint used_size)
+{
+  if (!gum_query_is_rwx_supported ())
+    return;
 
-    gum_x86_writer_put_push_near_ptr (cw, function_ctx_ptr);
-    gum_x86_writer_put_jmp_address (cw, GUM_ADDRESS (self->leave_thunk->data));
+  gum_code_slice_unref (self->pack_slice);
+  self->pack_slice = gum_code_slice_ref (slice);
+  self->pack_offset =
+      GUM_ALIGN_SIZE (used_size, GUM_INTERCEPTOR_TRAMPOLINE_ALIGNMENT);
+}
 
-    gum_x86_writer_flush (cw);
-    g_assert (gum_x86_writer_offset (cw) <= ctx->trampoline_slice->size);
+static guint
+gum_interceptor_backend_emit_trampoline (GumInterceptorBackend * self,
+                                         GumFunctionContext * ctx,
+                                         gpointer code,
+                                         gpointer pc)
+{
+  GumX86Writer * cw = &self->writer;
+  GumX86Relocator * rl = &self->relocator;
+  GumX86FunctionContextData * data = GUM_FCDATA (ctx);
+  guint reloc_bytes;
+
+  gum_x86_writer_reset (cw, code);
+  cw->pc = GUM_ADDRESS (pc);
+
+  if (ctx->type != GUM_INTERCEPTOR_TYPE_FAST)
+    gum_interceptor_backend_emit_invocation_trampolines (self, ctx);
+
+  if (ctx->type == GUM_INTERCEPTOR_TYPE_IMPORT)
+  {
+    ctx->on_invoke_trampoline = ctx->function_address;
+    ctx->overwritten_prologue_len = 0;
+
+    return gum_x86_writer_offset (cw);
   }
 
-  ctx->on_invoke_trampoline = gum_x86_writer_cur (cw);
+  ctx->on_invoke_trampoline = GSIZE_TO_POINTER (cw->pc);
   gum_x86_relocator_reset (rl, (guint8 *) ctx->function_address, cw);
 
   do
@@ -239,12 +347,61 @@ _gum_interceptor_backend_create_trampoline (GumInterceptorBackend * self,
   }
 
   gum_x86_writer_flush (cw);
-  g_assert (gum_x86_writer_offset (cw) <= ctx->trampoline_slice->size);
+  g_assert (gum_x86_writer_offset (cw) <= self->allocator->slice_size);
 
   ctx->overwritten_prologue_len = reloc_bytes;
   gum_memcpy (ctx->overwritten_prologue, ctx->function_address, reloc_bytes);
 
-  return TRUE;
+  return gum_x86_writer_offset (cw);
+}
+
+static void
+gum_interceptor_backend_emit_invocation_trampolines (
+    GumInterceptorBackend * self,
+    GumFunctionContext * ctx)
+{
+  GumX86Writer * cw = &self->writer;
+  GumX86FunctionContextData * data = GUM_FCDATA (ctx);
+  GumAddress function_ctx_ptr;
+  gpointer after_push_to_shadow_stack;
+
+  function_ctx_ptr = cw->pc;
+  gum_x86_writer_put_bytes (cw, (guint8 *) &ctx,
+      sizeof (GumFunctionContext *));
+
+  ctx->on_enter_trampoline = GSIZE_TO_POINTER (cw->pc);
+
+  gum_x86_writer_put_push_near_ptr (cw, function_ctx_ptr);
+  gum_x86_writer_put_jmp_address (cw, GUM_ADDRESS (self->enter_thunk->data));
+
+  if ((cw->cpu_features & GUM_CPU_CET_SS) != 0)
+  {
+    /*
+     * Jumping to push_to_shadow_stack will push the on_leave_trampoline
+     * address onto the shadow stack, thereby making it a legit address to
+     * return to. Then it will jump back through XAX.
+     */
+
+    after_push_to_shadow_stack = GSIZE_TO_POINTER (cw->pc);
+
+    gum_x86_writer_put_lea_reg_reg_offset (cw, GUM_X86_XSP,
+        GUM_X86_XSP, (gssize) sizeof (gpointer));
+
+    gum_x86_writer_put_jmp_reg (cw, GUM_X86_XAX);
+
+    data->push_to_shadow_stack = GSIZE_TO_POINTER (cw->pc);
+
+    gum_x86_writer_put_call_address (cw,
+        GUM_ADDRESS (after_push_to_shadow_stack));
+  }
+
+  ctx->on_leave_trampoline = GSIZE_TO_POINTER (cw->pc);
+
+  gum_x86_writer_put_push_near_ptr (cw, function_ctx_ptr);
+  gum_x86_writer_put_jmp_address (cw, GUM_ADDRESS (self->leave_thunk->data));
+
+  gum_x86_writer_flush (cw);
+  g_assert (gum_x86_writer_offset (cw) <= self->allocator->slice_size);
 }
 
 void
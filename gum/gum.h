@@ -29,6 +29,7 @@
 #include <gum/gummemory.h>
 #include <gum/gummemoryaccessmonitor.h>
 #include <gum/gummemorymap.h>
+#include <gum/gummemorysnapshot.h>
 #include <gum/gummetalarray.h>
 #include <gum/gummetalhash.h>
 #include <gum/gummodule.h>
@@ -144,6 +144,9 @@ gum_code_allocator_init (GumCodeAllocator * allocator,
   allocator->free_slices = NULL;
 
   allocator->dispatchers = NULL;
+
+  allocator->num_batches = 0;
+  allocator->num_slices_in_use = 0;
 }
 
 void
@@ -189,6 +192,8 @@ gum_code_allocator_try_alloc_slice_near (GumCodeAllocator * self,
 
       g_hash_table_add (self->dirty_pages, pages);
 
+      self->num_slices_in_use++;
+
       return slice;
     }
   }
@@ -242,6 +247,18 @@ gum_code_allocator_commit (GumCodeAllocator * self)
   }
 }
 
+void
+gum_code_allocator_query_stats (GumCodeAllocator * self,
+                                GumCodeAllocatorStats * stats)
+{
+  stats->slice_size = self->slice_size;
+  stats->num_batches = self->num_batches;
+  stats->mapped_size =
+      self->num_batches * self->pages_per_batch * gum_query_page_size ();
+  stats->num_slices_in_use = self->num_slices_in_use;
+  stats->num_free_slices = g_list_length (self->free_slices);
+}
+
 static GumCodeSlice *
 gum_code_allocator_try_alloc_batch_near (GumCodeAllocator * self,
                                          const GumAddressSpec * spec)
@@ -334,6 +351,9 @@ gum_code_allocator_try_alloc_batch_near (GumCodeAllocator * self,
 
   g_hash_table_add (self->dirty_pages, pages);
 
+  self->num_batches++;
+  self->num_slices_in_use++;
+
   return result;
 }
 
@@ -357,6 +377,8 @@ gum_code_pages_unref (GumCodePages * self)
       gum_cloak_remove_range (&range);
     }
 
+    self->allocator->num_batches--;
+
     g_slice_free1 (self->allocator->pages_metadata_size, self);
   }
 }
@@ -384,6 +406,8 @@ gum_code_slice_unref (GumCodeSlice * slice)
   element = GUM_CODE_SLICE_ELEMENT_FROM_SLICE (slice);
   pages = element->parent.data;
 
+  pages->allocator->num_slices_in_use--;
+
   if (gum_query_is_rwx_supported ())
   {
     GumCodeAllocator * allocator = pages->allocator;
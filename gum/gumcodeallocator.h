@@ -15,6 +15,7 @@
 G_BEGIN_DECLS
 
 typedef struct _GumCodeAllocator GumCodeAllocator;
+typedef struct _GumCodeAllocatorStats GumCodeAllocatorStats;
 typedef struct _GumCodeSlice GumCodeSlice;
 typedef struct _GumCodeDeflector GumCodeDeflector;
 
@@ -30,6 +31,18 @@ struct _GumCodeAllocator
   GList * free_slices;
 
   GSList * dispatchers;
+
+  guint num_batches;
+  guint num_slices_in_use;
+};
+
+struct _GumCodeAllocatorStats
+{
+  gsize slice_size;
+  guint num_batches;
+  gsize mapped_size;
+  guint num_slices_in_use;
+  guint num_free_slices;
 };
 
 struct _GumCodeSlice
@@ -59,6 +72,8 @@ GUM_API GumCodeSlice * gum_code_allocator_alloc_slice (GumCodeAllocator * self);
 GUM_API GumCodeSlice * gum_code_allocator_try_alloc_slice_near (
     GumCodeAllocator * self, const GumAddressSpec * spec, gsize alignment);
 GUM_API void gum_code_allocator_commit (GumCodeAllocator * self);
+GUM_API void gum_code_allocator_query_stats (GumCodeAllocator * self,
+    GumCodeAllocatorStats * stats);
 GUM_API GType gum_code_slice_get_type (void) G_GNUC_CONST;
 GUM_API GumCodeSlice * gum_code_slice_ref (GumCodeSlice * slice);
 GUM_API void gum_code_slice_unref (GumCodeSlice * slice);
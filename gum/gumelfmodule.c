@@ -51,6 +51,7 @@ typedef struct _GumElfRelocationGroup GumElfRelocationGroup;
 typedef struct _GumElfEnumerateImportsContext GumElfEnumerateImportsContext;
 typedef struct _GumElfEnumerateExportsContext GumElfEnumerateExportsContext;
 typedef struct _GumElfStoreSymtabParamsContext GumElfStoreSymtabParamsContext;
+typedef struct _GumElfSymbolLookup GumElfSymbolLookup;
 typedef struct _GumElfEnumerateDepsContext GumElfEnumerateDepsContext;
 
 enum
@@ -72,6 +73,28 @@ enum
   PROP_SOURCE_MODE,
 };
 
+struct _GumElfSymbolLookup
+{
+  gconstpointer entries;
+  gsize entry_size;
+  const guint16 * versyms;
+
+  const guint32 * gnu_hash;
+  guint32 gnu_nbuckets;
+  guint32 gnu_symoffset;
+  guint32 gnu_bloom_size;
+  guint32 gnu_bloom_shift;
+  const guint8 * gnu_bloom;
+  const guint32 * gnu_buckets;
+  const guint32 * gnu_chain;
+
+  const guint32 * sysv_hash;
+  guint32 sysv_nbuckets;
+  guint32 sysv_nchain;
+  const guint32 * sysv_buckets;
+  const guint32 * sysv_chain;
+};
+
 struct _GumElfModule
 {
   GObject parent;
@@ -97,8 +120,12 @@ struct _GumElfModule
   guint64 mapped_size;
   GumElfDynamicAddressState dynamic_address_state;
   const gchar * dynamic_strings;
+  GumElfSymbolLookup symbol_lookup;
 
   GMutex mutex;
+  gboolean loaded;
+  gboolean file_loaded;
+  gboolean sections_loaded;
 
   GumElfModule * fallback_elf_module;
   gboolean attempted_fallback_load;
@@ -169,6 +196,10 @@ static void gum_elf_module_get_property (GObject * object,
 static void gum_elf_module_set_property (GObject * object,
     guint property_id, const GValue * value, GParamSpec * pspec);
 
+static gboolean gum_elf_module_load_file (GumElfModule * self,
+    GError ** error);
+static void gum_elf_module_ensure_file_loaded (GumElfModule * self);
+static void gum_elf_module_ensure_sections_loaded (GumElfModule * self);
 static gboolean gum_elf_module_load_elf_header (GumElfModule * self,
     GError ** error);
 static gboolean gum_elf_module_load_program_headers (GumElfModule * self,
@@ -198,6 +229,20 @@ static gboolean gum_maybe_collect_import_slot_from_relocation (
     const GumElfRelocationDetails * details, gpointer user_data);
 static gboolean gum_emit_elf_export (const GumElfSymbolDetails * details,
     gpointer user_data);
+static gboolean gum_elf_symbol_is_export (const GumElfSymbolDetails * details);
+static void gum_elf_module_load_symbol_lookup (GumElfModule * self);
+static gboolean gum_store_symbol_lookup_params (
+    const GumElfDynamicEntryDetails * details, gpointer user_data);
+static gboolean gum_elf_module_load_gnu_hash_params (GumElfModule * self);
+static gboolean gum_elf_module_load_sysv_hash_params (GumElfModule * self);
+static gboolean gum_elf_module_find_symbol_using_gnu_hash (GumElfModule * self,
+    const gchar * name, GumElfSymbolDetails * details);
+static gboolean gum_elf_module_find_symbol_using_sysv_hash (
+    GumElfModule * self, const gchar * name, GumElfSymbolDetails * details);
+static gboolean gum_elf_module_try_match_dynamic_symbol (GumElfModule * self,
+    guint32 sym_index, const gchar * name, GumElfSymbolDetails * details);
+static guint32 gum_elf_gnu_hash (const gchar * name);
+static guint32 gum_elf_sysv_hash (const gchar * name);
 static void gum_elf_module_parse_symbol (GumElfModule * self,
     const GumElfSym * sym, const gchar * strings, GumElfSymbolDetails * d);
 static void gum_elf_module_read_symbol (GumElfModule * self,
@@ -519,15 +564,65 @@ gum_elf_module_new_from_memory (const gchar * path,
   return module;
 }
 
+/*
+ * Only the ELF header, program headers and dynamic entries are parsed up
+ * front, along with the parameters of the dynamic symbol hash table. Section
+ * headers and details are materialized on first use, and for modules loaded
+ * from memory the file itself is not even mapped until then, so looking up
+ * e.g. the entrypoint or an export only touches the pages that are needed.
+ */
 gboolean
 gum_elf_module_load (GumElfModule * self,
                      GError ** error)
 {
-  GError * local_error = NULL;
-
-  if (self->file_bytes != NULL)
+  if (self->loaded)
     return TRUE;
 
+  if (self->source_mode == GUM_ELF_SOURCE_MODE_OFFLINE)
+  {
+    if (!gum_elf_module_load_file (self, error))
+      goto propagate_error;
+    self->file_loaded = TRUE;
+  }
+
+  if (!gum_elf_module_load_elf_header (self, error))
+    goto propagate_error;
+
+  if (!gum_elf_module_load_program_headers (self, error))
+    goto propagate_error;
+
+  self->mapped_size = gum_elf_module_compute_mapped_size (self);
+  self->preferred_address = gum_elf_module_compute_preferred_address (self);
+
+  if (!gum_elf_module_load_dynamic_entries (self, error))
+    goto propagate_error;
+
+  self->dynamic_address_state =
+      gum_elf_module_detect_dynamic_address_state (self);
+
+  gum_elf_module_enumerate_dynamic_entries (self,
+      gum_store_dynamic_string_table, self);
+
+  gum_elf_module_load_symbol_lookup (self);
+
+  self->loaded = TRUE;
+
+  return TRUE;
+
+propagate_error:
+  {
+    gum_elf_module_unload (self);
+
+    return FALSE;
+  }
+}
+
+static gboolean
+gum_elf_module_load_file (GumElfModule * self,
+                          GError ** error)
+{
+  GError * local_error = NULL;
+
   if (self->source_blob != NULL)
   {
     self->file_bytes = g_bytes_ref (self->source_blob);
@@ -566,46 +661,62 @@ gum_elf_module_load (GumElfModule * self,
 
   self->file_data = g_bytes_get_data (self->file_bytes, &self->file_size);
 
-  if (!gum_elf_module_load_elf_header (self, error))
-    goto propagate_error;
+  return TRUE;
 
-  if (!gum_elf_module_load_program_headers (self, error))
-    goto propagate_error;
+unable_to_open:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_INVALID_ARGUMENT,
+        "%s", local_error->message);
+    g_error_free (local_error);
 
-  self->mapped_size = gum_elf_module_compute_mapped_size (self);
-  self->preferred_address = gum_elf_module_compute_preferred_address (self);
+    return FALSE;
+  }
+}
 
-  if (!gum_elf_module_load_section_headers (self, error))
-    goto propagate_error;
+static void
+gum_elf_module_ensure_file_loaded (GumElfModule * self)
+{
+  if (g_atomic_int_get (&self->file_loaded))
+    return;
 
-  if (!gum_elf_module_load_dynamic_entries (self, error))
-    goto propagate_error;
+  GUM_ELF_MODULE_LOCK (self);
 
-  self->dynamic_address_state =
-      gum_elf_module_detect_dynamic_address_state (self);
+  if (!self->file_loaded)
+  {
+    gum_elf_module_load_file (self, NULL);
+    g_atomic_int_set (&self->file_loaded, TRUE);
+  }
 
-  gum_elf_module_enumerate_dynamic_entries (self,
-      gum_store_dynamic_string_table, self);
+  GUM_ELF_MODULE_UNLOCK (self);
+}
 
-  if (!gum_elf_module_load_section_details (self, error))
-    goto propagate_error;
+static void
+gum_elf_module_ensure_sections_loaded (GumElfModule * self)
+{
+  if (g_atomic_int_get (&self->sections_loaded))
+    return;
 
-  return TRUE;
+  gum_elf_module_ensure_file_loaded (self);
 
-unable_to_open:
-  {
-    g_set_error (error, GUM_ERROR, GUM_ERROR_INVALID_ARGUMENT,
-        "%s", local_error->message);
-    goto propagate_error;
-  }
-propagate_error:
-  {
-    g_clear_error (&local_error);
+  GUM_ELF_MODULE_LOCK (self);
 
-    gum_elf_module_unload (self);
+  if (!self->sections_loaded)
+  {
+    if (self->file_data != NULL &&
+        gum_elf_module_load_section_headers (self, NULL))
+    {
+      if (!gum_elf_module_load_section_details (self, NULL))
+        g_array_set_size (self->shdrs, 0);
+    }
+    else
+    {
+      g_array_set_size (self->shdrs, 0);
+    }
 
-    return FALSE;
+    g_atomic_int_set (&self->sections_loaded, TRUE);
   }
+
+  GUM_ELF_MODULE_UNLOCK (self);
 }
 
 static gboolean
@@ -800,7 +911,8 @@ gum_elf_module_load_section_headers (GumElfModule * self,
   gconstpointer start, end, cursor;
   guint16 i;
 
-  data = gum_elf_module_get_file_data (self, &size);
+  data = self->file_data;
+  size = self->file_size;
 
   n = self->ehdr.shnum;
 
@@ -898,7 +1010,8 @@ gum_elf_module_load_section_details (GumElfModule * self,
   if (strings_shdr == NULL)
     return TRUE;
 
-  data = gum_elf_module_get_file_data (self, &size);
+  data = self->file_data;
+  size = self->file_size;
 
   strings = (const gchar *) data + strings_shdr->offset;
 
@@ -1065,7 +1178,12 @@ gum_elf_module_get_live_data (GumElfModule * self,
 static void
 gum_elf_module_unload (GumElfModule * self)
 {
+  self->loaded = FALSE;
+  self->file_loaded = FALSE;
+  self->sections_loaded = FALSE;
+
   self->dynamic_strings = NULL;
+  memset (&self->symbol_lookup, 0, sizeof (self->symbol_lookup));
   self->dynamic_address_state = GUM_ELF_DYNAMIC_ADDRESS_PRISTINE;
   self->mapped_size = GUM_ELF_DEFAULT_MAPPED_SIZE;
   self->preferred_address = 0;
@@ -1083,8 +1201,7 @@ gum_elf_module_unload (GumElfModule * self)
     self->file_mapped_range.base_address = 0;
     self->file_mapped_range.size = 0;
   }
-  g_bytes_unref (self->file_bytes);
-  self->file_bytes = NULL;
+  g_clear_pointer (&self->file_bytes, g_bytes_unref);
   self->file_data = NULL;
   self->file_size = 0;
 }
@@ -1092,6 +1209,8 @@ gum_elf_module_unload (GumElfModule * self)
 static GumElfModule *
 gum_elf_module_try_get_fallback_elf_module (GumElfModule * self)
 {
+  gum_elf_module_ensure_sections_loaded (self);
+
   GUM_ELF_MODULE_LOCK (self);
 
   if (!self->attempted_fallback_load)
@@ -1223,9 +1342,12 @@ gum_elf_module_get_interpreter (GumElfModule * self)
       gsize size;
       const gchar * interp;
 
-      data = gum_elf_module_get_file_data (self, &size);
+      data = gum_elf_module_get_live_data (self, &size);
 
-      interp = (const gchar *) data + phdr->offset;
+      interp = (self->source_mode == GUM_ELF_SOURCE_MODE_ONLINE)
+          ? GSIZE_TO_POINTER (
+              gum_elf_module_translate_to_online (self, phdr->vaddr))
+          : (const gchar *) data + phdr->offset;
       if (!gum_elf_module_check_str_bounds (self, interp, data, size, "interp",
             NULL))
       {
@@ -1261,6 +1383,8 @@ gconstpointer
 gum_elf_module_get_file_data (GumElfModule * self,
                               gsize * size)
 {
+  gum_elf_module_ensure_file_loaded (self);
+
   if (size != NULL)
     *size = self->file_size;
 
@@ -1300,6 +1424,8 @@ gum_elf_module_enumerate_sections (GumElfModule * self,
 {
   guint i;
 
+  gum_elf_module_ensure_sections_loaded (self);
+
   for (i = 0; i != self->shdrs->len; i++)
   {
     const GumElfSectionDetails * d =
@@ -1320,6 +1446,8 @@ gum_elf_module_enumerate_relocations (GumElfModule * self,
   guint i;
   GumElfRelocationGroup g = { 0, };
 
+  gum_elf_module_ensure_sections_loaded (self);
+
   data = gum_elf_module_get_file_data (self, &size);
 
   for (i = 0; i != self->shdrs->len; i++)
@@ -1690,11 +1818,7 @@ gum_emit_elf_export (const GumElfSymbolDetails * details,
 {
   GumElfEnumerateExportsContext * ctx = user_data;
 
-  if (details->shdr_index != GUM_ELF_SHDR_INDEX_UNDEF &&
-      (details->type == GUM_ELF_SYMBOL_FUNC ||
-       details->type == GUM_ELF_SYMBOL_OBJECT) &&
-      (details->bind == GUM_ELF_BIND_GLOBAL ||
-       details->bind == GUM_ELF_BIND_WEAK))
+  if (gum_elf_symbol_is_export (details))
   {
     GumExportDetails d;
 
@@ -1711,6 +1835,353 @@ gum_emit_elf_export (const GumElfSymbolDetails * details,
   return TRUE;
 }
 
+static gboolean
+gum_elf_symbol_is_export (const GumElfSymbolDetails * details)
+{
+  return details->shdr_index != GUM_ELF_SHDR_INDEX_UNDEF &&
+      (details->type == GUM_ELF_SYMBOL_FUNC ||
+       details->type == GUM_ELF_SYMBOL_OBJECT) &&
+      (details->bind == GUM_ELF_BIND_GLOBAL ||
+       details->bind == GUM_ELF_BIND_WEAK);
+}
+
+GumAddress
+gum_elf_module_find_export_by_name (GumElfModule * self,
+                                    const gchar * name)
+{
+  GumElfSymbolDetails details;
+
+  if (!gum_elf_module_find_dynamic_symbol_by_name (self, name, &details))
+    return 0;
+
+  if (!gum_elf_symbol_is_export (&details))
+    return 0;
+
+  return details.address;
+}
+
+/*
+ * Looks up a symbol through the module's own DT_GNU_HASH or DT_HASH table,
+ * without involving the dynamic linker. The table was located and its header
+ * validated when the module was loaded, and the lookup itself allocates
+ * nothing, so once a GumElfModule exists this is safe to use while the loader
+ * lock may be held by another thread. For the same reason section details are
+ * not loaded, so @details->section is only filled in if something else
+ * already caused them to be.
+ */
+gboolean
+gum_elf_module_find_dynamic_symbol_by_name (GumElfModule * self,
+                                            const gchar * name,
+                                            GumElfSymbolDetails * details)
+{
+  const GumElfSymbolLookup * lookup = &self->symbol_lookup;
+
+  if (lookup->gnu_hash != NULL)
+    return gum_elf_module_find_symbol_using_gnu_hash (self, name, details);
+
+  if (lookup->sysv_hash != NULL)
+    return gum_elf_module_find_symbol_using_sysv_hash (self, name, details);
+
+  return FALSE;
+}
+
+static void
+gum_elf_module_load_symbol_lookup (GumElfModule * self)
+{
+  GumElfSymbolLookup * lookup = &self->symbol_lookup;
+
+  gum_elf_module_enumerate_dynamic_entries (self,
+      gum_store_symbol_lookup_params, self);
+
+  if (lookup->entries == NULL || lookup->entry_size == 0 ||
+      self->dynamic_strings == NULL)
+  {
+    memset (lookup, 0, sizeof (GumElfSymbolLookup));
+    return;
+  }
+
+  if (lookup->gnu_hash != NULL && !gum_elf_module_load_gnu_hash_params (self))
+    lookup->gnu_hash = NULL;
+
+  if (lookup->sysv_hash != NULL &&
+      !gum_elf_module_load_sysv_hash_params (self))
+    lookup->sysv_hash = NULL;
+}
+
+static gboolean
+gum_store_symbol_lookup_params (const GumElfDynamicEntryDetails * details,
+                                gpointer user_data)
+{
+  GumElfModule * self = user_data;
+  GumElfSymbolLookup * lookup = &self->symbol_lookup;
+
+  switch (details->tag)
+  {
+    case GUM_ELF_DYNAMIC_SYMTAB:
+      lookup->entries =
+          gum_elf_module_resolve_dynamic_virtual_location (self, details->val);
+      break;
+    case GUM_ELF_DYNAMIC_SYMENT:
+      lookup->entry_size = details->val;
+      break;
+    case GUM_ELF_DYNAMIC_VERSYM:
+      lookup->versyms =
+          gum_elf_module_resolve_dynamic_virtual_location (self, details->val);
+      break;
+    case GUM_ELF_DYNAMIC_HASH:
+      lookup->sysv_hash =
+          gum_elf_module_resolve_dynamic_virtual_location (self, details->val);
+      break;
+    case GUM_ELF_DYNAMIC_GNU_HASH:
+      lookup->gnu_hash =
+          gum_elf_module_resolve_dynamic_virtual_location (self, details->val);
+      break;
+    default:
+      break;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gum_elf_module_load_gnu_hash_params (GumElfModule * self)
+{
+  GumElfSymbolLookup * lookup = &self->symbol_lookup;
+  const guint32 * table = lookup->gnu_hash;
+  gconstpointer data;
+  gsize size;
+  GError ** error = NULL;
+  guint word_bits;
+
+  data = gum_elf_module_get_live_data (self, &size);
+
+  GUM_CHECK_BOUNDS (table, table + 4, "GNU hash header");
+  lookup->gnu_nbuckets = gum_elf_module_read_uint32 (self, &table[0]);
+  lookup->gnu_symoffset = gum_elf_module_read_uint32 (self, &table[1]);
+  lookup->gnu_bloom_size = gum_elf_module_read_uint32 (self, &table[2]);
+  lookup->gnu_bloom_shift = gum_elf_module_read_uint32 (self, &table[3]);
+
+  word_bits = (self->ehdr.identity.klass == GUM_ELF_CLASS_64) ? 64 : 32;
+
+  /* Shifting a 32-bit hash by the word size or more is undefined. */
+  if (lookup->gnu_nbuckets == 0 || lookup->gnu_bloom_size == 0 ||
+      lookup->gnu_bloom_shift >= word_bits)
+    return FALSE;
+
+  lookup->gnu_bloom = (const guint8 *) (table + 4);
+  lookup->gnu_buckets = (const guint32 *) (lookup->gnu_bloom +
+      ((gsize) lookup->gnu_bloom_size * (word_bits / 8)));
+  lookup->gnu_chain = lookup->gnu_buckets + lookup->gnu_nbuckets;
+  GUM_CHECK_BOUNDS (lookup->gnu_bloom, lookup->gnu_chain, "GNU hash buckets");
+
+  return TRUE;
+
+propagate_error:
+  return FALSE;
+}
+
+static gboolean
+gum_elf_module_load_sysv_hash_params (GumElfModule * self)
+{
+  GumElfSymbolLookup * lookup = &self->symbol_lookup;
+  const guint32 * table = lookup->sysv_hash;
+  gconstpointer data;
+  gsize size;
+  GError ** error = NULL;
+
+  data = gum_elf_module_get_live_data (self, &size);
+
+  GUM_CHECK_BOUNDS (table, table + 2, "SysV hash header");
+  lookup->sysv_nbuckets = gum_elf_module_read_uint32 (self, &table[0]);
+  lookup->sysv_nchain = gum_elf_module_read_uint32 (self, &table[1]);
+  if (lookup->sysv_nbuckets == 0)
+    return FALSE;
+
+  lookup->sysv_buckets = table + 2;
+  lookup->sysv_chain = lookup->sysv_buckets + lookup->sysv_nbuckets;
+  GUM_CHECK_BOUNDS (lookup->sysv_buckets,
+      lookup->sysv_chain + lookup->sysv_nchain, "SysV hash table");
+
+  return TRUE;
+
+propagate_error:
+  return FALSE;
+}
+
+static gboolean
+gum_elf_module_find_symbol_using_gnu_hash (GumElfModule * self,
+                                           const gchar * name,
+                                           GumElfSymbolDetails * details)
+{
+  const GumElfSymbolLookup * lookup = &self->symbol_lookup;
+  gconstpointer data;
+  gsize size;
+  GError ** error = NULL;
+  guint word_bits;
+  guint32 hash, sym_index;
+  gsize word_index;
+  guint64 word, mask;
+
+  data = gum_elf_module_get_live_data (self, &size);
+
+  word_bits = (self->ehdr.identity.klass == GUM_ELF_CLASS_64) ? 64 : 32;
+
+  hash = gum_elf_gnu_hash (name);
+
+  word_index = (hash / word_bits) % lookup->gnu_bloom_size;
+  if (word_bits == 64)
+  {
+    word = gum_elf_module_read_uint64 (self,
+        (const guint64 *) lookup->gnu_bloom + word_index);
+  }
+  else
+  {
+    word = gum_elf_module_read_uint32 (self,
+        (const guint32 *) lookup->gnu_bloom + word_index);
+  }
+  mask = (G_GUINT64_CONSTANT (1) << (hash % word_bits)) |
+      (G_GUINT64_CONSTANT (1) << ((hash >> lookup->gnu_bloom_shift) %
+          word_bits));
+  if ((word & mask) != mask)
+    return FALSE;
+
+  sym_index = gum_elf_module_read_uint32 (self,
+      &lookup->gnu_buckets[hash % lookup->gnu_nbuckets]);
+  if (sym_index < lookup->gnu_symoffset)
+    return FALSE;
+
+  while (TRUE)
+  {
+    const guint32 * chain_entry =
+        &lookup->gnu_chain[sym_index - lookup->gnu_symoffset];
+    guint32 chain_hash;
+
+    GUM_CHECK_BOUNDS (chain_entry, chain_entry + 1, "GNU hash chain");
+    chain_hash = gum_elf_module_read_uint32 (self, chain_entry);
+
+    if ((chain_hash | 1) == (hash | 1) &&
+        gum_elf_module_try_match_dynamic_symbol (self, sym_index, name,
+          details))
+    {
+      return TRUE;
+    }
+
+    if ((chain_hash & 1) != 0)
+      break;
+
+    sym_index++;
+  }
+
+propagate_error:
+  return FALSE;
+}
+
+static gboolean
+gum_elf_module_find_symbol_using_sysv_hash (GumElfModule * self,
+                                            const gchar * name,
+                                            GumElfSymbolDetails * details)
+{
+  const GumElfSymbolLookup * lookup = &self->symbol_lookup;
+  guint32 nchain, sym_index, n;
+
+  nchain = lookup->sysv_nchain;
+
+  sym_index = gum_elf_module_read_uint32 (self,
+      &lookup->sysv_buckets[gum_elf_sysv_hash (name) % lookup->sysv_nbuckets]);
+
+  for (n = 0;
+      sym_index != GUM_STN_UNDEF && sym_index < nchain && n != nchain;
+      n++)
+  {
+    if (gum_elf_module_try_match_dynamic_symbol (self, sym_index, name,
+          details))
+      return TRUE;
+
+    sym_index = gum_elf_module_read_uint32 (self,
+        &lookup->sysv_chain[sym_index]);
+  }
+
+  return FALSE;
+}
+
+static gboolean
+gum_elf_module_try_match_dynamic_symbol (GumElfModule * self,
+                                         guint32 sym_index,
+                                         const gchar * name,
+                                         GumElfSymbolDetails * details)
+{
+  const GumElfSymbolLookup * lookup = &self->symbol_lookup;
+  gconstpointer data;
+  gsize size;
+  GError ** error = NULL;
+  const guint8 * entry;
+  GumElfSym sym;
+  const gchar * sym_name;
+
+  data = gum_elf_module_get_live_data (self, &size);
+
+  entry = (const guint8 *) lookup->entries + (sym_index * lookup->entry_size);
+  GUM_CHECK_BOUNDS (entry, entry + lookup->entry_size, "symbol");
+
+  if (lookup->versyms != NULL)
+  {
+    const guint16 * versym = &lookup->versyms[sym_index];
+
+    GUM_CHECK_BOUNDS (versym, versym + 1, "symbol version");
+
+    /* Only the default version of a symbol is visible by name. */
+    if ((gum_elf_module_read_uint16 (self, versym) & 0x8000) != 0)
+      return FALSE;
+  }
+
+  gum_elf_module_read_symbol (self, entry, &sym);
+
+  sym_name = self->dynamic_strings + sym.name;
+  GUM_CHECK_STR_BOUNDS (sym_name, "symbol name");
+  if (strcmp (sym_name, name) != 0)
+    return FALSE;
+
+  gum_elf_module_parse_symbol (self, &sym, self->dynamic_strings, details);
+
+  return TRUE;
+
+propagate_error:
+  return FALSE;
+}
+
+static guint32
+gum_elf_gnu_hash (const gchar * name)
+{
+  guint32 h = 5381;
+  const guint8 * p;
+
+  for (p = (const guint8 *) name; *p != '\0'; p++)
+    h = (h << 5) + h + *p;
+
+  return h;
+}
+
+static guint32
+gum_elf_sysv_hash (const gchar * name)
+{
+  guint32 h = 0;
+  const guint8 * p;
+
+  for (p = (const guint8 *) name; *p != '\0'; p++)
+  {
+    guint32 g;
+
+    h = (h << 4) + *p;
+
+    g = h & 0xf0000000;
+    if (g != 0)
+      h ^= g >> 24;
+    h &= ~g;
+  }
+
+  return h;
+}
+
 void
 gum_elf_module_enumerate_dynamic_symbols (GumElfModule * self,
                                           GumFoundElfSymbolFunc func,
@@ -1731,6 +2202,13 @@ gum_elf_module_enumerate_dynamic_symbols (GumElfModule * self,
 
   ctx.module = self;
 
+  /*
+   * Unlike a lookup by name, enumerating the whole table is expensive enough
+   * that also loading the section details is worth it, and callers rely on
+   * @section being filled in.
+   */
+  gum_elf_module_ensure_sections_loaded (self);
+
   gum_elf_module_enumerate_dynamic_entries (self, gum_store_symtab_params,
       &ctx);
   if (ctx.pending != 0 || ctx.entry_count == 0)
@@ -1771,7 +2249,9 @@ gum_elf_module_parse_symbol (GumElfModule * self,
   GumElfSymbolType type = GUM_ELF_ST_TYPE (sym->info);
   const GumElfSectionDetails * section;
 
-  section = gum_elf_module_find_section_details_by_index (self, sym->shndx);
+  section = g_atomic_int_get (&self->sections_loaded)
+      ? gum_elf_module_find_section_details_by_index (self, sym->shndx)
+      : NULL;
 
   if (type == GUM_ELF_SYMBOL_SECTION)
   {
@@ -1975,6 +2455,8 @@ gum_elf_module_enumerate_symbols_in_section (GumElfModule * self,
   gconstpointer cursor;
   GError ** error = NULL;
 
+  gum_elf_module_ensure_sections_loaded (self);
+
   shdr = gum_elf_module_find_section_header_by_type (self, section);
   if (shdr == NULL)
     goto consider_fallback;
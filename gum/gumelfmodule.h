@@ -1007,6 +1007,10 @@ GUM_API void gum_elf_module_enumerate_imports (GumElfModule * self,
     GumFoundImportFunc func, gpointer user_data);
 GUM_API void gum_elf_module_enumerate_exports (GumElfModule * self,
     GumFoundExportFunc func, gpointer user_data);
+GUM_API GumAddress gum_elf_module_find_export_by_name (GumElfModule * self,
+    const gchar * name);
+GUM_API gboolean gum_elf_module_find_dynamic_symbol_by_name (
+    GumElfModule * self, const gchar * name, GumElfSymbolDetails * details);
 GUM_API void gum_elf_module_enumerate_dynamic_symbols (GumElfModule * self,
     GumFoundElfSymbolFunc func, gpointer user_data);
 GUM_API void gum_elf_module_enumerate_symbols (GumElfModule * self,
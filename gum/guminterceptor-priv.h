@@ -23,7 +23,8 @@ typedef union _GumFunctionContextBackendData GumFunctionContextBackendData;
 enum _GumInterceptorType
 {
   GUM_INTERCEPTOR_TYPE_DEFAULT = 0,
-  GUM_INTERCEPTOR_TYPE_FAST    = 1
+  GUM_INTERCEPTOR_TYPE_FAST    = 1,
+  GUM_INTERCEPTOR_TYPE_IMPORT  = 2
 };
 
 union _GumFunctionContextBackendData
@@ -38,12 +39,14 @@ struct _GumFunctionContext
 
   gpointer grafted_hook;
   gpointer import_target;
+  GArray * import_slots;
 
   GumInterceptorType type;
   guint8 destroyed;
   guint8 activated;
   guint8 has_on_leave_listener;
   guint8 has_unignorable_listener;
+  guint8 has_unfiltered_listener;
 
   GumCodeSlice * trampoline_slice;
   GumCodeDeflector * trampoline_deflector;
@@ -85,6 +88,8 @@ G_GNUC_INTERNAL gboolean _gum_interceptor_backend_claim_grafted_trampoline (
     GumInterceptorBackend * self, GumFunctionContext * ctx);
 G_GNUC_INTERNAL gboolean _gum_interceptor_backend_create_trampoline (
     GumInterceptorBackend * self, GumFunctionContext * ctx);
+G_GNUC_INTERNAL gboolean _gum_interceptor_backend_create_import_trampoline (
+    GumInterceptorBackend * self, GumFunctionContext * ctx);
 G_GNUC_INTERNAL void _gum_interceptor_backend_destroy_trampoline (
     GumInterceptorBackend * self, GumFunctionContext * ctx);
 G_GNUC_INTERNAL void _gum_interceptor_backend_activate_trampoline (
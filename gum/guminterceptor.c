@@ -9,10 +9,12 @@
 
 #include "guminterceptor.h"
 
+#include "gumcloak.h"
 #include "gumcodesegment.h"
 #include "guminterceptor-priv.h"
 #include "gumlibc.h"
 #include "gummemory.h"
+#include "gummoduleregistry-priv.h"
 #include "gumprocess-priv.h"
 #include "gumtls.h"
 
@@ -27,16 +29,27 @@
 # define GUM_INTERCEPTOR_CODE_SLICE_SIZE 256
 #endif
 
+#define GUM_MAX_FILTERED_LISTENER_INDEX 32
+
 #define GUM_INTERCEPTOR_LOCK(o) g_rec_mutex_lock (&(o)->mutex)
 #define GUM_INTERCEPTOR_UNLOCK(o) g_rec_mutex_unlock (&(o)->mutex)
 
+#if ((defined (HAVE_LINUX) && !defined (HAVE_ANDROID)) || \
+    defined (HAVE_FREEBSD)) && defined (__GNUC__)
+# define GUM_INTERCEPTOR_USE_STATIC_TLS 1
+#endif
+
 typedef struct _GumInterceptorTransaction GumInterceptorTransaction;
 typedef guint GumInstrumentationError;
 typedef struct _GumDestroyTask GumDestroyTask;
 typedef struct _GumUpdateTask GumUpdateTask;
+typedef struct _GumImportTask GumImportTask;
+typedef struct _GumImportSlot GumImportSlot;
 typedef struct _GumSuspendOperation GumSuspendOperation;
 typedef struct _ListenerEntry ListenerEntry;
+typedef struct _ListenerFilter ListenerFilter;
 typedef struct _InterceptorThreadContext InterceptorThreadContext;
+typedef struct _InterceptorThreadSlot InterceptorThreadSlot;
 typedef struct _GumInvocationStackEntry GumInvocationStackEntry;
 typedef struct _ListenerDataSlot ListenerDataSlot;
 typedef struct _ListenerInvocationState ListenerInvocationState;
@@ -50,6 +63,7 @@ struct _GumInterceptorTransaction
   gint level;
   GQueue * pending_destroy_tasks;
   GHashTable * pending_update_tasks;
+  GArray * pending_import_tasks;
 
   GumInterceptor * interceptor;
 };
@@ -67,7 +81,13 @@ struct _GumInterceptor
 
   volatile guint selected_thread_id;
 
+  GumInterceptorMode mode;
+  gchar ** import_scope;
+  gulong module_added_handler;
+  gulong module_removed_handler;
+
   GumInterceptorTransaction current_transaction;
+  GQueue * retired_tasks;
 };
 
 enum _GumInstrumentationError
@@ -83,6 +103,7 @@ struct _GumDestroyTask
   GumFunctionContext * ctx;
   GDestroyNotify notify;
   gpointer data;
+  gint epoch;
 };
 
 struct _GumUpdateTask
@@ -91,6 +112,18 @@ struct _GumUpdateTask
   GumUpdateTaskFunc func;
 };
 
+struct _GumImportTask
+{
+  GumFunctionContext * ctx;
+  gboolean activate;
+};
+
+struct _GumImportSlot
+{
+  gpointer * address;
+  gpointer original_value;
+};
+
 struct _GumSuspendOperation
 {
   GumThreadId current_thread_id;
@@ -103,6 +136,15 @@ struct _ListenerEntry
   GumInvocationListener * listener_instance;
   gpointer function_data;
   gboolean unignorable;
+  ListenerFilter * filter;
+};
+
+struct _ListenerFilter
+{
+  gint ref_count;
+
+  guint num_predicates;
+  GumArgumentPredicate predicates[];
 };
 
 struct _InterceptorThreadContext
@@ -114,7 +156,20 @@ struct _InterceptorThreadContext
 
   GumInvocationStack * stack;
 
+  GumSpinlock listener_data_lock;
   GArray * listener_data_slots;
+
+  gint critical_depth;
+  volatile gint observed_epoch;
+
+  volatile gint in_use;
+  InterceptorThreadContext * next;
+};
+
+struct _InterceptorThreadSlot
+{
+  GumInterceptor * guard;
+  InterceptorThreadContext * context;
 };
 
 struct _GumInvocationStackEntry
@@ -127,6 +182,7 @@ struct _GumInvocationStackEntry
       [GUM_MAX_LISTENER_DATA];
   gboolean calling_replacement;
   gboolean only_invoke_unignorable_listeners;
+  guint32 filtered_listeners;
   gint original_system_error;
 };
 
@@ -160,6 +216,20 @@ static void gum_interceptor_activate (GumInterceptor * self,
     GumFunctionContext * ctx, gpointer prologue);
 static void gum_interceptor_deactivate (GumInterceptor * self,
     GumFunctionContext * ctx, gpointer prologue);
+static void gum_interceptor_apply_import_tasks (GumInterceptor * self,
+    GArray * tasks);
+static void gum_interceptor_patch_imports_in_module (GumInterceptor * self,
+    GumModule * module, GHashTable * targets);
+static gboolean gum_interceptor_patch_import_if_targeted (
+    const GumImportDetails * details, gpointer user_data);
+static gboolean gum_interceptor_is_module_in_import_scope (
+    GumInterceptor * self, GumModule * module);
+static void gum_interceptor_ensure_module_observer (GumInterceptor * self);
+static void gum_interceptor_on_module_added (GumModuleRegistry * registry,
+    GumModule * module, GumInterceptor * self);
+static void gum_interceptor_on_module_removed (GumModuleRegistry * registry,
+    GumModule * module, GumInterceptor * self);
+static gboolean gum_import_slot_write (gpointer * slot, gpointer value);
 
 static void gum_interceptor_transaction_init (
     GumInterceptorTransaction * transaction, GumInterceptor * interceptor);
@@ -176,6 +246,14 @@ static void gum_interceptor_transaction_schedule_destroy (
 static void gum_interceptor_transaction_schedule_update (
     GumInterceptorTransaction * self, GumFunctionContext * ctx,
     GumUpdateTaskFunc func);
+static void gum_interceptor_transaction_schedule_import_update (
+    GumInterceptorTransaction * self, GumFunctionContext * ctx,
+    gboolean activate);
+static void gum_interceptor_retire_tasks (GumInterceptor * self,
+    GQueue * tasks);
+static void gum_interceptor_reclaim (GumInterceptor * self);
+static void gum_interceptor_reclaim_all (GumInterceptor * self);
+static gboolean gum_interceptor_find_oldest_epoch (gint * epoch);
 
 static GumFunctionContext * gum_function_context_new (
     GumInterceptor * interceptor, gpointer function_address,
@@ -188,23 +266,43 @@ static gboolean gum_function_context_is_empty (
     GumFunctionContext * function_ctx);
 static void gum_function_context_add_listener (
     GumFunctionContext * function_ctx, GumInvocationListener * listener,
-    gpointer function_data, gboolean unignorable);
+    gpointer function_data, gboolean unignorable, ListenerFilter * filter);
 static void gum_function_context_remove_listener (
     GumFunctionContext * function_ctx, GumInvocationListener * listener);
+static void gum_function_context_update_listener_flags (
+    GumFunctionContext * function_ctx);
+static ListenerEntry * listener_entry_dup (const ListenerEntry * entry);
 static void listener_entry_free (ListenerEntry * entry);
+static ListenerFilter * listener_filter_new (
+    const GumArgumentPredicate * predicates, guint n_predicates);
+static ListenerFilter * listener_filter_ref (ListenerFilter * filter);
+static void listener_filter_unref (ListenerFilter * filter);
+static gboolean listener_filter_matches (const ListenerFilter * filter,
+    GumCpuContext * cpu_context);
+static gboolean gum_argument_predicate_matches (
+    const GumArgumentPredicate * predicate, GumCpuContext * cpu_context);
 static gboolean gum_function_context_has_listener (
     GumFunctionContext * function_ctx, GumInvocationListener * listener);
 static ListenerEntry ** gum_function_context_find_listener (
     GumFunctionContext * function_ctx, GumInvocationListener * listener);
 static ListenerEntry ** gum_function_context_find_taken_listener_slot (
     GumFunctionContext * function_ctx);
+static guint gum_function_context_count_listeners (
+    GumFunctionContext * function_ctx);
+static guint32 gum_reject_filtered_listeners (GPtrArray * listener_entries,
+    GumCpuContext * cpu_context);
+static gboolean gum_any_listener_accepts (GPtrArray * listener_entries,
+    guint32 rejected_listeners);
 static void gum_function_context_fixup_cpu_context (
     GumFunctionContext * function_ctx, GumCpuContext * cpu_context);
 
 static InterceptorThreadContext * get_interceptor_thread_context (void);
 static void release_interceptor_thread_context (
     InterceptorThreadContext * context);
+static InterceptorThreadContext * interceptor_thread_context_acquire (void);
 static InterceptorThreadContext * interceptor_thread_context_new (void);
+static void interceptor_thread_context_reset (
+    InterceptorThreadContext * context);
 static void interceptor_thread_context_destroy (
     InterceptorThreadContext * context);
 static gpointer interceptor_thread_context_get_listener_data (
@@ -232,11 +330,28 @@ G_DEFINE_TYPE (GumInterceptor, gum_interceptor, G_TYPE_OBJECT)
 static GMutex _gum_interceptor_lock;
 static GumInterceptor * _the_interceptor = NULL;
 
-static GumSpinlock gum_interceptor_thread_context_lock = GUM_SPINLOCK_INIT;
-static GHashTable * gum_interceptor_thread_contexts;
+/*
+ * Thread contexts are kept on a push-only list and recycled when their thread
+ * exits, so registering a thread never takes a lock. The GPrivate is only used
+ * to learn about thread exit; the hot path reads the guard and the context
+ * from a single static TLS block where the platform allows it.
+ */
+static InterceptorThreadContext * gum_interceptor_thread_contexts = NULL;
+static gboolean gum_interceptor_thread_contexts_live = FALSE;
 static GPrivate gum_interceptor_context_private =
     G_PRIVATE_INIT ((GDestroyNotify) release_interceptor_thread_context);
+#ifdef GUM_INTERCEPTOR_USE_STATIC_TLS
+static __thread InterceptorThreadSlot gum_interceptor_thread_slot
+    __attribute__ ((tls_model ("initial-exec")));
+#else
 static GumTlsKey gum_interceptor_guard_key;
+#endif
+
+/*
+ * Odd and monotonically increasing, so that zero can mean "quiescent" in
+ * InterceptorThreadContext.observed_epoch.
+ */
+static volatile gint gum_interceptor_epoch = 1;
 
 static GumInvocationStack _gum_interceptor_empty_stack = { NULL, 0 };
 
@@ -252,21 +367,81 @@ gum_interceptor_class_init (GumInterceptorClass * klass)
 void
 _gum_interceptor_init (void)
 {
-  gum_interceptor_thread_contexts = g_hash_table_new_full (NULL, NULL,
-      (GDestroyNotify) interceptor_thread_context_destroy, NULL);
+  gum_interceptor_thread_contexts_live = TRUE;
 
+#ifndef GUM_INTERCEPTOR_USE_STATIC_TLS
   gum_interceptor_guard_key = gum_tls_key_new ();
+#endif
 }
 
 void
 _gum_interceptor_deinit (void)
 {
+  InterceptorThreadContext * context, * next;
+
+#ifndef GUM_INTERCEPTOR_USE_STATIC_TLS
   gum_tls_key_free (gum_interceptor_guard_key);
+#endif
+
+  gum_interceptor_thread_contexts_live = FALSE;
 
-  g_hash_table_unref (gum_interceptor_thread_contexts);
+  for (context = gum_interceptor_thread_contexts;
+      context != NULL;
+      context = next)
+  {
+    next = context->next;
+    interceptor_thread_context_destroy (context);
+  }
   gum_interceptor_thread_contexts = NULL;
 }
 
+static inline GumInterceptor *
+gum_interceptor_get_guard (void)
+{
+#ifdef GUM_INTERCEPTOR_USE_STATIC_TLS
+  return gum_interceptor_thread_slot.guard;
+#else
+  return gum_tls_key_get_value (gum_interceptor_guard_key);
+#endif
+}
+
+static inline void
+gum_interceptor_set_guard (GumInterceptor * interceptor)
+{
+#ifdef GUM_INTERCEPTOR_USE_STATIC_TLS
+  gum_interceptor_thread_slot.guard = interceptor;
+#else
+  gum_tls_key_set_value (gum_interceptor_guard_key, interceptor);
+#endif
+}
+
+static inline InterceptorThreadContext *
+gum_interceptor_peek_thread_context (void)
+{
+#ifdef GUM_INTERCEPTOR_USE_STATIC_TLS
+  return gum_interceptor_thread_slot.context;
+#else
+  return g_private_get (&gum_interceptor_context_private);
+#endif
+}
+
+static inline void
+interceptor_thread_context_enter_critical (InterceptorThreadContext * self)
+{
+  if (self->critical_depth++ == 0)
+  {
+    g_atomic_int_set (&self->observed_epoch,
+        g_atomic_int_get (&gum_interceptor_epoch));
+  }
+}
+
+static inline void
+interceptor_thread_context_leave_critical (InterceptorThreadContext * self)
+{
+  if (--self->critical_depth == 0)
+    g_atomic_int_set (&self->observed_epoch, 0);
+}
+
 static void
 gum_interceptor_init (GumInterceptor * self)
 {
@@ -278,6 +453,7 @@ gum_interceptor_init (GumInterceptor * self)
   gum_code_allocator_init (&self->allocator, GUM_INTERCEPTOR_CODE_SLICE_SIZE);
 
   gum_interceptor_transaction_init (&self->current_transaction, self);
+  self->retired_tasks = g_queue_new ();
 }
 
 static void
@@ -285,6 +461,16 @@ gum_interceptor_dispose (GObject * object)
 {
   GumInterceptor * self = GUM_INTERCEPTOR (object);
 
+  if (self->module_added_handler != 0)
+  {
+    GumModuleRegistry * registry = gum_module_registry_obtain ();
+
+    g_signal_handler_disconnect (registry, self->module_added_handler);
+    g_signal_handler_disconnect (registry, self->module_removed_handler);
+    self->module_added_handler = 0;
+    self->module_removed_handler = 0;
+  }
+
   GUM_INTERCEPTOR_LOCK (self);
   gum_interceptor_transaction_begin (&self->current_transaction);
   self->current_transaction.is_dirty = TRUE;
@@ -302,6 +488,9 @@ gum_interceptor_finalize (GObject * object)
 {
   GumInterceptor * self = GUM_INTERCEPTOR (object);
 
+  gum_interceptor_reclaim_all (self);
+  g_queue_free (self->retired_tasks);
+
   gum_interceptor_transaction_destroy (&self->current_transaction);
 
   if (self->backend != NULL)
@@ -311,6 +500,8 @@ gum_interceptor_finalize (GObject * object)
 
   g_hash_table_unref (self->function_by_address);
 
+  g_strfreev (self->import_scope);
+
   gum_code_allocator_free (&self->allocator);
 
   G_OBJECT_CLASS (gum_interceptor_parent_class)->finalize (object);
@@ -353,12 +544,71 @@ the_interceptor_weak_notify (gpointer data,
   g_mutex_unlock (&_gum_interceptor_lock);
 }
 
+/*
+ * Selects how functions instrumented from now on get hooked. In
+ * GUM_INTERCEPTOR_MODE_IMPORTS the function's code is left untouched, and the
+ * import slots (GOT/PLT entries) referencing it are redirected instead, in all
+ * modules or the ones selected through gum_interceptor_set_import_scope().
+ * Modules loaded later get their slots redirected as they appear. Only calls
+ * that go through a module's imports are intercepted. Imports are matched on
+ * their resolved address, so slots that are still lazily bound get redirected
+ * too. Reverting puts back whatever a slot held when it was redirected, which
+ * for those is the PLT stub, so the next call through it binds it again.
+ */
+void
+gum_interceptor_set_mode (GumInterceptor * self,
+                          GumInterceptorMode mode)
+{
+  GUM_INTERCEPTOR_LOCK (self);
+  self->mode = mode;
+  GUM_INTERCEPTOR_UNLOCK (self);
+}
+
+GumInterceptorMode
+gum_interceptor_get_mode (GumInterceptor * self)
+{
+  return self->mode;
+}
+
+void
+gum_interceptor_set_import_scope (GumInterceptor * self,
+                                  const gchar * const * module_names)
+{
+  GUM_INTERCEPTOR_LOCK (self);
+  g_strfreev (self->import_scope);
+  self->import_scope = g_strdupv ((gchar **) module_names);
+  GUM_INTERCEPTOR_UNLOCK (self);
+}
+
 GumAttachReturn
 gum_interceptor_attach (GumInterceptor * self,
                         gpointer function_address,
                         GumInvocationListener * listener,
                         gpointer listener_function_data,
                         GumAttachFlags flags)
+{
+  return gum_interceptor_attach_filtered (self, function_address, listener,
+      listener_function_data, flags, NULL, 0);
+}
+
+/*
+ * Like gum_interceptor_attach(), but the listener is only invoked for calls
+ * where all of the given argument predicates hold. When every listener on a
+ * function is filtered and none of them accept a call, and there is no
+ * replacement, the call is forwarded to the original function without
+ * touching the invocation stack.
+ *
+ * A filtered listener can only be attached while the function has fewer than
+ * 32 listeners, otherwise GUM_ATTACH_TOO_MANY_FILTERED is returned.
+ */
+GumAttachReturn
+gum_interceptor_attach_filtered (GumInterceptor * self,
+                                 gpointer function_address,
+                                 GumInvocationListener * listener,
+                                 gpointer listener_function_data,
+                                 GumAttachFlags flags,
+                                 const GumArgumentPredicate * predicates,
+                                 guint n_predicates)
 {
   GumAttachReturn result = GUM_ATTACH_OK;
   GumFunctionContext * function_ctx;
@@ -380,8 +630,14 @@ gum_interceptor_attach (GumInterceptor * self,
   if (gum_function_context_has_listener (function_ctx, listener))
     goto already_attached;
 
+  if (n_predicates != 0 && gum_function_context_count_listeners (function_ctx)
+      >= GUM_MAX_FILTERED_LISTENER_INDEX)
+    goto too_many_filtered;
+
   gum_function_context_add_listener (function_ctx, listener,
-      listener_function_data, (flags & GUM_ATTACH_FLAGS_UNIGNORABLE) != 0);
+      listener_function_data, (flags & GUM_ATTACH_FLAGS_UNIGNORABLE) != 0,
+      (n_predicates != 0) ? listener_filter_new (predicates, n_predicates)
+      : NULL);
 
   goto beach;
 
@@ -408,6 +664,11 @@ already_attached:
     result = GUM_ATTACH_ALREADY_ATTACHED;
     goto beach;
   }
+too_many_filtered:
+  {
+    result = GUM_ATTACH_TOO_MANY_FILTERED;
+    goto beach;
+  }
 beach:
   {
     gum_interceptor_transaction_end (&self->current_transaction);
@@ -423,7 +684,8 @@ gum_interceptor_detach (GumInterceptor * self,
                         GumInvocationListener * listener)
 {
   GHashTableIter iter;
-  gpointer key, value;
+  gpointer value;
+  InterceptorThreadContext * thread_ctx;
 
   gum_interceptor_ignore_current_thread (self);
   GUM_INTERCEPTOR_LOCK (self);
@@ -449,15 +711,12 @@ gum_interceptor_detach (GumInterceptor * self,
     }
   }
 
-  gum_spinlock_acquire (&gum_interceptor_thread_context_lock);
-  g_hash_table_iter_init (&iter, gum_interceptor_thread_contexts);
-  while (g_hash_table_iter_next (&iter, &key, NULL))
+  for (thread_ctx = g_atomic_pointer_get (&gum_interceptor_thread_contexts);
+      thread_ctx != NULL;
+      thread_ctx = thread_ctx->next)
   {
-    InterceptorThreadContext * thread_ctx = key;
-
     interceptor_thread_context_forget_listener_data (thread_ctx, listener);
   }
-  gum_spinlock_release (&gum_interceptor_thread_context_lock);
 
   gum_interceptor_transaction_end (&self->current_transaction);
   GUM_INTERCEPTOR_UNLOCK (self);
@@ -612,8 +871,11 @@ gum_interceptor_flush (GumInterceptor * self)
     gum_interceptor_transaction_begin (&self->current_transaction);
     gum_interceptor_transaction_end (&self->current_transaction);
 
-    flushed =
-        g_queue_is_empty (self->current_transaction.pending_destroy_tasks);
+    gum_interceptor_ignore_current_thread (self);
+    gum_interceptor_reclaim (self);
+    gum_interceptor_unignore_current_thread (self);
+
+    flushed = g_queue_is_empty (self->retired_tasks);
   }
 
   GUM_INTERCEPTOR_UNLOCK (self);
@@ -621,6 +883,15 @@ gum_interceptor_flush (GumInterceptor * self)
   return flushed;
 }
 
+void
+gum_interceptor_query_code_stats (GumInterceptor * self,
+                                  GumCodeAllocatorStats * stats)
+{
+  GUM_INTERCEPTOR_LOCK (self);
+  gum_code_allocator_query_stats (&self->allocator, stats);
+  GUM_INTERCEPTOR_UNLOCK (self);
+}
+
 GumInvocationContext *
 gum_interceptor_get_current_invocation (void)
 {
@@ -658,7 +929,7 @@ gum_interceptor_get_current_stack (void)
 {
   InterceptorThreadContext * context;
 
-  context = g_private_get (&gum_interceptor_context_private);
+  context = gum_interceptor_peek_thread_context ();
   if (context == NULL)
     return &_gum_interceptor_empty_stack;
 
@@ -836,7 +1107,9 @@ gum_interceptor_instrument (GumInterceptor * self,
 
   if (ctx != NULL)
   {
-    if (ctx->type != type)
+    if (ctx->type != type &&
+        !(type == GUM_INTERCEPTOR_TYPE_DEFAULT &&
+          ctx->type == GUM_INTERCEPTOR_TYPE_IMPORT))
     {
       *error = GUM_INSTRUMENTATION_ERROR_WRONG_TYPE;
       return NULL;
@@ -850,13 +1123,28 @@ gum_interceptor_instrument (GumInterceptor * self,
         _gum_interceptor_backend_create (&self->mutex, &self->allocator);
   }
 
+  if (type == GUM_INTERCEPTOR_TYPE_DEFAULT &&
+      self->mode == GUM_INTERCEPTOR_MODE_IMPORTS)
+  {
+    type = GUM_INTERCEPTOR_TYPE_IMPORT;
+  }
+
   ctx = gum_function_context_new (self, function_address, type);
 
   if (gum_process_get_code_signing_policy () == GUM_CODE_SIGNING_REQUIRED)
   {
+    if (type == GUM_INTERCEPTOR_TYPE_IMPORT)
+      goto policy_violation;
+
     if (!_gum_interceptor_backend_claim_grafted_trampoline (self->backend, ctx))
       goto policy_violation;
   }
+  else if (type == GUM_INTERCEPTOR_TYPE_IMPORT)
+  {
+    if (!_gum_interceptor_backend_create_import_trampoline (self->backend,
+          ctx))
+      goto wrong_signature;
+  }
   else
   {
     if (!_gum_interceptor_backend_create_trampoline (self->backend, ctx))
@@ -865,8 +1153,18 @@ gum_interceptor_instrument (GumInterceptor * self,
 
   g_hash_table_insert (self->function_by_address, function_address, ctx);
 
-  gum_interceptor_transaction_schedule_update (&self->current_transaction, ctx,
-      gum_interceptor_activate);
+  if (type == GUM_INTERCEPTOR_TYPE_IMPORT)
+  {
+    gum_interceptor_ensure_module_observer (self);
+
+    gum_interceptor_transaction_schedule_import_update (
+        &self->current_transaction, ctx, TRUE);
+  }
+  else
+  {
+    gum_interceptor_transaction_schedule_update (&self->current_transaction,
+        ctx, gum_interceptor_activate);
+  }
 
   return ctx;
 
@@ -916,6 +1214,237 @@ gum_interceptor_deactivate (GumInterceptor * self,
   _gum_interceptor_backend_deactivate_trampoline (backend, ctx, prologue);
 }
 
+static void
+gum_interceptor_apply_import_tasks (GumInterceptor * self,
+                                    GArray * tasks)
+{
+  GHashTable * targets;
+  guint i;
+
+  targets = g_hash_table_new (NULL, NULL);
+
+  for (i = 0; i != tasks->len; i++)
+  {
+    GumImportTask * task = &g_array_index (tasks, GumImportTask, i);
+    GumFunctionContext * ctx = task->ctx;
+
+    if (task->activate)
+    {
+      if (ctx->destroyed)
+        continue;
+
+      g_assert (!ctx->activated);
+      ctx->activated = TRUE;
+
+      g_hash_table_insert (targets, ctx->function_address, ctx);
+    }
+    else
+    {
+      GArray * slots = ctx->import_slots;
+      guint j;
+
+      g_assert (ctx->activated);
+      ctx->activated = FALSE;
+
+      for (j = 0; j != slots->len; j++)
+      {
+        GumImportSlot * slot = &g_array_index (slots, GumImportSlot, j);
+
+        gum_import_slot_write (slot->address, slot->original_value);
+      }
+      g_array_set_size (slots, 0);
+    }
+  }
+
+  if (g_hash_table_size (targets) != 0)
+  {
+    GPtrArray * modules;
+
+    modules = _gum_module_registry_get_modules (gum_module_registry_obtain ());
+    for (i = 0; i != modules->len; i++)
+    {
+      gum_interceptor_patch_imports_in_module (self,
+          g_ptr_array_index (modules, i), targets);
+    }
+    g_ptr_array_unref (modules);
+  }
+
+  g_hash_table_unref (targets);
+}
+
+static void
+gum_interceptor_patch_imports_in_module (GumInterceptor * self,
+                                         GumModule * module,
+                                         GHashTable * targets)
+{
+  if (gum_cloak_has_range_containing (
+        gum_module_get_range (module)->base_address))
+    return;
+
+  if (!gum_interceptor_is_module_in_import_scope (self, module))
+    return;
+
+  gum_module_enumerate_imports (module,
+      gum_interceptor_patch_import_if_targeted, targets);
+}
+
+static gboolean
+gum_interceptor_patch_import_if_targeted (const GumImportDetails * details,
+                                          gpointer user_data)
+{
+  GHashTable * targets = user_data;
+  GumFunctionContext * ctx;
+  GumImportSlot slot;
+
+  if (details->slot == 0 || details->address == 0)
+    return TRUE;
+
+  ctx = g_hash_table_lookup (targets,
+      GSIZE_TO_POINTER (gum_strip_code_address (details->address)));
+  if (ctx == NULL)
+    return TRUE;
+
+  slot.address = GSIZE_TO_POINTER (details->slot);
+  slot.original_value = *slot.address;
+
+  if (gum_import_slot_write (slot.address, ctx->on_enter_trampoline))
+    g_array_append_val (ctx->import_slots, slot);
+
+  return TRUE;
+}
+
+static gboolean
+gum_interceptor_is_module_in_import_scope (GumInterceptor * self,
+                                           GumModule * module)
+{
+  gchar ** cur;
+
+  if (self->import_scope == NULL)
+    return TRUE;
+
+  for (cur = self->import_scope; *cur != NULL; cur++)
+  {
+    if (strcmp (*cur, gum_module_get_name (module)) == 0 ||
+        strcmp (*cur, gum_module_get_path (module)) == 0)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static void
+gum_interceptor_ensure_module_observer (GumInterceptor * self)
+{
+  GumModuleRegistry * registry;
+
+  if (self->module_added_handler != 0)
+    return;
+
+  registry = gum_module_registry_obtain ();
+
+  self->module_added_handler = g_signal_connect (registry, "module-added",
+      G_CALLBACK (gum_interceptor_on_module_added), self);
+  self->module_removed_handler = g_signal_connect (registry, "module-removed",
+      G_CALLBACK (gum_interceptor_on_module_removed), self);
+}
+
+static void
+gum_interceptor_on_module_added (GumModuleRegistry * registry,
+                                 GumModule * module,
+                                 GumInterceptor * self)
+{
+  GHashTable * targets;
+  GHashTableIter iter;
+  gpointer value;
+
+  gum_interceptor_ignore_current_thread (self);
+  GUM_INTERCEPTOR_LOCK (self);
+
+  targets = g_hash_table_new (NULL, NULL);
+
+  g_hash_table_iter_init (&iter, self->function_by_address);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+  {
+    GumFunctionContext * ctx = value;
+
+    if (ctx->type == GUM_INTERCEPTOR_TYPE_IMPORT && ctx->activated)
+      g_hash_table_insert (targets, ctx->function_address, ctx);
+  }
+
+  if (g_hash_table_size (targets) != 0)
+    gum_interceptor_patch_imports_in_module (self, module, targets);
+
+  g_hash_table_unref (targets);
+
+  GUM_INTERCEPTOR_UNLOCK (self);
+  gum_interceptor_unignore_current_thread (self);
+}
+
+static void
+gum_interceptor_on_module_removed (GumModuleRegistry * registry,
+                                   GumModule * module,
+                                   GumInterceptor * self)
+{
+  const GumMemoryRange * range;
+  GHashTableIter iter;
+  gpointer value;
+
+  range = gum_module_get_range (module);
+
+  gum_interceptor_ignore_current_thread (self);
+  GUM_INTERCEPTOR_LOCK (self);
+
+  g_hash_table_iter_init (&iter, self->function_by_address);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+  {
+    GumFunctionContext * ctx = value;
+    GArray * slots = ctx->import_slots;
+    guint i;
+
+    if (ctx->type != GUM_INTERCEPTOR_TYPE_IMPORT)
+      continue;
+
+    for (i = 0; i < slots->len; i++)
+    {
+      GumImportSlot * slot = &g_array_index (slots, GumImportSlot, i);
+
+      if (GUM_MEMORY_RANGE_INCLUDES (range, GUM_ADDRESS (slot->address)))
+      {
+        g_array_remove_index_fast (slots, i);
+        i--;
+      }
+    }
+  }
+
+  GUM_INTERCEPTOR_UNLOCK (self);
+  gum_interceptor_unignore_current_thread (self);
+}
+
+static gboolean
+gum_import_slot_write (gpointer * slot,
+                       gpointer value)
+{
+  GumPageProtection prot;
+  gboolean flip_needed;
+
+  if (!gum_memory_query_protection (slot, &prot))
+    return FALSE;
+
+  flip_needed = (prot & GUM_PAGE_WRITE) == 0;
+  if (flip_needed)
+  {
+    if (!gum_try_mprotect (slot, sizeof (gpointer), prot | GUM_PAGE_WRITE))
+      return FALSE;
+  }
+
+  g_atomic_pointer_set (slot, value);
+
+  if (flip_needed)
+    gum_try_mprotect (slot, sizeof (gpointer), prot);
+
+  return TRUE;
+}
+
 static void
 gum_interceptor_transaction_init (GumInterceptorTransaction * transaction,
                                   GumInterceptor * interceptor)
@@ -925,6 +1454,8 @@ gum_interceptor_transaction_init (GumInterceptorTransaction * transaction,
   transaction->pending_destroy_tasks = g_queue_new ();
   transaction->pending_update_tasks = g_hash_table_new_full (
       NULL, NULL, NULL, (GDestroyNotify) g_array_unref);
+  transaction->pending_import_tasks =
+      g_array_new (FALSE, FALSE, sizeof (GumImportTask));
 
   transaction->interceptor = interceptor;
 }
@@ -934,6 +1465,7 @@ gum_interceptor_transaction_destroy (GumInterceptorTransaction * transaction)
 {
   GumDestroyTask * task;
 
+  g_array_unref (transaction->pending_import_tasks);
   g_hash_table_unref (transaction->pending_update_tasks);
 
   while ((task = g_queue_pop_head (transaction->pending_destroy_tasks)) != NULL)
@@ -970,7 +1502,8 @@ gum_interceptor_transaction_end (GumInterceptorTransaction * self)
   gum_code_allocator_commit (&interceptor->allocator);
 
   if (g_queue_is_empty (self->pending_destroy_tasks) &&
-      g_hash_table_size (self->pending_update_tasks) == 0)
+      g_hash_table_size (self->pending_update_tasks) == 0 &&
+      self->pending_import_tasks->len == 0)
   {
     interceptor->current_transaction.is_dirty = FALSE;
     goto no_changes;
@@ -1163,31 +1696,16 @@ gum_interceptor_transaction_end (GumInterceptorTransaction * self)
 
   g_list_free (addresses);
 
-  {
-    GumDestroyTask * task;
+  if (self->pending_import_tasks->len != 0)
+    gum_interceptor_apply_import_tasks (interceptor, self->pending_import_tasks);
 
-    while ((task = g_queue_pop_head (self->pending_destroy_tasks)) != NULL)
-    {
-      if (task->ctx->trampoline_usage_counter == 0)
-      {
-        GUM_INTERCEPTOR_UNLOCK (interceptor);
-        task->notify (task->data);
-        GUM_INTERCEPTOR_LOCK (interceptor);
-
-        g_slice_free (GumDestroyTask, task);
-      }
-      else
-      {
-        interceptor->current_transaction.is_dirty = TRUE;
-        g_queue_push_tail (
-            interceptor->current_transaction.pending_destroy_tasks, task);
-      }
-    }
-  }
+  gum_interceptor_retire_tasks (interceptor, self->pending_destroy_tasks);
 
   gum_interceptor_transaction_destroy (self);
 
 no_changes:
+  gum_interceptor_reclaim (interceptor);
+
   gum_interceptor_unignore_current_thread (interceptor);
 }
 
@@ -1228,6 +1746,119 @@ gum_interceptor_transaction_schedule_destroy (GumInterceptorTransaction * self,
   g_queue_push_tail (self->pending_destroy_tasks, task);
 }
 
+/*
+ * Destroy tasks are retired once the code changes that unlink them have been
+ * applied. A retired task is stamped with the epoch at that point, and is only
+ * carried out once every thread that was inside the interceptor back then has
+ * passed through a quiescent state. Threads are only considered inside while
+ * running the interceptor's own entry and exit paths, so one that is blocked
+ * in a hooked function does not hold up reclamation.
+ */
+static void
+gum_interceptor_retire_tasks (GumInterceptor * self,
+                              GQueue * tasks)
+{
+  gint epoch;
+  GumDestroyTask * task;
+
+  if (g_queue_is_empty (tasks))
+    return;
+
+  epoch = g_atomic_int_add (&gum_interceptor_epoch, 2);
+
+  while ((task = g_queue_pop_head (tasks)) != NULL)
+  {
+    task->epoch = epoch;
+    g_queue_push_tail (self->retired_tasks, task);
+  }
+}
+
+static void
+gum_interceptor_reclaim (GumInterceptor * self)
+{
+  gboolean any_thread_inside;
+  gint oldest_epoch;
+  GQueue ready = G_QUEUE_INIT;
+  GList * cur, * next;
+  GumDestroyTask * task;
+
+  if (g_queue_is_empty (self->retired_tasks))
+    return;
+
+  any_thread_inside = gum_interceptor_find_oldest_epoch (&oldest_epoch);
+
+  for (cur = self->retired_tasks->head; cur != NULL; cur = next)
+  {
+    next = cur->next;
+    task = cur->data;
+
+    /* Tasks are stamped in order, so none of the remaining ones are due. */
+    if (any_thread_inside &&
+        (gint) ((guint) oldest_epoch - (guint) task->epoch) <= 0)
+      break;
+
+    /* A thread is still inside this function; try again later. */
+    if (task->ctx->destroyed &&
+        g_atomic_int_get (&task->ctx->trampoline_usage_counter) != 0)
+      continue;
+
+    g_queue_unlink (self->retired_tasks, cur);
+    g_queue_push_tail_link (&ready, cur);
+  }
+
+  if (g_queue_is_empty (&ready))
+    return;
+
+  GUM_INTERCEPTOR_UNLOCK (self);
+
+  while ((task = g_queue_pop_head (&ready)) != NULL)
+  {
+    task->notify (task->data);
+
+    g_slice_free (GumDestroyTask, task);
+  }
+
+  GUM_INTERCEPTOR_LOCK (self);
+}
+
+static void
+gum_interceptor_reclaim_all (GumInterceptor * self)
+{
+  GumDestroyTask * task;
+
+  while ((task = g_queue_pop_head (self->retired_tasks)) != NULL)
+  {
+    task->notify (task->data);
+
+    g_slice_free (GumDestroyTask, task);
+  }
+}
+
+static gboolean
+gum_interceptor_find_oldest_epoch (gint * epoch)
+{
+  gboolean found = FALSE;
+  InterceptorThreadContext * thread_ctx;
+
+  for (thread_ctx = g_atomic_pointer_get (&gum_interceptor_thread_contexts);
+      thread_ctx != NULL;
+      thread_ctx = thread_ctx->next)
+  {
+    gint observed = g_atomic_int_get (&thread_ctx->observed_epoch);
+
+    if (observed == 0)
+      continue;
+
+    if (!found || (gint) ((guint) observed - (guint) *epoch) < 0)
+    {
+      *epoch = observed;
+      found = TRUE;
+    }
+  }
+
+  return found;
+}
+
 static void
 gum_interceptor_transaction_schedule_update (GumInterceptorTransaction * self,
                                              GumFunctionContext * ctx,
@@ -1266,6 +1897,19 @@ gum_interceptor_transaction_schedule_update (GumInterceptorTransaction * self,
   }
 }
 
+static void
+gum_interceptor_transaction_schedule_import_update (
+    GumInterceptorTransaction * self,
+    GumFunctionContext * ctx,
+    gboolean activate)
+{
+  GumImportTask task;
+
+  task.ctx = ctx;
+  task.activate = activate;
+  g_array_append_val (self->pending_import_tasks, task);
+}
+
 static GumFunctionContext *
 gum_function_context_new (GumInterceptor * interceptor,
                           gpointer function_address,
@@ -1278,6 +1922,8 @@ gum_function_context_new (GumInterceptor * interceptor,
   ctx->type = type;
   ctx->listener_entries =
       g_ptr_array_new_full (1, (GDestroyNotify) listener_entry_free);
+  if (type == GUM_INTERCEPTOR_TYPE_IMPORT)
+    ctx->import_slots = g_array_new (FALSE, FALSE, sizeof (GumImportSlot));
   ctx->interceptor = interceptor;
 
   return ctx;
@@ -1288,6 +1934,9 @@ gum_function_context_finalize (GumFunctionContext * function_ctx)
 {
   g_assert (function_ctx->trampoline_slice == NULL);
 
+  if (function_ctx->import_slots != NULL)
+    g_array_free (function_ctx->import_slots, TRUE);
+
   g_ptr_array_unref (
       (GPtrArray *) g_atomic_pointer_get (&function_ctx->listener_entries));
 
@@ -1305,8 +1954,16 @@ gum_function_context_destroy (GumFunctionContext * function_ctx)
 
   if (function_ctx->activated)
   {
-    gum_interceptor_transaction_schedule_update (transaction, function_ctx,
-        gum_interceptor_deactivate);
+    if (function_ctx->type == GUM_INTERCEPTOR_TYPE_IMPORT)
+    {
+      gum_interceptor_transaction_schedule_import_update (transaction,
+          function_ctx, FALSE);
+    }
+    else
+    {
+      gum_interceptor_transaction_schedule_update (transaction, function_ctx,
+          gum_interceptor_deactivate);
+    }
   }
 
   gum_interceptor_transaction_schedule_destroy (transaction, function_ctx,
@@ -1316,8 +1973,16 @@ gum_function_context_destroy (GumFunctionContext * function_ctx)
 static void
 gum_function_context_perform_destroy (GumFunctionContext * function_ctx)
 {
-  _gum_interceptor_backend_destroy_trampoline (
-      function_ctx->interceptor->backend, function_ctx);
+  GumInterceptor * interceptor = function_ctx->interceptor;
+
+  /*
+   * Retired tasks are run without the lock held, but the code allocator's
+   * free list and counters are shared with whoever is creating trampolines.
+   */
+  GUM_INTERCEPTOR_LOCK (interceptor);
+  _gum_interceptor_backend_destroy_trampoline (interceptor->backend,
+      function_ctx);
+  GUM_INTERCEPTOR_UNLOCK (interceptor);
 
   gum_function_context_finalize (function_ctx);
 }
@@ -1335,7 +2000,8 @@ static void
 gum_function_context_add_listener (GumFunctionContext * function_ctx,
                                    GumInvocationListener * listener,
                                    gpointer function_data,
-                                   gboolean unignorable)
+                                   gboolean unignorable,
+                                   ListenerFilter * filter)
 {
   ListenerEntry * entry;
   GPtrArray * old_entries, * new_entries;
@@ -1346,6 +2012,7 @@ gum_function_context_add_listener (GumFunctionContext * function_ctx,
   entry->listener_instance = listener;
   entry->function_data = function_data;
   entry->unignorable = unignorable;
+  entry->filter = filter;
 
   old_entries =
       (GPtrArray *) g_atomic_pointer_get (&function_ctx->listener_entries);
@@ -1355,7 +2022,7 @@ gum_function_context_add_listener (GumFunctionContext * function_ctx,
   {
     ListenerEntry * old_entry = g_ptr_array_index (old_entries, i);
     if (old_entry != NULL)
-      g_ptr_array_add (new_entries, g_slice_dup (ListenerEntry, old_entry));
+      g_ptr_array_add (new_entries, listener_entry_dup (old_entry));
   }
   g_ptr_array_add (new_entries, entry);
 
@@ -1364,19 +2031,129 @@ gum_function_context_add_listener (GumFunctionContext * function_ctx,
       &function_ctx->interceptor->current_transaction, function_ctx,
       (GDestroyNotify) g_ptr_array_unref, old_entries);
 
-  if (entry->listener_interface->on_leave != NULL)
-    function_ctx->has_on_leave_listener = TRUE;
+  gum_function_context_update_listener_flags (function_ctx);
+}
+
+static ListenerEntry *
+listener_entry_dup (const ListenerEntry * entry)
+{
+  ListenerEntry * copy;
+
+  copy = g_slice_dup (ListenerEntry, entry);
+  if (copy->filter != NULL)
+    listener_filter_ref (copy->filter);
 
-  if (unignorable)
-    function_ctx->has_unignorable_listener = TRUE;
+  return copy;
 }
 
 static void
 listener_entry_free (ListenerEntry * entry)
 {
+  if (entry->filter != NULL)
+    listener_filter_unref (entry->filter);
+
   g_slice_free (ListenerEntry, entry);
 }
 
+static ListenerFilter *
+listener_filter_new (const GumArgumentPredicate * predicates,
+                     guint n_predicates)
+{
+  ListenerFilter * filter;
+  gsize header_size, prefixes_size;
+  guint8 * prefix_storage;
+  guint i;
+
+  header_size = sizeof (ListenerFilter) +
+      (n_predicates * sizeof (GumArgumentPredicate));
+
+  prefixes_size = 0;
+  for (i = 0; i != n_predicates; i++)
+  {
+    if (predicates[i].type == GUM_ARGUMENT_PREDICATE_PREFIX)
+      prefixes_size += predicates[i].prefix_size;
+  }
+
+  filter = g_malloc (header_size + prefixes_size);
+  filter->ref_count = 1;
+  filter->num_predicates = n_predicates;
+
+  prefix_storage = (guint8 *) filter + header_size;
+  for (i = 0; i != n_predicates; i++)
+  {
+    GumArgumentPredicate * p = &filter->predicates[i];
+
+    *p = predicates[i];
+
+    if (p->type == GUM_ARGUMENT_PREDICATE_PREFIX)
+    {
+      memcpy (prefix_storage, predicates[i].prefix, p->prefix_size);
+      p->prefix = prefix_storage;
+      prefix_storage += p->prefix_size;
+    }
+  }
+
+  return filter;
+}
+
+static ListenerFilter *
+listener_filter_ref (ListenerFilter * filter)
+{
+  g_atomic_int_inc (&filter->ref_count);
+
+  return filter;
+}
+
+static void
+listener_filter_unref (ListenerFilter * filter)
+{
+  if (g_atomic_int_dec_and_test (&filter->ref_count))
+    g_free (filter);
+}
+
+static gboolean
+listener_filter_matches (const ListenerFilter * filter,
+                         GumCpuContext * cpu_context)
+{
+  guint i;
+
+  for (i = 0; i != filter->num_predicates; i++)
+  {
+    if (!gum_argument_predicate_matches (&filter->predicates[i], cpu_context))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gum_argument_predicate_matches (const GumArgumentPredicate * predicate,
+                                GumCpuContext * cpu_context)
+{
+  gsize arg;
+
+  arg = GPOINTER_TO_SIZE (
+      gum_cpu_context_get_nth_argument (cpu_context, predicate->index));
+
+  switch (predicate->type)
+  {
+    case GUM_ARGUMENT_PREDICATE_EQUAL:
+      return (arg & predicate->mask) == predicate->value;
+    case GUM_ARGUMENT_PREDICATE_RANGE:
+      return arg >= predicate->min && arg <= predicate->max;
+    case GUM_ARGUMENT_PREDICATE_PREFIX:
+      if (!gum_memory_is_readable (GSIZE_TO_POINTER (arg),
+            predicate->prefix_size))
+        return FALSE;
+      return memcmp (GSIZE_TO_POINTER (arg), predicate->prefix,
+          predicate->prefix_size) == 0;
+    default:
+      g_assert_not_reached ();
+  }
+
+  return FALSE;
+}
+
 static void
 gum_function_context_remove_listener (GumFunctionContext * function_ctx,
                                       GumInvocationListener * listener)
@@ -1391,8 +2168,20 @@ gum_function_context_remove_listener (GumFunctionContext * function_ctx,
   listener_entry_free (*slot);
   *slot = NULL;
 
+  gum_function_context_update_listener_flags (function_ctx);
+}
+
+static void
+gum_function_context_update_listener_flags (GumFunctionContext * function_ctx)
+{
+  gboolean has_on_leave_listener, has_unignorable_listener,
+      has_unfiltered_listener;
+  GPtrArray * listener_entries;
+  guint i;
+
   has_on_leave_listener = FALSE;
   has_unignorable_listener = FALSE;
+  has_unfiltered_listener = FALSE;
   listener_entries =
       (GPtrArray *) g_atomic_pointer_get (&function_ctx->listener_entries);
   for (i = 0; i != listener_entries->len; i++)
@@ -1407,9 +2196,13 @@ gum_function_context_remove_listener (GumFunctionContext * function_ctx,
 
     if (entry->unignorable)
       has_unignorable_listener = TRUE;
+
+    if (entry->filter == NULL)
+      has_unfiltered_listener = TRUE;
   }
   function_ctx->has_on_leave_listener = has_on_leave_listener;
   function_ctx->has_unignorable_listener = has_unignorable_listener;
+  function_ctx->has_unfiltered_listener = has_unfiltered_listener;
 }
 
 static gboolean
@@ -1459,6 +2252,72 @@ gum_function_context_find_taken_listener_slot (
   return NULL;
 }
 
+static guint
+gum_function_context_count_listeners (GumFunctionContext * function_ctx)
+{
+  GPtrArray * listener_entries;
+  guint n, i;
+
+  listener_entries =
+      (GPtrArray *) g_atomic_pointer_get (&function_ctx->listener_entries);
+
+  n = 0;
+  for (i = 0; i != listener_entries->len; i++)
+  {
+    if (g_ptr_array_index (listener_entries, i) != NULL)
+      n++;
+  }
+
+  return n;
+}
+
+/*
+ * Evaluates the filter of each filtered listener once per call, and returns a
+ * mask with the bits of those that rejected it. Filtered listeners are never
+ * attached beyond GUM_MAX_FILTERED_LISTENER_INDEX, so the mask always fits.
+ */
+static guint32
+gum_reject_filtered_listeners (GPtrArray * listener_entries,
+                               GumCpuContext * cpu_context)
+{
+  guint32 rejected_listeners;
+  guint i;
+
+  rejected_listeners = 0;
+
+  for (i = 0; i != listener_entries->len; i++)
+  {
+    ListenerEntry * entry = g_ptr_array_index (listener_entries, i);
+
+    if (entry == NULL || entry->filter == NULL)
+      continue;
+
+    if (!listener_filter_matches (entry->filter, cpu_context))
+      rejected_listeners |= 1U << i;
+  }
+
+  return rejected_listeners;
+}
+
+static gboolean
+gum_any_listener_accepts (GPtrArray * listener_entries,
+                          guint32 rejected_listeners)
+{
+  guint i;
+
+  for (i = 0; i != listener_entries->len; i++)
+  {
+    if (g_ptr_array_index (listener_entries, i) == NULL)
+      continue;
+
+    if (i >= GUM_MAX_FILTERED_LISTENER_INDEX ||
+        (rejected_listeners & (1U << i)) == 0)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
 gboolean
 _gum_function_context_begin_invocation (GumFunctionContext * function_ctx,
                                         GumCpuContext * cpu_context,
@@ -1470,6 +2329,8 @@ _gum_function_context_begin_invocation (GumFunctionContext * function_ctx,
   GumInvocationStack * stack;
   GumInvocationStackEntry * stack_entry;
   GumInvocationContext * invocation_ctx = NULL;
+  GPtrArray * listener_entries = NULL;
+  guint32 rejected_listeners = 0;
   gint system_error;
   gboolean invoke_listeners = TRUE;
   gboolean only_invoke_unignorable_listeners = FALSE;
@@ -1477,20 +2338,54 @@ _gum_function_context_begin_invocation (GumFunctionContext * function_ctx,
 
   g_atomic_int_inc (&function_ctx->trampoline_usage_counter);
 
+  interceptor_ctx = gum_interceptor_peek_thread_context ();
+  if (interceptor_ctx != NULL)
+    interceptor_thread_context_enter_critical (interceptor_ctx);
+
   interceptor = function_ctx->interceptor;
 
 #ifdef HAVE_WINDOWS
   system_error = gum_thread_get_system_error ();
 #endif
 
-  if (gum_tls_key_get_value (gum_interceptor_guard_key) == interceptor)
+  if (gum_interceptor_get_guard () == interceptor)
   {
     *next_hop = function_ctx->on_invoke_trampoline;
     goto bypass;
   }
-  gum_tls_key_set_value (gum_interceptor_guard_key, interceptor);
+  gum_interceptor_set_guard (interceptor);
+
+  /*
+   * Filters may have to probe memory, which can end up in hooked functions,
+   * so they are only evaluated with the guard in place.
+   */
+  if (interceptor_ctx != NULL &&
+      !function_ctx->has_unfiltered_listener &&
+      function_ctx->replacement_function == NULL)
+  {
+#ifndef HAVE_WINDOWS
+    system_error = gum_thread_get_system_error ();
+#endif
 
-  interceptor_ctx = get_interceptor_thread_context ();
+    listener_entries =
+        (GPtrArray *) g_atomic_pointer_get (&function_ctx->listener_entries);
+    rejected_listeners =
+        gum_reject_filtered_listeners (listener_entries, cpu_context);
+
+    if (!gum_any_listener_accepts (listener_entries, rejected_listeners))
+    {
+      gum_thread_set_system_error (system_error);
+      gum_interceptor_set_guard (NULL);
+      *next_hop = function_ctx->on_invoke_trampoline;
+      goto bypass;
+    }
+  }
+
+  if (interceptor_ctx == NULL)
+  {
+    interceptor_ctx = get_interceptor_thread_context ();
+    interceptor_thread_context_enter_critical (interceptor_ctx);
+  }
   stack = interceptor_ctx->stack;
 
   stack_entry = gum_invocation_stack_peek_top (stack);
@@ -1500,7 +2395,7 @@ _gum_function_context_begin_invocation (GumFunctionContext * function_ctx,
           stack_entry->invocation_context.function)) ==
           function_ctx->function_address)
   {
-    gum_tls_key_set_value (gum_interceptor_guard_key, NULL);
+    gum_interceptor_set_guard (NULL);
     *next_hop = function_ctx->on_invoke_trampoline;
     goto bypass;
   }
@@ -1548,14 +2443,20 @@ _gum_function_context_begin_invocation (GumFunctionContext * function_ctx,
 
   if (invoke_listeners)
   {
-    GPtrArray * listener_entries;
     guint i;
 
     invocation_ctx->cpu_context = cpu_context;
     invocation_ctx->backend = &interceptor_ctx->listener_backend;
 
-    listener_entries =
-        (GPtrArray *) g_atomic_pointer_get (&function_ctx->listener_entries);
+    if (listener_entries == NULL)
+    {
+      listener_entries =
+          (GPtrArray *) g_atomic_pointer_get (&function_ctx->listener_entries);
+      rejected_listeners =
+          gum_reject_filtered_listeners (listener_entries, cpu_context);
+    }
+    stack_entry->filtered_listeners = rejected_listeners;
+
     for (i = 0; i != listener_entries->len; i++)
     {
       ListenerEntry * listener_entry;
@@ -1568,6 +2469,10 @@ _gum_function_context_begin_invocation (GumFunctionContext * function_ctx,
       if (only_invoke_unignorable_listeners && !listener_entry->unignorable)
         continue;
 
+      if (i < GUM_MAX_FILTERED_LISTENER_INDEX &&
+          (rejected_listeners & (1U << i)) != 0)
+        continue;
+
       state.point_cut = GUM_POINT_ENTER;
       state.entry = listener_entry;
       state.interceptor_ctx = interceptor_ctx;
@@ -1591,7 +2496,7 @@ _gum_function_context_begin_invocation (GumFunctionContext * function_ctx,
 
   gum_thread_set_system_error (system_error);
 
-  gum_tls_key_set_value (gum_interceptor_guard_key, NULL);
+  gum_interceptor_set_guard (NULL);
 
   if (will_trap_on_leave)
   {
@@ -1615,10 +2520,16 @@ _gum_function_context_begin_invocation (GumFunctionContext * function_ctx,
   }
 
 bypass:
+  /*
+   * While the thread is off running the hooked function it holds no pointers
+   * into listener arrays, so it is quiescent until _end_invocation(). The
+   * function context itself stays pinned by its usage counter.
+   */
+  if (interceptor_ctx != NULL)
+    interceptor_thread_context_leave_critical (interceptor_ctx);
+
   if (!will_trap_on_leave)
-  {
     g_atomic_int_dec_and_test (&function_ctx->trampoline_usage_counter);
-  }
 
   return will_trap_on_leave;
 }
@@ -1640,13 +2551,14 @@ _gum_function_context_end_invocation (GumFunctionContext * function_ctx,
   system_error = gum_thread_get_system_error ();
 #endif
 
-  gum_tls_key_set_value (gum_interceptor_guard_key, function_ctx->interceptor);
+  gum_interceptor_set_guard (function_ctx->interceptor);
 
 #ifndef HAVE_WINDOWS
   system_error = gum_thread_get_system_error ();
 #endif
 
   interceptor_ctx = get_interceptor_thread_context ();
+  interceptor_thread_context_enter_critical (interceptor_ctx);
 
   stack_entry = gum_invocation_stack_peek_top (interceptor_ctx->stack);
   *next_hop = gum_sign_code_pointer (stack_entry->caller_ret_addr);
@@ -1682,6 +2594,10 @@ _gum_function_context_end_invocation (GumFunctionContext * function_ctx,
     if (only_invoke_unignorable_listeners && !listener_entry->unignorable)
       continue;
 
+    if (i < GUM_MAX_FILTERED_LISTENER_INDEX &&
+        (stack_entry->filtered_listeners & (1U << i)) != 0)
+      continue;
+
     state.point_cut = GUM_POINT_LEAVE;
     state.entry = listener_entry;
     state.interceptor_ctx = interceptor_ctx;
@@ -1699,7 +2615,9 @@ _gum_function_context_end_invocation (GumFunctionContext * function_ctx,
 
   gum_invocation_stack_pop (interceptor_ctx->stack);
 
-  gum_tls_key_set_value (gum_interceptor_guard_key, NULL);
+  gum_interceptor_set_guard (NULL);
+
+  interceptor_thread_context_leave_critical (interceptor_ctx);
 
   g_atomic_int_dec_and_test (&function_ctx->trampoline_usage_counter);
 }
@@ -1737,16 +2655,15 @@ get_interceptor_thread_context (void)
 {
   InterceptorThreadContext * context;
 
-  context = g_private_get (&gum_interceptor_context_private);
-  if (context == NULL)
+  context = gum_interceptor_peek_thread_context ();
+  if (G_UNLIKELY (context == NULL))
   {
-    context = interceptor_thread_context_new ();
-
-    gum_spinlock_acquire (&gum_interceptor_thread_context_lock);
-    g_hash_table_add (gum_interceptor_thread_contexts, context);
-    gum_spinlock_release (&gum_interceptor_thread_context_lock);
+    context = interceptor_thread_context_acquire ();
 
     g_private_set (&gum_interceptor_context_private, context);
+#ifdef GUM_INTERCEPTOR_USE_STATIC_TLS
+    gum_interceptor_thread_slot.context = context;
+#endif
   }
 
   return context;
@@ -1755,12 +2672,46 @@ get_interceptor_thread_context (void)
 static void
 release_interceptor_thread_context (InterceptorThreadContext * context)
 {
-  if (gum_interceptor_thread_contexts == NULL)
+#ifdef GUM_INTERCEPTOR_USE_STATIC_TLS
+  gum_interceptor_thread_slot.context = NULL;
+#endif
+
+  if (!gum_interceptor_thread_contexts_live)
     return;
 
-  gum_spinlock_acquire (&gum_interceptor_thread_context_lock);
-  g_hash_table_remove (gum_interceptor_thread_contexts, context);
-  gum_spinlock_release (&gum_interceptor_thread_context_lock);
+  interceptor_thread_context_reset (context);
+
+  g_atomic_int_set (&context->in_use, FALSE);
+}
+
+static InterceptorThreadContext *
+interceptor_thread_context_acquire (void)
+{
+  InterceptorThreadContext * context, * head;
+
+  for (context = g_atomic_pointer_get (&gum_interceptor_thread_contexts);
+      context != NULL;
+      context = context->next)
+  {
+    if (g_atomic_int_get (&context->in_use))
+      continue;
+
+    if (g_atomic_int_compare_and_exchange (&context->in_use, FALSE, TRUE))
+      return context;
+  }
+
+  context = interceptor_thread_context_new ();
+  context->in_use = TRUE;
+
+  do
+  {
+    head = g_atomic_pointer_get (&gum_interceptor_thread_contexts);
+    context->next = head;
+  }
+  while (!g_atomic_pointer_compare_and_exchange (
+      &gum_interceptor_thread_contexts, head, context));
+
+  return context;
 }
 
 static GumPointCut
@@ -1890,12 +2841,36 @@ interceptor_thread_context_new (void)
   context->stack = g_array_sized_new (FALSE, TRUE,
       sizeof (GumInvocationStackEntry), GUM_MAX_CALL_DEPTH);
 
+  gum_spinlock_init (&context->listener_data_lock);
   context->listener_data_slots = g_array_sized_new (FALSE, TRUE,
       sizeof (ListenerDataSlot), GUM_MAX_LISTENERS_PER_FUNCTION);
 
   return context;
 }
 
+static void
+interceptor_thread_context_reset (InterceptorThreadContext * context)
+{
+  guint i;
+
+  context->ignore_level = 0;
+
+  context->critical_depth = 0;
+  g_atomic_int_set (&context->observed_epoch, 0);
+
+  g_array_set_size (context->stack, 0);
+
+  gum_spinlock_acquire (&context->listener_data_lock);
+  for (i = 0; i != context->listener_data_slots->len; i++)
+  {
+    ListenerDataSlot * slot;
+
+    slot = &g_array_index (context->listener_data_slots, ListenerDataSlot, i);
+    slot->owner = NULL;
+  }
+  gum_spinlock_release (&context->listener_data_lock);
+}
+
 static void
 interceptor_thread_context_destroy (InterceptorThreadContext * context)
 {
@@ -1911,21 +2886,34 @@ interceptor_thread_context_get_listener_data (InterceptorThreadContext * self,
                                               GumInvocationListener * listener,
                                               gsize required_size)
 {
+  gpointer data;
   guint i;
   ListenerDataSlot * available_slot = NULL;
 
   if (required_size > GUM_MAX_LISTENER_DATA)
     return NULL;
 
+  /*
+   * The slots are only ever used by the owning thread, but detach() walks
+   * every context to release the listener's slot, so the array must not be
+   * resized or reset under its feet.
+   */
+  gum_spinlock_acquire (&self->listener_data_lock);
+
   for (i = 0; i != self->listener_data_slots->len; i++)
   {
     ListenerDataSlot * slot;
 
     slot = &g_array_index (self->listener_data_slots, ListenerDataSlot, i);
     if (slot->owner == listener)
-      return slot->data;
+    {
+      data = slot->data;
+      goto beach;
+    }
     else if (slot->owner == NULL)
+    {
       available_slot = slot;
+    }
   }
 
   if (available_slot == NULL)
@@ -1941,8 +2929,12 @@ interceptor_thread_context_get_listener_data (InterceptorThreadContext * self,
   }
 
   available_slot->owner = listener;
+  data = available_slot->data;
+
+beach:
+  gum_spinlock_release (&self->listener_data_lock);
 
-  return available_slot->data;
+  return data;
 }
 
 static void
@@ -1952,6 +2944,8 @@ interceptor_thread_context_forget_listener_data (
 {
   guint i;
 
+  gum_spinlock_acquire (&self->listener_data_lock);
+
   for (i = 0; i != self->listener_data_slots->len; i++)
   {
     ListenerDataSlot * slot;
@@ -1960,9 +2954,11 @@ interceptor_thread_context_forget_listener_data (
     if (slot->owner == listener)
     {
       slot->owner = NULL;
-      return;
+      break;
     }
   }
+
+  gum_spinlock_release (&self->listener_data_lock);
 }
 
 static GumInvocationStackEntry *
@@ -1980,6 +2976,7 @@ gum_invocation_stack_push (GumInvocationStack * stack,
   entry->function_ctx = function_ctx;
   entry->caller_ret_addr = caller_ret_addr;
   entry->only_invoke_unignorable_listeners = only_invoke_unignorable_listeners;
+  entry->filtered_listeners = 0;
 
   ctx = &entry->invocation_context;
   ctx->function = gum_sign_code_pointer (function_ctx->function_address);
@@ -2023,6 +3020,10 @@ gum_interceptor_resolve (GumInterceptor * self,
     const gsize max_redirect_size = 16;
     gpointer target;
 
+    /* Import slots reference the function itself, not where it jumps to. */
+    if (self->mode == GUM_INTERCEPTOR_MODE_IMPORTS)
+      return address;
+
     gum_ensure_code_readable (address, max_redirect_size);
 
     /* Avoid following grafted branches. */
@@ -9,6 +9,7 @@
 #ifndef __GUM_INTERCEPTOR_H__
 #define __GUM_INTERCEPTOR_H__
 
+#include <gum/gumcodeallocator.h>
 #include <gum/gumdefs.h>
 #include <gum/guminvocationlistener.h>
 
@@ -22,6 +23,7 @@ G_DECLARE_FINAL_TYPE (GumInterceptor, gum_interceptor, GUM, INTERCEPTOR,
 
 typedef GArray GumInvocationStack;
 typedef guint GumInvocationState;
+typedef struct _GumArgumentPredicate GumArgumentPredicate;
 typedef void (* GumInterceptorLockedFunc) (gpointer user_data);
 
 typedef enum
@@ -32,11 +34,12 @@ typedef enum
 
 typedef enum
 {
-  GUM_ATTACH_OK               =  0,
-  GUM_ATTACH_WRONG_SIGNATURE  = -1,
-  GUM_ATTACH_ALREADY_ATTACHED = -2,
-  GUM_ATTACH_POLICY_VIOLATION = -3,
-  GUM_ATTACH_WRONG_TYPE       = -4,
+  GUM_ATTACH_OK                =  0,
+  GUM_ATTACH_WRONG_SIGNATURE   = -1,
+  GUM_ATTACH_ALREADY_ATTACHED  = -2,
+  GUM_ATTACH_POLICY_VIOLATION  = -3,
+  GUM_ATTACH_WRONG_TYPE        = -4,
+  GUM_ATTACH_TOO_MANY_FILTERED = -5,
 } GumAttachReturn;
 
 typedef enum
@@ -48,11 +51,68 @@ typedef enum
   GUM_REPLACE_WRONG_TYPE       = -4,
 } GumReplaceReturn;
 
+typedef enum
+{
+  GUM_INTERCEPTOR_MODE_INLINE,
+  GUM_INTERCEPTOR_MODE_IMPORTS,
+} GumInterceptorMode;
+
+typedef enum
+{
+  GUM_ARGUMENT_PREDICATE_EQUAL,
+  GUM_ARGUMENT_PREDICATE_RANGE,
+  GUM_ARGUMENT_PREDICATE_PREFIX,
+} GumArgumentPredicateType;
+
+struct _GumArgumentPredicate
+{
+  GumArgumentPredicateType type;
+  guint index;
+
+  union
+  {
+    /* (argument & mask) == value */
+    struct
+    {
+      gsize value;
+      gsize mask;
+    };
+
+    /* min <= argument <= max */
+    struct
+    {
+      gsize min;
+      gsize max;
+    };
+
+    /*
+     * argument points to readable memory that starts with the prefix_size
+     * bytes at prefix; NULL or otherwise unreadable arguments never match
+     */
+    struct
+    {
+      gconstpointer prefix;
+      gsize prefix_size;
+    };
+  };
+};
+
 GUM_API GumInterceptor * gum_interceptor_obtain (void);
 
+GUM_API void gum_interceptor_set_mode (GumInterceptor * self,
+    GumInterceptorMode mode);
+GUM_API GumInterceptorMode gum_interceptor_get_mode (GumInterceptor * self);
+GUM_API void gum_interceptor_set_import_scope (GumInterceptor * self,
+    const gchar * const * module_names);
+
 GUM_API GumAttachReturn gum_interceptor_attach (GumInterceptor * self,
     gpointer function_address, GumInvocationListener * listener,
     gpointer listener_function_data, GumAttachFlags flags);
+GUM_API GumAttachReturn gum_interceptor_attach_filtered (
+    GumInterceptor * self, gpointer function_address,
+    GumInvocationListener * listener, gpointer listener_function_data,
+    GumAttachFlags flags, const GumArgumentPredicate * predicates,
+    guint n_predicates);
 GUM_API void gum_interceptor_detach (GumInterceptor * self,
     GumInvocationListener * listener);
 
@@ -69,6 +129,9 @@ GUM_API void gum_interceptor_begin_transaction (GumInterceptor * self);
 GUM_API void gum_interceptor_end_transaction (GumInterceptor * self);
 GUM_API gboolean gum_interceptor_flush (GumInterceptor * self);
 
+GUM_API void gum_interceptor_query_code_stats (GumInterceptor * self,
+    GumCodeAllocatorStats * stats);
+
 GUM_API GumInvocationContext * gum_interceptor_get_current_invocation (void);
 GUM_API GumInvocationContext * gum_interceptor_get_live_replacement_invocation (
     gpointer replacement_function);
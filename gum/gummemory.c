@@ -9,8 +9,12 @@
 
 #include "gumcloak-priv.h"
 #include "gumcodesegment.h"
+#include "gumexceptor.h"
 #include "gumlibc.h"
 #include "gummemory-priv.h"
+#include "gumprocess.h"
+#include "gumspinlock.h"
+#include "gumworkerpool.h"
 
 #ifdef HAVE_PTRAUTH
 # include <ptrauth.h>
@@ -49,6 +53,50 @@
 # endif
 #endif
 
+#if defined (HAVE_I386) && GLIB_SIZEOF_VOID_P == 8
+# define GUM_HAVE_SSE2_PROBE 1
+# include <emmintrin.h>
+# if defined (__GNUC__) || defined (_MSC_VER)
+#  define GUM_HAVE_AVX2_PROBE 1
+#  include <immintrin.h>
+#  ifdef __GNUC__
+#   define GUM_AVX2_FUNCTION __attribute__ ((target ("avx2")))
+#  else
+#   define GUM_AVX2_FUNCTION
+#  endif
+# endif
+#elif defined (HAVE_ARM64)
+# define GUM_HAVE_NEON_PROBE 1
+# include <arm_neon.h>
+#endif
+
+#if ((defined (HAVE_LINUX) && !defined (HAVE_ANDROID)) || \
+    defined (HAVE_FREEBSD)) && defined (__GNUC__)
+# define GUM_HEAP_CACHE_USE_STATIC_TLS 1
+#endif
+
+#define GUM_HEAP_CACHE_COUNT 64
+#define GUM_HEAP_CACHE_N_CLASSES 16
+#define GUM_HEAP_CACHE_MAX_REQUEST_SIZE 512
+#define GUM_HEAP_CACHE_MIN_BLOCK_SIZE 16
+#define GUM_HEAP_CACHE_MAX_BLOCK_SIZE (512 + 63)
+#define GUM_HEAP_CACHE_MAX_BLOCKS 64
+#define GUM_HEAP_CACHE_FLUSH_BLOCKS 32
+
+#define GUM_PARALLEL_SCAN_MIN_CHUNKS 4
+#define GUM_PARALLEL_SCAN_MIN_CHUNK_SIZE (1024 * 1024)
+#define GUM_PARALLEL_SCAN_MAX_CHUNK_SIZE (16 * 1024 * 1024)
+#define GUM_PARALLEL_SCAN_CHUNKS_PER_WORKER 4
+#define GUM_PARALLEL_SCAN_MAX_BUFFERED_MATCHES 4096
+
+typedef struct _GumHeapCache GumHeapCache;
+typedef struct _GumParallelScan GumParallelScan;
+typedef struct _GumParallelScanChunk GumParallelScanChunk;
+typedef struct _GumMatchProbe GumMatchProbe;
+typedef struct _GumMultiScanner GumMultiScanner;
+typedef struct _GumMultiScanEntry GumMultiScanEntry;
+typedef struct _GumMultiScanRegexContext GumMultiScanRegexContext;
+
 struct _GumMatchPattern
 {
   gint ref_count;
@@ -57,9 +105,143 @@ struct _GumMatchPattern
   GRegex * regex;
 };
 
+struct _GumHeapCache
+{
+  GumSpinlock lock;
+  gsize cached_bytes;
+  gpointer blocks[GUM_HEAP_CACHE_N_CLASSES];
+  guint n_blocks[GUM_HEAP_CACHE_N_CLASSES];
+};
+
+struct _GumParallelScan
+{
+  const GumMatchPattern * pattern;
+  GumExceptor * exceptor;
+
+  GumMemoryScanMatchFunc func;
+  gpointer user_data;
+  GumAddress last_end;
+  gboolean stopped;
+  volatile gint cancelled;
+
+  GMutex mutex;
+  GCond cond;
+};
+
+struct _GumParallelScanChunk
+{
+  GumMemoryRange range;
+  GArray * matches;
+  gboolean faulted;
+  gboolean truncated;
+  gboolean done;
+
+  GumParallelScan * scan;
+};
+
+struct _GumMatchProbe
+{
+  guint offset[2];
+  guint8 value[2];
+  guint8 mask[2];
+};
+
+typedef const guint8 * (* GumMatchProbeFindFunc) (const GumMatchProbe * probe,
+    const guint8 * cur, const guint8 * end);
+
+struct _GumMultiScanEntry
+{
+  guint pattern_index;
+  const GumMatchPattern * pattern;
+
+  guint16 key;
+  const guint8 * anchor;
+  guint anchor_size;
+  guint anchor_offset;
+
+  GumAddress next_start;
+};
+
+struct _GumMultiScanner
+{
+  GArray * pair_entries;
+  guint8 pair_filter[G_MAXUINT16 / 8 + 1];
+
+  GArray * byte_entries;
+  guint8 byte_filter[256];
+
+  GArray * unanchored_entries;
+};
+
+struct _GumMultiScanRegexContext
+{
+  guint pattern_index;
+  GumMemoryScanMultiMatchFunc func;
+  gpointer user_data;
+  gboolean carry_on;
+};
+
+#ifndef GUM_USE_SYSTEM_ALLOC
+static gpointer gum_heap_cache_malloc (mspace msp, GumHeapCache * caches,
+    gsize size);
+static gpointer gum_heap_cache_calloc (mspace msp, GumHeapCache * caches,
+    gsize count, gsize size);
+static void gum_heap_cache_free (mspace msp, GumHeapCache * caches,
+    gpointer mem);
+static gsize gum_heap_cache_query_cached_bytes (GumHeapCache * caches);
+static void gum_heap_cache_reset (GumHeapCache * caches);
+static GumHeapCache * gum_heap_cache_get_for_current_thread (
+    GumHeapCache * caches);
+static guint gum_heap_cache_class_for_request (gsize size);
+static gint gum_heap_cache_class_for_block (gsize usable_size);
+#endif
+
 static void gum_memory_scan_raw (const GumMemoryRange * range,
     const GumMatchPattern * pattern, GumMemoryScanMatchFunc func,
     gpointer user_data);
+static void gum_parallel_scan_chunk_run (GumParallelScanChunk * chunk,
+    GumParallelScan * scan);
+static gboolean gum_parallel_scan_chunk_collect_match (GumAddress address,
+    gsize size, GumParallelScanChunk * chunk);
+static void gum_parallel_scan_merge_chunk (GumParallelScan * self,
+    const GumParallelScanChunk * chunk);
+static gboolean gum_parallel_scan_emit_match (GumAddress address, gsize size,
+    GumParallelScan * self);
+static void gum_match_probe_init (GumMatchProbe * probe,
+    const GumMatchToken * needle);
+static gint gum_match_probe_score_byte (guint8 value, guint8 mask);
+static GumMatchProbeFindFunc gum_match_probe_select_find_func (void);
+static const guint8 * gum_match_probe_find_scalar (const GumMatchProbe * probe,
+    const guint8 * cur, const guint8 * end);
+#ifdef GUM_HAVE_SSE2_PROBE
+static const guint8 * gum_match_probe_find_sse2 (const GumMatchProbe * probe,
+    const guint8 * cur, const guint8 * end);
+#endif
+#ifdef GUM_HAVE_AVX2_PROBE
+static const guint8 * gum_match_probe_find_avx2 (const GumMatchProbe * probe,
+    const guint8 * cur, const guint8 * end);
+#endif
+#ifdef GUM_HAVE_NEON_PROBE
+static const guint8 * gum_match_probe_find_neon (const GumMatchProbe * probe,
+    const guint8 * cur, const guint8 * end);
+#endif
+static void gum_multi_scanner_init (GumMultiScanner * self,
+    GumMatchPattern * const * patterns, guint n_patterns);
+static void gum_multi_scanner_destroy (GumMultiScanner * self);
+static gint gum_multi_scan_entry_compare (const GumMultiScanEntry * a,
+    const GumMultiScanEntry * b);
+static gboolean gum_multi_scanner_scan (GumMultiScanner * self,
+    const GumMemoryRange * range, GumMemoryScanMultiMatchFunc func,
+    gpointer user_data);
+static gboolean gum_multi_scanner_try_entries (GArray * entries, guint16 key,
+    const guint8 * cur, GumAddress base_address, GumAddress end_address,
+    GumMemoryScanMultiMatchFunc func, gpointer user_data);
+static gboolean gum_multi_scan_entry_try_match (GumMultiScanEntry * entry,
+    const guint8 * cur, GumAddress base_address, GumAddress end_address,
+    GumMemoryScanMultiMatchFunc func, gpointer user_data,
+    gboolean * carry_on);
+static gboolean gum_multi_scan_emit_regex_match (GumAddress address,
+    gsize size, GumMultiScanRegexContext * ctx);
 static void gum_memory_scan_regex (const GumMemoryRange * range,
     const GRegex * regex, GumMemoryScanMatchFunc func, gpointer user_data);
 static GumMatchPattern * gum_match_pattern_new_from_hexstring (
@@ -68,6 +250,8 @@ static GumMatchPattern * gum_match_pattern_new_from_regex (
     const gchar * regex_str);
 static GumMatchPattern * gum_match_pattern_new (void);
 static void gum_match_pattern_update_computed_size (GumMatchPattern * self);
+static gboolean gum_match_pattern_find_anchor (const GumMatchPattern * self,
+    const guint8 ** anchor, guint * anchor_size, guint * anchor_offset);
 static GumMatchToken * gum_match_pattern_get_longest_token (
     const GumMatchPattern * self, GumMatchType type);
 static gboolean gum_match_pattern_try_match_on (const GumMatchPattern * self,
@@ -88,6 +272,19 @@ static guint gum_heap_ref_count = 0;
 #ifndef GUM_USE_SYSTEM_ALLOC
 static mspace gum_mspace_main = NULL;
 static mspace gum_mspace_internal = NULL;
+static GumHeapCache gum_heap_caches_main[GUM_HEAP_CACHE_COUNT];
+static GumHeapCache gum_heap_caches_internal[GUM_HEAP_CACHE_COUNT];
+static const guint16 gum_heap_cache_class_sizes[GUM_HEAP_CACHE_N_CLASSES] =
+{
+  16, 32, 48, 64, 80, 96, 112, 128,
+  160, 192, 224, 256,
+  320, 384, 448, 512,
+};
+# ifdef GUM_HEAP_CACHE_USE_STATIC_TLS
+static gint gum_heap_cache_next_slot = 0;
+static __thread guint gum_heap_cache_slot
+    __attribute__ ((tls_model ("initial-exec")));
+# endif
 #endif
 static guint gum_cached_page_size;
 
@@ -127,6 +324,9 @@ gum_internal_heap_unref (void)
     return;
 
 #ifndef GUM_USE_SYSTEM_ALLOC
+  gum_heap_cache_reset (gum_heap_caches_internal);
+  gum_heap_cache_reset (gum_heap_caches_main);
+
   destroy_mspace (gum_mspace_internal);
   gum_mspace_internal = NULL;
 
@@ -215,6 +415,47 @@ gum_query_rwx_support (void)
 #endif
 }
 
+/**
+ * gum_memory_read_many:
+ * @ranges: (array length=n_ranges): the ranges to read
+ * @n_ranges: number of elements in @ranges
+ * @buffer: where to store the data, large enough to hold the sum of all sizes
+ *   in @ranges, laid out back to back in the same order
+ * @n_bytes_read: (array length=n_ranges): where to store the number of bytes
+ *   successfully read from each range
+ *
+ * Reads several ranges at once, tolerating any of them being inaccessible.
+ * Each range gets a slot in @buffer of its full size, regardless of how much
+ * of it could be read. On Linux this is done with one system call per batch
+ * of ranges.
+ */
+#ifndef HAVE_LINUX
+void
+gum_memory_read_many (const GumMemoryRange * ranges,
+                      guint n_ranges,
+                      guint8 * buffer,
+                      gsize * n_bytes_read)
+{
+  guint i;
+
+  for (i = 0; i != n_ranges; i++)
+  {
+    const GumMemoryRange * r = &ranges[i];
+    guint8 * data;
+
+    data = gum_memory_read (GSIZE_TO_POINTER (r->base_address), r->size,
+        &n_bytes_read[i]);
+    if (data != NULL)
+      memcpy (buffer, data, n_bytes_read[i]);
+    else
+      n_bytes_read[i] = 0;
+    g_free (data);
+
+    buffer += r->size;
+  }
+}
+#endif
+
 /**
  * gum_memory_patch_code:
  * @address: address to modify from
@@ -355,6 +596,265 @@ gum_memory_scan (const GumMemoryRange * range,
     gum_memory_scan_regex (range, pattern->regex, func, user_data);
 }
 
+/**
+ * gum_memory_scan_parallel:
+ * @range: the #GumMemoryRange to scan
+ * @pattern: the #GumMatchPattern to look for occurrences of
+ * @n_workers: how many chunks to keep being scanned concurrently, or 0 to
+ *   use one per processor
+ * @func: (scope call): function to process each match
+ * @user_data: data to pass to @func
+ *
+ * Like gum_memory_scan(), but splits @range into page-aligned chunks that are
+ * scanned concurrently on Gum's shared worker threads. Matches are still
+ * delivered to @func on the calling thread, in address order, and with the
+ * same results as gum_memory_scan(). Each chunk is handed over as soon as it
+ * and the ones before it are done, and only a few chunks are scanned ahead,
+ * so memory use stays bounded. Returning %FALSE from @func stops the workers
+ * too. Small ranges and regex patterns are scanned on the calling thread.
+ */
+void
+gum_memory_scan_parallel (const GumMemoryRange * range,
+                          const GumMatchPattern * pattern,
+                          guint n_workers,
+                          GumMemoryScanMatchFunc func,
+                          gpointer user_data)
+{
+  GumParallelScan scan;
+  GumParallelScanChunk * window;
+  GumWorkerGroup * group;
+  GumAddress range_end;
+  gsize page_size, chunk_size, overlap;
+  guint n_chunks, window_size, n_pushed, i;
+  gboolean merge_faulted;
+  GumMemoryRange rest;
+
+  if (n_workers == 0)
+    n_workers = _gum_worker_pool_get_max_workers ();
+
+  if (pattern->regex != NULL || n_workers < 2 ||
+      range->size < GUM_PARALLEL_SCAN_MIN_CHUNKS *
+      GUM_PARALLEL_SCAN_MIN_CHUNK_SIZE)
+  {
+    gum_memory_scan (range, pattern, func, user_data);
+    return;
+  }
+
+  page_size = gum_query_page_size ();
+  chunk_size = GUM_ALIGN_SIZE (
+      range->size / (n_workers * GUM_PARALLEL_SCAN_CHUNKS_PER_WORKER),
+      page_size);
+  chunk_size = CLAMP (chunk_size, GUM_PARALLEL_SCAN_MIN_CHUNK_SIZE,
+      GUM_PARALLEL_SCAN_MAX_CHUNK_SIZE);
+  overlap = pattern->size - 1;
+
+  range_end = range->base_address + range->size;
+  n_chunks = (range->size + chunk_size - 1) / chunk_size;
+
+  scan.pattern = pattern;
+  scan.exceptor = gum_exceptor_obtain ();
+  scan.func = func;
+  scan.user_data = user_data;
+  scan.last_end = range->base_address;
+  scan.stopped = FALSE;
+  scan.cancelled = FALSE;
+  g_mutex_init (&scan.mutex);
+  g_cond_init (&scan.cond);
+
+  window_size = MIN (2 * n_workers, n_chunks);
+  window = g_new (GumParallelScanChunk, window_size);
+  for (i = 0; i != window_size; i++)
+  {
+    window[i].matches = g_array_new (FALSE, FALSE, sizeof (GumMemoryRange));
+    window[i].done = TRUE;
+    window[i].scan = &scan;
+  }
+
+  group = _gum_worker_group_new ((GFunc) gum_parallel_scan_chunk_run, &scan);
+
+  n_pushed = 0;
+  merge_faulted = FALSE;
+  for (i = 0; i != n_chunks && !scan.stopped; i++)
+  {
+    GumParallelScanChunk * chunk;
+    GumExceptorScope scope;
+
+    while (n_pushed != n_chunks && n_pushed - i != window_size)
+    {
+      GumAddress start, end;
+
+      chunk = &window[n_pushed % window_size];
+
+      start = range->base_address + (n_pushed * chunk_size);
+      end = MIN (start + chunk_size + overlap, range_end);
+
+      chunk->range.base_address = start;
+      chunk->range.size = end - start;
+      g_array_set_size (chunk->matches, 0);
+      chunk->faulted = FALSE;
+      chunk->truncated = FALSE;
+      chunk->done = FALSE;
+
+      _gum_worker_group_push (group, chunk);
+      n_pushed++;
+    }
+
+    chunk = &window[i % window_size];
+
+    g_mutex_lock (&scan.mutex);
+    while (!chunk->done)
+      g_cond_wait (&scan.cond, &scan.mutex);
+    g_mutex_unlock (&scan.mutex);
+
+    if (gum_exceptor_try (scan.exceptor, &scope))
+      gum_parallel_scan_merge_chunk (&scan, chunk);
+
+    if (gum_exceptor_catch (scan.exceptor, &scope))
+    {
+      merge_faulted = TRUE;
+      break;
+    }
+  }
+
+  g_atomic_int_set (&scan.cancelled, TRUE);
+  _gum_worker_group_free (group);
+
+  for (i = 0; i != window_size; i++)
+    g_array_free (window[i].matches, TRUE);
+  g_free (window);
+
+  g_cond_clear (&scan.cond);
+  g_mutex_clear (&scan.mutex);
+
+  g_object_unref (scan.exceptor);
+
+  /*
+   * The workers may still be using our stack when the calling thread faults,
+   * so we catch it above and only let it propagate once they are gone, by
+   * carrying on sequentially from where we were.
+   */
+  if (merge_faulted)
+  {
+    rest.base_address = scan.last_end;
+    rest.size = range_end - rest.base_address;
+
+    gum_memory_scan (&rest, pattern, func, user_data);
+  }
+}
+
+static void
+gum_parallel_scan_chunk_run (GumParallelScanChunk * chunk,
+                             GumParallelScan * scan)
+{
+  GumExceptorScope scope;
+
+  if (!g_atomic_int_get (&scan->cancelled))
+  {
+    if (gum_exceptor_try (scan->exceptor, &scope))
+    {
+      gum_memory_scan (&chunk->range, scan->pattern,
+          (GumMemoryScanMatchFunc) gum_parallel_scan_chunk_collect_match,
+          chunk);
+    }
+
+    if (gum_exceptor_catch (scan->exceptor, &scope))
+      chunk->faulted = TRUE;
+  }
+
+  g_mutex_lock (&scan->mutex);
+  chunk->done = TRUE;
+  g_cond_broadcast (&scan->cond);
+  g_mutex_unlock (&scan->mutex);
+}
+
+static gboolean
+gum_parallel_scan_chunk_collect_match (GumAddress address,
+                                       gsize size,
+                                       GumParallelScanChunk * chunk)
+{
+  GumMemoryRange match;
+
+  if (g_atomic_int_get (&chunk->scan->cancelled))
+    return FALSE;
+
+  if (chunk->matches->len == GUM_PARALLEL_SCAN_MAX_BUFFERED_MATCHES)
+  {
+    chunk->truncated = TRUE;
+    return FALSE;
+  }
+
+  match.base_address = address;
+  match.size = size;
+  g_array_append_val (chunk->matches, match);
+
+  return TRUE;
+}
+
+/*
+ * A sequential scan resumes searching right after the previous match, so a
+ * chunk's results can only be used as-is if none of them begin inside the
+ * previous chunk's last match. Otherwise, and for chunks that faulted, the
+ * chunk is scanned again on the calling thread from where a sequential scan
+ * would have continued. This also means that any fault is raised on the
+ * calling thread, just like with gum_memory_scan(). The same goes for the
+ * remainder of a chunk whose worker gave up after buffering too many matches.
+ */
+static void
+gum_parallel_scan_merge_chunk (GumParallelScan * self,
+                               const GumParallelScanChunk * chunk)
+{
+  const GArray * matches = chunk->matches;
+  GumAddress chunk_end;
+  GumMemoryRange rest;
+  guint i;
+
+  if (!chunk->faulted && (matches->len == 0 ||
+      g_array_index (matches, GumMemoryRange, 0).base_address >=
+      self->last_end))
+  {
+    for (i = 0; i != matches->len; i++)
+    {
+      const GumMemoryRange * m = &g_array_index (matches, GumMemoryRange, i);
+
+      if (!gum_parallel_scan_emit_match (m->base_address, m->size, self))
+        return;
+    }
+
+    if (!chunk->truncated)
+      return;
+  }
+
+  chunk_end = chunk->range.base_address + chunk->range.size;
+
+  rest.base_address = MAX (chunk->range.base_address, self->last_end);
+  if (rest.base_address >= chunk_end)
+    return;
+  rest.size = chunk_end - rest.base_address;
+
+  gum_memory_scan (&rest, self->pattern,
+      (GumMemoryScanMatchFunc) gum_parallel_scan_emit_match, self);
+}
+
+static gboolean
+gum_parallel_scan_emit_match (GumAddress address,
+                              gsize size,
+                              GumParallelScan * self)
+{
+  gboolean proceed;
+
+  proceed = self->func (address, size, self->user_data);
+
+  self->last_end = address + size;
+
+  if (!proceed)
+  {
+    self->stopped = TRUE;
+    g_atomic_int_set (&self->cancelled, TRUE);
+  }
+
+  return proceed;
+}
+
 static void
 gum_memory_scan_raw (const GumMemoryRange * range,
                      const GumMatchPattern * pattern,
@@ -364,7 +864,9 @@ gum_memory_scan_raw (const GumMemoryRange * range,
   GumMatchToken * needle;
   guint8 * needle_data, * mask_data = NULL;
   guint needle_len, pattern_size;
-  guint8 * cur, * end_address;
+  GumMatchProbe probe;
+  GumMatchProbeFindFunc find;
+  const guint8 * cur, * end_address;
 
   needle = gum_match_pattern_get_longest_token (pattern, GUM_MATCH_EXACT);
   if (needle == NULL)
@@ -377,6 +879,9 @@ gum_memory_scan_raw (const GumMemoryRange * range,
   needle_len = needle->bytes->len;
   pattern_size = gum_match_pattern_get_size (pattern);
 
+  gum_match_probe_init (&probe, needle);
+  find = gum_match_probe_select_find_func ();
+
   cur = GSIZE_TO_POINTER (range->base_address);
   end_address = cur + range->size - (pattern_size - needle->offset) + 1;
 
@@ -384,25 +889,22 @@ gum_memory_scan_raw (const GumMemoryRange * range,
   {
     guint8 * start;
 
+    cur = find (&probe, cur, end_address);
+    if (cur == NULL)
+      return;
+
     if (mask_data == NULL)
     {
-      if (cur[0] != needle_data[0] ||
-          memcmp (cur, needle_data, needle_len) != 0)
-      {
+      if (memcmp (cur, needle_data, needle_len) != 0)
         continue;
-      }
     }
     else
     {
-      if ((cur[0] & mask_data[0]) != (needle_data[0] & mask_data[0]) ||
-          gum_memcmp_mask ((guint8 *) cur, (guint8 *) needle_data,
-              (guint8 *) mask_data, needle_len) != 0)
-      {
+      if (gum_memcmp_mask (cur, needle_data, mask_data, needle_len) != 0)
         continue;
-      }
     }
 
-    start = cur - needle->offset;
+    start = (guint8 *) cur - needle->offset;
 
     if (gum_match_pattern_try_match_on (pattern, start))
     {
@@ -414,6 +916,527 @@ gum_memory_scan_raw (const GumMemoryRange * range,
   }
 }
 
+/*
+ * Candidate positions are located by probing two bytes of the needle at
+ * once, picking the ones least likely to occur in typical code and data so
+ * that few false positives reach the full comparison. Masked bytes are
+ * probed using their mask, which lets nibble wildcards take the same
+ * vectorized path as exact bytes.
+ */
+static void
+gum_match_probe_init (GumMatchProbe * probe,
+                      const GumMatchToken * needle)
+{
+  const guint8 * bytes, * masks;
+  guint len, i, slot;
+
+  bytes = (const guint8 *) needle->bytes->data;
+  masks = (needle->masks != NULL) ? (const guint8 *) needle->masks->data : NULL;
+  len = needle->bytes->len;
+
+  for (slot = 0; slot != G_N_ELEMENTS (probe->offset); slot++)
+  {
+    gint best_score = -1;
+    guint best_offset = 0;
+
+    for (i = 0; i != len; i++)
+    {
+      guint8 mask;
+      gint score;
+
+      if (slot == 1 && i == probe->offset[0] && len > 1)
+        continue;
+
+      mask = (masks != NULL) ? masks[i] : 0xff;
+      score = gum_match_probe_score_byte (bytes[i], mask);
+      if (score > best_score)
+      {
+        best_score = score;
+        best_offset = i;
+      }
+    }
+
+    probe->offset[slot] = best_offset;
+    probe->mask[slot] = (masks != NULL) ? masks[best_offset] : 0xff;
+    probe->value[slot] = bytes[best_offset] & probe->mask[slot];
+  }
+}
+
+static gint
+gum_match_probe_score_byte (guint8 value,
+                            guint8 mask)
+{
+  gint score;
+  guint8 remaining;
+
+  score = 0;
+  for (remaining = mask; remaining != 0; remaining &= remaining - 1)
+    score += 2;
+
+  if (mask != 0xff)
+    return score;
+
+  switch (value)
+  {
+    case 0x00:
+    case 0xff:
+      return 4;
+    case 0x01:
+    case 0x0f:
+    case 0x20:
+    case 0x24:
+    case 0x41:
+    case 0x48:
+    case 0x4c:
+    case 0x83:
+    case 0x89:
+    case 0x8b:
+    case 0x90:
+    case 0xcc:
+    case 0xe8:
+      return 10;
+    default:
+      return score;
+  }
+}
+
+static GumMatchProbeFindFunc
+gum_match_probe_select_find_func (void)
+{
+#if defined (GUM_HAVE_AVX2_PROBE)
+  if ((gum_query_cpu_features () & GUM_CPU_AVX2) != 0)
+    return gum_match_probe_find_avx2;
+  return gum_match_probe_find_sse2;
+#elif defined (GUM_HAVE_SSE2_PROBE)
+  return gum_match_probe_find_sse2;
+#elif defined (GUM_HAVE_NEON_PROBE)
+  return gum_match_probe_find_neon;
+#else
+  return gum_match_probe_find_scalar;
+#endif
+}
+
+static const guint8 *
+gum_match_probe_find_scalar (const GumMatchProbe * probe,
+                             const guint8 * cur,
+                             const guint8 * end)
+{
+  const guint o0 = probe->offset[0];
+  const guint o1 = probe->offset[1];
+  const guint8 v0 = probe->value[0];
+  const guint8 v1 = probe->value[1];
+  const guint8 m0 = probe->mask[0];
+  const guint8 m1 = probe->mask[1];
+
+  for (; cur < end; cur++)
+  {
+    if ((cur[o0] & m0) == v0 && (cur[o1] & m1) == v1)
+      return cur;
+  }
+
+  return NULL;
+}
+
+/*
+ * The vectorized variants test one block of consecutive candidate positions
+ * per iteration. A block is only processed when all of its positions are
+ * below @end, which guarantees that the loads stay inside the range being
+ * scanned, and the scalar variant takes care of the remainder.
+ */
+
+#ifdef GUM_HAVE_SSE2_PROBE
+
+static const guint8 *
+gum_match_probe_find_sse2 (const GumMatchProbe * probe,
+                           const guint8 * cur,
+                           const guint8 * end)
+{
+  const __m128i v0 = _mm_set1_epi8 ((char) probe->value[0]);
+  const __m128i v1 = _mm_set1_epi8 ((char) probe->value[1]);
+  const __m128i m0 = _mm_set1_epi8 ((char) probe->mask[0]);
+  const __m128i m1 = _mm_set1_epi8 ((char) probe->mask[1]);
+
+  for (; cur < end && end - cur >= 16; cur += 16)
+  {
+    __m128i a, b;
+    guint bits;
+
+    a = _mm_loadu_si128 ((const __m128i *) (cur + probe->offset[0]));
+    b = _mm_loadu_si128 ((const __m128i *) (cur + probe->offset[1]));
+
+    a = _mm_cmpeq_epi8 (_mm_and_si128 (a, m0), v0);
+    b = _mm_cmpeq_epi8 (_mm_and_si128 (b, m1), v1);
+
+    bits = _mm_movemask_epi8 (_mm_and_si128 (a, b));
+    if (bits != 0)
+      return cur + g_bit_nth_lsf (bits, -1);
+  }
+
+  return gum_match_probe_find_scalar (probe, cur, end);
+}
+
+#endif
+
+#ifdef GUM_HAVE_AVX2_PROBE
+
+GUM_AVX2_FUNCTION
+static const guint8 *
+gum_match_probe_find_avx2 (const GumMatchProbe * probe,
+                           const guint8 * cur,
+                           const guint8 * end)
+{
+  const __m256i v0 = _mm256_set1_epi8 ((char) probe->value[0]);
+  const __m256i v1 = _mm256_set1_epi8 ((char) probe->value[1]);
+  const __m256i m0 = _mm256_set1_epi8 ((char) probe->mask[0]);
+  const __m256i m1 = _mm256_set1_epi8 ((char) probe->mask[1]);
+
+  for (; cur < end && end - cur >= 32; cur += 32)
+  {
+    __m256i a, b;
+    guint bits;
+
+    a = _mm256_loadu_si256 ((const __m256i *) (cur + probe->offset[0]));
+    b = _mm256_loadu_si256 ((const __m256i *) (cur + probe->offset[1]));
+
+    a = _mm256_cmpeq_epi8 (_mm256_and_si256 (a, m0), v0);
+    b = _mm256_cmpeq_epi8 (_mm256_and_si256 (b, m1), v1);
+
+    bits = (guint) _mm256_movemask_epi8 (_mm256_and_si256 (a, b));
+    if (bits != 0)
+      return cur + g_bit_nth_lsf (bits, -1);
+  }
+
+  return gum_match_probe_find_sse2 (probe, cur, end);
+}
+
+#endif
+
+#ifdef GUM_HAVE_NEON_PROBE
+
+static const guint8 *
+gum_match_probe_find_neon (const GumMatchProbe * probe,
+                           const guint8 * cur,
+                           const guint8 * end)
+{
+  const uint8x16_t v0 = vdupq_n_u8 (probe->value[0]);
+  const uint8x16_t v1 = vdupq_n_u8 (probe->value[1]);
+  const uint8x16_t m0 = vdupq_n_u8 (probe->mask[0]);
+  const uint8x16_t m1 = vdupq_n_u8 (probe->mask[1]);
+
+  for (; cur < end && end - cur >= 16; cur += 16)
+  {
+    uint8x16_t a, b, hits;
+    guint8 lanes[16];
+    guint i;
+
+    a = vld1q_u8 (cur + probe->offset[0]);
+    b = vld1q_u8 (cur + probe->offset[1]);
+
+    hits = vandq_u8 (vceqq_u8 (vandq_u8 (a, m0), v0),
+        vceqq_u8 (vandq_u8 (b, m1), v1));
+    if (vmaxvq_u8 (hits) == 0)
+      continue;
+
+    vst1q_u8 (lanes, hits);
+    for (i = 0; lanes[i] == 0; i++)
+      ;
+
+    return cur + i;
+  }
+
+  return gum_match_probe_find_scalar (probe, cur, end);
+}
+
+#endif
+
+/**
+ * gum_memory_scan_multi:
+ * @range: the #GumMemoryRange to scan
+ * @patterns: (array length=n_patterns): the #GumMatchPattern objects to look
+ *   for occurrences of
+ * @n_patterns: number of elements in @patterns
+ * @func: (scope call): function to process each match
+ * @user_data: data to pass to @func
+ *
+ * Scans @range for occurrences of any of @patterns, calling @func with the
+ * index of the pattern and the location of each match. Unlike calling
+ * gum_memory_scan() once per pattern, the range is only walked once for all
+ * non-regex patterns. Matches are reported in the order in which they are
+ * discovered, which is not necessarily sorted by address across patterns.
+ */
+void
+gum_memory_scan_multi (const GumMemoryRange * range,
+                       GumMatchPattern * const * patterns,
+                       guint n_patterns,
+                       GumMemoryScanMultiMatchFunc func,
+                       gpointer user_data)
+{
+  GumMultiScanner scanner;
+  gboolean carry_on;
+  guint i;
+
+  gum_multi_scanner_init (&scanner, patterns, n_patterns);
+  carry_on = gum_multi_scanner_scan (&scanner, range, func, user_data);
+  gum_multi_scanner_destroy (&scanner);
+
+  for (i = 0; i != n_patterns && carry_on; i++)
+  {
+    const GumMatchPattern * pattern = patterns[i];
+    GumMultiScanRegexContext ctx;
+
+    if (pattern->regex == NULL)
+      continue;
+
+    ctx.pattern_index = i;
+    ctx.func = func;
+    ctx.user_data = user_data;
+    ctx.carry_on = TRUE;
+
+    gum_memory_scan_regex (range, pattern->regex,
+        (GumMemoryScanMatchFunc) gum_multi_scan_emit_regex_match, &ctx);
+
+    carry_on = ctx.carry_on;
+  }
+}
+
+/*
+ * Every pattern is reduced to an anchor: its longest run of fully specified
+ * bytes. Anchors of two or more bytes are bucketed by their first two bytes,
+ * with a 64 Kbit bitmap in front so that most positions are rejected by a
+ * single bit test. Single-byte anchors get a 256-entry filter of their own,
+ * and the rare pattern without any fully specified byte is tried everywhere.
+ * Candidates are then confirmed using the same matcher as gum_memory_scan().
+ */
+static void
+gum_multi_scanner_init (GumMultiScanner * self,
+                        GumMatchPattern * const * patterns,
+                        guint n_patterns)
+{
+  guint i;
+
+  self->pair_entries = g_array_new (FALSE, FALSE, sizeof (GumMultiScanEntry));
+  memset (self->pair_filter, 0, sizeof (self->pair_filter));
+
+  self->byte_entries = g_array_new (FALSE, FALSE, sizeof (GumMultiScanEntry));
+  memset (self->byte_filter, 0, sizeof (self->byte_filter));
+
+  self->unanchored_entries =
+      g_array_new (FALSE, FALSE, sizeof (GumMultiScanEntry));
+
+  for (i = 0; i != n_patterns; i++)
+  {
+    const GumMatchPattern * pattern = patterns[i];
+    GumMultiScanEntry entry;
+
+    if (pattern->regex != NULL)
+      continue;
+
+    entry.pattern_index = i;
+    entry.pattern = pattern;
+    entry.key = 0;
+    entry.next_start = 0;
+
+    if (!gum_match_pattern_find_anchor (pattern, &entry.anchor,
+        &entry.anchor_size, &entry.anchor_offset))
+    {
+      entry.anchor = NULL;
+      entry.anchor_size = 0;
+      entry.anchor_offset = 0;
+
+      g_array_append_val (self->unanchored_entries, entry);
+    }
+    else if (entry.anchor_size == 1)
+    {
+      entry.key = entry.anchor[0];
+      self->byte_filter[entry.key] = TRUE;
+
+      g_array_append_val (self->byte_entries, entry);
+    }
+    else
+    {
+      entry.key = entry.anchor[0] | (entry.anchor[1] << 8);
+      self->pair_filter[entry.key >> 3] |= 1 << (entry.key & 7);
+
+      g_array_append_val (self->pair_entries, entry);
+    }
+  }
+
+  g_array_sort (self->pair_entries,
+      (GCompareFunc) gum_multi_scan_entry_compare);
+  g_array_sort (self->byte_entries,
+      (GCompareFunc) gum_multi_scan_entry_compare);
+}
+
+static void
+gum_multi_scanner_destroy (GumMultiScanner * self)
+{
+  g_array_free (self->unanchored_entries, TRUE);
+  g_array_free (self->byte_entries, TRUE);
+  g_array_free (self->pair_entries, TRUE);
+}
+
+static gint
+gum_multi_scan_entry_compare (const GumMultiScanEntry * a,
+                              const GumMultiScanEntry * b)
+{
+  if (a->key != b->key)
+    return (a->key < b->key) ? -1 : 1;
+
+  return (gint) a->pattern_index - (gint) b->pattern_index;
+}
+
+static gboolean
+gum_multi_scanner_scan (GumMultiScanner * self,
+                        const GumMemoryRange * range,
+                        GumMemoryScanMultiMatchFunc func,
+                        gpointer user_data)
+{
+  const guint8 * base, * end, * cur;
+  GumAddress base_address, end_address;
+  gboolean have_pairs, have_bytes, have_unanchored;
+
+  have_pairs = self->pair_entries->len != 0;
+  have_bytes = self->byte_entries->len != 0;
+  have_unanchored = self->unanchored_entries->len != 0;
+  if (!have_pairs && !have_bytes && !have_unanchored)
+    return TRUE;
+
+  base = GSIZE_TO_POINTER (range->base_address);
+  end = base + range->size;
+  base_address = range->base_address;
+  end_address = range->base_address + range->size;
+
+  for (cur = base; cur != end; cur++)
+  {
+    if (have_pairs && cur + 1 != end)
+    {
+      guint16 key = cur[0] | (cur[1] << 8);
+
+      if ((self->pair_filter[key >> 3] & (1 << (key & 7))) != 0 &&
+          !gum_multi_scanner_try_entries (self->pair_entries, key, cur,
+              base_address, end_address, func, user_data))
+      {
+        return FALSE;
+      }
+    }
+
+    if (have_bytes && self->byte_filter[cur[0]] &&
+        !gum_multi_scanner_try_entries (self->byte_entries, cur[0], cur,
+            base_address, end_address, func, user_data))
+    {
+      return FALSE;
+    }
+
+    if (have_unanchored)
+    {
+      guint i;
+
+      for (i = 0; i != self->unanchored_entries->len; i++)
+      {
+        GumMultiScanEntry * entry = &g_array_index (self->unanchored_entries,
+            GumMultiScanEntry, i);
+        gboolean carry_on = TRUE;
+
+        gum_multi_scan_entry_try_match (entry, cur, base_address, end_address,
+            func, user_data, &carry_on);
+        if (!carry_on)
+          return FALSE;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gum_multi_scanner_try_entries (GArray * entries,
+                               guint16 key,
+                               const guint8 * cur,
+                               GumAddress base_address,
+                               GumAddress end_address,
+                               GumMemoryScanMultiMatchFunc func,
+                               gpointer user_data)
+{
+  GumMultiScanEntry * elements = (GumMultiScanEntry *) entries->data;
+  guint lo, hi, i;
+
+  lo = 0;
+  hi = entries->len;
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+
+    if (elements[mid].key < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  for (i = lo; i != entries->len && elements[i].key == key; i++)
+  {
+    gboolean carry_on = TRUE;
+
+    gum_multi_scan_entry_try_match (&elements[i], cur, base_address,
+        end_address, func, user_data, &carry_on);
+    if (!carry_on)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gum_multi_scan_entry_try_match (GumMultiScanEntry * entry,
+                                const guint8 * cur,
+                                GumAddress base_address,
+                                GumAddress end_address,
+                                GumMemoryScanMultiMatchFunc func,
+                                gpointer user_data,
+                                gboolean * carry_on)
+{
+  GumAddress start;
+  guint size;
+
+  if (GUM_ADDRESS (cur) - base_address < entry->anchor_offset)
+    return FALSE;
+  start = GUM_ADDRESS (cur) - entry->anchor_offset;
+
+  if (start < entry->next_start)
+    return FALSE;
+
+  size = entry->pattern->size;
+  if (end_address - start < size)
+    return FALSE;
+
+  if (entry->anchor_size > 2 &&
+      memcmp (cur + 2, entry->anchor + 2, entry->anchor_size - 2) != 0)
+  {
+    return FALSE;
+  }
+
+  if (!gum_match_pattern_try_match_on (entry->pattern,
+      GSIZE_TO_POINTER (start)))
+  {
+    return FALSE;
+  }
+
+  entry->next_start = start + size;
+
+  *carry_on = func (entry->pattern_index, start, size, user_data);
+
+  return TRUE;
+}
+
+static gboolean
+gum_multi_scan_emit_regex_match (GumAddress address,
+                                 gsize size,
+                                 GumMultiScanRegexContext * ctx)
+{
+  ctx->carry_on = ctx->func (ctx->pattern_index, address, size, ctx->user_data);
+
+  return ctx->carry_on;
+}
+
 static void
 gum_memory_scan_regex (const GumMemoryRange * range,
                        const GRegex * regex,
@@ -655,6 +1678,64 @@ gum_match_pattern_update_computed_size (GumMatchPattern * self)
   }
 }
 
+static gboolean
+gum_match_pattern_find_anchor (const GumMatchPattern * self,
+                               const guint8 ** anchor,
+                               guint * anchor_size,
+                               guint * anchor_offset)
+{
+  GumMatchToken * token;
+  guint i, best_size;
+
+  token = gum_match_pattern_get_longest_token (self, GUM_MATCH_EXACT);
+  if (token != NULL)
+  {
+    *anchor = (const guint8 *) token->bytes->data;
+    *anchor_size = token->bytes->len;
+    *anchor_offset = token->offset;
+    return TRUE;
+  }
+
+  best_size = 0;
+
+  for (i = 0; i != self->tokens->len; i++)
+  {
+    const guint8 * masks;
+    guint j, run_start, run_size;
+
+    token = (GumMatchToken *) g_ptr_array_index (self->tokens, i);
+    if (token->type != GUM_MATCH_MASK)
+      continue;
+
+    masks = (const guint8 *) token->masks->data;
+    run_start = 0;
+    run_size = 0;
+
+    for (j = 0; j != token->masks->len; j++)
+    {
+      if (masks[j] != 0xff)
+      {
+        run_size = 0;
+        continue;
+      }
+
+      if (run_size == 0)
+        run_start = j;
+      run_size++;
+
+      if (run_size > best_size)
+      {
+        best_size = run_size;
+        *anchor = (const guint8 *) token->bytes->data + run_start;
+        *anchor_size = run_size;
+        *anchor_offset = token->offset + run_start;
+      }
+    }
+  }
+
+  return best_size != 0;
+}
+
 static GumMatchToken *
 gum_match_pattern_get_longest_token (const GumMatchPattern * self,
                                      GumMatchType type)
@@ -889,9 +1970,12 @@ gum_peek_private_memory_usage (void)
 
   info = mspace_mallinfo (gum_mspace_main);
   total += (guint) info.uordblks;
+  total -= (guint) gum_heap_cache_query_cached_bytes (gum_heap_caches_main);
 
   info = mspace_mallinfo (gum_mspace_internal);
   total += (guint) info.uordblks;
+  total -= (guint) gum_heap_cache_query_cached_bytes (
+      gum_heap_caches_internal);
 
   return total;
 }
@@ -899,13 +1983,14 @@ gum_peek_private_memory_usage (void)
 gpointer
 gum_malloc (gsize size)
 {
-  return mspace_malloc (gum_mspace_main, size);
+  return gum_heap_cache_malloc (gum_mspace_main, gum_heap_caches_main, size);
 }
 
 gpointer
 gum_malloc0 (gsize size)
 {
-  return mspace_calloc (gum_mspace_main, 1, size);
+  return gum_heap_cache_calloc (gum_mspace_main, gum_heap_caches_main, 1,
+      size);
 }
 
 gsize
@@ -918,7 +2003,8 @@ gpointer
 gum_calloc (gsize count,
             gsize size)
 {
-  return mspace_calloc (gum_mspace_main, count, size);
+  return gum_heap_cache_calloc (gum_mspace_main, gum_heap_caches_main, count,
+      size);
 }
 
 gpointer
@@ -941,7 +2027,8 @@ gum_memdup (gconstpointer mem,
 {
   gpointer result;
 
-  result = mspace_malloc (gum_mspace_main, byte_size);
+  result = gum_heap_cache_malloc (gum_mspace_main, gum_heap_caches_main,
+      byte_size);
   memcpy (result, mem, byte_size);
 
   return result;
@@ -950,20 +2037,22 @@ gum_memdup (gconstpointer mem,
 void
 gum_free (gpointer mem)
 {
-  mspace_free (gum_mspace_main, mem);
+  gum_heap_cache_free (gum_mspace_main, gum_heap_caches_main, mem);
 }
 
 gpointer
 gum_internal_malloc (size_t size)
 {
-  return mspace_malloc (gum_mspace_internal, size);
+  return gum_heap_cache_malloc (gum_mspace_internal, gum_heap_caches_internal,
+      size);
 }
 
 gpointer
 gum_internal_calloc (size_t count,
                      size_t size)
 {
-  return mspace_calloc (gum_mspace_internal, count, size);
+  return gum_heap_cache_calloc (gum_mspace_internal, gum_heap_caches_internal,
+      count, size);
 }
 
 gpointer
@@ -976,7 +2065,202 @@ gum_internal_realloc (gpointer mem,
 void
 gum_internal_free (gpointer mem)
 {
-  mspace_free (gum_mspace_internal, mem);
+  gum_heap_cache_free (gum_mspace_internal, gum_heap_caches_internal, mem);
+}
+
+/*
+ * Small blocks are recycled through a fixed pool of caches sitting in front
+ * of each mspace, so that the common malloc()/free() pairs only contend on a
+ * per-cache spinlock instead of the mspace-wide lock. Threads are assigned a
+ * cache on first use; a pool rather than true per-thread caches means blocks
+ * are never stranded when a thread goes away, which matters since we cannot
+ * rely on TLS destructors this early. Overflowing free-lists are returned to
+ * the mspace in batches.
+ */
+
+static gpointer
+gum_heap_cache_malloc (mspace msp,
+                       GumHeapCache * caches,
+                       gsize size)
+{
+  guint klass;
+  GumHeapCache * cache;
+  gpointer block;
+
+  if (size > GUM_HEAP_CACHE_MAX_REQUEST_SIZE)
+    return mspace_malloc (msp, size);
+
+  klass = gum_heap_cache_class_for_request (size);
+  cache = gum_heap_cache_get_for_current_thread (caches);
+
+  gum_spinlock_acquire (&cache->lock);
+
+  block = cache->blocks[klass];
+  if (block != NULL)
+  {
+    cache->blocks[klass] = *((gpointer *) block);
+    cache->n_blocks[klass]--;
+    cache->cached_bytes -= mspace_usable_size (block);
+  }
+
+  gum_spinlock_release (&cache->lock);
+
+  if (block == NULL)
+    block = mspace_malloc (msp, gum_heap_cache_class_sizes[klass]);
+
+  return block;
+}
+
+static gpointer
+gum_heap_cache_calloc (mspace msp,
+                       GumHeapCache * caches,
+                       gsize count,
+                       gsize size)
+{
+  gsize total;
+  gpointer block;
+
+  if (count != 0 && size > G_MAXSIZE / count)
+    return NULL;
+  total = count * size;
+
+  if (total > GUM_HEAP_CACHE_MAX_REQUEST_SIZE)
+    return mspace_calloc (msp, 1, total);
+
+  block = gum_heap_cache_malloc (msp, caches, total);
+  if (block != NULL)
+    memset (block, 0, total);
+
+  return block;
+}
+
+static void
+gum_heap_cache_free (mspace msp,
+                     GumHeapCache * caches,
+                     gpointer mem)
+{
+  gsize usable_size;
+  gint klass;
+  GumHeapCache * cache;
+  gpointer flushed[GUM_HEAP_CACHE_FLUSH_BLOCKS];
+  guint n_flushed = 0;
+
+  if (mem == NULL)
+    return;
+
+  usable_size = mspace_usable_size (mem);
+  klass = gum_heap_cache_class_for_block (usable_size);
+  if (klass == -1)
+  {
+    mspace_free (msp, mem);
+    return;
+  }
+
+  cache = gum_heap_cache_get_for_current_thread (caches);
+
+  gum_spinlock_acquire (&cache->lock);
+
+  *((gpointer *) mem) = cache->blocks[klass];
+  cache->blocks[klass] = mem;
+  cache->n_blocks[klass]++;
+  cache->cached_bytes += usable_size;
+
+  if (cache->n_blocks[klass] > GUM_HEAP_CACHE_MAX_BLOCKS)
+  {
+    for (n_flushed = 0; n_flushed != GUM_HEAP_CACHE_FLUSH_BLOCKS; n_flushed++)
+    {
+      gpointer block = cache->blocks[klass];
+
+      cache->blocks[klass] = *((gpointer *) block);
+      cache->cached_bytes -= mspace_usable_size (block);
+
+      flushed[n_flushed] = block;
+    }
+    cache->n_blocks[klass] -= n_flushed;
+  }
+
+  gum_spinlock_release (&cache->lock);
+
+  if (n_flushed != 0)
+    mspace_bulk_free (msp, flushed, n_flushed);
+}
+
+static gsize
+gum_heap_cache_query_cached_bytes (GumHeapCache * caches)
+{
+  gsize total = 0;
+  guint i;
+
+  for (i = 0; i != GUM_HEAP_CACHE_COUNT; i++)
+  {
+    GumHeapCache * cache = &caches[i];
+
+    gum_spinlock_acquire (&cache->lock);
+    total += cache->cached_bytes;
+    gum_spinlock_release (&cache->lock);
+  }
+
+  return total;
+}
+
+static void
+gum_heap_cache_reset (GumHeapCache * caches)
+{
+  /* The mspace is about to be destroyed, taking the cached blocks with it. */
+  memset (caches, 0, GUM_HEAP_CACHE_COUNT * sizeof (GumHeapCache));
+}
+
+static GumHeapCache *
+gum_heap_cache_get_for_current_thread (GumHeapCache * caches)
+{
+#ifdef GUM_HEAP_CACHE_USE_STATIC_TLS
+  guint slot = gum_heap_cache_slot;
+
+  if (slot == 0)
+  {
+    slot = ((guint) g_atomic_int_add (&gum_heap_cache_next_slot, 1) %
+        GUM_HEAP_CACHE_COUNT) + 1;
+    gum_heap_cache_slot = slot;
+  }
+
+  return &caches[slot - 1];
+#else
+  guint64 id = (guint64) gum_process_get_current_thread_id ();
+
+  return &caches[((id * G_GUINT64_CONSTANT (0x9e3779b97f4a7c15)) >> 58) %
+      GUM_HEAP_CACHE_COUNT];
+#endif
+}
+
+static guint
+gum_heap_cache_class_for_request (gsize size)
+{
+  if (size <= 128)
+    return (size != 0) ? (guint) (size - 1) / 16 : 0;
+
+  if (size <= 256)
+    return 8 + (guint) (size - 129) / 32;
+
+  return 12 + (guint) (size - 257) / 64;
+}
+
+static gint
+gum_heap_cache_class_for_block (gsize usable_size)
+{
+  if (usable_size < GUM_HEAP_CACHE_MIN_BLOCK_SIZE ||
+      usable_size > GUM_HEAP_CACHE_MAX_BLOCK_SIZE)
+    return -1;
+
+  if (usable_size < 128)
+    return (gint) (usable_size / 16) - 1;
+
+  if (usable_size < 256)
+    return 7 + (gint) (usable_size - 128) / 32;
+
+  if (usable_size < 512)
+    return 11 + (gint) (usable_size - 256) / 64;
+
+  return GUM_HEAP_CACHE_N_CLASSES - 1;
 }
 
 #else
@@ -95,6 +95,8 @@ typedef gboolean (* GumFoundRangeFunc) (const GumRangeDetails * details,
 typedef void (* GumMemoryPatchApplyFunc) (gpointer mem, gpointer user_data);
 typedef gboolean (* GumMemoryScanMatchFunc) (GumAddress address, gsize size,
     gpointer user_data);
+typedef gboolean (* GumMemoryScanMultiMatchFunc) (guint pattern_index,
+    GumAddress address, gsize size, gpointer user_data);
 
 GUM_API void gum_internal_heap_ref (void);
 GUM_API void gum_internal_heap_unref (void);
@@ -112,6 +114,8 @@ GUM_API gboolean gum_memory_query_protection (gconstpointer address,
     GumPageProtection * prot);
 GUM_API guint8 * gum_memory_read (gconstpointer address, gsize len,
     gsize * n_bytes_read);
+GUM_API void gum_memory_read_many (const GumMemoryRange * ranges,
+    guint n_ranges, guint8 * buffer, gsize * n_bytes_read);
 GUM_API gboolean gum_memory_write (gpointer address, const guint8 * bytes,
     gsize len);
 GUM_API gboolean gum_memory_patch_code (gpointer address, gsize size,
@@ -121,6 +125,12 @@ GUM_API gboolean gum_memory_mark_code (gpointer address, gsize size);
 GUM_API void gum_memory_scan (const GumMemoryRange * range,
     const GumMatchPattern * pattern, GumMemoryScanMatchFunc func,
     gpointer user_data);
+GUM_API void gum_memory_scan_parallel (const GumMemoryRange * range,
+    const GumMatchPattern * pattern, guint n_workers,
+    GumMemoryScanMatchFunc func, gpointer user_data);
+GUM_API void gum_memory_scan_multi (const GumMemoryRange * range,
+    GumMatchPattern * const * patterns, guint n_patterns,
+    GumMemoryScanMultiMatchFunc func, gpointer user_data);
 
 GUM_API GType gum_match_pattern_get_type (void) G_GNUC_CONST;
 GUM_API GumMatchPattern * gum_match_pattern_new_from_string (
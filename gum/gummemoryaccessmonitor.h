@@ -41,6 +41,9 @@ GUM_API GumMemoryAccessMonitor * gum_memory_access_monitor_new (
     GumMemoryAccessNotify func, gpointer data,
     GDestroyNotify data_destroy);
 
+GUM_API void gum_memory_access_monitor_set_async_delivery (
+    GumMemoryAccessMonitor * self, gboolean enabled);
+
 GUM_API gboolean gum_memory_access_monitor_enable (
     GumMemoryAccessMonitor * self, GError ** error);
 GUM_API void gum_memory_access_monitor_disable (GumMemoryAccessMonitor * self);
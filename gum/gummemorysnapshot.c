@@ -0,0 +1,770 @@
+/*
+ * Copyright (C) 2025 Ole André Vadla Ravnås <oleavr@nowsecure.com>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "gummemorysnapshot.h"
+
+#ifdef HAVE_LINUX
+# include "backend-linux/gumlinux-priv.h"
+#endif
+
+#include <string.h>
+
+#if defined (HAVE_I386) && GLIB_SIZEOF_VOID_P == 8
+# define GUM_HAVE_SSE2_DIFF 1
+# include <emmintrin.h>
+#elif defined (HAVE_ARM64)
+# define GUM_HAVE_NEON_DIFF 1
+# include <arm_neon.h>
+#endif
+
+#define GUM_SNAPSHOT_BATCH_SIZE 256
+
+typedef struct _GumSnapshotPage GumSnapshotPage;
+typedef struct _GumSnapshotReader GumSnapshotReader;
+typedef struct _GumChangeCollector GumChangeCollector;
+
+struct _GumMemorySnapshot
+{
+  gint ref_count;
+
+  GumMemoryRange * ranges;
+  guint n_ranges;
+  guint * first_page;
+  gsize size;
+
+  gsize page_size;
+  GumSnapshotPage ** pages;
+  guint n_pages;
+  GumSnapshotPage * zero_page;
+  guint n_unique_pages;
+
+#ifdef HAVE_LINUX
+  GumLinuxWriteTracker * write_tracker;
+  guint write_generation;
+#endif
+};
+
+struct _GumSnapshotPage
+{
+  gint ref_count;
+  guint8 * data;
+};
+
+struct _GumSnapshotReader
+{
+  gsize page_size;
+  GumMemoryRange ranges[GUM_SNAPSHOT_BATCH_SIZE];
+  guint page_indices[GUM_SNAPSHOT_BATCH_SIZE];
+  gsize n_bytes_read[GUM_SNAPSHOT_BATCH_SIZE];
+  guint n;
+  guint8 * buffer;
+};
+
+struct _GumChangeCollector
+{
+  GArray * changes;
+  gboolean has_pending;
+  GumMemoryChange pending;
+};
+
+static void gum_memory_snapshot_capture_pages (GumMemorySnapshot * self,
+    GumMemorySnapshot * previous, const guint8 * dirty);
+static void gum_memory_snapshot_store_batch (GumMemorySnapshot * self,
+    GumMemorySnapshot * previous, GumSnapshotReader * reader);
+static gboolean gum_memory_snapshot_has_same_layout (GumMemorySnapshot * self,
+    GumMemorySnapshot * other);
+static void gum_memory_snapshot_get_page_window (GumMemorySnapshot * self,
+    guint range_index, guint page_index, gsize * start, gsize * end);
+#ifdef HAVE_LINUX
+static guint8 * gum_memory_snapshot_collect_written_pages (
+    GumMemorySnapshot * self, GumMemorySnapshot * previous);
+#endif
+
+static void gum_snapshot_reader_init (GumSnapshotReader * reader,
+    gsize page_size);
+static void gum_snapshot_reader_destroy (GumSnapshotReader * reader);
+static void gum_snapshot_reader_add (GumSnapshotReader * reader,
+    GumAddress address, guint page_index);
+static void gum_snapshot_reader_flush (GumSnapshotReader * reader);
+
+static GumSnapshotPage * gum_snapshot_page_new (gsize page_size);
+static GumSnapshotPage * gum_snapshot_page_ref (GumSnapshotPage * page);
+static void gum_snapshot_page_unref (GumSnapshotPage * page);
+
+static void gum_change_collector_init (GumChangeCollector * collector);
+static void gum_change_collector_add (GumChangeCollector * collector,
+    gsize offset, gsize size);
+static void gum_change_collector_flush (GumChangeCollector * collector);
+static void gum_collect_changes (const guint8 * a, const guint8 * b,
+    gsize start, gsize end, gsize base_offset,
+    GumChangeCollector * collector);
+static gsize gum_count_equal_bytes (const guint8 * a, const guint8 * b,
+    gsize size);
+static gsize gum_count_unequal_bytes (const guint8 * a, const guint8 * b,
+    gsize size);
+static gboolean gum_is_all_zeros (const guint8 * data, gsize size);
+
+G_DEFINE_BOXED_TYPE (GumMemorySnapshot, gum_memory_snapshot,
+                     gum_memory_snapshot_ref, gum_memory_snapshot_unref)
+
+/**
+ * gum_memory_snapshot_take:
+ * @ranges: (array length=n_ranges): the ranges to capture
+ * @n_ranges: number of elements in @ranges
+ * @previous: (nullable): an earlier snapshot of the same ranges
+ * @flags: flags controlling dirty page tracking
+ *
+ * Copies the contents of @ranges into a new snapshot. Pages are stored
+ * individually, and any page whose contents are unchanged since @previous is
+ * shared with it instead of being copied. Pages filled with zeros are shared
+ * as well. Inaccessible pages are recorded as such.
+ *
+ * When %GUM_MEMORY_SNAPSHOT_TRACK_DIRTY is passed on Linux >= 6.7, writes to
+ * @ranges are tracked from then on using userfaultfd's asynchronous
+ * write-protection, so that a later snapshot passing this one as @previous
+ * only needs to read the pages written to in the meantime. Pages are reported
+ * and re-protected in one atomic step, so no write goes unnoticed. Where this
+ * is not available, or @ranges are already registered with a userfaultfd,
+ * every page is read and compared against @previous instead.
+ *
+ * Returns: (transfer full): the snapshot
+ */
+GumMemorySnapshot *
+gum_memory_snapshot_take (const GumMemoryRange * ranges,
+                          guint n_ranges,
+                          GumMemorySnapshot * previous,
+                          GumMemorySnapshotFlags flags)
+{
+  GumMemorySnapshot * snapshot;
+  guint8 * dirty = NULL;
+  guint i;
+
+  snapshot = g_slice_new0 (GumMemorySnapshot);
+  snapshot->ref_count = 1;
+
+  snapshot->ranges = g_memdup2 (ranges, n_ranges * sizeof (GumMemoryRange));
+  snapshot->n_ranges = n_ranges;
+  snapshot->first_page = g_new (guint, n_ranges);
+  snapshot->page_size = gum_query_page_size ();
+
+  for (i = 0; i != n_ranges; i++)
+  {
+    const GumMemoryRange * r = &ranges[i];
+    GumAddress start, end;
+
+    start = r->base_address & ~((GumAddress) snapshot->page_size - 1);
+    end = (r->base_address + r->size + snapshot->page_size - 1) &
+        ~((GumAddress) snapshot->page_size - 1);
+
+    snapshot->first_page[i] = snapshot->n_pages;
+    snapshot->n_pages += (end - start) / snapshot->page_size;
+    snapshot->size += r->size;
+  }
+
+  snapshot->pages = g_new0 (GumSnapshotPage *, snapshot->n_pages);
+
+  if (previous != NULL &&
+      !gum_memory_snapshot_has_same_layout (snapshot, previous))
+  {
+    previous = NULL;
+  }
+
+  if (previous != NULL && previous->zero_page != NULL)
+    snapshot->zero_page = gum_snapshot_page_ref (previous->zero_page);
+
+#ifdef HAVE_LINUX
+  if (previous != NULL && previous->write_tracker != NULL)
+    dirty = gum_memory_snapshot_collect_written_pages (snapshot, previous);
+
+  if ((flags & GUM_MEMORY_SNAPSHOT_TRACK_DIRTY) == 0)
+  {
+    g_clear_pointer (&snapshot->write_tracker,
+        _gum_linux_write_tracker_unref);
+  }
+  else if (snapshot->write_tracker == NULL)
+  {
+    snapshot->write_tracker = _gum_linux_write_tracker_new (ranges, n_ranges,
+        &snapshot->write_generation);
+  }
+#endif
+
+  gum_memory_snapshot_capture_pages (snapshot, previous, dirty);
+
+  g_free (dirty);
+
+  return snapshot;
+}
+
+GumMemorySnapshot *
+gum_memory_snapshot_ref (GumMemorySnapshot * self)
+{
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+gum_memory_snapshot_unref (GumMemorySnapshot * self)
+{
+  guint i;
+
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
+  for (i = 0; i != self->n_pages; i++)
+  {
+    GumSnapshotPage * page = self->pages[i];
+
+    if (page != NULL)
+      gum_snapshot_page_unref (page);
+  }
+  g_free (self->pages);
+
+  if (self->zero_page != NULL)
+    gum_snapshot_page_unref (self->zero_page);
+
+#ifdef HAVE_LINUX
+  if (self->write_tracker != NULL)
+    _gum_linux_write_tracker_unref (self->write_tracker);
+#endif
+
+  g_free (self->first_page);
+  g_free (self->ranges);
+
+  g_slice_free (GumMemorySnapshot, self);
+}
+
+/**
+ * gum_memory_snapshot_get_ranges:
+ * @self: a #GumMemorySnapshot
+ * @n_ranges: (out): where to store the number of ranges
+ *
+ * Returns: (array length=n_ranges) (transfer none): the ranges captured
+ */
+const GumMemoryRange *
+gum_memory_snapshot_get_ranges (GumMemorySnapshot * self,
+                                guint * n_ranges)
+{
+  *n_ranges = self->n_ranges;
+
+  return self->ranges;
+}
+
+/**
+ * gum_memory_snapshot_get_size:
+ * @self: a #GumMemorySnapshot
+ *
+ * Returns: the sum of the sizes of the ranges captured, which is also the
+ *   upper bound of the offsets reported by gum_memory_snapshot_diff()
+ */
+gsize
+gum_memory_snapshot_get_size (GumMemorySnapshot * self)
+{
+  return self->size;
+}
+
+/**
+ * gum_memory_snapshot_get_unique_page_count:
+ * @self: a #GumMemorySnapshot
+ *
+ * Returns: the number of pages whose contents had to be copied, i.e. that
+ *   are neither shared with the previous snapshot, zero-filled, nor
+ *   inaccessible
+ */
+guint
+gum_memory_snapshot_get_unique_page_count (GumMemorySnapshot * self)
+{
+  return self->n_unique_pages;
+}
+
+/**
+ * gum_memory_snapshot_diff:
+ * @self: a #GumMemorySnapshot
+ * @other: (nullable): a later snapshot of the same ranges, or %NULL to
+ *   compare against the current contents of memory
+ * @error: return location for a #GError
+ *
+ * Determines which bytes differ between @self and @other. Each change is
+ * reported as an offset and size, where offsets are relative to the ranges
+ * of @self laid out back to back in the order they were given. Adjacent
+ * changes within the same range are coalesced, and a page that is only
+ * accessible on one side is reported as changed in its entirety.
+ *
+ * Returns: (transfer full) (element-type Gum.MemoryChange): the changes in
+ *   ascending order of offset, or %NULL on error
+ */
+GArray *
+gum_memory_snapshot_diff (GumMemorySnapshot * self,
+                          GumMemorySnapshot * other,
+                          GError ** error)
+{
+  GumChangeCollector collector;
+  GumSnapshotReader reader;
+  gsize range_offset;
+  guint range_index;
+
+  if (other != NULL && !gum_memory_snapshot_has_same_layout (self, other))
+    goto layout_mismatch;
+
+  gum_change_collector_init (&collector);
+  if (other == NULL)
+    gum_snapshot_reader_init (&reader, self->page_size);
+
+  range_offset = 0;
+
+  for (range_index = 0; range_index != self->n_ranges; range_index++)
+  {
+    const GumMemoryRange * r = &self->ranges[range_index];
+    GumAddress first_page_address;
+    guint first_page, n_pages, i;
+
+    first_page_address = r->base_address & ~((GumAddress) self->page_size - 1);
+    first_page = self->first_page[range_index];
+    n_pages = ((range_index + 1 != self->n_ranges)
+        ? self->first_page[range_index + 1]
+        : self->n_pages) - first_page;
+
+    for (i = 0; i != n_pages; i += GUM_SNAPSHOT_BATCH_SIZE)
+    {
+      guint n, j;
+
+      n = MIN (n_pages - i, GUM_SNAPSHOT_BATCH_SIZE);
+
+      if (other == NULL)
+      {
+        reader.n = 0;
+        for (j = 0; j != n; j++)
+        {
+          gum_snapshot_reader_add (&reader,
+              first_page_address + (i + j) * self->page_size, i + j);
+        }
+        gum_snapshot_reader_flush (&reader);
+      }
+
+      for (j = 0; j != n; j++)
+      {
+        guint page_index = i + j;
+        GumSnapshotPage * page_a, * page_b;
+        const guint8 * a, * b;
+        gsize start, end, base_offset;
+
+        page_a = self->pages[first_page + page_index];
+        a = (page_a != NULL) ? page_a->data : NULL;
+
+        if (other != NULL)
+        {
+          page_b = other->pages[first_page + page_index];
+          if (page_b == page_a)
+            continue;
+          b = (page_b != NULL) ? page_b->data : NULL;
+        }
+        else
+        {
+          b = (reader.n_bytes_read[j] == self->page_size)
+              ? reader.buffer + (j * self->page_size)
+              : NULL;
+          if (a == NULL && b == NULL)
+            continue;
+        }
+
+        gum_memory_snapshot_get_page_window (self, range_index, page_index,
+            &start, &end);
+        base_offset = range_offset + (first_page_address +
+            page_index * self->page_size) - r->base_address;
+
+        if (a == NULL || b == NULL)
+        {
+          gum_change_collector_add (&collector, base_offset + start,
+              end - start);
+        }
+        else
+        {
+          gum_collect_changes (a, b, start, end, base_offset, &collector);
+        }
+      }
+    }
+
+    gum_change_collector_flush (&collector);
+
+    range_offset += r->size;
+  }
+
+  if (other == NULL)
+    gum_snapshot_reader_destroy (&reader);
+
+  return collector.changes;
+
+layout_mismatch:
+  {
+    g_set_error (error, GUM_ERROR, GUM_ERROR_INVALID_ARGUMENT,
+        "Snapshots must cover the same ranges");
+    return NULL;
+  }
+}
+
+static void
+gum_memory_snapshot_capture_pages (GumMemorySnapshot * self,
+                                   GumMemorySnapshot * previous,
+                                   const guint8 * dirty)
+{
+  GumSnapshotReader reader;
+  guint range_index;
+
+  gum_snapshot_reader_init (&reader, self->page_size);
+
+  for (range_index = 0; range_index != self->n_ranges; range_index++)
+  {
+    const GumMemoryRange * r = &self->ranges[range_index];
+    GumAddress first_page_address;
+    guint first_page, end_page, i;
+
+    first_page_address = r->base_address & ~((GumAddress) self->page_size - 1);
+    first_page = self->first_page[range_index];
+    end_page = (range_index + 1 != self->n_ranges)
+        ? self->first_page[range_index + 1]
+        : self->n_pages;
+
+    for (i = first_page; i != end_page; i++)
+    {
+      if (dirty != NULL && (dirty[i / 8] & (1 << (i % 8))) == 0 &&
+          previous->pages[i] != NULL)
+      {
+        self->pages[i] = gum_snapshot_page_ref (previous->pages[i]);
+        continue;
+      }
+
+      gum_snapshot_reader_add (&reader,
+          first_page_address + (i - first_page) * self->page_size, i);
+      if (reader.n == GUM_SNAPSHOT_BATCH_SIZE)
+        gum_memory_snapshot_store_batch (self, previous, &reader);
+    }
+  }
+
+  gum_memory_snapshot_store_batch (self, previous, &reader);
+
+  gum_snapshot_reader_destroy (&reader);
+}
+
+static void
+gum_memory_snapshot_store_batch (GumMemorySnapshot * self,
+                                 GumMemorySnapshot * previous,
+                                 GumSnapshotReader * reader)
+{
+  const gsize page_size = self->page_size;
+  guint i;
+
+  gum_snapshot_reader_flush (reader);
+
+  for (i = 0; i != reader->n; i++)
+  {
+    guint page_index = reader->page_indices[i];
+    const guint8 * data = reader->buffer + (i * page_size);
+    GumSnapshotPage * previous_page, * page;
+
+    if (reader->n_bytes_read[i] != page_size)
+      continue;
+
+    previous_page = (previous != NULL) ? previous->pages[page_index] : NULL;
+
+    if (previous_page != NULL &&
+        memcmp (previous_page->data, data, page_size) == 0)
+    {
+      page = gum_snapshot_page_ref (previous_page);
+    }
+    else if (gum_is_all_zeros (data, page_size))
+    {
+      if (self->zero_page == NULL)
+      {
+        self->zero_page = gum_snapshot_page_new (page_size);
+        memset (self->zero_page->data, 0, page_size);
+      }
+
+      page = gum_snapshot_page_ref (self->zero_page);
+    }
+    else
+    {
+      page = gum_snapshot_page_new (page_size);
+      memcpy (page->data, data, page_size);
+      self->n_unique_pages++;
+    }
+
+    self->pages[page_index] = page;
+  }
+
+  reader->n = 0;
+}
+
+static gboolean
+gum_memory_snapshot_has_same_layout (GumMemorySnapshot * self,
+                                     GumMemorySnapshot * other)
+{
+  if (other->n_ranges != self->n_ranges)
+    return FALSE;
+
+  return memcmp (other->ranges, self->ranges,
+      self->n_ranges * sizeof (GumMemoryRange)) == 0;
+}
+
+static void
+gum_memory_snapshot_get_page_window (GumMemorySnapshot * self,
+                                     guint range_index,
+                                     guint page_index,
+                                     gsize * start,
+                                     gsize * end)
+{
+  const GumMemoryRange * r = &self->ranges[range_index];
+  GumAddress page_address;
+
+  page_address = (r->base_address & ~((GumAddress) self->page_size - 1)) +
+      page_index * self->page_size;
+
+  *start = (r->base_address > page_address)
+      ? r->base_address - page_address
+      : 0;
+  *end = MIN (r->base_address + r->size - page_address, self->page_size);
+}
+
+#ifdef HAVE_LINUX
+
+static guint8 *
+gum_memory_snapshot_collect_written_pages (GumMemorySnapshot * self,
+                                           GumMemorySnapshot * previous)
+{
+  guint8 * written;
+  guint generation;
+
+  written = g_malloc0 ((self->n_pages + 7) / 8);
+  generation = previous->write_generation;
+
+  if (!_gum_linux_write_tracker_collect (previous->write_tracker, &generation,
+        written))
+  {
+    g_free (written);
+    return NULL;
+  }
+
+  self->write_tracker = _gum_linux_write_tracker_ref (previous->write_tracker);
+  self->write_generation = generation;
+
+  return written;
+}
+
+#endif
+
+static void
+gum_snapshot_reader_init (GumSnapshotReader * reader,
+                          gsize page_size)
+{
+  reader->page_size = page_size;
+  reader->n = 0;
+  reader->buffer = g_malloc (GUM_SNAPSHOT_BATCH_SIZE * page_size);
+}
+
+static void
+gum_snapshot_reader_destroy (GumSnapshotReader * reader)
+{
+  g_free (reader->buffer);
+}
+
+static void
+gum_snapshot_reader_add (GumSnapshotReader * reader,
+                         GumAddress address,
+                         guint page_index)
+{
+  GumMemoryRange * r = &reader->ranges[reader->n];
+
+  r->base_address = address;
+  r->size = reader->page_size;
+
+  reader->page_indices[reader->n] = page_index;
+
+  reader->n++;
+}
+
+static void
+gum_snapshot_reader_flush (GumSnapshotReader * reader)
+{
+  if (reader->n == 0)
+    return;
+
+  gum_memory_read_many (reader->ranges, reader->n, reader->buffer,
+      reader->n_bytes_read);
+}
+
+static GumSnapshotPage *
+gum_snapshot_page_new (gsize page_size)
+{
+  GumSnapshotPage * page;
+
+  page = g_malloc (sizeof (GumSnapshotPage) + page_size);
+  page->ref_count = 1;
+  page->data = (guint8 *) (page + 1);
+
+  return page;
+}
+
+static GumSnapshotPage *
+gum_snapshot_page_ref (GumSnapshotPage * page)
+{
+  g_atomic_int_inc (&page->ref_count);
+
+  return page;
+}
+
+static void
+gum_snapshot_page_unref (GumSnapshotPage * page)
+{
+  if (g_atomic_int_dec_and_test (&page->ref_count))
+    g_free (page);
+}
+
+static void
+gum_change_collector_init (GumChangeCollector * collector)
+{
+  collector->changes = g_array_new (FALSE, FALSE, sizeof (GumMemoryChange));
+  collector->has_pending = FALSE;
+}
+
+static void
+gum_change_collector_add (GumChangeCollector * collector,
+                          gsize offset,
+                          gsize size)
+{
+  GumMemoryChange * pending = &collector->pending;
+
+  if (collector->has_pending && pending->offset + pending->size == offset)
+  {
+    pending->size += size;
+    return;
+  }
+
+  gum_change_collector_flush (collector);
+
+  pending->offset = offset;
+  pending->size = size;
+  collector->has_pending = TRUE;
+}
+
+static void
+gum_change_collector_flush (GumChangeCollector * collector)
+{
+  if (!collector->has_pending)
+    return;
+
+  g_array_append_val (collector->changes, collector->pending);
+  collector->has_pending = FALSE;
+}
+
+static void
+gum_collect_changes (const guint8 * a,
+                     const guint8 * b,
+                     gsize start,
+                     gsize end,
+                     gsize base_offset,
+                     GumChangeCollector * collector)
+{
+  gsize offset = start;
+
+  while (offset != end)
+  {
+    gsize n;
+
+    offset += gum_count_equal_bytes (a + offset, b + offset, end - offset);
+    if (offset == end)
+      break;
+
+    n = gum_count_unequal_bytes (a + offset, b + offset, end - offset);
+    gum_change_collector_add (collector, base_offset + offset, n);
+    offset += n;
+  }
+}
+
+static gsize
+gum_count_equal_bytes (const guint8 * a,
+                       const guint8 * b,
+                       gsize size)
+{
+  gsize offset = 0;
+
+#if defined (GUM_HAVE_SSE2_DIFF)
+  for (; offset + 16 <= size; offset += 16)
+  {
+    guint mask;
+
+    mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (
+        _mm_loadu_si128 ((const __m128i *) (a + offset)),
+        _mm_loadu_si128 ((const __m128i *) (b + offset))));
+    if (mask != 0xffff)
+      return offset + g_bit_nth_lsf (~mask, -1);
+  }
+#elif defined (GUM_HAVE_NEON_DIFF)
+  for (; offset + 16 <= size; offset += 16)
+  {
+    uint8x16_t eq;
+
+    eq = vceqq_u8 (vld1q_u8 (a + offset), vld1q_u8 (b + offset));
+    if (vminvq_u8 (eq) != 0xff)
+      break;
+  }
+#else
+  for (; offset + sizeof (guint64) <= size; offset += sizeof (guint64))
+  {
+    guint64 x, y;
+
+    memcpy (&x, a + offset, sizeof (x));
+    memcpy (&y, b + offset, sizeof (y));
+    if (x != y)
+      break;
+  }
+#endif
+
+  while (offset != size && a[offset] == b[offset])
+    offset++;
+
+  return offset;
+}
+
+static gsize
+gum_count_unequal_bytes (const guint8 * a,
+                         const guint8 * b,
+                         gsize size)
+{
+  gsize offset = 0;
+
+#if defined (GUM_HAVE_SSE2_DIFF)
+  for (; offset + 16 <= size; offset += 16)
+  {
+    guint mask;
+
+    mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (
+        _mm_loadu_si128 ((const __m128i *) (a + offset)),
+        _mm_loadu_si128 ((const __m128i *) (b + offset))));
+    if (mask != 0)
+      return offset + g_bit_nth_lsf (mask, -1);
+  }
+#elif defined (GUM_HAVE_NEON_DIFF)
+  for (; offset + 16 <= size; offset += 16)
+  {
+    uint8x16_t eq;
+
+    eq = vceqq_u8 (vld1q_u8 (a + offset), vld1q_u8 (b + offset));
+    if (vmaxvq_u8 (eq) != 0)
+      break;
+  }
+#endif
+
+  while (offset != size && a[offset] != b[offset])
+    offset++;
+
+  return offset;
+}
+
+static gboolean
+gum_is_all_zeros (const guint8 * data,
+                  gsize size)
+{
+  return data[0] == 0 && memcmp (data, data + 1, size - 1) == 0;
+}
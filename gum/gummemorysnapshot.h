@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2025 Ole André Vadla Ravnås <oleavr@nowsecure.com>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_MEMORY_SNAPSHOT_H__
+#define __GUM_MEMORY_SNAPSHOT_H__
+
+#include <gum/gummemory.h>
+
+G_BEGIN_DECLS
+
+#define GUM_TYPE_MEMORY_SNAPSHOT (gum_memory_snapshot_get_type ())
+
+typedef struct _GumMemorySnapshot GumMemorySnapshot;
+typedef struct _GumMemoryChange GumMemoryChange;
+
+typedef enum {
+  GUM_MEMORY_SNAPSHOT_FLAGS_NONE  = 0,
+  GUM_MEMORY_SNAPSHOT_TRACK_DIRTY = (1 << 0),
+} GumMemorySnapshotFlags;
+
+struct _GumMemoryChange
+{
+  gsize offset;
+  gsize size;
+};
+
+GUM_API GType gum_memory_snapshot_get_type (void) G_GNUC_CONST;
+
+GUM_API GumMemorySnapshot * gum_memory_snapshot_take (
+    const GumMemoryRange * ranges, guint n_ranges,
+    GumMemorySnapshot * previous, GumMemorySnapshotFlags flags);
+GUM_API GumMemorySnapshot * gum_memory_snapshot_ref (GumMemorySnapshot * self);
+GUM_API void gum_memory_snapshot_unref (GumMemorySnapshot * self);
+
+GUM_API const GumMemoryRange * gum_memory_snapshot_get_ranges (
+    GumMemorySnapshot * self, guint * n_ranges);
+GUM_API gsize gum_memory_snapshot_get_size (GumMemorySnapshot * self);
+GUM_API guint gum_memory_snapshot_get_unique_page_count (
+    GumMemorySnapshot * self);
+
+GUM_API GArray * gum_memory_snapshot_diff (GumMemorySnapshot * self,
+    GumMemorySnapshot * other, GError ** error);
+
+G_END_DECLS
+
+#endif
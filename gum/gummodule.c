@@ -8,23 +8,35 @@
 
 #include <string.h>
 
-typedef struct _GumSymbolEntry GumSymbolEntry;
+#define GUM_SYMBOL_TABLE_EMPTY G_MAXUINT32
 
-struct _GumSymbolEntry
+typedef struct _GumSymbolTable GumSymbolTable;
+typedef struct _GumSymbolTableEntry GumSymbolTableEntry;
+
+struct _GumSymbolTable
+{
+  GArray * entries;
+  guint32 * buckets;
+  guint mask;
+};
+
+struct _GumSymbolTableEntry
 {
   const gchar * name;
   GumAddress address;
 };
 
-static gboolean gum_store_symbol (const GumSymbolDetails * details,
+static GumSymbolTable * gum_module_get_symbol_table (GumModule * self);
+
+static GumSymbolTable * gum_symbol_table_new (GumModule * module);
+static void gum_symbol_table_free (GumSymbolTable * table);
+static const GumSymbolTableEntry * gum_symbol_table_lookup (
+    GumSymbolTable * self, const gchar * name);
+static gboolean gum_symbol_table_collect (const GumSymbolDetails * details,
     gpointer user_data);
-static gint gum_symbol_entry_compare (const GumSymbolEntry * lhs,
-    const GumSymbolEntry * rhs);
 
 G_DEFINE_INTERFACE (GumModule, gum_module, G_TYPE_OBJECT)
 
-G_LOCK_DEFINE_STATIC (gum_module_symbol_cache);
-
 static void
 gum_module_default_init (GumModuleInterface * iface)
 {
@@ -115,66 +127,139 @@ gum_module_find_symbol_by_name (GumModule * self,
                                 const gchar * symbol_name)
 {
   GumModuleInterface * iface;
-  GArray * cache;
-  GumSymbolEntry needle;
-  guint matched_index;
+  const GumSymbolTableEntry * entry;
 
   iface = GUM_MODULE_GET_IFACE (self);
 
   if (iface->find_symbol_by_name != NULL)
     return iface->find_symbol_by_name (self, symbol_name);
 
-  G_LOCK (gum_module_symbol_cache);
+  entry = gum_symbol_table_lookup (gum_module_get_symbol_table (self),
+      symbol_name);
+  if (entry == NULL)
+    return 0;
+
+  return entry->address;
+}
 
-  cache = g_object_get_data (G_OBJECT (self), "symbol-cache");
-  if (cache == NULL)
+/*
+ * The table is built without holding any lock, so concurrent first lookups
+ * may each build one. Only the first one to be published is kept.
+ */
+static GumSymbolTable *
+gum_module_get_symbol_table (GumModule * self)
+{
+  GumSymbolTable * table;
+
+  table = g_object_get_data (G_OBJECT (self), "symbol-table");
+  if (table != NULL)
+    return table;
+
+  table = gum_symbol_table_new (self);
+
+  if (!g_object_replace_data (G_OBJECT (self), "symbol-table", NULL, table,
+        (GDestroyNotify) gum_symbol_table_free, NULL))
   {
-    cache = g_array_new (FALSE, FALSE, sizeof (GumSymbolEntry));
-    gum_module_enumerate_symbols (self, gum_store_symbol, cache);
-    g_array_sort (cache, (GCompareFunc) gum_symbol_entry_compare);
-    g_object_set_data_full (G_OBJECT (self), "symbol-cache", cache,
-        (GDestroyNotify) g_array_unref);
+    gum_symbol_table_free (table);
+    table = g_object_get_data (G_OBJECT (self), "symbol-table");
   }
 
-  G_UNLOCK (gum_module_symbol_cache);
+  return table;
+}
+
+/*
+ * The table borrows the names handed to us by the module, which stay alive
+ * for as long as the module does. Entries are kept densely packed, with the
+ * buckets only holding their indices. When a name occurs more than once, the
+ * first symbol enumerated is the one a lookup finds.
+ */
+static GumSymbolTable *
+gum_symbol_table_new (GumModule * module)
+{
+  GumSymbolTable * table;
+  GArray * entries;
+  guint capacity, i;
+
+  entries = g_array_new (FALSE, FALSE, sizeof (GumSymbolTableEntry));
+  gum_module_enumerate_symbols (module, gum_symbol_table_collect, entries);
 
-  needle.name = symbol_name;
-  needle.address = 0;
+  capacity = 8;
+  while (capacity < entries->len * 2)
+    capacity *= 2;
 
-  if (!g_array_binary_search (cache, &needle,
-        (GCompareFunc) gum_symbol_entry_compare, &matched_index))
+  table = g_slice_new (GumSymbolTable);
+  table->entries = entries;
+  table->buckets = g_new (guint32, capacity);
+  table->mask = capacity - 1;
+
+  memset (table->buckets, 0xff, capacity * sizeof (guint32));
+
+  for (i = 0; i != entries->len; i++)
   {
-    return 0;
+    const gchar * name = g_array_index (entries, GumSymbolTableEntry, i).name;
+    guint slot;
+
+    for (slot = g_str_hash (name) & table->mask;
+        table->buckets[slot] != GUM_SYMBOL_TABLE_EMPTY;
+        slot = (slot + 1) & table->mask)
+    {
+      const GumSymbolTableEntry * existing = &g_array_index (entries,
+          GumSymbolTableEntry, table->buckets[slot]);
+
+      if (strcmp (existing->name, name) == 0)
+        break;
+    }
+
+    if (table->buckets[slot] == GUM_SYMBOL_TABLE_EMPTY)
+      table->buckets[slot] = i;
+  }
+
+  return table;
+}
+
+static void
+gum_symbol_table_free (GumSymbolTable * table)
+{
+  g_free (table->buckets);
+  g_array_free (table->entries, TRUE);
+
+  g_slice_free (GumSymbolTable, table);
+}
+
+static const GumSymbolTableEntry *
+gum_symbol_table_lookup (GumSymbolTable * self,
+                         const gchar * name)
+{
+  guint slot;
+
+  for (slot = g_str_hash (name) & self->mask;
+      self->buckets[slot] != GUM_SYMBOL_TABLE_EMPTY;
+      slot = (slot + 1) & self->mask)
+  {
+    const GumSymbolTableEntry * entry = &g_array_index (self->entries,
+        GumSymbolTableEntry, self->buckets[slot]);
+
+    if (strcmp (entry->name, name) == 0)
+      return entry;
   }
 
-  return g_array_index (cache, GumSymbolEntry, matched_index).address;
+  return NULL;
 }
 
 static gboolean
-gum_store_symbol (const GumSymbolDetails * details,
-                  gpointer user_data)
+gum_symbol_table_collect (const GumSymbolDetails * details,
+                          gpointer user_data)
 {
-  GArray * cache = user_data;
-  GumSymbolEntry entry;
+  GArray * entries = user_data;
+  GumSymbolTableEntry entry;
 
-  /*
-   * Implementations guarantee that the lifetime of this string is at least that
-   * of the module.
-   */
   entry.name = details->name;
   entry.address = details->address;
-  g_array_append_val (cache, entry);
+  g_array_append_val (entries, entry);
 
   return TRUE;
 }
 
-static gint
-gum_symbol_entry_compare (const GumSymbolEntry * lhs,
-                          const GumSymbolEntry * rhs)
-{
-  return strcmp (lhs->name, rhs->name);
-}
-
 const gchar *
 gum_symbol_type_to_string (GumSymbolType type)
 {
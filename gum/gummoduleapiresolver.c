@@ -18,11 +18,17 @@
 
 #include "gummodulemap.h"
 #include "gumprocess.h"
+#include "gumworkerpool.h"
 
 #include <string.h>
 
 typedef struct _GumModuleMetadata GumModuleMetadata;
 typedef struct _GumFunctionMetadata GumFunctionMetadata;
+typedef struct _GumFunctionIndex GumFunctionIndex;
+typedef struct _GumFunctionIndexEntry GumFunctionIndexEntry;
+typedef struct _GumItemQuery GumItemQuery;
+typedef guint GumItemQueryKind;
+typedef struct _GumMetadataLoad GumMetadataLoad;
 
 struct _GumModuleApiResolver
 {
@@ -40,18 +46,60 @@ struct _GumModuleMetadata
 
   GumModule * module;
 
-  GHashTable * import_by_name;
-  GHashTable * export_by_name;
+  GPtrArray * imports;
+  GPtrArray * exports;
+  GumFunctionIndex * import_index;
+  GumFunctionIndex * folded_import_index;
+  GumFunctionIndex * export_index;
+  GumFunctionIndex * folded_export_index;
   GArray * sections;
 };
 
 struct _GumFunctionMetadata
 {
   gchar * name;
+  gchar * folded_name;
   GumAddress address;
   gchar * module;
 };
 
+struct _GumFunctionIndex
+{
+  GArray * by_key;
+  GArray * by_reversed_key;
+};
+
+struct _GumFunctionIndexEntry
+{
+  const gchar * key;
+  gsize key_length;
+  GumFunctionMetadata * function;
+};
+
+enum _GumItemQueryKind
+{
+  GUM_ITEM_QUERY_EXACT,
+  GUM_ITEM_QUERY_PREFIX,
+  GUM_ITEM_QUERY_SUFFIX,
+  GUM_ITEM_QUERY_INFIX,
+  GUM_ITEM_QUERY_SCAN,
+};
+
+struct _GumItemQuery
+{
+  GumItemQueryKind kind;
+  const gchar * literal;
+  gsize literal_length;
+  gchar * infix;
+  gboolean needs_pattern;
+};
+
+struct _GumMetadataLoad
+{
+  gchar collection;
+  gboolean ignore_case;
+};
+
 static void gum_module_api_resolver_iface_init (gpointer g_iface,
     gpointer iface_data);
 static void gum_module_api_resolver_finalize (GObject * object);
@@ -59,10 +107,26 @@ static void gum_module_api_resolver_enumerate_matches (
     GumApiResolver * resolver, const gchar * query, GumFoundApiFunc func,
     gpointer user_data, GError ** error);
 
+static GPtrArray * gum_module_api_resolver_find_modules (
+    GumModuleApiResolver * self, const gchar * module_query,
+    gboolean ignore_case);
+
+static void gum_load_module_metadata (GPtrArray * modules, gchar collection,
+    gboolean ignore_case);
+
+static void gum_item_query_parse (GumItemQuery * query, const gchar * str);
+static void gum_item_query_clear (GumItemQuery * query);
+
 static void gum_module_metadata_unref (GumModuleMetadata * module);
-static GHashTable * gum_module_metadata_get_imports (GumModuleMetadata * self);
-static GHashTable * gum_module_metadata_get_exports (GumModuleMetadata * self);
+static GPtrArray * gum_module_metadata_get_imports (GumModuleMetadata * self);
+static GPtrArray * gum_module_metadata_get_exports (GumModuleMetadata * self);
+static GumFunctionIndex * gum_module_metadata_get_function_index (
+    GumModuleMetadata * self, gchar collection, gboolean ignore_case);
 static GArray * gum_module_metadata_get_sections (GumModuleMetadata * self);
+static gboolean gum_module_metadata_is_loaded (GumModuleMetadata * self,
+    const GumMetadataLoad * load);
+static void gum_module_metadata_load (GumModuleMetadata * self,
+    const GumMetadataLoad * load);
 static gboolean gum_module_metadata_collect_import (
     const GumImportDetails * details, gpointer user_data);
 static gboolean gum_module_metadata_collect_export (
@@ -70,10 +134,32 @@ static gboolean gum_module_metadata_collect_export (
 static gboolean gum_module_metadata_collect_section (
     const GumSectionDetails * details, gpointer user_data);
 
+static void gum_sort_and_dedup_functions (GPtrArray * functions);
+static gint gum_function_metadata_compare_name (GumFunctionMetadata ** lhs,
+    GumFunctionMetadata ** rhs);
+
 static GumFunctionMetadata * gum_function_metadata_new (const gchar * name,
     GumAddress address, const gchar * module);
 static void gum_function_metadata_free (GumFunctionMetadata * function);
 
+static GumFunctionIndex * gum_function_index_new (GPtrArray * functions,
+    gboolean ignore_case);
+static void gum_function_index_free (GumFunctionIndex * self);
+static GArray * gum_function_index_lookup (GumFunctionIndex * self,
+    const GumItemQuery * query, guint * start, guint * end);
+static gint gum_function_index_entry_compare (
+    const GumFunctionIndexEntry * lhs, const GumFunctionIndexEntry * rhs);
+static gint gum_function_index_entry_compare_reversed (
+    const GumFunctionIndexEntry * lhs, const GumFunctionIndexEntry * rhs);
+static gint gum_compare_key_to_literal (const GumFunctionIndexEntry * entry,
+    const gchar * literal, gsize literal_length);
+static gint gum_compare_key_prefix_to_literal (
+    const GumFunctionIndexEntry * entry, const gchar * literal,
+    gsize literal_length);
+static gint gum_compare_key_suffix_to_literal (
+    const GumFunctionIndexEntry * entry, const gchar * literal,
+    gsize literal_length);
+
 static void gum_section_details_free (GumSectionDetails * self);
 
 G_DEFINE_TYPE_EXTENDED (GumModuleApiResolver,
@@ -124,8 +210,12 @@ gum_module_api_resolver_init (GumModuleApiResolver * self)
     meta = g_slice_new (GumModuleMetadata);
     meta->ref_count = 2;
     meta->module = g_object_ref (module);
-    meta->import_by_name = NULL;
-    meta->export_by_name = NULL;
+    meta->imports = NULL;
+    meta->exports = NULL;
+    meta->import_index = NULL;
+    meta->folded_import_index = NULL;
+    meta->export_index = NULL;
+    meta->folded_export_index = NULL;
     meta->sections = NULL;
 
     g_hash_table_insert (self->module_by_name,
@@ -174,11 +264,11 @@ gum_module_api_resolver_enumerate_matches (GumApiResolver * resolver,
   gboolean ignore_case;
   gchar * collection, * module_query, * item_query;
   gboolean no_patterns_in_item_query;
-  GPatternSpec * module_spec, * item_spec;
-  GHashTableIter module_iter;
-  GHashTable * seen_modules;
+  GumItemQuery item;
+  GPatternSpec * item_spec;
+  GPtrArray * modules;
+  guint module_index;
   gboolean carry_on;
-  GumModuleMetadata * module;
 
   g_regex_match (self->query_pattern, query, 0, &query_info);
   if (!g_match_info_matches (query_info))
@@ -210,158 +300,127 @@ gum_module_api_resolver_enumerate_matches (GumApiResolver * resolver,
       strchr (item_query, '*') == NULL &&
       strchr (item_query, '?') == NULL;
 
-  module_spec = g_pattern_spec_new (module_query);
+  gum_item_query_parse (&item, item_query);
   item_spec = g_pattern_spec_new (item_query);
 
-  g_hash_table_iter_init (&module_iter, self->module_by_name);
-  seen_modules = g_hash_table_new (NULL, NULL);
+  modules = gum_module_api_resolver_find_modules (self, module_query,
+      ignore_case);
+  if (!(collection[0] == 'e' && no_patterns_in_item_query))
+    gum_load_module_metadata (modules, collection[0], ignore_case);
   carry_on = TRUE;
 
-  while (carry_on &&
-      g_hash_table_iter_next (&module_iter, NULL, (gpointer *) &module))
+  for (module_index = 0;
+      carry_on && module_index != modules->len;
+      module_index++)
   {
-    const gchar * module_name, * module_path;
-    const gchar * normalized_module_name, * normalized_module_path;
-    gchar * module_name_copy = NULL;
-    gchar * module_path_copy = NULL;
-
-    if (g_hash_table_contains (seen_modules, module))
-      continue;
-    g_hash_table_add (seen_modules, module);
+    GumModuleMetadata * module;
+    const gchar * module_path;
+    GumFunctionIndex * function_index;
+    GArray * entries;
+    guint start, end, i;
 
-    module_name = gum_module_get_name (module->module);
+    module = g_ptr_array_index (modules, module_index);
     module_path = gum_module_get_path (module->module);
 
-    if (ignore_case)
+    if (collection[0] == 's')
     {
-      module_name_copy = g_utf8_strdown (module_name, -1);
-      normalized_module_name = module_name_copy;
+      GArray * sections;
 
-      module_path_copy = g_utf8_strdown (module_path, -1);
-      normalized_module_path = module_path_copy;
-    }
-    else
-    {
-      normalized_module_name = module_name;
-      normalized_module_path = module_path;
-    }
-
-    if (g_pattern_spec_match_string (module_spec, normalized_module_name) ||
-        g_pattern_spec_match_string (module_spec, normalized_module_path))
-    {
-      GHashTable * functions;
-      GHashTableIter function_iter;
-      GumFunctionMetadata * function;
-
-      if (collection[0] == 's')
+      sections = gum_module_metadata_get_sections (module);
+      for (i = 0; i != sections->len; i++)
       {
-        GArray * sections;
-        guint i;
+        const GumSectionDetails * section = &g_array_index (sections,
+            GumSectionDetails, i);
 
-        sections = gum_module_metadata_get_sections (module);
-        for (i = 0; i != sections->len; i++)
+        if (g_pattern_spec_match_string (item_spec, section->name))
         {
-          const GumSectionDetails * section = &g_array_index (sections,
-              GumSectionDetails, i);
-
-          if (g_pattern_spec_match_string (item_spec, section->name))
-          {
-            GumApiDetails details;
+          GumApiDetails details;
 
-            details.name = g_strconcat (
-                module_path,
-                "!",
-                section->id,
-                NULL);
-            details.address = section->address;
-            details.size = section->size;
+          details.name = g_strconcat (
+              module_path,
+              "!",
+              section->id,
+              NULL);
+          details.address = section->address;
+          details.size = section->size;
 
-            carry_on = func (&details, user_data);
+          carry_on = func (&details, user_data);
 
-            g_free ((gpointer) details.name);
-          }
+          g_free ((gpointer) details.name);
         }
-
-        continue;
       }
 
-      if (collection[0] == 'e' && no_patterns_in_item_query)
-      {
-        GumApiDetails details;
+      continue;
+    }
+
+    if (collection[0] == 'e' && no_patterns_in_item_query)
+    {
+      GumApiDetails details;
 
-        details.address =
-            gum_module_find_export_by_name (module->module, item_query);
-        details.size = GUM_API_SIZE_NONE;
+      details.address =
+          gum_module_find_export_by_name (module->module, item_query);
+      details.size = GUM_API_SIZE_NONE;
 
 #ifndef HAVE_WINDOWS
-        if (details.address != 0)
-        {
-          if (gum_module_map_find (self->all_modules, details.address) !=
-              module->module)
-            details.address = 0;
-        }
+      if (details.address != 0)
+      {
+        if (gum_module_map_find (self->all_modules, details.address) !=
+            module->module)
+          details.address = 0;
+      }
 #endif
 
-        if (details.address != 0)
-        {
-          details.name = g_strconcat (module_path, "!", item_query, NULL);
-
-          carry_on = func (&details, user_data);
-
-          g_free ((gpointer) details.name);
-        }
+      if (details.address != 0)
+      {
+        details.name = g_strconcat (module_path, "!", item_query, NULL);
 
-        g_assert (module_name_copy == NULL && module_path_copy == NULL);
+        carry_on = func (&details, user_data);
 
-        continue;
+        g_free ((gpointer) details.name);
       }
 
-      functions = (collection[0] == 'i')
-          ? gum_module_metadata_get_imports (module)
-          : gum_module_metadata_get_exports (module);
+      continue;
+    }
 
-      g_hash_table_iter_init (&function_iter, functions);
-      while (carry_on &&
-          g_hash_table_iter_next (&function_iter, NULL, (gpointer *) &function))
-      {
-        const gchar * function_name = function->name;
-        gchar * function_name_copy = NULL;
+    function_index = gum_module_metadata_get_function_index (module,
+        collection[0], ignore_case);
+    entries = gum_function_index_lookup (function_index, &item, &start, &end);
 
-        if (ignore_case)
-        {
-          function_name_copy = g_utf8_strdown (function_name, -1);
-          function_name = function_name_copy;
-        }
+    for (i = start; carry_on && i != end; i++)
+    {
+      const GumFunctionIndexEntry * entry =
+          &g_array_index (entries, GumFunctionIndexEntry, i);
+      const GumFunctionMetadata * function = entry->function;
+      GumApiDetails details;
 
-        if (g_pattern_spec_match_string (item_spec, function_name))
-        {
-          GumApiDetails details;
+      if (item.infix != NULL && strstr (entry->key, item.infix) == NULL)
+        continue;
 
-          details.name = g_strconcat (
-              (function->module != NULL) ? function->module : module_path,
-              "!",
-              function->name,
-              NULL);
-          details.address = function->address;
-          details.size = GUM_API_SIZE_NONE;
+      if (item.needs_pattern &&
+          !g_pattern_spec_match (item_spec, entry->key_length, entry->key,
+              NULL))
+      {
+        continue;
+      }
 
-          carry_on = func (&details, user_data);
+      details.name = g_strconcat (
+          (function->module != NULL) ? function->module : module_path,
+          "!",
+          function->name,
+          NULL);
+      details.address = function->address;
+      details.size = GUM_API_SIZE_NONE;
 
-          g_free ((gpointer) details.name);
-        }
+      carry_on = func (&details, user_data);
 
-        g_free (function_name_copy);
-      }
+      g_free ((gpointer) details.name);
     }
-
-    g_free (module_path_copy);
-    g_free (module_name_copy);
   }
 
-  g_hash_table_unref (seen_modules);
+  g_ptr_array_unref (modules);
 
   g_pattern_spec_free (item_spec);
-  g_pattern_spec_free (module_spec);
+  gum_item_query_clear (&item);
 
   g_free (item_query);
   g_free (module_query);
@@ -378,6 +437,204 @@ invalid_query:
   }
 }
 
+static GPtrArray *
+gum_module_api_resolver_find_modules (GumModuleApiResolver * self,
+                                      const gchar * module_query,
+                                      gboolean ignore_case)
+{
+  GPtrArray * modules;
+  GPatternSpec * module_spec;
+  GHashTableIter iter;
+  GHashTable * seen_modules;
+  GumModuleMetadata * module;
+
+  modules = g_ptr_array_new ();
+
+  if (!ignore_case &&
+      strchr (module_query, '*') == NULL &&
+      strchr (module_query, '?') == NULL)
+  {
+    module = g_hash_table_lookup (self->module_by_name, module_query);
+    if (module != NULL)
+      g_ptr_array_add (modules, module);
+    return modules;
+  }
+
+  module_spec = g_pattern_spec_new (module_query);
+  seen_modules = g_hash_table_new (NULL, NULL);
+
+  g_hash_table_iter_init (&iter, self->module_by_name);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &module))
+  {
+    const gchar * module_name, * module_path;
+    gchar * module_name_copy = NULL;
+    gchar * module_path_copy = NULL;
+
+    if (g_hash_table_contains (seen_modules, module))
+      continue;
+    g_hash_table_add (seen_modules, module);
+
+    module_name = gum_module_get_name (module->module);
+    module_path = gum_module_get_path (module->module);
+
+    if (ignore_case)
+    {
+      module_name_copy = g_utf8_strdown (module_name, -1);
+      module_name = module_name_copy;
+
+      module_path_copy = g_utf8_strdown (module_path, -1);
+      module_path = module_path_copy;
+    }
+
+    if (g_pattern_spec_match_string (module_spec, module_name) ||
+        g_pattern_spec_match_string (module_spec, module_path))
+    {
+      g_ptr_array_add (modules, module);
+    }
+
+    g_free (module_path_copy);
+    g_free (module_name_copy);
+  }
+
+  g_hash_table_unref (seen_modules);
+  g_pattern_spec_free (module_spec);
+
+  return modules;
+}
+
+/*
+ * Parsing the imports, exports or sections of a module is by far the most
+ * expensive part of a query spanning many modules, and each module can be
+ * parsed independently of the others. So we fan out the modules whose
+ * metadata has not been loaded yet across Gum's worker pool, each job only
+ * writing to the metadata of the module it was handed. With only a few of
+ * them we leave it to the lookups to load them lazily, as the caller may
+ * well stop before getting to them.
+ */
+static void
+gum_load_module_metadata (GPtrArray * modules,
+                          gchar collection,
+                          gboolean ignore_case)
+{
+  GumMetadataLoad load;
+  GPtrArray * pending;
+  guint i;
+
+  load.collection = collection;
+  load.ignore_case = ignore_case;
+
+  pending = g_ptr_array_new ();
+  for (i = 0; i != modules->len; i++)
+  {
+    GumModuleMetadata * module = g_ptr_array_index (modules, i);
+
+    if (!gum_module_metadata_is_loaded (module, &load))
+      g_ptr_array_add (pending, module);
+  }
+
+  _gum_worker_pool_try_run_jobs (pending, (GFunc) gum_module_metadata_load,
+      &load);
+
+  g_ptr_array_unref (pending);
+}
+
+/*
+ * Picks the index lookup that narrows down the candidates the most: exact
+ * names and literal prefixes are looked up through the names sorted
+ * forwards, and literal suffixes through the names sorted backwards. When a
+ * pattern has both, e.g. foo*bar, the longer of the two is used. Patterns
+ * with neither, e.g. *alloc*, cannot use the index and have to visit every
+ * name, but are screened with strstr() on their longest literal before the
+ * pattern gets involved. The pattern only needs to be applied to the
+ * resulting candidates if the chosen literal alone does not decide a match.
+ */
+static void
+gum_item_query_parse (GumItemQuery * query,
+                      const gchar * str)
+{
+  const gchar * first_wildcard, * last_wildcard, * cursor, * segment;
+  gsize prefix_length, suffix_length;
+  gboolean single_star;
+
+  query->infix = NULL;
+
+  first_wildcard = strpbrk (str, "*?");
+  if (first_wildcard == NULL)
+  {
+    query->kind = GUM_ITEM_QUERY_EXACT;
+    query->literal = str;
+    query->literal_length = strlen (str);
+    query->needs_pattern = FALSE;
+    return;
+  }
+
+  last_wildcard = first_wildcard;
+  for (cursor = first_wildcard + 1; *cursor != '\0'; cursor++)
+  {
+    if (*cursor == '*' || *cursor == '?')
+      last_wildcard = cursor;
+  }
+
+  prefix_length = first_wildcard - str;
+  suffix_length = strlen (last_wildcard + 1);
+  single_star = first_wildcard == last_wildcard && first_wildcard[0] == '*';
+
+  if (prefix_length != 0 && prefix_length >= suffix_length)
+  {
+    query->kind = GUM_ITEM_QUERY_PREFIX;
+    query->literal = str;
+    query->literal_length = prefix_length;
+    query->needs_pattern = !(single_star && suffix_length == 0);
+    return;
+  }
+
+  if (suffix_length != 0)
+  {
+    query->kind = GUM_ITEM_QUERY_SUFFIX;
+    query->literal = last_wildcard + 1;
+    query->literal_length = suffix_length;
+    query->needs_pattern = !(single_star && prefix_length == 0);
+    return;
+  }
+
+  query->kind = GUM_ITEM_QUERY_SCAN;
+  query->literal = NULL;
+  query->literal_length = 0;
+
+  segment = first_wildcard + 1;
+  for (cursor = segment; cursor <= last_wildcard; cursor++)
+  {
+    if (*cursor == '*' || *cursor == '?')
+    {
+      if ((gsize) (cursor - segment) > query->literal_length)
+      {
+        query->literal = segment;
+        query->literal_length = cursor - segment;
+      }
+      segment = cursor + 1;
+    }
+  }
+
+  if (query->literal_length != 0)
+  {
+    query->kind = GUM_ITEM_QUERY_INFIX;
+    query->infix = g_strndup (query->literal, query->literal_length);
+    query->needs_pattern = !(first_wildcard[0] == '*' &&
+        query->literal == first_wildcard + 1 &&
+        query->literal + query->literal_length == last_wildcard &&
+        last_wildcard[0] == '*');
+    return;
+  }
+
+  query->needs_pattern = strcmp (str, "*") != 0;
+}
+
+static void
+gum_item_query_clear (GumItemQuery * query)
+{
+  g_clear_pointer (&query->infix, g_free);
+}
+
 static void
 gum_module_metadata_unref (GumModuleMetadata * meta)
 {
@@ -387,11 +644,16 @@ gum_module_metadata_unref (GumModuleMetadata * meta)
     if (meta->sections != NULL)
       g_array_unref (meta->sections);
 
-    if (meta->export_by_name != NULL)
-      g_hash_table_unref (meta->export_by_name);
+    g_clear_pointer (&meta->folded_export_index, gum_function_index_free);
+    g_clear_pointer (&meta->export_index, gum_function_index_free);
+    g_clear_pointer (&meta->folded_import_index, gum_function_index_free);
+    g_clear_pointer (&meta->import_index, gum_function_index_free);
+
+    if (meta->exports != NULL)
+      g_ptr_array_unref (meta->exports);
 
-    if (meta->import_by_name != NULL)
-      g_hash_table_unref (meta->import_by_name);
+    if (meta->imports != NULL)
+      g_ptr_array_unref (meta->imports);
 
     g_object_unref (meta->module);
 
@@ -399,32 +661,59 @@ gum_module_metadata_unref (GumModuleMetadata * meta)
   }
 }
 
-static GHashTable *
+static GPtrArray *
 gum_module_metadata_get_imports (GumModuleMetadata * self)
 {
-  if (self->import_by_name == NULL)
+  if (self->imports == NULL)
   {
-    self->import_by_name = g_hash_table_new_full (g_str_hash, g_str_equal,
-        g_free, (GDestroyNotify) gum_function_metadata_free);
+    self->imports = g_ptr_array_new_with_free_func (
+        (GDestroyNotify) gum_function_metadata_free);
     gum_module_enumerate_imports (self->module,
-        gum_module_metadata_collect_import, self->import_by_name);
+        gum_module_metadata_collect_import, self->imports);
+    gum_sort_and_dedup_functions (self->imports);
   }
 
-  return self->import_by_name;
+  return self->imports;
 }
 
-static GHashTable *
+static GPtrArray *
 gum_module_metadata_get_exports (GumModuleMetadata * self)
 {
-  if (self->export_by_name == NULL)
+  if (self->exports == NULL)
   {
-    self->export_by_name = g_hash_table_new_full (g_str_hash, g_str_equal,
-        g_free, (GDestroyNotify) gum_function_metadata_free);
+    self->exports = g_ptr_array_new_with_free_func (
+        (GDestroyNotify) gum_function_metadata_free);
     gum_module_enumerate_exports (self->module,
-        gum_module_metadata_collect_export, self->export_by_name);
+        gum_module_metadata_collect_export, self->exports);
+    gum_sort_and_dedup_functions (self->exports);
+  }
+
+  return self->exports;
+}
+
+static GumFunctionIndex *
+gum_module_metadata_get_function_index (GumModuleMetadata * self,
+                                        gchar collection,
+                                        gboolean ignore_case)
+{
+  GumFunctionIndex ** slot;
+  GPtrArray * functions;
+
+  if (collection == 'i')
+  {
+    slot = ignore_case ? &self->folded_import_index : &self->import_index;
+    functions = gum_module_metadata_get_imports (self);
+  }
+  else
+  {
+    slot = ignore_case ? &self->folded_export_index : &self->export_index;
+    functions = gum_module_metadata_get_exports (self);
   }
 
-  return self->export_by_name;
+  if (*slot == NULL)
+    *slot = gum_function_index_new (functions, ignore_case);
+
+  return *slot;
 }
 
 static GArray *
@@ -442,19 +731,44 @@ gum_module_metadata_get_sections (GumModuleMetadata * self)
   return self->sections;
 }
 
+static gboolean
+gum_module_metadata_is_loaded (GumModuleMetadata * self,
+                               const GumMetadataLoad * load)
+{
+  switch (load->collection)
+  {
+    case 'i':
+      return (load->ignore_case ? self->folded_import_index
+          : self->import_index) != NULL;
+    case 'e':
+      return (load->ignore_case ? self->folded_export_index
+          : self->export_index) != NULL;
+    default:
+      return self->sections != NULL;
+  }
+}
+
+static void
+gum_module_metadata_load (GumModuleMetadata * self,
+                          const GumMetadataLoad * load)
+{
+  if (load->collection == 's')
+    gum_module_metadata_get_sections (self);
+  else
+    gum_module_metadata_get_function_index (self, load->collection,
+        load->ignore_case);
+}
+
 static gboolean
 gum_module_metadata_collect_import (const GumImportDetails * details,
                                     gpointer user_data)
 {
-  GHashTable * import_by_name = user_data;
+  GPtrArray * imports = user_data;
 
   if (details->type == GUM_IMPORT_FUNCTION && details->address != 0)
   {
-    GumFunctionMetadata * function;
-
-    function = gum_function_metadata_new (details->name, details->address,
-        details->module);
-    g_hash_table_insert (import_by_name, g_strdup (function->name), function);
+    g_ptr_array_add (imports, gum_function_metadata_new (details->name,
+        details->address, details->module));
   }
 
   return TRUE;
@@ -464,15 +778,12 @@ static gboolean
 gum_module_metadata_collect_export (const GumExportDetails * details,
                                     gpointer user_data)
 {
-  GHashTable * export_by_name = user_data;
+  GPtrArray * exports = user_data;
 
   if (details->type == GUM_EXPORT_FUNCTION)
   {
-    GumFunctionMetadata * function;
-
-    function = gum_function_metadata_new (details->name, details->address,
-        NULL);
-    g_hash_table_insert (export_by_name, g_strdup (function->name), function);
+    g_ptr_array_add (exports, gum_function_metadata_new (details->name,
+        details->address, NULL));
   }
 
   return TRUE;
@@ -493,6 +804,51 @@ gum_module_metadata_collect_section (const GumSectionDetails * details,
   return TRUE;
 }
 
+static void
+gum_sort_and_dedup_functions (GPtrArray * functions)
+{
+  gpointer * pdata;
+  guint n, i;
+
+  /*
+   * The sort is stable, so when a name occurs more than once, the function
+   * that was added last is the one that remains.
+   */
+  g_ptr_array_sort (functions,
+      (GCompareFunc) gum_function_metadata_compare_name);
+
+  /*
+   * Compact in a single pass, swapping the duplicates towards the end so
+   * that shrinking the array hands them to its free func.
+   */
+  pdata = functions->pdata;
+  n = 0;
+  for (i = 0; i != functions->len; i++)
+  {
+    GumFunctionMetadata * cur = pdata[i];
+    gpointer tmp;
+
+    if (i + 1 != functions->len &&
+        strcmp (cur->name,
+            ((GumFunctionMetadata *) pdata[i + 1])->name) == 0)
+      continue;
+
+    tmp = pdata[n];
+    pdata[n] = cur;
+    pdata[i] = tmp;
+    n++;
+  }
+
+  g_ptr_array_set_size (functions, n);
+}
+
+static gint
+gum_function_metadata_compare_name (GumFunctionMetadata ** lhs,
+                                    GumFunctionMetadata ** rhs)
+{
+  return strcmp ((*lhs)->name, (*rhs)->name);
+}
+
 static GumFunctionMetadata *
 gum_function_metadata_new (const gchar * name,
                            GumAddress address,
@@ -502,6 +858,7 @@ gum_function_metadata_new (const gchar * name,
 
   function = g_slice_new (GumFunctionMetadata);
   function->name = g_strdup (name);
+  function->folded_name = NULL;
   function->address = address;
   function->module = g_strdup (module);
 
@@ -512,11 +869,191 @@ static void
 gum_function_metadata_free (GumFunctionMetadata * meta)
 {
   g_free (meta->module);
+  g_free (meta->folded_name);
   g_free (meta->name);
 
   g_slice_free (GumFunctionMetadata, meta);
 }
 
+static GumFunctionIndex *
+gum_function_index_new (GPtrArray * functions,
+                        gboolean ignore_case)
+{
+  GumFunctionIndex * self;
+  guint i;
+
+  self = g_slice_new (GumFunctionIndex);
+  self->by_key = g_array_sized_new (FALSE, FALSE,
+      sizeof (GumFunctionIndexEntry), functions->len);
+
+  for (i = 0; i != functions->len; i++)
+  {
+    GumFunctionMetadata * function = g_ptr_array_index (functions, i);
+    GumFunctionIndexEntry entry;
+
+    if (ignore_case)
+    {
+      if (function->folded_name == NULL)
+        function->folded_name = g_utf8_strdown (function->name, -1);
+      entry.key = function->folded_name;
+    }
+    else
+    {
+      entry.key = function->name;
+    }
+    entry.key_length = strlen (entry.key);
+    entry.function = function;
+
+    g_array_append_val (self->by_key, entry);
+  }
+
+  self->by_reversed_key = g_array_copy (self->by_key);
+
+  g_array_sort (self->by_key,
+      (GCompareFunc) gum_function_index_entry_compare);
+  g_array_sort (self->by_reversed_key,
+      (GCompareFunc) gum_function_index_entry_compare_reversed);
+
+  return self;
+}
+
+static void
+gum_function_index_free (GumFunctionIndex * self)
+{
+  g_array_unref (self->by_reversed_key);
+  g_array_unref (self->by_key);
+
+  g_slice_free (GumFunctionIndex, self);
+}
+
+static GArray *
+gum_function_index_lookup (GumFunctionIndex * self,
+                           const GumItemQuery * query,
+                           guint * start,
+                           guint * end)
+{
+  GArray * entries;
+  gint (* compare) (const GumFunctionIndexEntry * entry,
+      const gchar * literal, gsize literal_length);
+  guint lo, hi;
+
+  switch (query->kind)
+  {
+    case GUM_ITEM_QUERY_EXACT:
+      entries = self->by_key;
+      compare = gum_compare_key_to_literal;
+      break;
+    case GUM_ITEM_QUERY_PREFIX:
+      entries = self->by_key;
+      compare = gum_compare_key_prefix_to_literal;
+      break;
+    case GUM_ITEM_QUERY_SUFFIX:
+      entries = self->by_reversed_key;
+      compare = gum_compare_key_suffix_to_literal;
+      break;
+    case GUM_ITEM_QUERY_INFIX:
+    case GUM_ITEM_QUERY_SCAN:
+    default:
+      *start = 0;
+      *end = self->by_key->len;
+      return self->by_key;
+  }
+
+  lo = 0;
+  hi = entries->len;
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+
+    if (compare (&g_array_index (entries, GumFunctionIndexEntry, mid),
+          query->literal, query->literal_length) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *start = lo;
+
+  hi = entries->len;
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+
+    if (compare (&g_array_index (entries, GumFunctionIndexEntry, mid),
+          query->literal, query->literal_length) <= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *end = lo;
+
+  return entries;
+}
+
+static gint
+gum_function_index_entry_compare (const GumFunctionIndexEntry * lhs,
+                                  const GumFunctionIndexEntry * rhs)
+{
+  return strcmp (lhs->key, rhs->key);
+}
+
+static gint
+gum_function_index_entry_compare_reversed (const GumFunctionIndexEntry * lhs,
+                                           const GumFunctionIndexEntry * rhs)
+{
+  gsize n, i;
+
+  n = MIN (lhs->key_length, rhs->key_length);
+  for (i = 1; i <= n; i++)
+  {
+    guint8 l = lhs->key[lhs->key_length - i];
+    guint8 r = rhs->key[rhs->key_length - i];
+
+    if (l != r)
+      return (l < r) ? -1 : 1;
+  }
+
+  if (lhs->key_length == rhs->key_length)
+    return 0;
+
+  return (lhs->key_length < rhs->key_length) ? -1 : 1;
+}
+
+static gint
+gum_compare_key_to_literal (const GumFunctionIndexEntry * entry,
+                            const gchar * literal,
+                            gsize literal_length)
+{
+  return strcmp (entry->key, literal);
+}
+
+static gint
+gum_compare_key_prefix_to_literal (const GumFunctionIndexEntry * entry,
+                                   const gchar * literal,
+                                   gsize literal_length)
+{
+  return strncmp (entry->key, literal, literal_length);
+}
+
+static gint
+gum_compare_key_suffix_to_literal (const GumFunctionIndexEntry * entry,
+                                   const gchar * literal,
+                                   gsize literal_length)
+{
+  gsize n, i;
+
+  n = MIN (entry->key_length, literal_length);
+  for (i = 1; i <= n; i++)
+  {
+    guint8 k = entry->key[entry->key_length - i];
+    guint8 l = literal[literal_length - i];
+
+    if (k != l)
+      return (k < l) ? -1 : 1;
+  }
+
+  return (entry->key_length < literal_length) ? -1 : 0;
+}
+
 static void
 gum_section_details_free (GumSectionDetails * section)
 {
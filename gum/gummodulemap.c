@@ -6,22 +6,64 @@
 
 #include "gummodulemap.h"
 
+#include "gummoduleregistry-priv.h"
+
 #include <stdlib.h>
 
+typedef struct _GumCollectModulesContext GumCollectModulesContext;
+typedef struct _GumModuleMapLink GumModuleMapLink;
+
 struct _GumModuleMap
 {
   GObject parent;
 
+  GMutex mutex;
   GPtrArray * modules;
+  GPtrArray * pinned;
+  GPtrArray * retired;
+  gint active_readers;
+  gint has_retired;
+
+  GumModuleRegistry * registry;
+  gulong added_handler;
+  gulong removed_handler;
 
   GumModuleMapFilterFunc filter_func;
   gpointer filter_data;
   GDestroyNotify filter_data_destroy;
 };
 
+struct _GumCollectModulesContext
+{
+  GumModuleMap * map;
+  GPtrArray * modules;
+};
+
+struct _GumModuleMapLink
+{
+  GWeakRef map;
+};
+
 static void gum_module_map_dispose (GObject * object);
+static void gum_module_map_finalize (GObject * object);
+
+static void gum_module_map_publish (GumModuleMap * self, GPtrArray * modules);
+static void gum_module_map_release_retired (GumModuleMap * self);
+static void gum_module_map_on_module_added (GumModuleRegistry * registry,
+    GumModule * module, GumModuleMapLink * link);
+static void gum_module_map_on_module_removed (GumModuleRegistry * registry,
+    GumModule * module, GumModuleMapLink * link);
+static void gum_module_map_add (GumModuleMap * self, GumModule * module);
+static void gum_module_map_remove (GumModuleMap * self, GumModule * module);
+
+static GumModuleMapLink * gum_module_map_link_new (GumModuleMap * map);
+static GumModuleMapLink * gum_module_map_link_ref (GumModuleMapLink * link);
+static void gum_module_map_link_unref (GumModuleMapLink * link);
+static void gum_module_map_link_clear (GumModuleMapLink * link);
 
 static gboolean gum_add_module (GumModule * module, gpointer user_data);
+static guint gum_find_insertion_index (GPtrArray * modules,
+    GumAddress base_address);
 static gint gum_module_compare_base (GumModule ** lhs_module,
     GumModule ** rhs_module);
 static gint gum_module_compare_to_key (const GumAddress * key_ptr,
@@ -35,12 +77,16 @@ gum_module_map_class_init (GumModuleMapClass * klass)
   GObjectClass * object_class = G_OBJECT_CLASS (klass);
 
   object_class->dispose = gum_module_map_dispose;
+  object_class->finalize = gum_module_map_finalize;
 }
 
 static void
 gum_module_map_init (GumModuleMap * self)
 {
+  g_mutex_init (&self->mutex);
   self->modules = g_ptr_array_new_full (0, g_object_unref);
+  self->retired = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) g_ptr_array_unref);
 }
 
 static void
@@ -48,7 +94,23 @@ gum_module_map_dispose (GObject * object)
 {
   GumModuleMap * self = GUM_MODULE_MAP (object);
 
+  if (self->registry != NULL)
+  {
+    g_signal_handler_disconnect (self->registry, self->added_handler);
+    g_signal_handler_disconnect (self->registry, self->removed_handler);
+    self->registry = NULL;
+  }
+
+  /*
+   * A handler already running on another thread holds its own reference, so
+   * it can only get here if dispose is run explicitly. Either way it checks
+   * for cleared state under the mutex.
+   */
+  g_mutex_lock (&self->mutex);
+  g_clear_pointer (&self->retired, g_ptr_array_unref);
+  g_clear_pointer (&self->pinned, g_ptr_array_unref);
   g_clear_pointer (&self->modules, g_ptr_array_unref);
+  g_mutex_unlock (&self->mutex);
 
   if (self->filter_data_destroy != NULL)
     self->filter_data_destroy (self->filter_data);
@@ -60,13 +122,51 @@ gum_module_map_dispose (GObject * object)
   G_OBJECT_CLASS (gum_module_map_parent_class)->dispose (object);
 }
 
+static void
+gum_module_map_finalize (GObject * object)
+{
+  GumModuleMap * self = GUM_MODULE_MAP (object);
+
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (gum_module_map_parent_class)->finalize (object);
+}
+
+/*
+ * An unfiltered map follows the module registry, applying each addition and
+ * removal to a copy of its sorted array and publishing that atomically. This
+ * means gum_module_map_find() never blocks, and there is rarely any need for
+ * a full gum_module_map_update().
+ *
+ * Filtered maps are not kept up-to-date this way, as their filter may not be
+ * safe to call from whichever thread happens to load or unload a module.
+ *
+ * The handlers only hold a weak reference to the map, through a link that
+ * each connection keeps alive, so a handler that is still running on another
+ * thread when the map goes away never touches freed memory.
+ */
 GumModuleMap *
 gum_module_map_new (void)
 {
   GumModuleMap * map;
+  GumModuleMapLink * link;
 
   map = g_object_new (GUM_TYPE_MODULE_MAP, NULL);
 
+  link = gum_module_map_link_new (map);
+
+  map->registry = gum_module_registry_obtain ();
+  map->added_handler = g_signal_connect_data (map->registry, "module-added",
+      G_CALLBACK (gum_module_map_on_module_added),
+      gum_module_map_link_ref (link),
+      (GClosureNotify) gum_module_map_link_unref, 0);
+  map->removed_handler = g_signal_connect_data (map->registry,
+      "module-removed", G_CALLBACK (gum_module_map_on_module_removed),
+      gum_module_map_link_ref (link),
+      (GClosureNotify) gum_module_map_link_unref, 0);
+
+  gum_module_map_link_unref (link);
+
   gum_module_map_update (map);
 
   return map;
@@ -89,42 +189,283 @@ gum_module_map_new_filtered (GumModuleMapFilterFunc func,
   return map;
 }
 
+/**
+ * gum_module_map_find:
+ * @self: a module map
+ * @address: address to look up
+ *
+ * Finds the module containing @address, without taking any locks.
+ *
+ * Returns: (nullable) (transfer none): the module containing @address. It
+ *   stays valid while the module remains in the map. Once it has been
+ *   removed, the map drops its reference as soon as no lookups are in
+ *   flight, so take a reference if you need it beyond that.
+ */
 GumModule *
 gum_module_map_find (GumModuleMap * self,
                      GumAddress address)
 {
+  GumModule * module;
+  GPtrArray * modules;
   GumModule ** entry;
   GumAddress bare_address;
 
   bare_address = gum_strip_code_address (address);
 
-  entry = bsearch (&bare_address, self->modules->pdata, self->modules->len,
+  g_atomic_int_inc (&self->active_readers);
+
+  modules = g_atomic_pointer_get (&self->modules);
+
+  entry = bsearch (&bare_address, modules->pdata, modules->len,
       sizeof (GumModule *), (GCompareFunc) gum_module_compare_to_key);
-  if (entry == NULL)
-    return NULL;
+  module = (entry != NULL) ? *entry : NULL;
 
-  return *entry;
+  if (g_atomic_int_dec_and_test (&self->active_readers) &&
+      g_atomic_int_get (&self->has_retired) &&
+      g_mutex_trylock (&self->mutex))
+  {
+    gum_module_map_release_retired (self);
+    g_mutex_unlock (&self->mutex);
+  }
+
+  return module;
 }
 
 void
 gum_module_map_update (GumModuleMap * self)
 {
-  g_ptr_array_set_size (self->modules, 0);
-  gum_process_enumerate_modules (gum_add_module, self);
-  g_ptr_array_sort (self->modules, (GCompareFunc) gum_module_compare_base);
+  GumCollectModulesContext ctx;
+
+  ctx.map = self;
+  ctx.modules = g_ptr_array_new_full (0, g_object_unref);
+
+  g_mutex_lock (&self->mutex);
+
+  gum_process_enumerate_modules (gum_add_module, &ctx);
+  g_ptr_array_sort (ctx.modules, (GCompareFunc) gum_module_compare_base);
+
+  gum_module_map_publish (self, ctx.modules);
+
+  g_mutex_unlock (&self->mutex);
 }
 
+/**
+ * gum_module_map_get_values:
+ * @self: a module map
+ *
+ * Returns: (transfer none): the modules currently in the map, sorted by base
+ *   address. The array is an immutable snapshot that stays valid until the
+ *   next call to this function, or until the map is disposed.
+ */
 GPtrArray *
 gum_module_map_get_values (GumModuleMap * self)
 {
-  return self->modules;
+  GPtrArray * modules;
+
+  g_mutex_lock (&self->mutex);
+
+  modules = self->modules;
+
+  g_clear_pointer (&self->pinned, g_ptr_array_unref);
+  self->pinned = g_ptr_array_ref (modules);
+
+  g_mutex_unlock (&self->mutex);
+
+  return modules;
+}
+
+static void
+gum_module_map_publish (GumModuleMap * self,
+                        GPtrArray * modules)
+{
+  GPtrArray * previous;
+
+  previous = self->modules;
+  g_atomic_pointer_set (&self->modules, modules);
+
+  g_ptr_array_add (self->retired, previous);
+  g_atomic_int_set (&self->has_retired, TRUE);
+
+  gum_module_map_release_retired (self);
+}
+
+/*
+ * Readers announce themselves before loading the array, so once none are in
+ * flight, nobody can still be looking at the arrays we replaced. The last
+ * reader to leave also gets here, if it can do so without blocking, so
+ * retired arrays don't pile up between changes.
+ *
+ * The retired arrays also hold the last map references to modules that have
+ * since been removed or replaced, which keeps them alive for any reader that
+ * is about to return one of them.
+ */
+static void
+gum_module_map_release_retired (GumModuleMap * self)
+{
+  if (self->retired == NULL || g_atomic_int_get (&self->active_readers) != 0)
+    return;
+
+  g_ptr_array_set_size (self->retired, 0);
+  g_atomic_int_set (&self->has_retired, FALSE);
+}
+
+static void
+gum_module_map_on_module_added (GumModuleRegistry * registry,
+                                GumModule * module,
+                                GumModuleMapLink * link)
+{
+  GumModuleMap * self;
+
+  self = g_weak_ref_get (&link->map);
+  if (self == NULL)
+    return;
+
+  gum_module_map_add (self, module);
+
+  g_object_unref (self);
+}
+
+static void
+gum_module_map_on_module_removed (GumModuleRegistry * registry,
+                                  GumModule * module,
+                                  GumModuleMapLink * link)
+{
+  GumModuleMap * self;
+
+  self = g_weak_ref_get (&link->map);
+  if (self == NULL)
+    return;
+
+  gum_module_map_remove (self, module);
+
+  g_object_unref (self);
+}
+
+/*
+ * The registry emits its signals after dropping its lock, so the removal of a
+ * module may reach us before its addition. We handle that by only adding
+ * modules that are still registered, checked while holding our own lock, and
+ * by only removing the exact module we were told about. Any removal racing
+ * with us has to wait for the lock, and will then find the module.
+ */
+static void
+gum_module_map_add (GumModuleMap * self,
+                    GumModule * module)
+{
+  GumAddress base_address;
+  GPtrArray * registered, * modules;
+  gboolean still_registered;
+  guint index;
+
+  base_address = gum_module_get_range (module)->base_address;
+
+  g_mutex_lock (&self->mutex);
+
+  if (self->modules == NULL)
+    goto beach;
+
+  registered = _gum_module_registry_get_modules (self->registry);
+  still_registered = g_ptr_array_find (registered, module, NULL);
+  g_ptr_array_unref (registered);
+  if (!still_registered)
+    goto beach;
+
+  modules = g_ptr_array_copy (self->modules, (GCopyFunc) g_object_ref, NULL);
+
+  index = gum_find_insertion_index (modules, base_address);
+  if (index != modules->len &&
+      gum_module_get_range (g_ptr_array_index (modules, index))
+          ->base_address == base_address)
+  {
+    GumModule * previous = g_ptr_array_index (modules, index);
+
+    if (previous == module)
+    {
+      g_ptr_array_unref (modules);
+      goto beach;
+    }
+
+    g_ptr_array_index (modules, index) = g_object_ref (module);
+    g_object_unref (previous);
+  }
+  else
+  {
+    g_ptr_array_insert (modules, index, g_object_ref (module));
+  }
+
+  gum_module_map_publish (self, modules);
+
+beach:
+  g_mutex_unlock (&self->mutex);
+}
+
+static void
+gum_module_map_remove (GumModuleMap * self,
+                       GumModule * module)
+{
+  GumAddress base_address;
+  GPtrArray * modules;
+  guint index;
+
+  base_address = gum_module_get_range (module)->base_address;
+
+  g_mutex_lock (&self->mutex);
+
+  if (self->modules == NULL)
+    goto beach;
+
+  index = gum_find_insertion_index (self->modules, base_address);
+  if (index == self->modules->len ||
+      g_ptr_array_index (self->modules, index) != module)
+  {
+    goto beach;
+  }
+
+  modules = g_ptr_array_copy (self->modules, (GCopyFunc) g_object_ref, NULL);
+  g_ptr_array_remove_index (modules, index);
+
+  gum_module_map_publish (self, modules);
+
+beach:
+  g_mutex_unlock (&self->mutex);
+}
+
+static GumModuleMapLink *
+gum_module_map_link_new (GumModuleMap * map)
+{
+  GumModuleMapLink * link;
+
+  link = g_atomic_rc_box_new0 (GumModuleMapLink);
+  g_weak_ref_init (&link->map, map);
+
+  return link;
+}
+
+static GumModuleMapLink *
+gum_module_map_link_ref (GumModuleMapLink * link)
+{
+  return g_atomic_rc_box_acquire (link);
+}
+
+static void
+gum_module_map_link_unref (GumModuleMapLink * link)
+{
+  g_atomic_rc_box_release_full (link,
+      (GDestroyNotify) gum_module_map_link_clear);
+}
+
+static void
+gum_module_map_link_clear (GumModuleMapLink * link)
+{
+  g_weak_ref_clear (&link->map);
 }
 
 static gboolean
 gum_add_module (GumModule * module,
                 gpointer user_data)
 {
-  GumModuleMap * self = user_data;
+  GumCollectModulesContext * ctx = user_data;
+  GumModuleMap * self = ctx->map;
 
   if (self->filter_func != NULL)
   {
@@ -132,11 +473,33 @@ gum_add_module (GumModule * module,
       return TRUE;
   }
 
-  g_ptr_array_add (self->modules, g_object_ref (module));
+  g_ptr_array_add (ctx->modules, g_object_ref (module));
 
   return TRUE;
 }
 
+static guint
+gum_find_insertion_index (GPtrArray * modules,
+                          GumAddress base_address)
+{
+  guint lo, hi;
+
+  lo = 0;
+  hi = modules->len;
+  while (lo < hi)
+  {
+    guint mid = lo + ((hi - lo) / 2);
+    GumModule * module = g_ptr_array_index (modules, mid);
+
+    if (gum_module_get_range (module)->base_address < base_address)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
 static gint
 gum_module_compare_base (GumModule ** lhs_module,
                          GumModule ** rhs_module)
@@ -27,6 +27,8 @@ G_BEGIN_DECLS
 
 GUM_API gboolean gum_symbol_details_from_address (gpointer address,
     GumDebugSymbolDetails * details);
+GUM_API void gum_symbol_details_from_addresses (const gpointer * addresses,
+    guint n_addresses, GumDebugSymbolDetails * details, gboolean * resolved);
 GUM_API gchar * gum_symbol_name_from_address (gpointer address);
 
 GUM_API gpointer gum_find_function (const gchar * name);
@@ -34,6 +36,8 @@ GUM_API GArray * gum_find_functions_named (const gchar * name);
 GUM_API GArray * gum_find_functions_matching (const gchar * str);
 GUM_API gboolean gum_load_symbols (const gchar * path);
 
+GUM_API void gum_symbol_util_set_cache_dir (const gchar * path);
+
 G_END_DECLS
 
 #endif
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2024 Ole André Vadla Ravnås <oleavr@nowsecure.com>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#include "gumworkerpool.h"
+
+#include "gum-init.h"
+
+#define GUM_WORKER_POOL_MIN_JOBS 4
+
+typedef struct _GumWorkerJob GumWorkerJob;
+
+struct _GumWorkerGroup
+{
+  GFunc func;
+  gpointer user_data;
+
+  GMutex mutex;
+  GCond cond;
+  guint pending;
+};
+
+struct _GumWorkerJob
+{
+  GumWorkerGroup * group;
+  gpointer data;
+};
+
+static GThreadPool * gum_worker_pool_obtain (void);
+static void gum_worker_pool_deinit (void);
+static void gum_worker_pool_run (GumWorkerJob * job, gpointer user_data);
+
+static GThreadPool * gum_worker_pool = NULL;
+static GPrivate gum_worker_pool_is_worker;
+
+/*
+ * One pool of threads shared by everything in Gum that fans out work, created
+ * on first use and sized to the number of processors. Jobs are tracked per
+ * group so each caller only ever waits for its own work.
+ *
+ * A job that pushes to a group of its own runs that work inline, as waiting
+ * on the pool from inside it could otherwise starve it of threads.
+ */
+
+guint
+_gum_worker_pool_get_max_workers (void)
+{
+  return g_get_num_processors ();
+}
+
+/*
+ * Calls @func with each of @jobs on the pool and waits for all of them to be
+ * done. If there are too few jobs for this to pay off, nothing is run and
+ * FALSE is returned, leaving it up to the caller whether to run them right
+ * away or only once needed.
+ */
+gboolean
+_gum_worker_pool_try_run_jobs (GPtrArray * jobs,
+                               GFunc func,
+                               gpointer user_data)
+{
+  GumWorkerGroup * group;
+  guint i;
+
+  if (jobs->len < GUM_WORKER_POOL_MIN_JOBS ||
+      _gum_worker_pool_get_max_workers () < 2)
+    return FALSE;
+
+  group = _gum_worker_group_new (func, user_data);
+
+  for (i = 0; i != jobs->len; i++)
+    _gum_worker_group_push (group, g_ptr_array_index (jobs, i));
+
+  _gum_worker_group_free (group);
+
+  return TRUE;
+}
+
+GumWorkerGroup *
+_gum_worker_group_new (GFunc func,
+                       gpointer user_data)
+{
+  GumWorkerGroup * group;
+
+  group = g_slice_new (GumWorkerGroup);
+  group->func = func;
+  group->user_data = user_data;
+
+  g_mutex_init (&group->mutex);
+  g_cond_init (&group->cond);
+  group->pending = 0;
+
+  return group;
+}
+
+void
+_gum_worker_group_free (GumWorkerGroup * group)
+{
+  _gum_worker_group_wait (group);
+
+  g_cond_clear (&group->cond);
+  g_mutex_clear (&group->mutex);
+
+  g_slice_free (GumWorkerGroup, group);
+}
+
+void
+_gum_worker_group_push (GumWorkerGroup * group,
+                        gpointer job)
+{
+  GumWorkerJob * j;
+
+  if (g_private_get (&gum_worker_pool_is_worker) != NULL)
+  {
+    group->func (job, group->user_data);
+    return;
+  }
+
+  j = g_slice_new (GumWorkerJob);
+  j->group = group;
+  j->data = job;
+
+  g_mutex_lock (&group->mutex);
+  group->pending++;
+  g_mutex_unlock (&group->mutex);
+
+  g_thread_pool_push (gum_worker_pool_obtain (), j, NULL);
+}
+
+void
+_gum_worker_group_wait (GumWorkerGroup * group)
+{
+  g_mutex_lock (&group->mutex);
+  while (group->pending != 0)
+    g_cond_wait (&group->cond, &group->mutex);
+  g_mutex_unlock (&group->mutex);
+}
+
+static GThreadPool *
+gum_worker_pool_obtain (void)
+{
+  static gsize initialized = FALSE;
+
+  if (g_once_init_enter (&initialized))
+  {
+    gum_worker_pool = g_thread_pool_new ((GFunc) gum_worker_pool_run, NULL,
+        _gum_worker_pool_get_max_workers (), FALSE, NULL);
+
+    _gum_register_destructor (gum_worker_pool_deinit);
+
+    g_once_init_leave (&initialized, TRUE);
+  }
+
+  return gum_worker_pool;
+}
+
+static void
+gum_worker_pool_deinit (void)
+{
+  g_thread_pool_free (gum_worker_pool, FALSE, TRUE);
+  gum_worker_pool = NULL;
+}
+
+static void
+gum_worker_pool_run (GumWorkerJob * job,
+                     gpointer user_data)
+{
+  GumWorkerGroup * group = job->group;
+
+  g_private_set (&gum_worker_pool_is_worker, GSIZE_TO_POINTER (TRUE));
+
+  group->func (job->data, group->user_data);
+
+  g_slice_free (GumWorkerJob, job);
+
+  g_mutex_lock (&group->mutex);
+  if (--group->pending == 0)
+    g_cond_broadcast (&group->cond);
+  g_mutex_unlock (&group->mutex);
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2024 Ole André Vadla Ravnås <oleavr@nowsecure.com>
+ *
+ * Licence: wxWindows Library Licence, Version 3.1
+ */
+
+#ifndef __GUM_WORKER_POOL_H__
+#define __GUM_WORKER_POOL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GumWorkerGroup GumWorkerGroup;
+
+G_GNUC_INTERNAL guint _gum_worker_pool_get_max_workers (void);
+G_GNUC_INTERNAL gboolean _gum_worker_pool_try_run_jobs (GPtrArray * jobs,
+    GFunc func, gpointer user_data);
+
+G_GNUC_INTERNAL GumWorkerGroup * _gum_worker_group_new (GFunc func,
+    gpointer user_data);
+G_GNUC_INTERNAL void _gum_worker_group_free (GumWorkerGroup * group);
+G_GNUC_INTERNAL void _gum_worker_group_push (GumWorkerGroup * group,
+    gpointer job);
+G_GNUC_INTERNAL void _gum_worker_group_wait (GumWorkerGroup * group);
+
+G_END_DECLS
+
+#endif
@@ -50,6 +50,12 @@ test_api_resolver_fixture_teardown (TestApiResolverFixture * fixture,
   g_clear_object (&fixture->resolver);
 }
 
+static gboolean check_printf_export (const GumApiDetails * details,
+    gpointer user_data);
+static gboolean check_alloc_export (const GumApiDetails * details,
+    gpointer user_data);
+static gboolean count_exports_per_module (const GumApiDetails * details,
+    gpointer user_data);
 static gboolean check_module_import (const GumApiDetails * details,
     gpointer user_data);
 static gboolean check_section (const GumApiDetails * details,
@@ -10,6 +10,9 @@
 TESTLIST_BEGIN (api_resolver)
   TESTENTRY (module_exports_can_be_resolved_case_sensitively)
   TESTENTRY (module_exports_can_be_resolved_case_insensitively)
+  TESTENTRY (module_exports_can_be_resolved_by_suffix)
+  TESTENTRY (module_exports_can_be_resolved_by_infix)
+  TESTENTRY (module_exports_loaded_in_parallel_match_serial_loads)
   TESTENTRY (module_imports_can_be_resolved)
   TESTENTRY (module_sections_can_be_resolved)
   TESTENTRY (objc_methods_can_be_resolved_case_sensitively)
@@ -73,6 +76,146 @@ TESTCASE (module_exports_can_be_resolved_case_insensitively)
   g_assert_cmpuint (ctx.number_of_calls, >, 1);
 }
 
+TESTCASE (module_exports_can_be_resolved_by_suffix)
+{
+  GError * error = NULL;
+  guint number_of_exports_seen = 0;
+
+  fixture->resolver = gum_api_resolver_make ("module");
+  g_assert_nonnull (fixture->resolver);
+
+  gum_api_resolver_enumerate_matches (fixture->resolver, "exports:*!*printf",
+      check_printf_export, &number_of_exports_seen, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (number_of_exports_seen, >, 1);
+
+  number_of_exports_seen = 0;
+  gum_api_resolver_enumerate_matches (fixture->resolver,
+      "exports:*!*PRINTF/i", check_printf_export, &number_of_exports_seen,
+      &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (number_of_exports_seen, >, 1);
+}
+
+static gboolean
+check_printf_export (const GumApiDetails * details,
+                     gpointer user_data)
+{
+  guint * number_of_exports_seen = user_data;
+  gchar * name;
+
+  name = g_ascii_strdown (details->name, -1);
+  g_assert_true (g_str_has_suffix (name, "printf"));
+  g_free (name);
+
+  (*number_of_exports_seen)++;
+
+  return TRUE;
+}
+
+TESTCASE (module_exports_can_be_resolved_by_infix)
+{
+  GError * error = NULL;
+  guint number_of_exports_seen = 0;
+
+  fixture->resolver = gum_api_resolver_make ("module");
+  g_assert_nonnull (fixture->resolver);
+
+  gum_api_resolver_enumerate_matches (fixture->resolver, "exports:*!*alloc*",
+      check_alloc_export, &number_of_exports_seen, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (number_of_exports_seen, >, 1);
+
+  number_of_exports_seen = 0;
+  gum_api_resolver_enumerate_matches (fixture->resolver,
+      "exports:*!*ALLOC*/i", check_alloc_export, &number_of_exports_seen,
+      &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (number_of_exports_seen, >, 1);
+}
+
+static gboolean
+check_alloc_export (const GumApiDetails * details,
+                    gpointer user_data)
+{
+  guint * number_of_exports_seen = user_data;
+  gchar * name;
+
+  name = g_ascii_strdown (strrchr (details->name, '!') + 1, -1);
+  g_assert_nonnull (strstr (name, "alloc"));
+  g_free (name);
+
+  (*number_of_exports_seen)++;
+
+  return TRUE;
+}
+
+TESTCASE (module_exports_loaded_in_parallel_match_serial_loads)
+{
+  GError * error = NULL;
+  GHashTable * exports_per_module;
+  GHashTableIter iter;
+  const gchar * module_path;
+  gpointer n;
+  guint total_exports_seen;
+
+  exports_per_module = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      NULL);
+
+  fixture->resolver = gum_api_resolver_make ("module");
+  gum_api_resolver_enumerate_matches (fixture->resolver, "exports:*!*",
+      count_exports_per_module, exports_per_module, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (g_hash_table_size (exports_per_module), >, 1);
+  g_clear_object (&fixture->resolver);
+
+  fixture->resolver = gum_api_resolver_make ("module");
+  total_exports_seen = 0;
+
+  g_hash_table_iter_init (&iter, exports_per_module);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &module_path, &n))
+  {
+    gchar * query;
+    TestForEachContext ctx;
+
+    query = g_strconcat ("exports:", module_path, "!*", NULL);
+
+    ctx.number_of_calls = 0;
+    ctx.value_to_return = TRUE;
+    gum_api_resolver_enumerate_matches (fixture->resolver, query,
+        match_found_cb, &ctx, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (ctx.number_of_calls, ==, GPOINTER_TO_UINT (n));
+
+    total_exports_seen += ctx.number_of_calls;
+
+    g_free (query);
+  }
+
+  g_assert_cmpuint (total_exports_seen, >, 0);
+
+  g_hash_table_unref (exports_per_module);
+}
+
+static gboolean
+count_exports_per_module (const GumApiDetails * details,
+                          gpointer user_data)
+{
+  GHashTable * exports_per_module = user_data;
+  gchar * module_path;
+  guint n;
+
+  module_path = g_strndup (details->name,
+      strrchr (details->name, '!') - details->name);
+
+  n = GPOINTER_TO_UINT (g_hash_table_lookup (exports_per_module,
+      module_path));
+  g_hash_table_insert (exports_per_module, module_path,
+      GUINT_TO_POINTER (n + 1));
+
+  return TRUE;
+}
+
 TESTCASE (module_imports_can_be_resolved)
 {
 #ifdef HAVE_DARWIN
@@ -116,6 +116,10 @@ struct _TestInterceptorFixture
   ListenerContext * listener_context[2];
 };
 
+static GumAttachReturn interceptor_fixture_try_attach_filtered (
+    TestInterceptorFixture * h, guint listener_index, gpointer test_func,
+    gchar enter_char, gchar leave_char,
+    const GumArgumentPredicate * predicates, guint n_predicates);
 static void listener_context_free (ListenerContext * ctx);
 static void listener_context_on_enter (ListenerContext * self,
     GumInvocationContext * context);
@@ -216,6 +220,20 @@ interceptor_fixture_try_attach (TestInterceptorFixture * h,
                                 gpointer test_func,
                                 gchar enter_char,
                                 gchar leave_char)
+{
+  return interceptor_fixture_try_attach_filtered (h, listener_index, test_func,
+      enter_char, leave_char, NULL, 0);
+}
+
+static GumAttachReturn
+interceptor_fixture_try_attach_filtered (
+    TestInterceptorFixture * h,
+    guint listener_index,
+    gpointer test_func,
+    gchar enter_char,
+    gchar leave_char,
+    const GumArgumentPredicate * predicates,
+    guint n_predicates)
 {
   GumAttachReturn result;
   ListenerContext * ctx;
@@ -240,9 +258,9 @@ interceptor_fixture_try_attach (TestInterceptorFixture * h,
   ctx->enter_char = enter_char;
   ctx->leave_char = leave_char;
 
-  result = gum_interceptor_attach (h->interceptor, test_func,
+  result = gum_interceptor_attach_filtered (h->interceptor, test_func,
       GUM_INVOCATION_LISTENER (ctx->listener), NULL,
-      GUM_ATTACH_FLAGS_NONE);
+      GUM_ATTACH_FLAGS_NONE, predicates, n_predicates);
   if (result == GUM_ATTACH_OK)
   {
     h->listener_context[listener_index] = ctx;
@@ -266,6 +284,20 @@ interceptor_fixture_attach (TestInterceptorFixture * h,
       enter_char, leave_char), ==, GUM_ATTACH_OK);
 }
 
+static void
+interceptor_fixture_attach_filtered (TestInterceptorFixture * h,
+                                     guint listener_index,
+                                     gpointer test_func,
+                                     gchar enter_char,
+                                     gchar leave_char,
+                                     const GumArgumentPredicate * predicates,
+                                     guint n_predicates)
+{
+  g_assert_cmpint (interceptor_fixture_try_attach_filtered (h, listener_index,
+      test_func, enter_char, leave_char, predicates, n_predicates), ==,
+      GUM_ATTACH_OK);
+}
+
 static void
 interceptor_fixture_detach (TestInterceptorFixture * h,
                             guint listener_index)
@@ -50,8 +50,20 @@ TESTLIST_BEGIN (interceptor)
   TESTENTRY (ignore_current_thread_nested)
   TESTENTRY (ignore_other_threads)
   TESTENTRY (detach)
+  TESTENTRY (detach_reclaims_listener)
+  TESTENTRY (detach_reclaims_listener_despite_blocked_thread)
+  TESTENTRY (code_stats)
   TESTENTRY (listener_ref_count)
   TESTENTRY (function_data)
+  TESTENTRY (attach_filtered_by_value)
+  TESTENTRY (attach_filtered_by_range)
+  TESTENTRY (attach_filtered_by_prefix)
+  TESTENTRY (attach_filtered_alongside_unfiltered)
+  TESTENTRY (attach_filtered_beyond_listener_limit)
+#if defined (HAVE_LINUX) && !defined (HAVE_ANDROID) && \
+    (defined (HAVE_I386) || defined (HAVE_ARM64))
+  TESTENTRY (attach_in_imports_mode)
+#endif
 
   TESTENTRY (i_can_has_replaceability)
   TESTENTRY (already_replaced)
@@ -73,9 +85,23 @@ TESTLIST_BEGIN (interceptor)
   TESTENTRY (fast_interceptor_performance)
 TESTLIST_END ()
 
+typedef struct _BlockedCall BlockedCall;
+
+struct _BlockedCall
+{
+  GMutex mutex;
+  GCond cond;
+  gboolean entered;
+  gboolean released;
+};
+
 #ifdef HAVE_WINDOWS
 static gpointer hit_target_function_repeatedly (gpointer data);
 #endif
+static void on_probe_hit (GumInvocationContext * context,
+    gpointer user_data);
+static gpointer make_blocked_call (gpointer data);
+static void block_until_released (BlockedCall * call);
 static gpointer replacement_malloc (gsize size);
 static gpointer replacement_target_function (GString * str);
 static gpointer (* target_function_fast) (GString * str) = NULL;
@@ -263,6 +289,172 @@ TESTCASE (function_arguments)
       ==, 0x12349876);
 }
 
+TESTCASE (attach_filtered_by_value)
+{
+  GumArgumentPredicate predicate = { 0, };
+
+  predicate.type = GUM_ARGUMENT_PREDICATE_EQUAL;
+  predicate.index = 0;
+  predicate.value = 0x1200;
+  predicate.mask = 0xff00;
+
+  interceptor_fixture_attach_filtered (fixture, 0, target_nop_function_a,
+      'a', 'b', &predicate, 1);
+
+  target_nop_function_a (GSIZE_TO_POINTER (0x3456));
+  g_assert_cmpstr (fixture->result->str, ==, "");
+
+  target_nop_function_a (GSIZE_TO_POINTER (0x1234));
+  g_assert_cmpstr (fixture->result->str, ==, "ab");
+  g_assert_cmphex (fixture->listener_context[0]->last_seen_argument,
+      ==, 0x1234);
+}
+
+TESTCASE (attach_filtered_by_range)
+{
+  GumArgumentPredicate predicate = { 0, };
+
+  predicate.type = GUM_ARGUMENT_PREDICATE_RANGE;
+  predicate.index = 0;
+  predicate.min = 10;
+  predicate.max = 20;
+
+  interceptor_fixture_attach_filtered (fixture, 0, target_nop_function_a,
+      'a', 'b', &predicate, 1);
+
+  target_nop_function_a (GSIZE_TO_POINTER (9));
+  target_nop_function_a (GSIZE_TO_POINTER (10));
+  target_nop_function_a (GSIZE_TO_POINTER (20));
+  target_nop_function_a (GSIZE_TO_POINTER (21));
+  g_assert_cmpstr (fixture->result->str, ==, "abab");
+}
+
+TESTCASE (attach_filtered_by_prefix)
+{
+  GumArgumentPredicate predicate = { 0, };
+
+  predicate.type = GUM_ARGUMENT_PREDICATE_PREFIX;
+  predicate.index = 0;
+  predicate.prefix = "/etc";
+  predicate.prefix_size = 4;
+
+  interceptor_fixture_attach_filtered (fixture, 0, target_nop_function_a,
+      'a', 'b', &predicate, 1);
+
+  target_nop_function_a (NULL);
+  target_nop_function_a (GSIZE_TO_POINTER (1));
+  target_nop_function_a ("/usr/lib/libc.so");
+  g_assert_cmpstr (fixture->result->str, ==, "");
+
+  target_nop_function_a ("/etc/hosts");
+  g_assert_cmpstr (fixture->result->str, ==, "ab");
+}
+
+TESTCASE (attach_filtered_alongside_unfiltered)
+{
+  GumArgumentPredicate predicate = { 0, };
+
+  predicate.type = GUM_ARGUMENT_PREDICATE_EQUAL;
+  predicate.index = 0;
+  predicate.value = 2;
+  predicate.mask = G_MAXSIZE;
+
+  interceptor_fixture_attach_filtered (fixture, 0, target_nop_function_a,
+      'a', 'b', &predicate, 1);
+  interceptor_fixture_attach (fixture, 1, target_nop_function_a, 'c', 'd');
+
+  target_nop_function_a (GSIZE_TO_POINTER (1));
+  g_assert_cmpstr (fixture->result->str, ==, "cd");
+
+  g_string_truncate (fixture->result, 0);
+  target_nop_function_a (GSIZE_TO_POINTER (2));
+  g_assert_cmpstr (fixture->result->str, ==, "acbd");
+}
+
+TESTCASE (attach_filtered_beyond_listener_limit)
+{
+  GumArgumentPredicate predicate = { 0, };
+  GPtrArray * listeners;
+  GumInvocationListener * filtered_listener;
+  guint i;
+
+  predicate.type = GUM_ARGUMENT_PREDICATE_EQUAL;
+  predicate.index = 0;
+  predicate.value = 2;
+  predicate.mask = G_MAXSIZE;
+
+  listeners = g_ptr_array_new_with_free_func (g_object_unref);
+  for (i = 0; i != 32; i++)
+  {
+    GumInvocationListener * listener =
+        gum_make_probe_listener (on_probe_hit, NULL, NULL);
+
+    g_assert_cmpint (gum_interceptor_attach (fixture->interceptor,
+        target_nop_function_a, listener, NULL, GUM_ATTACH_FLAGS_NONE), ==,
+        GUM_ATTACH_OK);
+    g_ptr_array_add (listeners, listener);
+  }
+
+  filtered_listener = gum_make_probe_listener (on_probe_hit, NULL, NULL);
+  g_assert_cmpint (gum_interceptor_attach_filtered (fixture->interceptor,
+      target_nop_function_a, filtered_listener, NULL, GUM_ATTACH_FLAGS_NONE,
+      &predicate, 1), ==, GUM_ATTACH_TOO_MANY_FILTERED);
+
+  gum_interceptor_detach (fixture->interceptor, g_ptr_array_index (listeners,
+      0));
+  g_assert_cmpint (gum_interceptor_attach_filtered (fixture->interceptor,
+      target_nop_function_a, filtered_listener, NULL, GUM_ATTACH_FLAGS_NONE,
+      &predicate, 1), ==, GUM_ATTACH_OK);
+
+  for (i = 0; i != listeners->len; i++)
+  {
+    gum_interceptor_detach (fixture->interceptor,
+        g_ptr_array_index (listeners, i));
+  }
+  gum_interceptor_detach (fixture->interceptor, filtered_listener);
+
+  g_object_unref (filtered_listener);
+  g_ptr_array_unref (listeners);
+}
+
+static void
+on_probe_hit (GumInvocationContext * context,
+                 gpointer user_data)
+{
+}
+
+#if defined (HAVE_LINUX) && !defined (HAVE_ANDROID) && \
+    (defined (HAVE_I386) || defined (HAVE_ARM64))
+
+TESTCASE (attach_in_imports_mode)
+{
+  gpointer getpid_impl;
+  pid_t expected_pid;
+
+  getpid_impl = GSIZE_TO_POINTER (
+      gum_module_find_global_export_by_name ("getpid"));
+  g_assert_nonnull (getpid_impl);
+
+  /* Make sure our import slot is bound. */
+  expected_pid = getpid ();
+
+  gum_interceptor_set_mode (fixture->interceptor,
+      GUM_INTERCEPTOR_MODE_IMPORTS);
+  interceptor_fixture_attach (fixture, 0, getpid_impl, '>', '<');
+  gum_interceptor_set_mode (fixture->interceptor, GUM_INTERCEPTOR_MODE_INLINE);
+
+  g_assert_cmpint (getpid (), ==, expected_pid);
+  g_assert_cmpstr (fixture->result->str, ==, "><");
+
+  interceptor_fixture_detach (fixture, 0);
+  g_string_truncate (fixture->result, 0);
+
+  g_assert_cmpint (getpid (), ==, expected_pid);
+  g_assert_cmpstr (fixture->result->str, ==, "");
+}
+
+#endif
+
 TESTCASE (function_return_value)
 {
   gpointer return_value;
@@ -368,6 +560,103 @@ TESTCASE (detach)
   g_assert_cmpstr (fixture->result->str, ==, "c|d");
 }
 
+TESTCASE (detach_reclaims_listener)
+{
+  GObject * listener;
+
+  interceptor_fixture_attach (fixture, 0, target_function, 'a', 'b');
+  listener = G_OBJECT (fixture->listener_context[0]->listener);
+
+  target_function (fixture->result);
+  g_assert_cmpstr (fixture->result->str, ==, "a|b");
+
+  interceptor_fixture_detach (fixture, 0);
+  g_assert_true (gum_interceptor_flush (fixture->interceptor));
+  g_assert_cmpuint (listener->ref_count, ==, 1);
+}
+
+TESTCASE (detach_reclaims_listener_despite_blocked_thread)
+{
+  BlockedCall call;
+  GThread * thread;
+  GObject * listener;
+
+  g_mutex_init (&call.mutex);
+  g_cond_init (&call.cond);
+  call.entered = FALSE;
+  call.released = FALSE;
+
+  interceptor_fixture_attach (fixture, 0, target_function, 'a', 'b');
+  listener = G_OBJECT (fixture->listener_context[0]->listener);
+  interceptor_fixture_attach (fixture, 1, block_until_released, 'c', 'd');
+
+  thread = g_thread_new ("interceptor-test-blocked", make_blocked_call, &call);
+
+  g_mutex_lock (&call.mutex);
+  while (!call.entered)
+    g_cond_wait (&call.cond, &call.mutex);
+  g_mutex_unlock (&call.mutex);
+
+  interceptor_fixture_detach (fixture, 0);
+  g_assert_true (gum_interceptor_flush (fixture->interceptor));
+  g_assert_cmpuint (listener->ref_count, ==, 1);
+
+  g_mutex_lock (&call.mutex);
+  call.released = TRUE;
+  g_cond_broadcast (&call.cond);
+  g_mutex_unlock (&call.mutex);
+
+  g_thread_join (thread);
+
+  g_cond_clear (&call.cond);
+  g_mutex_clear (&call.mutex);
+}
+
+static gpointer
+make_blocked_call (gpointer data)
+{
+  block_until_released (data);
+
+  return NULL;
+}
+
+GUM_HOOK_TARGET static void
+block_until_released (BlockedCall * call)
+{
+  g_mutex_lock (&call->mutex);
+
+  call->entered = TRUE;
+  g_cond_broadcast (&call->cond);
+
+  while (!call->released)
+    g_cond_wait (&call->cond, &call->mutex);
+
+  g_mutex_unlock (&call->mutex);
+}
+
+TESTCASE (code_stats)
+{
+  GumCodeAllocatorStats before, after;
+
+  gum_interceptor_query_code_stats (fixture->interceptor, &before);
+  g_assert_cmpuint (before.slice_size, !=, 0);
+
+  interceptor_fixture_attach (fixture, 0, target_nop_function_a, 'a', 'b');
+  interceptor_fixture_attach (fixture, 1, target_nop_function_b, 'c', 'd');
+
+  gum_interceptor_query_code_stats (fixture->interceptor, &after);
+  g_assert_cmpuint (after.num_batches, >=, 1);
+  g_assert_cmpuint (after.mapped_size, >=,
+      after.num_slices_in_use * after.slice_size);
+#if defined (HAVE_I386)
+  if (gum_query_is_rwx_supported ())
+  {
+    g_assert_cmpint (
+        (gint) after.num_slices_in_use - (gint) before.num_slices_in_use, <, 2);
+  }
+#endif
+}
+
 TESTCASE (listener_ref_count)
 {
   interceptor_fixture_attach (fixture, 0, target_function, 'a', 'b');
@@ -7,6 +7,12 @@
 #include "testutil.h"
 
 #include "gummemory-priv.h"
+#include "gummemorysnapshot.h"
+#ifdef HAVE_LINUX
+# include "gum/gumlinux.h"
+
+# include <sys/mman.h>
+#endif
 
 #define TESTCASE(NAME) \
     void test_memory_ ## NAME (void)
@@ -19,6 +25,7 @@ TESTLIST_BEGIN (memory)
   TESTENTRY (read_from_unaligned_address_should_succeed)
   TESTENTRY (read_across_two_pages_should_return_correct_data)
   TESTENTRY (read_beyond_page_should_return_partial_data)
+  TESTENTRY (read_many_should_report_status_of_each_range)
   TESTENTRY (write_to_valid_address_should_succeed)
   TESTENTRY (write_to_invalid_address_should_fail)
   TESTENTRY (match_pattern_from_string_does_proper_validation)
@@ -26,7 +33,20 @@ TESTLIST_BEGIN (memory)
   TESTENTRY (scan_range_finds_three_wildcarded_matches)
   TESTENTRY (scan_range_finds_three_masked_matches)
   TESTENTRY (scan_range_finds_three_regex_matches)
+  TESTENTRY (scan_range_finds_matches_spanning_vector_blocks)
+  TESTENTRY (scan_range_finds_matches_of_multiple_patterns)
+  TESTENTRY (scan_range_in_parallel_matches_sequential_scan)
+  TESTENTRY (scan_range_in_parallel_can_be_stopped_early)
   TESTENTRY (is_memory_readable_handles_mixed_page_protections)
+  TESTENTRY (query_protection_reflects_mprotect)
+#ifdef HAVE_LINUX
+  TESTENTRY (is_memory_readable_notices_foreign_unmap)
+  TESTENTRY (query_protection_notices_foreign_mprotect)
+  TESTENTRY (soft_dirty_pages_reflect_writes)
+  TESTENTRY (snapshot_tracking_dirty_pages_sees_writes)
+#endif
+  TESTENTRY (snapshot_diff_reports_changed_runs)
+  TESTENTRY (small_allocations_are_recycled_across_threads)
   TESTENTRY (alloc_n_pages_returns_aligned_rw_address)
   TESTENTRY (alloc_n_pages_near_returns_aligned_rw_address_within_range)
   TESTENTRY (allocate_handles_alignment)
@@ -42,8 +62,29 @@ typedef struct _TestForEachContext {
   guint expected_size;
 } TestForEachContext;
 
+typedef struct _TestStoreMatchesContext {
+  GArray * matches;
+  guint limit;
+} TestStoreMatchesContext;
+
+typedef struct _TestMultiScanContext {
+  gboolean value_to_return;
+  guint number_of_calls;
+
+  GumAddress address[3][3];
+  gsize size[3][3];
+  guint number_of_matches[3];
+} TestMultiScanContext;
+
 static gboolean match_found_cb (GumAddress address, gsize size,
     gpointer user_data);
+static gboolean store_match_cb (GumAddress address, gsize size,
+    gpointer user_data);
+static gboolean store_matches_until_limit_cb (GumAddress address, gsize size,
+    gpointer user_data);
+static gboolean multi_match_found_cb (guint pattern_index, GumAddress address,
+    gsize size, gpointer user_data);
+static gpointer churn_small_allocations (gpointer data);
 
 TESTCASE (read_from_valid_address_should_succeed)
 {
@@ -149,6 +190,54 @@ TESTCASE (read_beyond_page_should_return_partial_data)
   gum_free_pages (page);
 }
 
+TESTCASE (read_many_should_report_status_of_each_range)
+{
+  guint8 * page;
+  guint page_size;
+  GumMemoryRange ranges[4];
+  guint8 buffer[2 + 8 + 4 + 3];
+  gsize n_bytes_read[G_N_ELEMENTS (ranges)];
+
+  page = gum_alloc_n_pages (2, GUM_PAGE_RW);
+  page_size = gum_query_page_size ();
+  page[0] = 0x13;
+  page[1] = 0x37;
+  page[page_size - 2] = 0xaa;
+  page[page_size - 1] = 0xbb;
+  page[42] = 0x01;
+  page[43] = 0x02;
+  page[44] = 0x03;
+  gum_mprotect (page + page_size, page_size, GUM_PAGE_NO_ACCESS);
+
+  ranges[0].base_address = GUM_ADDRESS (page);
+  ranges[0].size = 2;
+  ranges[1].base_address = 0x42;
+  ranges[1].size = 8;
+  ranges[2].base_address = GUM_ADDRESS (page + page_size - 2);
+  ranges[2].size = 4;
+  ranges[3].base_address = GUM_ADDRESS (page + 42);
+  ranges[3].size = 3;
+
+  gum_memory_read_many (ranges, G_N_ELEMENTS (ranges), buffer, n_bytes_read);
+
+  g_assert_cmpuint (n_bytes_read[0], ==, 2);
+  g_assert_cmphex (buffer[0], ==, 0x13);
+  g_assert_cmphex (buffer[1], ==, 0x37);
+
+  g_assert_cmpuint (n_bytes_read[1], ==, 0);
+
+  g_assert_cmpuint (n_bytes_read[2], ==, 2);
+  g_assert_cmphex (buffer[2 + 8 + 0], ==, 0xaa);
+  g_assert_cmphex (buffer[2 + 8 + 1], ==, 0xbb);
+
+  g_assert_cmpuint (n_bytes_read[3], ==, 3);
+  g_assert_cmphex (buffer[2 + 8 + 4 + 0], ==, 0x01);
+  g_assert_cmphex (buffer[2 + 8 + 4 + 1], ==, 0x02);
+  g_assert_cmphex (buffer[2 + 8 + 4 + 2], ==, 0x03);
+
+  gum_free_pages (page);
+}
+
 TESTCASE (write_to_valid_address_should_succeed)
 {
   guint8 bytes[3] = { 0x00, 0x00, 0x12 };
@@ -406,6 +495,193 @@ TESTCASE (scan_range_finds_three_regex_matches)
   gum_match_pattern_unref (pattern);
 }
 
+TESTCASE (scan_range_finds_matches_spanning_vector_blocks)
+{
+  guint8 buf[100] = { 0, };
+  GumMemoryRange range;
+  GumMatchPattern * pattern;
+  TestForEachContext ctx;
+
+  buf[31] = 0x13;
+  buf[32] = 0x37;
+  buf[50] = 0x13;
+  buf[51] = 0x37;
+  buf[98] = 0x13;
+  buf[99] = 0x37;
+
+  range.base_address = GUM_ADDRESS (buf);
+  range.size = sizeof (buf);
+
+  ctx.expected_address[0] = buf + 31;
+  ctx.expected_address[1] = buf + 50;
+  ctx.expected_address[2] = buf + 98;
+  ctx.expected_size = 2;
+
+  pattern = gum_match_pattern_new_from_string ("13 37");
+  g_assert_nonnull (pattern);
+
+  ctx.number_of_calls = 0;
+  ctx.value_to_return = TRUE;
+  gum_memory_scan (&range, pattern, match_found_cb, &ctx);
+  g_assert_cmpuint (ctx.number_of_calls, ==, 3);
+
+  gum_match_pattern_unref (pattern);
+
+  buf[50] = 0x1c;
+
+  pattern = gum_match_pattern_new_from_string ("10 37 : f0 ff");
+  g_assert_nonnull (pattern);
+
+  ctx.number_of_calls = 0;
+  ctx.value_to_return = TRUE;
+  gum_memory_scan (&range, pattern, match_found_cb, &ctx);
+  g_assert_cmpuint (ctx.number_of_calls, ==, 3);
+
+  gum_match_pattern_unref (pattern);
+}
+
+TESTCASE (scan_range_finds_matches_of_multiple_patterns)
+{
+  gchar buf[] = {
+    0x13, 0x37,
+    0x12, 0x00, 0x13, 0x37,
+    0x72, 0xc0, 0x13,
+    'B', 'r', 'a', 'i', 'n',
+    0x12
+  };
+  GumMemoryRange range;
+  GumMatchPattern * patterns[3];
+  TestMultiScanContext ctx;
+
+  range.base_address = GUM_ADDRESS (buf);
+  range.size = sizeof (buf);
+
+  patterns[0] = gum_match_pattern_new_from_string ("13 37");
+  patterns[1] = gum_match_pattern_new_from_string ("12 ?? 13 : 1f ff ff");
+  patterns[2] = gum_match_pattern_new_from_string ("/Br[a-z]+/");
+
+  memset (&ctx, 0, sizeof (ctx));
+  ctx.value_to_return = TRUE;
+  gum_memory_scan_multi (&range, patterns, G_N_ELEMENTS (patterns),
+      multi_match_found_cb, &ctx);
+  g_assert_cmpuint (ctx.number_of_calls, ==, 5);
+
+  g_assert_cmpuint (ctx.number_of_matches[0], ==, 2);
+  g_assert_cmphex (ctx.address[0][0], ==, GUM_ADDRESS (buf + 0));
+  g_assert_cmphex (ctx.address[0][1], ==, GUM_ADDRESS (buf + 4));
+  g_assert_cmpuint (ctx.size[0][0], ==, 2);
+  g_assert_cmpuint (ctx.size[0][1], ==, 2);
+
+  g_assert_cmpuint (ctx.number_of_matches[1], ==, 2);
+  g_assert_cmphex (MIN (ctx.address[1][0], ctx.address[1][1]), ==,
+      GUM_ADDRESS (buf + 2));
+  g_assert_cmphex (MAX (ctx.address[1][0], ctx.address[1][1]), ==,
+      GUM_ADDRESS (buf + 6));
+  g_assert_cmpuint (ctx.size[1][0], ==, 3);
+  g_assert_cmpuint (ctx.size[1][1], ==, 3);
+
+  g_assert_cmpuint (ctx.number_of_matches[2], ==, 1);
+  g_assert_cmphex (ctx.address[2][0], ==, GUM_ADDRESS (buf + 9));
+  g_assert_cmpuint (ctx.size[2][0], ==, 5);
+
+  memset (&ctx, 0, sizeof (ctx));
+  ctx.value_to_return = FALSE;
+  gum_memory_scan_multi (&range, patterns, G_N_ELEMENTS (patterns),
+      multi_match_found_cb, &ctx);
+  g_assert_cmpuint (ctx.number_of_calls, ==, 1);
+
+  gum_match_pattern_unref (patterns[2]);
+  gum_match_pattern_unref (patterns[1]);
+  gum_match_pattern_unref (patterns[0]);
+}
+
+TESTCASE (scan_range_in_parallel_matches_sequential_scan)
+{
+  const gsize mib = 1024 * 1024;
+  guint8 * buf;
+  gsize size, offsets[] = { 0, mib - 3, 2 * mib - 1, 3 * mib - 2 };
+  GumMemoryRange range;
+  GumMatchPattern * pattern;
+  GArray * expected, * actual;
+  guint i;
+
+  size = 4 * mib;
+  buf = gum_alloc_n_pages (size / gum_query_page_size (), GUM_PAGE_RW);
+  for (i = 0; i != G_N_ELEMENTS (offsets); i++)
+    memset (buf + offsets[i], 0xaa, 7);
+  buf[size - 2] = 0xaa;
+  buf[size - 1] = 0xaa;
+
+  range.base_address = GUM_ADDRESS (buf);
+  range.size = size;
+
+  pattern = gum_match_pattern_new_from_string ("aa aa");
+
+  expected = g_array_new (FALSE, FALSE, sizeof (GumMemoryRange));
+  gum_memory_scan (&range, pattern, store_match_cb, expected);
+  g_assert_cmpuint (expected->len, ==, 13);
+
+  actual = g_array_new (FALSE, FALSE, sizeof (GumMemoryRange));
+  gum_memory_scan_parallel (&range, pattern, 4, store_match_cb, actual);
+  g_assert_cmpuint (actual->len, ==, expected->len);
+  for (i = 0; i != expected->len; i++)
+  {
+    GumMemoryRange * e = &g_array_index (expected, GumMemoryRange, i);
+    GumMemoryRange * a = &g_array_index (actual, GumMemoryRange, i);
+
+    g_assert_cmphex (a->base_address, ==, e->base_address);
+    g_assert_cmpuint (a->size, ==, e->size);
+  }
+
+  g_array_free (actual, TRUE);
+  g_array_free (expected, TRUE);
+  gum_match_pattern_unref (pattern);
+  gum_free_pages (buf);
+}
+
+TESTCASE (scan_range_in_parallel_can_be_stopped_early)
+{
+  const gsize mib = 1024 * 1024;
+  guint8 * buf;
+  gsize size;
+  GumMemoryRange range;
+  GumMatchPattern * pattern;
+  TestStoreMatchesContext expected, actual;
+  guint i;
+
+  size = 8 * mib;
+  buf = gum_alloc_n_pages (size / gum_query_page_size (), GUM_PAGE_RW);
+  memset (buf, 0xaa, size);
+
+  range.base_address = GUM_ADDRESS (buf);
+  range.size = size;
+
+  pattern = gum_match_pattern_new_from_string ("aa aa aa");
+
+  expected.matches = g_array_new (FALSE, FALSE, sizeof (GumMemoryRange));
+  expected.limit = 500000;
+  gum_memory_scan (&range, pattern, store_matches_until_limit_cb, &expected);
+  g_assert_cmpuint (expected.matches->len, ==, expected.limit);
+
+  actual.matches = g_array_new (FALSE, FALSE, sizeof (GumMemoryRange));
+  actual.limit = expected.limit;
+  gum_memory_scan_parallel (&range, pattern, 4, store_matches_until_limit_cb,
+      &actual);
+  g_assert_cmpuint (actual.matches->len, ==, expected.matches->len);
+  for (i = 0; i != expected.matches->len; i++)
+  {
+    GumMemoryRange * e = &g_array_index (expected.matches, GumMemoryRange, i);
+    GumMemoryRange * a = &g_array_index (actual.matches, GumMemoryRange, i);
+
+    g_assert_cmphex (a->base_address, ==, e->base_address);
+  }
+
+  g_array_free (actual.matches, TRUE);
+  g_array_free (expected.matches, TRUE);
+  gum_match_pattern_unref (pattern);
+  gum_free_pages (buf);
+}
+
 TESTCASE (is_memory_readable_handles_mixed_page_protections)
 {
   guint8 * pages;
@@ -441,6 +717,296 @@ TESTCASE (is_memory_readable_handles_mixed_page_protections)
   gum_free_pages (pages);
 }
 
+TESTCASE (query_protection_reflects_mprotect)
+{
+  guint8 * page;
+  GumPageProtection prot;
+
+  page = gum_alloc_n_pages (1, GUM_PAGE_RW);
+
+  g_assert_true (gum_memory_query_protection (page, &prot));
+  g_assert_cmpuint (prot, ==, GUM_PAGE_RW);
+
+  gum_mprotect (page, gum_query_page_size (), GUM_PAGE_READ);
+  g_assert_true (gum_memory_query_protection (page, &prot));
+  g_assert_cmpuint (prot, ==, GUM_PAGE_READ);
+
+  gum_mprotect (page, gum_query_page_size (), GUM_PAGE_NO_ACCESS);
+  g_assert_false (gum_memory_is_readable (page, 1));
+
+  gum_mprotect (page, gum_query_page_size (), GUM_PAGE_RW);
+  gum_free_pages (page);
+}
+
+#ifdef HAVE_LINUX
+
+TESTCASE (is_memory_readable_notices_foreign_unmap)
+{
+  gsize page_size;
+  guint8 * pages;
+
+  page_size = gum_query_page_size ();
+
+  pages = mmap (NULL, 2 * page_size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  g_assert_true (pages != (guint8 *) MAP_FAILED);
+
+  g_assert_true (gum_memory_is_readable (pages, 2 * page_size));
+
+  munmap (pages + page_size, page_size);
+
+  g_assert_true (gum_memory_is_readable (pages, page_size));
+  g_assert_false (gum_memory_is_readable (pages, 2 * page_size));
+  g_assert_false (gum_memory_is_readable (pages + page_size, 1));
+
+  munmap (pages, page_size);
+
+  g_assert_false (gum_memory_is_readable (pages, 1));
+}
+
+TESTCASE (query_protection_notices_foreign_mprotect)
+{
+  const guint n_pages = 100;
+  gsize page_size;
+  guint8 * pages, * last_page;
+  GumPageProtection prot;
+
+  page_size = gum_query_page_size ();
+
+  pages = mmap (NULL, n_pages * page_size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  g_assert_true (pages != (guint8 *) MAP_FAILED);
+  last_page = pages + (n_pages - 1) * page_size;
+
+  g_assert_true (gum_memory_query_protection (last_page, &prot));
+  g_assert_cmpuint (prot, ==, GUM_PAGE_RW);
+  g_assert_true (gum_memory_is_readable (pages, n_pages * page_size));
+
+  g_assert_cmpint (mprotect (last_page, page_size, PROT_NONE), ==, 0);
+
+  g_assert_true (gum_memory_query_protection (last_page, &prot));
+  g_assert_cmpuint (prot, ==, GUM_PAGE_NO_ACCESS);
+  g_assert_true (gum_memory_is_readable (pages, (n_pages - 1) * page_size));
+  g_assert_false (gum_memory_is_readable (pages, n_pages * page_size));
+
+  munmap (pages, n_pages * page_size);
+}
+
+TESTCASE (soft_dirty_pages_reflect_writes)
+{
+  guint8 * pages;
+  guint page_size, i;
+  GumMemoryRange range;
+  guint8 bitmap;
+  GError * error = NULL;
+
+  page_size = gum_query_page_size ();
+  pages = gum_alloc_n_pages (4, GUM_PAGE_RW);
+  for (i = 0; i != 4; i++)
+    pages[i * page_size] = 1;
+
+  if (!gum_linux_reset_soft_dirty (&error))
+  {
+    g_print ("<skipping, not supported by kernel> ");
+    g_error_free (error);
+    gum_free_pages (pages);
+    return;
+  }
+
+  pages[(1 * page_size) + 42] = 2;
+  pages[(3 * page_size) + 7] = 3;
+
+  range.base_address = GUM_ADDRESS (pages + 1);
+  range.size = (4 * page_size) - 2;
+
+  bitmap = 0xff;
+  g_assert_true (gum_linux_query_soft_dirty_pages (&range, &bitmap, &error));
+  g_assert_no_error (error);
+  g_assert_cmphex (bitmap, ==, (1 << 1) | (1 << 3));
+
+  gum_free_pages (pages);
+}
+
+TESTCASE (snapshot_tracking_dirty_pages_sees_writes)
+{
+  guint8 * pages;
+  guint page_size, i;
+  GumMemoryRange range;
+  GumMemorySnapshot * first, * second, * third;
+  GArray * changes;
+  GumMemoryChange * c;
+  GError * error = NULL;
+
+  page_size = gum_query_page_size ();
+  pages = gum_alloc_n_pages (4, GUM_PAGE_RW);
+  for (i = 0; i != 4; i++)
+    memset (pages + (i * page_size), 0x10 + i, page_size);
+
+  range.base_address = GUM_ADDRESS (pages);
+  range.size = 4 * page_size;
+
+  first = gum_memory_snapshot_take (&range, 1, NULL,
+      GUM_MEMORY_SNAPSHOT_TRACK_DIRTY);
+
+  pages[(2 * page_size) + 5] = 0x55;
+
+  second = gum_memory_snapshot_take (&range, 1, first,
+      GUM_MEMORY_SNAPSHOT_TRACK_DIRTY);
+
+  changes = gum_memory_snapshot_diff (first, second, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (changes->len, ==, 1);
+  c = &g_array_index (changes, GumMemoryChange, 0);
+  g_assert_cmpuint (c->offset, ==, (2 * page_size) + 5);
+  g_assert_cmpuint (c->size, ==, 1);
+  g_array_free (changes, TRUE);
+
+  changes = gum_memory_snapshot_diff (second, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (changes->len, ==, 0);
+  g_array_free (changes, TRUE);
+
+  pages[0] = 0x66;
+  pages[(3 * page_size) - 1] = 0x77;
+
+  third = gum_memory_snapshot_take (&range, 1, second,
+      GUM_MEMORY_SNAPSHOT_TRACK_DIRTY);
+
+  changes = gum_memory_snapshot_diff (second, third, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (changes->len, ==, 2);
+  c = &g_array_index (changes, GumMemoryChange, 0);
+  g_assert_cmpuint (c->offset, ==, 0);
+  g_assert_cmpuint (c->size, ==, 1);
+  c = &g_array_index (changes, GumMemoryChange, 1);
+  g_assert_cmpuint (c->offset, ==, (3 * page_size) - 1);
+  g_assert_cmpuint (c->size, ==, 1);
+  g_array_free (changes, TRUE);
+
+  gum_memory_snapshot_unref (third);
+  gum_memory_snapshot_unref (second);
+  gum_memory_snapshot_unref (first);
+  gum_free_pages (pages);
+}
+
+#endif
+
+TESTCASE (snapshot_diff_reports_changed_runs)
+{
+  guint8 * pages;
+  guint page_size;
+  GumMemoryRange range, other_range;
+  GumMemorySnapshot * before, * after, * other;
+  GArray * changes;
+  GumMemoryChange * c;
+  GError * error = NULL;
+
+  page_size = gum_query_page_size ();
+  pages = gum_alloc_n_pages (3, GUM_PAGE_RW);
+  memset (pages, 0x11, page_size);
+  memset (pages + (2 * page_size), 0x22, page_size);
+
+  range.base_address = GUM_ADDRESS (pages + 16);
+  range.size = (3 * page_size) - 32;
+
+  before = gum_memory_snapshot_take (&range, 1, NULL,
+      GUM_MEMORY_SNAPSHOT_FLAGS_NONE);
+  g_assert_cmpuint (gum_memory_snapshot_get_size (before), ==, range.size);
+  g_assert_cmpuint (gum_memory_snapshot_get_unique_page_count (before), ==, 2);
+
+  changes = gum_memory_snapshot_diff (before, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (changes->len, ==, 0);
+  g_array_free (changes, TRUE);
+
+  pages[(2 * page_size) - 1] = 0x01;
+  pages[2 * page_size] = 0x33;
+  memset (pages + (2 * page_size) + 100, 0x44, 4);
+
+  changes = gum_memory_snapshot_diff (before, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (changes->len, ==, 2);
+  c = &g_array_index (changes, GumMemoryChange, 0);
+  g_assert_cmpuint (c->offset, ==, (2 * page_size) - 1 - 16);
+  g_assert_cmpuint (c->size, ==, 2);
+  c = &g_array_index (changes, GumMemoryChange, 1);
+  g_assert_cmpuint (c->offset, ==, (2 * page_size) + 100 - 16);
+  g_assert_cmpuint (c->size, ==, 4);
+  g_array_free (changes, TRUE);
+
+  after = gum_memory_snapshot_take (&range, 1, before,
+      GUM_MEMORY_SNAPSHOT_FLAGS_NONE);
+  g_assert_cmpuint (gum_memory_snapshot_get_unique_page_count (after), ==, 2);
+
+  changes = gum_memory_snapshot_diff (before, after, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (changes->len, ==, 2);
+  g_assert_cmpuint (g_array_index (changes, GumMemoryChange, 0).offset, ==,
+      (2 * page_size) - 1 - 16);
+  g_array_free (changes, TRUE);
+
+  changes = gum_memory_snapshot_diff (after, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (changes->len, ==, 0);
+  g_array_free (changes, TRUE);
+
+  other_range.base_address = GUM_ADDRESS (pages);
+  other_range.size = page_size;
+  other = gum_memory_snapshot_take (&other_range, 1, NULL,
+      GUM_MEMORY_SNAPSHOT_FLAGS_NONE);
+  g_assert_null (gum_memory_snapshot_diff (before, other, &error));
+  g_assert_error (error, GUM_ERROR, GUM_ERROR_INVALID_ARGUMENT);
+  g_error_free (error);
+
+  gum_memory_snapshot_unref (other);
+  gum_memory_snapshot_unref (after);
+  gum_memory_snapshot_unref (before);
+  gum_free_pages (pages);
+}
+
+TESTCASE (small_allocations_are_recycled_across_threads)
+{
+  guint usage_before;
+  GThread * threads[4];
+  guint i;
+
+  usage_before = gum_peek_private_memory_usage ();
+
+  for (i = 0; i != G_N_ELEMENTS (threads); i++)
+  {
+    threads[i] = g_thread_new ("gum-test-heap-churn", churn_small_allocations,
+        NULL);
+  }
+  for (i = 0; i != G_N_ELEMENTS (threads); i++)
+    g_thread_join (threads[i]);
+
+  g_assert_cmpuint (gum_peek_private_memory_usage (), ==, usage_before);
+}
+
+static gpointer
+churn_small_allocations (gpointer data)
+{
+  gpointer blocks[256];
+  guint round, i;
+
+  for (round = 0; round != 16; round++)
+  {
+    for (i = 0; i != G_N_ELEMENTS (blocks); i++)
+    {
+      gsize size = 1 + ((round * 131 + i * 7) % 600);
+
+      blocks[i] = (i % 2 == 0) ? gum_malloc (size) : gum_malloc0 (size);
+      g_assert_cmpuint (gum_malloc_usable_size (blocks[i]), >=, size);
+      memset (blocks[i], 0x5a, size);
+    }
+
+    for (i = 0; i != G_N_ELEMENTS (blocks); i++)
+      gum_free (blocks[(i * 37) % G_N_ELEMENTS (blocks)]);
+  }
+
+  return NULL;
+}
+
 TESTCASE (alloc_n_pages_returns_aligned_rw_address)
 {
   gpointer page;
@@ -570,3 +1136,56 @@ match_found_cb (GumAddress address,
 
   return ctx->value_to_return;
 }
+
+static gboolean
+multi_match_found_cb (guint pattern_index,
+                      GumAddress address,
+                      gsize size,
+                      gpointer user_data)
+{
+  TestMultiScanContext * ctx = (TestMultiScanContext *) user_data;
+  guint n;
+
+  g_assert_cmpuint (pattern_index, <, G_N_ELEMENTS (ctx->number_of_matches));
+
+  n = ctx->number_of_matches[pattern_index];
+  g_assert_cmpuint (n, <, G_N_ELEMENTS (ctx->address[pattern_index]));
+
+  ctx->address[pattern_index][n] = address;
+  ctx->size[pattern_index][n] = size;
+  ctx->number_of_matches[pattern_index]++;
+
+  ctx->number_of_calls++;
+
+  return ctx->value_to_return;
+}
+
+static gboolean
+store_match_cb (GumAddress address,
+                gsize size,
+                gpointer user_data)
+{
+  GArray * matches = (GArray *) user_data;
+  GumMemoryRange match;
+
+  match.base_address = address;
+  match.size = size;
+  g_array_append_val (matches, match);
+
+  return TRUE;
+}
+
+static gboolean
+store_matches_until_limit_cb (GumAddress address,
+                              gsize size,
+                              gpointer user_data)
+{
+  TestStoreMatchesContext * ctx = user_data;
+  GumMemoryRange match;
+
+  match.base_address = address;
+  match.size = size;
+  g_array_append_val (ctx->matches, match);
+
+  return ctx->matches->len != ctx->limit;
+}
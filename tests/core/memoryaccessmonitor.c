@@ -9,6 +9,7 @@
 TESTLIST_BEGIN (memoryaccessmonitor)
   TESTENTRY (notify_on_read_access)
   TESTENTRY (notify_on_write_access)
+  TESTENTRY (notify_on_write_access_with_async_delivery)
   TESTENTRY (notify_on_execute_access)
   TESTENTRY (notify_should_include_progress)
   TESTENTRY (disable)
@@ -93,6 +94,47 @@ TESTCASE (notify_on_write_access)
 #endif
 }
 
+TESTCASE (notify_on_write_access_with_async_delivery)
+{
+  volatile guint8 * bytes = GSIZE_TO_POINTER (fixture->range.base_address);
+  guint page_size;
+  guint8 val;
+  volatile GumMemoryAccessDetails * d = &fixture->last_details;
+
+  page_size = gum_query_page_size ();
+
+  bytes[fixture->offset_in_first_page] = 0x13;
+  bytes[fixture->offset_in_second_page] = 0x37;
+
+  fixture->monitor = gum_memory_access_monitor_new (&fixture->range, 1,
+      GUM_PAGE_WRITE, TRUE, memory_access_notify_cb, fixture, NULL);
+  gum_memory_access_monitor_set_async_delivery (fixture->monitor, TRUE);
+  g_assert_true (gum_memory_access_monitor_enable (fixture->monitor, NULL));
+
+  val = bytes[fixture->offset_in_first_page];
+  g_assert_cmpuint (fixture->number_of_notifies, ==, 0);
+  g_assert_cmpuint (val, ==, 0x13);
+
+  bytes[fixture->offset_in_first_page] = 0x14;
+  g_assert_cmpuint (fixture->number_of_notifies, ==, 1);
+  g_assert_cmpuint (d->thread_id, ==, gum_process_get_current_thread_id ());
+  g_assert_cmpint (d->operation, ==, GUM_MEMOP_WRITE);
+  g_assert_true (d->address >= (gpointer) bytes &&
+      d->address < (gpointer) (bytes + page_size));
+  g_assert_cmpuint (d->page_index, ==, 0);
+  g_assert_cmpuint (d->pages_completed, ==, 1);
+
+  bytes[fixture->offset_in_first_page] = 0x15;
+  g_assert_cmpuint (fixture->number_of_notifies, ==, 1);
+  g_assert_cmpuint (bytes[fixture->offset_in_first_page], ==, 0x15);
+
+  DISABLE_MONITOR ();
+
+  bytes[fixture->offset_in_second_page] = 0x38;
+  g_assert_cmpuint (fixture->number_of_notifies, ==, 1);
+  g_assert_cmpuint (bytes[fixture->offset_in_second_page], ==, 0x38);
+}
+
 TESTCASE (notify_on_execute_access)
 {
   volatile GumMemoryAccessDetails * d = &fixture->last_details;
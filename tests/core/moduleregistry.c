@@ -6,6 +6,7 @@
 
 #include "gummoduleregistry.h"
 
+#include "gummodulemap.h"
 #include "testutil.h"
 
 #define TESTCASE(NAME) \
@@ -15,13 +16,30 @@
 
 TESTLIST_BEGIN (module_registry)
   TESTENTRY (module_registry_should_emit_signal_on_add)
+  TESTENTRY (module_map_should_follow_registry_signals)
+  TESTENTRY (module_map_should_handle_concurrent_signals)
 TESTLIST_END ()
 
+typedef struct _TestModuleMapStress TestModuleMapStress;
+
+struct _TestModuleMapStress
+{
+  GumModuleRegistry * registry;
+  GumModuleMap * map;
+  GumModule * module;
+  GumAddress address;
+  volatile gint running;
+};
+
 static void on_module_added (GumModuleRegistry * registry, GumModule * module,
     gpointer user_data);
 static void on_module_removed (GumModuleRegistry * registry, GumModule * module,
     gpointer user_data);
 
+static gpointer toggle_module (gpointer data);
+static gpointer look_up_module (gpointer data);
+static gpointer churn_module_maps (gpointer data);
+
 TESTCASE (module_registry_should_emit_signal_on_add)
 {
   GumModuleRegistry * registry;
@@ -42,6 +60,112 @@ TESTCASE (module_registry_should_emit_signal_on_add)
     g_usleep (60 * G_USEC_PER_SEC);
 }
 
+TESTCASE (module_map_should_follow_registry_signals)
+{
+  GumModuleRegistry * registry;
+  GumModuleMap * map;
+  GumModule * main_module, * found;
+  GumAddress address;
+
+  registry = gum_module_registry_obtain ();
+  map = gum_module_map_new ();
+
+  main_module = gum_process_get_main_module ();
+  address = gum_module_get_range (main_module)->base_address;
+
+  found = gum_module_map_find (map, address);
+  g_assert_nonnull (found);
+  g_assert_cmpstr (gum_module_get_path (found), ==,
+      gum_module_get_path (main_module));
+
+  g_signal_emit_by_name (registry, "module-removed", main_module);
+  g_assert_null (gum_module_map_find (map, address));
+
+  g_signal_emit_by_name (registry, "module-added", main_module);
+  found = gum_module_map_find (map, address);
+  g_assert_true (found == main_module);
+
+  g_object_unref (map);
+}
+
+TESTCASE (module_map_should_handle_concurrent_signals)
+{
+  TestModuleMapStress stress;
+  GThread * togglers[2], * readers[2], * churner;
+  guint i;
+
+  stress.registry = gum_module_registry_obtain ();
+  stress.map = gum_module_map_new ();
+  stress.module = gum_process_get_main_module ();
+  stress.address = gum_module_get_range (stress.module)->base_address;
+  stress.running = TRUE;
+
+  for (i = 0; i != G_N_ELEMENTS (readers); i++)
+    readers[i] = g_thread_new ("module-map-reader", look_up_module, &stress);
+  churner = g_thread_new ("module-map-churner", churn_module_maps, &stress);
+  for (i = 0; i != G_N_ELEMENTS (togglers); i++)
+    togglers[i] = g_thread_new ("module-map-toggler", toggle_module, &stress);
+
+  for (i = 0; i != G_N_ELEMENTS (togglers); i++)
+    g_thread_join (togglers[i]);
+  g_atomic_int_set (&stress.running, FALSE);
+  g_thread_join (churner);
+  for (i = 0; i != G_N_ELEMENTS (readers); i++)
+    g_thread_join (readers[i]);
+
+  g_assert_true (gum_module_map_find (stress.map, stress.address) ==
+      stress.module);
+
+  g_object_unref (stress.map);
+}
+
+static gpointer
+toggle_module (gpointer data)
+{
+  TestModuleMapStress * stress = data;
+  guint i;
+
+  for (i = 0; i != 2000; i++)
+  {
+    g_signal_emit_by_name (stress->registry, "module-removed", stress->module);
+    g_signal_emit_by_name (stress->registry, "module-added", stress->module);
+  }
+
+  return NULL;
+}
+
+static gpointer
+look_up_module (gpointer data)
+{
+  TestModuleMapStress * stress = data;
+
+  while (g_atomic_int_get (&stress->running))
+  {
+    GumModule * found;
+
+    found = gum_module_map_find (stress->map, stress->address);
+    if (found != NULL)
+    {
+      g_assert_true (found == stress->module);
+      g_assert_cmphex (gum_module_get_range (found)->base_address, ==,
+          stress->address);
+    }
+  }
+
+  return NULL;
+}
+
+static gpointer
+churn_module_maps (gpointer data)
+{
+  TestModuleMapStress * stress = data;
+
+  while (g_atomic_int_get (&stress->running))
+    g_object_unref (gum_module_map_new ());
+
+  return NULL;
+}
+
 static void
 on_module_added (GumModuleRegistry * registry,
                  GumModule * module,
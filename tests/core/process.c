@@ -22,6 +22,9 @@
 #if defined (HAVE_LINUX) && defined (HAVE_SYS_AUXV_H)
 # include <sys/auxv.h>
 #endif
+#if defined (HAVE_LINUX) && !defined (HAVE_ANDROID)
+# include <sys/mman.h>
+#endif
 
 #if defined (HAVE_LINUX)
 # include "gum/gumlinux.h"
@@ -45,6 +48,7 @@ TESTLIST_BEGIN (process)
   TESTENTRY (module_import_slot_should_contain_correct_value)
   TESTENTRY (module_exports)
   TESTENTRY (module_symbols)
+  TESTENTRY (module_symbol_can_be_found_by_name)
   TESTENTRY (module_ranges_can_be_enumerated)
   TESTENTRY (module_sections_can_be_enumerated)
   TESTENTRY (module_dependencies_can_be_enumerated)
@@ -53,6 +57,11 @@ TESTLIST_BEGIN (process)
 #ifndef HAVE_ASAN
   TESTENTRY (module_export_matches_system_lookup)
 #endif
+#ifdef HAVE_ELF
+  TESTENTRY (elf_module_export_can_be_found_by_name)
+  TESTENTRY (elf_module_sections_should_load_on_demand)
+  TESTENTRY (elf_module_from_memory_should_not_require_file)
+#endif
 #ifdef HAVE_WINDOWS
   TESTENTRY (get_set_system_error)
   TESTENTRY (get_current_thread_id)
@@ -71,6 +80,7 @@ TESTLIST_BEGIN (process)
 #endif
 #if defined (HAVE_LINUX) && !defined (HAVE_ANDROID)
   TESTENTRY (linux_process_modules)
+  TESTENTRY (linux_ranges_include_foreign_mappings)
 #endif
 #if defined (HAVE_LINUX) && defined (HAVE_SYS_AUXV_H)
   TESTENTRY (linux_get_cpu_from_auxv_null_32bit)
@@ -163,6 +173,8 @@ static gboolean export_found_cb (const GumExportDetails * details,
     gpointer user_data);
 static gboolean symbol_found_cb (const GumSymbolDetails * details,
     gpointer user_data);
+static gboolean store_first_defined_symbol (const GumSymbolDetails * details,
+    gpointer user_data);
 static gboolean range_found_cb (const GumRangeDetails * details,
     gpointer user_data);
 static gboolean range_check_cb (const GumRangeDetails * details,
@@ -179,6 +191,12 @@ static gboolean section_found_cb (const GumSectionDetails * details,
     gpointer user_data);
 static gboolean dep_found_cb (const GumDependencyDetails * details,
     gpointer user_data);
+#ifdef HAVE_ELF
+static gboolean count_defined_elf_function_with_section (
+    const GumElfSymbolDetails * details, gpointer user_data);
+static gboolean count_elf_section (const GumElfSectionDetails * details,
+    gpointer user_data);
+#endif
 
 TESTCASE (process_threads)
 {
@@ -388,6 +406,38 @@ verify_module_bounds (GumModule * module,
   return TRUE;
 }
 
+TESTCASE (linux_ranges_include_foreign_mappings)
+{
+  gsize page_size;
+  guint8 * page;
+  TestRangeContext ctx;
+
+  page_size = gum_query_page_size ();
+
+  g_assert_true (gum_memory_is_readable (&page_size, sizeof (page_size)));
+
+  page = mmap (NULL, 3 * page_size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  g_assert_true (page != (guint8 *) MAP_FAILED);
+  g_assert_cmpint (mprotect (page + page_size, page_size, PROT_READ), ==, 0);
+
+  ctx.range.base_address = GUM_ADDRESS (page + page_size);
+  ctx.range.size = page_size;
+  ctx.found = FALSE;
+  ctx.found_exact = FALSE;
+  gum_process_enumerate_ranges (GUM_PAGE_READ, range_check_cb, &ctx);
+  g_assert_true (ctx.found_exact);
+
+  g_assert_true (gum_memory_is_readable (page, 3 * page_size));
+
+  munmap (page, 3 * page_size);
+
+  ctx.found = FALSE;
+  ctx.found_exact = FALSE;
+  gum_process_enumerate_ranges (GUM_PAGE_READ, range_check_cb, &ctx);
+  g_assert_false (ctx.found_exact);
+}
+
 #endif
 
 #if defined (HAVE_LINUX) && defined (HAVE_SYS_AUXV_H)
@@ -816,6 +866,28 @@ TESTCASE (module_symbols)
   g_object_unref (module);
 }
 
+TESTCASE (module_symbol_can_be_found_by_name)
+{
+  GumModule * module;
+  GumSymbolDetails first = { 0, };
+
+  module = gum_process_find_module_by_name (GUM_TESTS_MODULE_NAME);
+  g_assert_nonnull (module);
+
+  gum_module_enumerate_symbols (module, store_first_defined_symbol, &first);
+  g_assert_nonnull (first.name);
+
+  g_assert_cmphex (gum_module_find_symbol_by_name (module, first.name), ==,
+      first.address);
+  g_assert_cmphex (gum_module_find_symbol_by_name (module, first.name), ==,
+      first.address);
+  g_assert_cmphex (gum_module_find_symbol_by_name (module,
+      "gum_test_symbol_that_does_not_exist"), ==, 0);
+
+  g_free ((gchar *) first.name);
+  g_object_unref (module);
+}
+
 TESTCASE (module_ranges_can_be_enumerated)
 {
   GumModule * module;
@@ -943,6 +1015,169 @@ TESTCASE (module_export_matches_system_lookup)
 #endif
 }
 
+#ifdef HAVE_ELF
+
+TESTCASE (elf_module_export_can_be_found_by_name)
+{
+  GumModule * module;
+  const GumMemoryRange * range;
+  void * lib, * system_address;
+  GumElfModule * online, * offline;
+  GumAddress online_address, offline_address;
+  GError * error = NULL;
+
+  module = gum_process_find_module_by_name (SYSTEM_MODULE_NAME);
+  g_assert_nonnull (module);
+  range = gum_module_get_range (module);
+
+  lib = dlopen (gum_module_get_path (module), RTLD_LAZY | RTLD_NOLOAD);
+  g_assert_nonnull (lib);
+  system_address = dlsym (lib, SYSTEM_MODULE_EXPORT);
+  g_assert_nonnull (system_address);
+
+  online = gum_elf_module_new_from_memory (gum_module_get_path (module),
+      range->base_address, &error);
+  g_assert_no_error (error);
+
+  online_address =
+      gum_elf_module_find_export_by_name (online, SYSTEM_MODULE_EXPORT);
+  g_assert_cmphex (online_address, ==, GPOINTER_TO_SIZE (system_address));
+  g_assert_cmphex (
+      gum_elf_module_find_export_by_name (online, "gum_nonexistent_export"),
+      ==, 0);
+
+  offline = gum_elf_module_new_from_file (gum_module_get_path (module),
+      &error);
+  g_assert_no_error (error);
+
+  offline_address =
+      gum_elf_module_find_export_by_name (offline, SYSTEM_MODULE_EXPORT);
+  g_assert_cmphex (offline_address, !=, 0);
+  g_assert_cmphex (
+      offline_address - gum_elf_module_get_base_address (offline), ==,
+      online_address - range->base_address);
+
+  g_object_unref (offline);
+  g_object_unref (online);
+
+  dlclose (lib);
+
+  g_object_unref (module);
+}
+
+TESTCASE (elf_module_sections_should_load_on_demand)
+{
+  GumModule * module;
+  GumElfModule * elf;
+  GumElfSymbolDetails details;
+  guint n_functions, n_sections;
+  GError * error = NULL;
+
+  module = gum_process_find_module_by_name (SYSTEM_MODULE_NAME);
+  g_assert_nonnull (module);
+
+  elf = gum_elf_module_new_from_memory (gum_module_get_path (module),
+      gum_module_get_range (module)->base_address, &error);
+  g_assert_no_error (error);
+
+  g_assert_true (gum_elf_module_find_dynamic_symbol_by_name (elf,
+      SYSTEM_MODULE_EXPORT, &details));
+  g_assert_cmphex (details.address, !=, 0);
+  g_assert_null (details.section);
+
+  g_object_unref (elf);
+
+  elf = gum_elf_module_new_from_memory (gum_module_get_path (module),
+      gum_module_get_range (module)->base_address, &error);
+  g_assert_no_error (error);
+
+  g_assert_true (gum_elf_module_find_dynamic_symbol_by_name (elf,
+      SYSTEM_MODULE_EXPORT, &details));
+  g_assert_null (details.section);
+
+  n_functions = 0;
+  gum_elf_module_enumerate_dynamic_symbols (elf,
+      count_defined_elf_function_with_section, &n_functions);
+  g_assert_cmpuint (n_functions, >, 0);
+
+  n_sections = 0;
+  gum_elf_module_enumerate_sections (elf, count_elf_section, &n_sections);
+  g_assert_cmpuint (n_sections, >, 1);
+
+  g_assert_true (gum_elf_module_find_dynamic_symbol_by_name (elf,
+      SYSTEM_MODULE_EXPORT, &details));
+  g_assert_nonnull (details.section);
+
+  g_object_unref (elf);
+  g_object_unref (module);
+}
+
+TESTCASE (elf_module_from_memory_should_not_require_file)
+{
+  GumModule * module;
+  GumElfModule * elf;
+  gchar * bogus_path;
+  GumElfSymbolDetails details;
+  guint n_sections;
+  GError * error = NULL;
+
+  module = gum_process_find_module_by_name (SYSTEM_MODULE_NAME);
+  g_assert_nonnull (module);
+
+  /*
+   * The file is only needed for section details, so a module whose file has
+   * gone away still loads, just without any sections.
+   */
+  bogus_path = g_build_filename ("/nonexistent", SYSTEM_MODULE_NAME, NULL);
+  elf = gum_elf_module_new_from_memory (bogus_path,
+      gum_module_get_range (module)->base_address, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (elf);
+  g_free (bogus_path);
+
+  g_assert_true (gum_elf_module_find_dynamic_symbol_by_name (elf,
+      SYSTEM_MODULE_EXPORT, &details));
+  g_assert_cmphex (details.address, ==, gum_module_find_export_by_name (
+      module, SYSTEM_MODULE_EXPORT));
+
+  n_sections = 0;
+  gum_elf_module_enumerate_sections (elf, count_elf_section, &n_sections);
+  g_assert_cmpuint (n_sections, ==, 0);
+  g_assert_null (gum_elf_module_get_file_data (elf, NULL));
+
+  g_object_unref (elf);
+  g_object_unref (module);
+}
+
+static gboolean
+count_defined_elf_function_with_section (const GumElfSymbolDetails * details,
+                                         gpointer user_data)
+{
+  guint * n_functions = user_data;
+
+  if (details->type != GUM_ELF_SYMBOL_FUNC ||
+      details->shdr_index == GUM_ELF_SHDR_INDEX_UNDEF)
+    return TRUE;
+
+  g_assert_nonnull (details->section);
+  (*n_functions)++;
+
+  return TRUE;
+}
+
+static gboolean
+count_elf_section (const GumElfSectionDetails * details,
+                   gpointer user_data)
+{
+  guint * n_sections = user_data;
+
+  (*n_sections)++;
+
+  return TRUE;
+}
+
+#endif
+
 #ifndef HAVE_WINDOWS
 
 static gboolean
@@ -1337,6 +1572,21 @@ symbol_found_cb (const GumSymbolDetails * details,
   return ctx->value_to_return;
 }
 
+static gboolean
+store_first_defined_symbol (const GumSymbolDetails * details,
+                            gpointer user_data)
+{
+  GumSymbolDetails * first = user_data;
+
+  if (details->address == 0 || details->name[0] == '\0')
+    return TRUE;
+
+  *first = *details;
+  first->name = g_strdup (details->name);
+
+  return FALSE;
+}
+
 static gboolean
 range_found_cb (const GumRangeDetails * details,
                 gpointer user_data)
@@ -191,6 +191,8 @@ TESTLIST_BEGIN (script)
     TESTENTRY (ansi_string_can_be_allocated_in_code_page_1252)
 #endif
     TESTENTRY (read_from_unaccessible_memory_can_be_performed_safely)
+    TESTENTRY (many_ranges_can_be_read_in_one_go)
+    TESTENTRY (memory_snapshots_can_be_diffed)
     TESTENTRY (write_to_unaccessible_memory_can_be_performed_safely)
     TESTENTRY (invalid_read_results_in_exception)
     TESTENTRY (invalid_write_results_in_exception)
@@ -199,6 +201,7 @@ TESTLIST_BEGIN (script)
     TESTENTRY (memory_can_be_scanned_with_match_pattern_object)
     TESTENTRY (memory_can_be_scanned_synchronously)
     TESTENTRY (memory_can_be_scanned_asynchronously)
+    TESTENTRY (memory_can_be_scanned_for_multiple_patterns)
     TESTENTRY (memory_scan_should_be_interruptible)
     TESTENTRY (memory_scan_handles_unreadable_memory)
     TESTENTRY (memory_scan_handles_bad_arguments)
@@ -369,6 +372,7 @@ TESTLIST_BEGIN (script)
 
   TESTGROUP_BEGIN ("DebugSymbol")
     TESTENTRY (address_can_be_resolved_to_symbol)
+    TESTENTRY (addresses_can_be_resolved_to_symbols)
     TESTENTRY (name_can_be_resolved_to_symbol)
     TESTENTRY (function_can_be_found_by_name)
     TESTENTRY (functions_can_be_found_by_name)
@@ -1461,6 +1465,29 @@ TESTCASE (address_can_be_resolved_to_symbol)
   EXPECT_NO_MESSAGES ();
 }
 
+TESTCASE (addresses_can_be_resolved_to_symbols)
+{
+#ifdef HAVE_ANDROID
+  if (!g_test_slow ())
+  {
+    g_print ("<skipping, run in slow mode> ");
+    return;
+  }
+#endif
+
+  COMPILE_AND_LOAD_SCRIPT (
+      "const address = " GUM_PTR_CONST ";"
+      "const syms = DebugSymbol.fromAddresses([address, address]);"
+      "send(syms.length);"
+      "send(syms[0].name);"
+      "send(syms[1].address.equals(address));",
+      target_function_int);
+  EXPECT_SEND_MESSAGE_WITH ("2");
+  EXPECT_SEND_MESSAGE_WITH ("\"target_function_int\"");
+  EXPECT_SEND_MESSAGE_WITH ("true");
+  EXPECT_NO_MESSAGES ();
+}
+
 TESTCASE (name_can_be_resolved_to_symbol)
 {
   gchar * expected;
@@ -8335,6 +8362,39 @@ TESTCASE (memory_can_be_scanned_asynchronously)
   EXPECT_SEND_MESSAGE_WITH ("\"access violation accessing 0xdead\"");
 }
 
+TESTCASE (memory_can_be_scanned_for_multiple_patterns)
+{
+  guint8 haystack[] = { 0x01, 0x02, 0x13, 0x37, 0x03, 0x13, 0x37 };
+
+  COMPILE_AND_LOAD_SCRIPT (
+      "for (const match of Memory.scanMultiSync(" GUM_PTR_CONST ", 7, "
+          "['13 37', new MatchPattern('02 13')])) {"
+      "  send(`match index=${match.index} "
+          "offset=${match.address.sub(" GUM_PTR_CONST ").toInt32()} "
+          "size=${match.size}`);"
+      "}"
+      "send('done');",
+      haystack, haystack);
+  EXPECT_SEND_MESSAGE_WITH ("\"match index=1 offset=1 size=2\"");
+  EXPECT_SEND_MESSAGE_WITH ("\"match index=0 offset=2 size=2\"");
+  EXPECT_SEND_MESSAGE_WITH ("\"match index=0 offset=5 size=2\"");
+  EXPECT_SEND_MESSAGE_WITH ("\"done\"");
+
+  COMPILE_AND_LOAD_SCRIPT (
+      "Memory.scanMulti(" GUM_PTR_CONST ", 7, ['13 37', '02 13'], {"
+      "  onMatch(address, size, index) {"
+      "    send('onMatch index=' + index + ' offset=' +"
+      "      address.sub(" GUM_PTR_CONST ").toInt32() + ' size=' + size);"
+      "  }"
+      "})"
+      ".catch(e => console.error(e.message))"
+      ".then(() => send('DONE'));", haystack, haystack);
+  EXPECT_SEND_MESSAGE_WITH ("\"onMatch index=1 offset=1 size=2\"");
+  EXPECT_SEND_MESSAGE_WITH ("\"onMatch index=0 offset=2 size=2\"");
+  EXPECT_SEND_MESSAGE_WITH ("\"onMatch index=0 offset=5 size=2\"");
+  EXPECT_SEND_MESSAGE_WITH ("\"DONE\"");
+}
+
 TESTCASE (memory_scan_should_be_interruptible)
 {
   guint8 haystack[] = { 0x01, 0x02, 0x13, 0x37, 0x03, 0x13, 0x37 };
@@ -9512,6 +9572,44 @@ TESTCASE (read_from_unaccessible_memory_can_be_performed_safely)
   EXPECT_ERROR_MESSAGE_WITH (ANY_LINE_NUMBER, "Error: memory read failed");
 }
 
+TESTCASE (many_ranges_can_be_read_in_one_go)
+{
+  const guint8 buf[3] = { 0x13, 0x37, 0x42 };
+
+  COMPILE_AND_LOAD_SCRIPT (
+      "const [a, b, c] = Memory.readMany(["
+      "  { base: " GUM_PTR_CONST ", size: 2 },"
+      "  { base: ptr(1234), size: 8 },"
+      "  { base: " GUM_PTR_CONST ".add(2), size: 1 },"
+      "]);"
+      "send(b, a);"
+      "send(c.byteLength, c);",
+      buf, buf);
+  EXPECT_SEND_MESSAGE_WITH_PAYLOAD_AND_DATA ("null", "13 37");
+  EXPECT_SEND_MESSAGE_WITH_PAYLOAD_AND_DATA ("1", "42");
+}
+
+TESTCASE (memory_snapshots_can_be_diffed)
+{
+  guint8 buf[64] = { 0, };
+
+  COMPILE_AND_LOAD_SCRIPT (
+      "const range = { base: " GUM_PTR_CONST ", size: 64 };"
+      "const before = new MemorySnapshot([range]);"
+      "range.base.add(10).writeU16(0x1337);"
+      "range.base.add(40).writeU8(0x42);"
+      "const after = new MemorySnapshot([range], before);"
+      "const live = before.diff();"
+      "const { offsets, sizes } = before.diff(after);"
+      "send([after.size, Array.from(offsets), Array.from(sizes)]);"
+      "send(live.offsets.length === offsets.length);"
+      "send(after.diff().offsets.length);",
+      buf);
+  EXPECT_SEND_MESSAGE_WITH ("[64,[10,40],[2,1]]");
+  EXPECT_SEND_MESSAGE_WITH ("true");
+  EXPECT_SEND_MESSAGE_WITH ("0");
+}
+
 TESTCASE (write_to_unaccessible_memory_can_be_performed_safely)
 {
   guint8 buf[3] = { 0x13, 0x37, 0x42 };